@@ -5,6 +5,7 @@
 #include <boost/log/expressions.hpp>
 #include <boost/log/sinks/text_file_backend.hpp>
 #include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
 #include <boost/log/sources/severity_channel_logger.hpp>
 #include <boost/log/sources/record_ostream.hpp>
 #include <boost/log/utility/setup/file.hpp>
@@ -15,9 +16,37 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
 
+#include "applogger_async_queue.hxx"
+#include "applogger_format.hxx"
+#include "applogger_binary.hxx"
+#include "applogger_ring_buffer.hxx"
+#include "applogger_rate_limiter.hxx"
+#include "applogger_file_collector.hxx"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Lowest severity (as the index of AppLogger::Severity) compiled into the logging 
+// calls; set through the APPLOGGER_MIN_SEVERITY CMake option
+#ifndef APPLOGGER_COMPILE_MIN_SEVERITY
+#define APPLOGGER_COMPILE_MIN_SEVERITY 0
+#endif
 
 namespace logging = boost::log;
 namespace sinks = boost::log::sinks;
@@ -40,6 +69,78 @@ public:
 
     static Severity severityFromString(const std::string& str) noexcept(false);
 
+    // Whether messages of this severity are compiled in at all
+    static constexpr bool isCompiledIn(const Severity severity)
+    {
+        return static_cast<int>(severity) >= APPLOGGER_COMPILE_MIN_SEVERITY;
+    }
+
+    // Behaviour of an asynchronous sink when its record queue is full
+    using OverflowPolicy = AsyncRecordQueue::OverflowPolicy;
+
+    static OverflowPolicy overflowPolicyFromString(const std::string& str) noexcept(false);
+
+    // Kind of file a channel sink writes
+    enum class SinkType
+    {
+        TextFile,       // formatted text lines
+        BinaryFile,     // compact binary records, see applogger_binary.hxx and app-logger-decode
+        RingBuffer      // formatted text lines in a fixed-size memory-mapped file, see app-logger-ring-dump
+    };
+
+    static SinkType sinkTypeFromString(const std::string& str) noexcept(false);
+
+    // Options controlling how a channel sink is created
+    struct SinkOptions
+    {
+        // Kind of file to write; binary sinks ignore the format string
+        SinkType type = SinkType::TextFile;
+
+        // Write records from a dedicated thread instead of the caller's thread
+        bool asynchronous = false;
+
+        // Max number of records waiting for the writer thread (asynchronous only)
+        std::size_t queueCapacity = 8192;
+
+        // What to do with new records when the queue is full (asynchronous only)
+        OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+
+        // Bytes of records kept by a ring buffer sink
+        std::uint64_t ringBufferSize = logring::defaultCapacity;
+
+        // Text files are rotated when they reach this size (0 = no size limit)...
+        std::uintmax_t rotationSize = 10 * 1024 * 1024;
+
+        // ... and every interval (0 = daily at midnight)
+        std::chrono::seconds rotationInterval{ 0 };
+
+        // How many rotated text files to keep and whether to compress them
+        RetentionOptions retention;
+
+        // Limits on the messages of the channel; they apply to all its sinks
+        // and replace the limits set by an earlier sink of the same channel
+        RateLimitOptions rateLimit;
+    };
+
+    // Channel-specific logger type
+    typedef logging::sources::severity_channel_logger_mt<Severity, std::string> channel_logger_t;
+
+    // Stable reference to a registered channel; cache it to log 
+    // without looking the channel up by name on every call
+    struct ChannelHandle
+    {
+        std::uint32_t id;
+    };
+
+    // Max number of distinct channels a logger can register
+    static constexpr std::size_t maxChannels = 1024;
+
+    // Parse options given as "key=value" pairs separated by ';', 
+    // e.g. "type=binary; async=true; queue_size=4096; overflow=drop_oldest", "type=ring; ring_size=16M"
+    // "rate_limit=100; burst=500; sample_first=10; sample_every=1000; dedup_window_ms=5000"
+    // or "rotation_size=100M; rotation_interval=6h; max_files=20; max_total_size=2G; compress=true"
+    static SinkOptions sinkOptionsFromString(const std::string& str) noexcept(false);
+
     // Singleton instance getter
     static AppLogger& getInstance();
 
@@ -53,6 +154,14 @@ public:
         const std::string& format
     );
 
+    void addChannelSinkWithFormat(
+        const std::string& channel,
+        const std::string& filename,
+        const Severity minSeverity,
+        const std::string& format,
+        const SinkOptions& options
+    );
+
     // Add a channel-specific sink with custom filter and format
     void addChannelSink(
         const std::string& channel,
@@ -60,65 +169,390 @@ public:
         const Severity minSeverity
     );
 
-    // Log a message to a specific channel with specified severity
+    void addChannelSink(
+        const std::string& channel,
+        const std::string& filename,
+        const Severity minSeverity,
+        const SinkOptions& options
+    );
+
+    // Number of records discarded by the asynchronous sinks of a channel
+    std::uintmax_t getDroppedRecordCount(const std::string& channel) const;
+
+    // Number of messages of a channel suppressed by its rate limits
+    std::uintmax_t getSuppressedCount(const std::string& channel) const;
+
+    // Log a summary (count, min, max, p50, p99) of every timer zone recorded with
+    // timeutils::ScopedTimer (time_utilities/scoped_timer.hpp) to a channel, at Info severity
+    void reportTimers(const std::string& channel);
+
+    // Report the timers to a channel every interval from a background thread,
+    // replacing any earlier periodic report, until stopTimerReports is called
+    void startTimerReports(const std::string& channel, const std::chrono::seconds interval) noexcept(false);
+
+    // Stop the periodic timer reports, if any
+    void stopTimerReports();
+
+    // Register a channel (or find the one already registered) and return its handle.
+    // Safe to call from any thread; the handle stays valid for the lifetime of the logger.
+    // Throws if maxChannels channels are already registered.
+    ChannelHandle registerChannel(const std::string& channel) noexcept(false);
+
+    // Name of a registered channel
+    const std::string& channelName(const ChannelHandle handle) const;
+
+    // Whether a handle refers to a registered channel (e.g. an id received through the C interface)
+    bool isRegistered(const ChannelHandle handle) const
+    {
+        return handle.id < maxChannels && channels[handle.id].load(std::memory_order_acquire) != nullptr;
+    }
+
+    // Messages below the threshold are discarded before a record is created.
+    // The threshold follows the lowest severity accepted by the sinks added so far;
+    // setting it explicitly overrides that until the next sink is added.
+    void setSeverityThreshold(const Severity severity)
+    {
+        severityThreshold.store(static_cast<int>(severity), std::memory_order_relaxed);
+    }
+
+    Severity getSeverityThreshold() const
+    {
+        return static_cast<Severity>(severityThreshold.load(std::memory_order_relaxed));
+    }
+
+    // Whether a message of this severity would be passed on to the sinks
+    bool isEnabled(const Severity severity) const
+    {
+        return isCompiledIn(severity) && 
+            static_cast<int>(severity) >= severityThreshold.load(std::memory_order_relaxed);
+    }
+
+    // Log a message to a specific channel with specified severity. Once
+    // maxChannels channels are registered, messages to other channels are
+    // logged without one (no rate limits, and only the console prints them).
     template<typename T>
     void logToChannel(const std::string& channel, const Severity severity, const T& message) 
     {
+        if (!isEnabled(severity))
+            return;
+
+        const ChannelHandle handle = findOrRegisterChannel(channel);
+        if (isRegistered(handle))
+            logToChannel(handle, severity, message);
+        else
+            logUnregistered(channel, severity, message);
+    }
+
+    // Log a message to a registered channel; the lookup is a single array read.
+    // The rate limits are only charged for records that a sink accepts.
+    template<typename T>
+    void logToChannel(const ChannelHandle channel, const Severity severity, const T& message) 
+    {
+        if (!isEnabled(severity))
+            return;
+
+        auto& slg = getChannelLogger(channel);
+        logging::record rec = slg.open_record(keywords::severity = severity);
+        if (!rec || isSuppressed(channel, [&message]() { return messageKey(message); }))
+            return;
+
+        logging::record_ostream strm(rec);
+        strm << message;
+        strm.flush();
+        slg.push_record(boost::move(rec));
+    }
+
+    // Log a message built from a "{}"-style format string, e.g. 
+    // logf(channel, Severity::Debug, "iteration {} residual {}", i, r).
+    // The arguments are only formatted if a sink accepts the record and the rate
+    // limits let it through (they are only charged for accepted records), and the
+    // message is built in a per-thread buffer that is reused between calls.
+    template<typename... Args>
+    void logf(const ChannelHandle channel, const Severity severity, const char* fmt, const Args&... args)
+    {
+        if (!isEnabled(severity))
+            return;
+
         auto& slg = getChannelLogger(channel);
-        BOOST_LOG_SEV(slg, severity) << message;
+        logging::record rec = slg.open_record(keywords::severity = severity);
+        if (!rec || isSuppressed(channel, [&]() { return formatKey(fmt, args...); }))
+            return;
+
+        // Binary sinks store the raw arguments; the message text is only
+        // built if a text sink (or the console) may print the record
+        const ChannelEntry& entry = *channels[channel.id].load(std::memory_order_acquire);
+        const int binarySinks = entry.binarySinks.load(std::memory_order_relaxed);
+        if (binarySinks > 0)
+        {
+            logbinary::Payload payload{ logbinary::format_id(fmt), std::string() };
+            logbinary::pack(payload.args, args...);
+            rec.attribute_values().insert("BinaryPayload", attrs::make_attribute_value(std::move(payload)));
+        }
+
+        if (binarySinks == 0 || entry.textSinks.load(std::memory_order_relaxed) > 0 ||
+            static_cast<int>(severity) >= consoleSeverity.load(std::memory_order_relaxed))
+        {
+            std::string& buffer = logformat::thread_buffer();
+            logformat::format_to(buffer, fmt, args...);
+
+            logging::record_ostream strm(rec);
+            strm.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            strm.flush();
+        }
+        slg.push_record(boost::move(rec));
+    }
+
+    template<typename... Args>
+    void logf(const std::string& channel, const Severity severity, const char* fmt, const Args&... args)
+    {
+        if (!isEnabled(severity))
+            return;
+
+        const ChannelHandle handle = findOrRegisterChannel(channel);
+        if (isRegistered(handle))
+        {
+            logf(handle, severity, fmt, args...);
+            return;
+        }
+
+        std::string& buffer = logformat::thread_buffer();
+        logformat::format_to(buffer, fmt, args...);
+        logUnregistered(channel, severity, std::string_view(buffer));
     }
 
     // Convenience methods for different severity levels with channel specification
     template<typename T> 
     void debug(const std::string& channel, const T& message) 
     { 
-        logToChannel(channel, Severity::Debug, message); 
+        if constexpr (isCompiledIn(Severity::Debug))
+            logToChannel(channel, Severity::Debug, message); 
+    }
+
+    template<typename T> 
+    void debug(const ChannelHandle channel, const T& message) 
+    { 
+        if constexpr (isCompiledIn(Severity::Debug))
+            logToChannel(channel, Severity::Debug, message); 
     }
     
     template<typename T> 
     void info(const std::string& channel, const T& message) 
     { 
-        logToChannel(channel, Severity::Info, message); 
+        if constexpr (isCompiledIn(Severity::Info))
+            logToChannel(channel, Severity::Info, message); 
+    }
+
+    template<typename T> 
+    void info(const ChannelHandle channel, const T& message) 
+    { 
+        if constexpr (isCompiledIn(Severity::Info))
+            logToChannel(channel, Severity::Info, message); 
     }
     
     template<typename T> 
     void warning(const std::string& channel, const T& message) 
     { 
-        logToChannel(channel, Severity::Warning, message); 
+        if constexpr (isCompiledIn(Severity::Warning))
+            logToChannel(channel, Severity::Warning, message); 
+    }
+
+    template<typename T> 
+    void warning(const ChannelHandle channel, const T& message) 
+    { 
+        if constexpr (isCompiledIn(Severity::Warning))
+            logToChannel(channel, Severity::Warning, message); 
     }
     
     template<typename T> 
     void error(const std::string& channel, const T& message) 
     { 
-        logToChannel(channel, Severity::Error, message); 
+        if constexpr (isCompiledIn(Severity::Error))
+            logToChannel(channel, Severity::Error, message); 
+    }
+
+    template<typename T> 
+    void error(const ChannelHandle channel, const T& message) 
+    { 
+        if constexpr (isCompiledIn(Severity::Error))
+            logToChannel(channel, Severity::Error, message); 
     }
     
     template<typename T> 
     void critical(const std::string& channel, const T& message) 
     { 
-        logToChannel(channel, Severity::Critical, message); 
+        if constexpr (isCompiledIn(Severity::Critical))
+            logToChannel(channel, Severity::Critical, message); 
+    }
+
+    template<typename T> 
+    void critical(const ChannelHandle channel, const T& message) 
+    { 
+        if constexpr (isCompiledIn(Severity::Critical))
+            logToChannel(channel, Severity::Critical, message); 
     }
 
     AppLogger() = default;
-    ~AppLogger() = default;
+
+    // Removes the channel sinks from the core, writing out anything still queued
+    ~AppLogger();
 private:
     
     AppLogger(const AppLogger&) = delete;
     AppLogger& operator=(const AppLogger&) = delete;
 
+    // Lowest severity passed on to the sinks, see setSeverityThreshold
+    std::atomic<int> severityThreshold{ static_cast<int>(Severity::Debug) };
+
+    // Guards the sink containers below, formatterCache and lowestSinkSeverity
+    mutable std::mutex sinkMutex;
+
+    // Lowest severity accepted by any sink added through this logger
+    int lowestSinkSeverity = static_cast<int>(Severity::Critical) + 1;
+
+    // Lower the threshold so that messages for a newly added sink get through; sinkMutex must be held
+    void acceptSeverity(const Severity severity);
+
+    // Keep the logging core alive for as long as the sinks are attached to it
+    boost::shared_ptr<logging::core> loggingCore = logging::core::get();
+
+    // Console sink created by init()
+    boost::shared_ptr<sinks::sink> consoleSink;
+
+    // Lowest severity the console sink prints (above Critical if there is no console)
+    std::atomic<int> consoleSeverity{ static_cast<int>(Severity::Critical) + 1 };
+
     // Store channel-specific sinks
-    std::map<std::string, boost::shared_ptr<sinks::synchronous_sink<sinks::text_file_backend>>> channelSinks;
+    std::multimap<std::string, boost::shared_ptr<sinks::sink>> channelSinks;
+
+    // Formatters by format string ("" for the default format), shared by all 
+    // sinks using the same format so that a record is formatted once for all of them
+    std::unordered_map<std::string, logging::formatter> formatterCache;
+
+    // Asynchronous sinks, which need to be stopped and drained on destruction
+    struct AsyncSinkEntry
+    {
+        boost::shared_ptr<sinks::sink> sink;
+        AsyncRecordQueue* queue;
+        std::function<void()> stop;
+    };
+    std::multimap<std::string, AsyncSinkEntry> asyncChannelSinks;
     
-    // Store channel-specific loggers
-    std::map<std::string, boost::shared_ptr<logging::sources::severity_channel_logger<Severity, std::string>>> channelLoggers;
+    // Per-channel state, created on registration and kept until the logger is destroyed
+    struct ChannelEntry
+    {
+        explicit ChannelEntry(const std::string& channel) :
+            name(channel), logger(keywords::channel = channel)
+        {}
+
+        const std::string name;
+        channel_logger_t logger;
+
+        // Number of text and binary sinks added for this channel
+        std::atomic<int> textSinks{ 0 };
+        std::atomic<int> binarySinks{ 0 };
+
+        // Current rate limiter (null if none); every limiter ever set is kept
+        // in limiters, guarded by sinkMutex, so a logging thread can still use 
+        // the one it loaded
+        std::atomic<RateLimiter*> limiter{ nullptr };
+        std::vector<std::unique_ptr<RateLimiter>> limiters;
+    };
+
+    // Registered channels, indexed by ChannelHandle::id. Entries are published
+    // once and never change, so reading them needs no lock.
+    std::array<std::atomic<ChannelEntry*>, maxChannels> channels{};
+
+    // Owns the channel entries and maps channel names to ids; guarded by channelRegistryMutex
+    std::vector<std::unique_ptr<ChannelEntry>> channelStorage;
+    std::unordered_map<std::string, std::uint32_t> channelIds;
+    mutable std::shared_mutex channelRegistryMutex;
+
+    // Background thread of startTimerReports and what it needs to stop
+    std::thread timerReportThread;
+    std::mutex timerReportMutex;
+    std::condition_variable timerReportWake;
+    bool timerReportStop = false;
 
     // Initialize console sink with custom format
     void initConsoleSink();
 
-    // Get or create a channel-specific logger
-    logging::sources::severity_channel_logger<Severity, std::string>& getChannelLogger(
-        const std::string& channel
+    // Wrap a backend in a (synchronous or asynchronous) frontend and register it with the core
+    template<typename BackendT>
+    void addChannelFrontend(
+        const std::string& channel,
+        const boost::shared_ptr<BackendT>& backend,
+        const Severity minSeverity,
+        const logging::formatter& formatter,
+        const SinkOptions& options
     );
+
+    // Formatter for a format string, parsed on first use and then taken from formatterCache
+    logging::formatter sharedFormatter(const std::string& format);
+
+    // Create the file sink for a channel and register it with the core
+    void attachChannelSink(
+        const std::string& channel,
+        const std::string& filename,
+        const Severity minSeverity,
+        const logging::formatter& formatter,
+        const SinkOptions& options
+    );
+
+    // registerChannel, but an invalid handle (see isRegistered) instead of throwing
+    // when maxChannels channels are already registered
+    ChannelHandle findOrRegisterChannel(const std::string& channel);
+
+    // Log a message to a channel that could not be registered, through a logger
+    // made for the call; only sinks not tied to a channel (the console) get it
+    template<typename T>
+    void logUnregistered(const std::string& channel, const Severity severity, const T& message)
+    {
+        channel_logger_t slg(keywords::channel = channel);
+        logging::record rec = slg.open_record(keywords::severity = severity);
+        if (!rec)
+            return;
+
+        logging::record_ostream strm(rec);
+        strm << message;
+        strm.flush();
+        slg.push_record(boost::move(rec));
+    }
+
+    // Get the logger of a registered channel
+    channel_logger_t& getChannelLogger(const ChannelHandle channel)
+    {
+        return channels[channel.id].load(std::memory_order_acquire)->logger;
+    }
+
+    // Whether the rate limits of the channel suppress a message; the key 
+    // identifying the message is only computed if the limits deduplicate
+    template<typename KeyF>
+    bool isSuppressed(const ChannelHandle channel, const KeyF& key)
+    {
+        RateLimiter* limiter = channels[channel.id].load(std::memory_order_acquire)->limiter.load(std::memory_order_acquire);
+        return limiter && !limiter->allow(limiter->deduplicates() ? key() : 0);
+    }
+
+    // Deduplication key of a message; messages that are not text are not deduplicated
+    template<typename T>
+    static std::size_t messageKey(const T& message)
+    {
+        if constexpr (std::is_convertible<const T&, std::string_view>::value)
+            return std::hash<std::string_view>()(std::string_view(message)) | 1;
+        else
+            return 0;
+    }
+
+    // Deduplication key of a logf message, from the format string and the
+    // packed arguments (so the message does not need to be formatted)
+    template<typename... Args>
+    static std::size_t formatKey(const char* fmt, const Args&... args)
+    {
+        thread_local std::string packed;
+        packed.assign(fmt);
+        logbinary::pack(packed, args...);
+        return std::hash<std::string>()(packed) | 1;
+    }
 };
 
 // Severity level to string conversion
@@ -143,3 +577,17 @@ std::basic_ostream<CharT, TraitsT>& operator<<(
     
     return strm;
 }
+
+// Logging macros that skip evaluating the message when the severity is compiled 
+// out or below the logger's threshold, e.g. APPLOGGER_DEBUG(logger, "solver", "x = " + std::to_string(x));
+#define APPLOGGER_LOG(logger, channel, severity, message) \
+    do { \
+        if ((logger).isEnabled(severity)) \
+            (logger).logToChannel((channel), (severity), (message)); \
+    } while (0)
+
+#define APPLOGGER_DEBUG(logger, channel, message)     APPLOGGER_LOG(logger, channel, AppLogger::Severity::Debug, message)
+#define APPLOGGER_INFO(logger, channel, message)      APPLOGGER_LOG(logger, channel, AppLogger::Severity::Info, message)
+#define APPLOGGER_WARNING(logger, channel, message)   APPLOGGER_LOG(logger, channel, AppLogger::Severity::Warning, message)
+#define APPLOGGER_ERROR(logger, channel, message)     APPLOGGER_LOG(logger, channel, AppLogger::Severity::Error, message)
+#define APPLOGGER_CRITICAL(logger, channel, message)  APPLOGGER_LOG(logger, channel, AppLogger::Severity::Critical, message)
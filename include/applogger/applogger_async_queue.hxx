@@ -0,0 +1,207 @@
+#pragma once
+
+#include <boost/log/core/record_view.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace logging = boost::log;
+
+// Bounded record queue used as the queueing strategy of the asynchronous
+// channel sinks (see sinks::asynchronous_sink). Producers push records under
+// a short lock; the dedicated writer thread takes the whole pending queue in
+// one go and feeds the backend from that batch without touching the lock.
+// The capacity covers both the queued records and those of the batch the
+// writer has yet to write, so at most that many records are held in memory.
+class AsyncRecordQueue
+{
+public:
+    // What to do with a new record when the queue is full
+    enum class OverflowPolicy
+    {
+        Block,          // wait until the writer thread makes room
+        DropOldest,     // discard the oldest queued record
+        DropNewest      // discard the incoming record
+    };
+
+    // Set the queue limits; can be called while the writer thread is running
+    void setLimits(const std::size_t capacity, const OverflowPolicy policy)
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queueCapacity = capacity > 0 ? capacity : 1;
+        overflowPolicy = policy;
+        spaceAvailable.notify_all();
+    }
+
+    // Stop accepting records, before the writer thread is stopped: producers
+    // waiting for room give up, and later records are discarded. This is not
+    // done by interrupt_dequeue, which the frontend also calls to flush.
+    void stopAccepting()
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        spaceAvailable.notify_all();
+    }
+
+    // Number of records discarded because the queue was full or no longer accepts records
+    std::uintmax_t droppedCount() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+protected:
+    AsyncRecordQueue() = default;
+
+    template<typename ArgsT>
+    explicit AsyncRecordQueue(const ArgsT&) {}
+
+    // Enqueue a record, applying the overflow policy if the queue is full;
+    // the record is dropped if the queue stopped accepting records meanwhile
+    void enqueue(const logging::record_view& rec)
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (overflowPolicy == OverflowPolicy::Block && !hasRoom())
+        {
+            ++waitingProducers;
+            spaceAvailable.wait(lock, [this]() {
+                return stopping || hasRoom() || overflowPolicy != OverflowPolicy::Block;
+            });
+            --waitingProducers;
+        }
+
+        if (stopping)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // The oldest records may all be in the writer's batch already; then the new one goes
+        while (!hasRoom())
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            if (overflowPolicy == OverflowPolicy::DropNewest || pending.empty())
+                return;
+
+            pending.pop_front();
+        }
+
+        const bool wasEmpty = pending.empty();
+        pending.push_back(rec);
+        if (wasEmpty)
+            recordsAvailable.notify_one();
+    }
+
+    // Attempt to enqueue a record without blocking
+    bool try_enqueue(const logging::record_view& rec)
+    {
+        std::unique_lock<std::mutex> lock(queueMutex, std::try_to_lock);
+        if (!lock.owns_lock() || stopping || !hasRoom())
+            return false;
+
+        const bool wasEmpty = pending.empty();
+        pending.push_back(rec);
+        if (wasEmpty)
+            recordsAvailable.notify_one();
+        return true;
+    }
+
+    bool try_dequeue_ready(logging::record_view& rec)
+    {
+        return try_dequeue(rec);
+    }
+
+    // Dequeue a record without blocking; only called from the feeding thread
+    bool try_dequeue(logging::record_view& rec)
+    {
+        if (batch.empty())
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (pending.empty())
+                return false;
+            takePending();
+        }
+
+        popBatch(rec);
+        return true;
+    }
+
+    // Dequeue a record, blocking until one is available or the wait is interrupted
+    bool dequeue_ready(logging::record_view& rec)
+    {
+        if (batch.empty())
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            while (pending.empty() && !interruptionRequested)
+                recordsAvailable.wait(lock);
+
+            if (interruptionRequested)
+            {
+                interruptionRequested = false;
+                return false;
+            }
+            takePending();
+        }
+
+        popBatch(rec);
+        return true;
+    }
+
+    // Wake the feeding thread possibly blocked in dequeue_ready
+    void interrupt_dequeue()
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        interruptionRequested = true;
+        recordsAvailable.notify_one();
+    }
+
+private:
+    // Whether a record fits within the capacity; queueMutex must be held
+    bool hasRoom() const
+    {
+        return pending.size() + inBatch.load() < queueCapacity;
+    }
+
+    // Move everything queued so far into the writer's batch; queueMutex must be held
+    void takePending()
+    {
+        batch.swap(pending);
+        inBatch.store(batch.size());
+    }
+
+    // Each record written makes room; producers waiting for it are woken
+    // under the lock, so that none misses the wakeup
+    void popBatch(logging::record_view& rec)
+    {
+        rec.swap(batch.front());
+        batch.pop_front();
+        inBatch.fetch_sub(1);
+        if (waitingProducers.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            spaceAvailable.notify_all();
+        }
+    }
+
+    std::mutex queueMutex;
+    std::condition_variable recordsAvailable;
+    std::condition_variable spaceAvailable;
+
+    // Records waiting for the writer thread
+    std::deque<logging::record_view> pending;
+
+    // Records taken by the writer thread, only accessed by the feeding thread,
+    // and how many of them are left (read by the producers)
+    std::deque<logging::record_view> batch;
+    std::atomic<std::size_t> inBatch{ 0 };
+    std::atomic<std::size_t> waitingProducers{ 0 };
+
+    std::size_t queueCapacity = 8192;
+    OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+    bool interruptionRequested = false;
+    bool stopping = false;
+    std::atomic<std::uintmax_t> dropped{ 0 };
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+// Layout of the binary channel logs written by BinaryFileBackend and turned
+// back into text by app-logger-decode. Integers are stored in the byte order
+// of the machine that wrote the file.
+//
+//    file    := header entry*
+//    header  := magic[8] version:u32 reserved:u32
+//    entry   := 'C' id:u32 length:u32 name[length]          (channel definition)
+//             | 'F' id:u32 length:u32 format[length]        (format string definition)
+//             | 'R' timestamp:i64 severity:u8 channel:u32 format:u32 length:u32 args[length]
+//    args    := (type:u8 value)*
+//
+// The timestamp is the record's TimeStamp in microseconds since 1970-01-01, in
+// the same (local) time the text sinks print. Definitions always appear before
+// the first record that uses them.
+namespace logbinary
+{
+    constexpr char fileMagic[8] = { 'A', 'L', 'O', 'G', 'B', 'I', 'N', '1' };
+    constexpr std::uint32_t fileVersion = 1;
+
+    // Entry tags
+    constexpr std::uint8_t channelTag = 'C';
+    constexpr std::uint8_t formatTag = 'F';
+    constexpr std::uint8_t recordTag = 'R';
+
+    // Argument type tags
+    constexpr std::uint8_t signedArg = 'i';     // i64
+    constexpr std::uint8_t unsignedArg = 'u';   // u64
+    constexpr std::uint8_t floatArg = 'd';      // f64
+    constexpr std::uint8_t boolArg = 'b';       // u8
+    constexpr std::uint8_t charArg = 'c';       // u8
+    constexpr std::uint8_t stringArg = 's';     // length:u32 bytes[length]
+
+    // Format of records that were not logged through logf: "{}" with the message as argument
+    constexpr std::uint32_t plainMessageFormat = 0;
+
+    // Arguments of a logf call, attached to the record for the binary sinks
+    struct Payload
+    {
+        std::uint32_t formatId;
+        std::string args;
+    };
+
+    template<typename T>
+    void put(std::string& bytes, const T value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written");
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool get(const char*& pos, const char* end, T& value)
+    {
+        if (static_cast<std::size_t>(end - pos) < sizeof(T))
+            return false;
+        std::memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    inline void pack_arg(std::string& bytes, const std::string_view value)
+    {
+        put(bytes, stringArg);
+        put(bytes, static_cast<std::uint32_t>(value.size()));
+        bytes.append(value.data(), value.size());
+    }
+
+    inline void pack_arg(std::string& bytes, const std::string& value)
+    {
+        pack_arg(bytes, std::string_view(value));
+    }
+
+    inline void pack_arg(std::string& bytes, const char* value)
+    {
+        pack_arg(bytes, std::string_view(value ? value : "(null)"));
+    }
+
+    inline void pack_arg(std::string& bytes, const char value)
+    {
+        put(bytes, charArg);
+        put(bytes, static_cast<std::uint8_t>(value));
+    }
+
+    inline void pack_arg(std::string& bytes, const bool value)
+    {
+        put(bytes, boolArg);
+        put(bytes, static_cast<std::uint8_t>(value ? 1 : 0));
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value &&
+        !std::is_same<T, bool>::value && !std::is_same<T, char>::value, void>::type
+    pack_arg(std::string& bytes, const T value)
+    {
+        if (std::is_floating_point<T>::value)
+        {
+            put(bytes, floatArg);
+            put(bytes, static_cast<double>(value));
+        }
+        else if (std::is_signed<T>::value)
+        {
+            put(bytes, signedArg);
+            put(bytes, static_cast<std::int64_t>(value));
+        }
+        else
+        {
+            put(bytes, unsignedArg);
+            put(bytes, static_cast<std::uint64_t>(value));
+        }
+    }
+
+    // Anything else that can be streamed is stored as text
+    template<typename T>
+    typename std::enable_if<!std::is_arithmetic<T>::value &&
+        !std::is_convertible<const T&, std::string_view>::value &&
+        !std::is_convertible<const T&, const char*>::value, void>::type
+    pack_arg(std::string& bytes, const T& value)
+    {
+        std::ostringstream ss;
+        ss << value;
+        pack_arg(bytes, ss.str());
+    }
+
+    template<typename... Args>
+    void pack(std::string& bytes, const Args&... args)
+    {
+        (pack_arg(bytes, args), ...);
+        (void)bytes;
+    }
+
+    // Process-wide registry of format strings, defined in the library.
+    // Returns the id of the format and a copy of it that stays valid for the
+    // lifetime of the process.
+    std::uint32_t register_format(const char* fmt, const char** registered);
+
+    // The format string registered under an id (empty if unknown)
+    std::string format_string(const std::uint32_t id);
+
+    // Id of a format string; repeated calls with the same pointer are served
+    // from a per-thread cache after checking the text is still the same. The
+    // cache is emptied when it holds too many pointers, e.g. formats built in
+    // temporary buffers, which would otherwise add an entry per call.
+    inline std::uint32_t format_id(const char* fmt)
+    {
+        struct CacheEntry
+        {
+            std::uint32_t id;
+            const char* registered;
+        };
+        constexpr std::size_t maxCachedFormats = 1024;
+        thread_local std::unordered_map<const char*, CacheEntry> cache;
+
+        auto it = cache.find(fmt);
+        if (it != cache.end() && std::strcmp(it->second.registered, fmt) == 0)
+            return it->second.id;
+
+        if (it == cache.end() && cache.size() >= maxCachedFormats)
+            cache.clear();
+
+        CacheEntry entry;
+        entry.id = register_format(fmt, &entry.registered);
+        cache[fmt] = entry;
+        return entry.id;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "applogger_binary.hxx"
+
+#include <boost/log/sinks/basic_sink_backend.hpp>
+#include <boost/log/sinks/frontend_requirements.hpp>
+#include <boost/log/core/record_view.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace logging = boost::log;
+namespace sinks = boost::log::sinks;
+
+// Sink backend writing compact binary records (see applogger_binary.hxx) 
+// instead of formatted text. Records logged with AppLogger::logf keep their
+// raw arguments; any other record is stored with its message as the only 
+// argument. Use app-logger-decode to turn the file back into text.
+class BinaryFileBackend :
+    public sinks::basic_sink_backend<
+        sinks::combine_requirements<sinks::synchronized_feeding, sinks::flushing>::type
+    >
+{
+public:
+    // Opens (truncates) the file and writes the file header
+    explicit BinaryFileBackend(const std::string& filename) noexcept(false);
+
+    // Write a record
+    void consume(const logging::record_view& rec);
+
+    // Flush the file buffer
+    void flush();
+
+private:
+    // Id of a channel in this file, writing its definition on first use
+    std::uint32_t channelId(const std::string& channel);
+
+    // Write the definition of a format string on first use
+    void defineFormat(const std::uint32_t formatId);
+
+    std::ofstream file;
+
+    // Channels and formats already defined in this file
+    std::unordered_map<std::string, std::uint32_t> channelIds;
+    std::vector<bool> formatDefined;
+
+    // Reused buffer for encoding a record
+    std::string entry;
+};
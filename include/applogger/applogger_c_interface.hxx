@@ -10,6 +10,13 @@
 #define APPLOGGER_EXIT_SUCCESS         0
 #define APPLOGGER_EXIT_WITH_MESSAGES   1
 
+/* Severity codes for the functions taking an integer severity */
+#define APPLOGGER_SEVERITY_DEBUG       0
+#define APPLOGGER_SEVERITY_INFO        1
+#define APPLOGGER_SEVERITY_WARNING     2
+#define APPLOGGER_SEVERITY_ERROR       3
+#define APPLOGGER_SEVERITY_CRITICAL    4
+
 #if __cplusplus
 extern "C" {
 #endif
@@ -18,8 +25,9 @@ extern "C" {
     * @brief Retrieves the applogger errors to be displayed or 
     * used by the caller.
     * 
-    * When this is called without NULL for buffer, the message queue
-    * is emptied.
+    * When this is called without NULL for buffer, the messages copied
+    * to the buffer are removed from the queue; messages that do not fit
+    * stay queued. It is safe to call while other threads report messages.
     * 
     * @param buffer [out] Returns the string containing all current messages from the module. It can be NULL to get the required size of the buffer.
     * @param nchars [inout] The size of the buffer. If it is smaller than the required length, the message is truncated.
@@ -39,6 +47,9 @@ extern "C" {
    /**
     * @brief Initialises the applogger module.
     * 
+    * Once initialised, the other functions can be called from several threads at once.
+    * This function and destroy_applogger must not run at the same time as any other call.
+    * 
     * @param err [out] Returns 0 on success, -1 on error and 1 in case of success with messages.
     */
    DllExport void initialise_applogger(int* err);
@@ -55,6 +66,40 @@ extern "C" {
    DllExport void add_sink_to_applogger(const char* sinkname, 
       const char* channel, const char* format, const char* minseverity, int* err);
 
+   /**
+    * @brief Adds a sink (file or stream) to the logger, with extra options controlling how it is written.
+    * 
+    * Options are given as "key=value" pairs separated by ';' (keys are not case-sensitive):
+    *    - type: "text" (default), "binary" or "ring". Binary sinks store compact records that are turned back into text with app-logger-decode; the format is ignored.
+    *      Ring sinks keep the most recent records in a fixed-size memory-mapped file that survives a crash; print it with app-logger-ring-dump.
+    *    - ring_size: Size of the records area of a ring sink in bytes, optionally with a K, M or G suffix. Defaults to 8M.
+    *    - rotation_size: Size at which a text file is rotated, in bytes with an optional K, M or G suffix. 0 disables it. Defaults to 10M.
+    *    - rotation_interval: Rotate a text file this often, in seconds with an optional s, m, h or d suffix. Defaults to 0 (daily at midnight).
+    *    - max_files, max_total_size: Keep at most this many rotated files / bytes of rotated files, deleting the oldest. Defaults to 0 (no limit).
+    *    - compress: "true" or "false" (default). Compress rotated files with gzip on a background thread (needs a build with zlib).
+    * 
+    * Rate limits apply to all sinks of the channel and replace those set by an earlier sink of the same channel.
+    * Suppressed messages are dropped before they are formatted (see get_applogger_suppressed_count):
+    *    - rate_limit: Sustained number of messages per second. Defaults to 0 (no limit).
+    *    - burst: Number of messages that can be logged at once under rate_limit. Defaults to one second's worth.
+    *    - sample_first, sample_every: Log the first N messages, then every Kth one. With sample_every=0 only the first N are logged.
+    *    - dedup_window_ms: Drop a message identical to one logged within this many milliseconds.
+    *    - async: "true" or "false" (default). Write the records from a dedicated thread instead of the caller's thread.
+    *    - queue_size: Max number of records waiting to be written by an asynchronous sink. Defaults to 8192.
+    *    - overflow: What an asynchronous sink does when the queue is full. Valid values are [block, drop_oldest, drop_newest]. Defaults to block.
+    * 
+    * Example: "async=true; queue_size=4096; overflow=drop_oldest"
+    * 
+    * @param sinkname [in] The path and file name for the log.
+    * @param channel [in] The name of the channel associated with the sink (log file).
+    * @param format [in] Custom format of the error messages for this sink/channel. It can be NULL to use the default format.
+    * @param minseverity [in] The minimum level of severity of a message to appear in this log. Valid values are [Debug, Info, Warning, Error, Critical] (not case-sensitive). It can be NULL and it defaults to Info.
+    * @param options [in] The sink options. It can be NULL to use the defaults (same as add_sink_to_applogger).
+    * @param err [out] Returns 0 on success, -1 on error and 1 in case of success with messages.
+    */
+   DllExport void add_sink_with_options_to_applogger(const char* sinkname, 
+      const char* channel, const char* format, const char* minseverity, const char* options, int* err);
+
    /**
     * @brief Sends a message to the logger to be logged to the appropriate sink.
     * 
@@ -65,8 +110,74 @@ extern "C" {
     */
    DllExport void send_message_to_applogger(const char* channel, const char* severity, const char* message, int* err);
 
+   /**
+    * @brief Retrieves the id of a channel, to be used with the functions taking channel ids.
+    * The channel does not need to have a sink yet; the id stays valid until the logger is destroyed.
+    * 
+    * @param channel [in] The name of the channel.
+    * @param id [out] Returns the id of the channel.
+    * @param err [out] Returns 0 on success, -1 on error and 1 in case of success with messages.
+    */
+   DllExport void get_applogger_channel_id(const char* channel, int* id, int* err);
+
+   /**
+    * @brief Retrieves the number of messages of a channel suppressed by its rate limits.
+    * 
+    * @param channel [in] The name of the channel.
+    * @param count [out] Returns the number of suppressed messages (0 for unknown channels).
+    * @param err [out] Returns 0 on success, -1 on error and 1 in case of success with messages.
+    */
+   DllExport void get_applogger_suppressed_count(const char* channel, long long* count, int* err);
+
+   /**
+    * @brief Sends a message to a channel given by its id, with an integer severity (one of APPLOGGER_SEVERITY_*).
+    * Avoids the channel lookup and severity parsing of send_message_to_applogger.
+    * 
+    * @param channel_id [in] The id of the channel, as returned by get_applogger_channel_id.
+    * @param severity [in] The severity of the message. Invalid values are logged as APPLOGGER_SEVERITY_INFO.
+    * @param message [in] The message to be logged.
+    * @param length [in] The number of characters in the message. If negative, the message is a null-terminated string.
+    * @param err [out] Returns 0 on success, -1 on error and 1 in case of success with messages.
+    */
+   DllExport void send_message_with_id_to_applogger(int channel_id, int severity, const char* message, int length, int* err);
+
+   /**
+    * @brief Sends a batch of messages to the logger in one call.
+    * The messages are read in place; nothing is copied for messages rejected by the severity threshold.
+    * Messages with an unknown channel id are skipped and reported once per batch.
+    * 
+    * @param count [in] The number of messages in the batch.
+    * @param channel_ids [in] The channel id of each message, as returned by get_applogger_channel_id.
+    * @param severities [in] The severity of each message (one of APPLOGGER_SEVERITY_*). Invalid values are logged as APPLOGGER_SEVERITY_INFO.
+    * @param messages [in] The messages to be logged.
+    * @param lengths [in] The number of characters in each message. It can be NULL if all messages are null-terminated strings; a negative length marks a single null-terminated message.
+    * @param err [out] Returns 0 on success, -1 on error and 1 in case of success with messages.
+    */
+   DllExport void send_messages_to_applogger(int count, const int* channel_ids, const int* severities, 
+      const char* const* messages, const int* lengths, int* err);
+
+   /**
+    * @brief Logs a summary of every timer zone recorded with timeutils::ScopedTimer
+    * (count, min, max, p50 and p99 since the start of the process) to a channel, at Info severity.
+    * 
+    * @param channel [in] The name of the channel.
+    * @param err [out] Returns 0 on success, -1 on error and 1 in case of success with messages.
+    */
+   DllExport void report_applogger_timers(const char* channel, int* err);
+
+   /**
+    * @brief Logs the timer summaries of report_applogger_timers to a channel periodically, from a background thread.
+    * Replaces any earlier periodic report.
+    * 
+    * @param channel [in] The name of the channel.
+    * @param interval_seconds [in] The time between two reports in seconds. 0 stops the periodic reports.
+    * @param err [out] Returns 0 on success, -1 on error and 1 in case of success with messages.
+    */
+   DllExport void start_applogger_timer_reports(const char* channel, int interval_seconds, int* err);
+
    /**
     * @brief Closes any open log files and destroys the internal objects.
+    * Records still queued in asynchronous sinks are written out first.
     * Any messages from the module are cleared and cannot be recovered.
     * It is recommended to retrieve them before calling this function.
     * 
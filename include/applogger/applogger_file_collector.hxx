@@ -0,0 +1,107 @@
+#pragma once
+
+#include <boost/log/sinks/text_file_backend.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/version.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace logging = boost::log;
+namespace sinks = boost::log::sinks;
+
+// What happens to the files a text sink has rotated
+struct RetentionOptions
+{
+    // Keep at most this many rotated files (0 = no limit)
+    std::size_t maxFiles = 0;
+
+    // Keep at most this many bytes of rotated files (0 = no limit)
+    std::uintmax_t maxTotalSize = 0;
+
+    // Compress rotated files (gzip); only available if built with zlib
+    bool compress = false;
+
+    bool enabled() const
+    {
+        return maxFiles > 0 || maxTotalSize > 0 || compress;
+    }
+};
+
+// Whether rotated files can be compressed in this build
+bool rotatedFileCompressionAvailable();
+
+// File collector of the text sinks. A rotated file is renamed next to the
+// active one with a timestamp (app.log -> app.20240131T120000.log), which is
+// quick, and handed to a background thread that compresses it (app.20240131T120000.log.gz)
+// and removes the oldest rotated files beyond the retention limits. The
+// thread writing the records never waits for the compression. If the file
+// name is a pattern (network_%Y%m%d.log), the rotated name starts from the
+// expanded one (network_20240131.20240131T120000.log).
+class RotatedFileCollector : public sinks::file::collector
+{
+public:
+    // activeFile is the file the sink writes to; rotated files go to the same directory
+    RotatedFileCollector(const boost::filesystem::path& activeFile, const RetentionOptions& options) noexcept(false);
+
+    // Finishes the pending compressions before returning
+    ~RotatedFileCollector() override;
+
+    void store_file(const boost::filesystem::path& srcPath) override;
+
+#if BOOST_VERSION >= 107700
+    bool is_in_storage(const boost::filesystem::path& srcPath) const override;
+
+    sinks::file::scan_result scan_for_files(sinks::file::scan_method method,
+        const boost::filesystem::path& pattern = boost::filesystem::path()) override;
+#else
+    uintmax_t scan_for_files(sinks::file::scan_method method,
+        const boost::filesystem::path& pattern = boost::filesystem::path(), unsigned int* counter = 0) override;
+#endif
+
+    // Block until the files stored so far are compressed and the retention limits applied
+    void waitIdle();
+
+private:
+    struct StoredFile
+    {
+        boost::filesystem::path path;
+        std::uintmax_t size;
+    };
+
+    // Whether a file name is one of the rotated files of this sink
+    bool isRotatedFile(const boost::filesystem::path& path) const;
+
+    // Find the rotated files left by earlier runs, oldest first
+    std::size_t scanDirectory();
+
+    // Background thread: compress the queued files and apply the retention limits
+    void run();
+    void compress(StoredFile& file);
+    void applyRetention();
+
+    const boost::filesystem::path directory;
+    // Of the file name given to the sink, which may hold placeholders
+    const std::string stem;
+    const std::string extension;
+    const RetentionOptions options;
+
+    std::mutex collectorMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable idle;
+
+    // Files waiting for the background thread, and whether it is working on one
+    std::deque<boost::filesystem::path> pending;
+    bool busy = false;
+    bool stopping = false;
+
+    // Rotated files, oldest first; only used by the background thread once it runs
+    std::deque<StoredFile> stored;
+    std::size_t foundAtStart = 0;
+
+    std::thread worker;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Minimal "{}"-style message formatting used by AppLogger::logf.
+// Arguments are appended straight into a caller-provided buffer, so
+// formatting into a reused buffer does not allocate once it has grown
+// to the size of a typical message. Use "{{" and "}}" for literal braces.
+namespace logformat
+{
+    // Reusable per-thread buffer for formatting messages; returned empty
+    inline std::string& thread_buffer()
+    {
+        thread_local std::string buffer = []() {
+            std::string b;
+            b.reserve(512);
+            return b;
+        }();
+        buffer.clear();
+        return buffer;
+    }
+
+    inline void append(std::string& buffer, const std::string_view value)
+    {
+        buffer.append(value.data(), value.size());
+    }
+
+    inline void append(std::string& buffer, const std::string& value)
+    {
+        buffer.append(value);
+    }
+
+    inline void append(std::string& buffer, const char* value)
+    {
+        if (value)
+            buffer.append(value);
+        else
+            buffer.append("(null)");
+    }
+
+    inline void append(std::string& buffer, const char value)
+    {
+        buffer.push_back(value);
+    }
+
+    inline void append(std::string& buffer, const bool value)
+    {
+        buffer.append(value ? "true" : "false");
+    }
+
+    // Numbers are converted with std::to_chars (no locale, no allocation)
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value &&
+        !std::is_same<T, bool>::value && !std::is_same<T, char>::value, void>::type
+    append(std::string& buffer, const T value)
+    {
+        char digits[64];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, static_cast<std::size_t>(result.ptr - digits));
+    }
+
+    // Anything else that can be streamed; this path may allocate
+    template<typename T>
+    typename std::enable_if<!std::is_arithmetic<T>::value &&
+        !std::is_convertible<const T&, std::string_view>::value &&
+        !std::is_convertible<const T&, const char*>::value, void>::type
+    append(std::string& buffer, const T& value)
+    {
+        thread_local std::ostringstream ss;
+        ss.str(std::string());
+        ss.clear();
+        ss << value;
+        buffer.append(ss.str());
+    }
+
+    // Copy the format string up to the next "{}" (unescaping "{{" and "}}").
+    // Returns the position after the placeholder, or npos if there is none.
+    inline std::size_t copy_until_placeholder(std::string& buffer, const std::string_view fmt)
+    {
+        std::size_t i = 0;
+        while (i < fmt.size())
+        {
+            const char c = fmt[i];
+            if ((c == '{' || c == '}') && i + 1 < fmt.size() && fmt[i + 1] == c)
+            {
+                buffer.push_back(c);
+                i += 2;
+                continue;
+            }
+            if (c == '{' && i + 1 < fmt.size() && fmt[i + 1] == '}')
+                return i + 2;
+
+            buffer.push_back(c);
+            ++i;
+        }
+        return std::string_view::npos;
+    }
+
+    inline void format_to(std::string& buffer, std::string_view fmt)
+    {
+        std::size_t next = copy_until_placeholder(buffer, fmt);
+        while (next != std::string_view::npos)
+        {
+            fmt = fmt.substr(next);
+            next = copy_until_placeholder(buffer, fmt);
+        }
+    }
+
+    // Replace each "{}" in fmt with the next argument. Arguments without a
+    // placeholder are ignored; placeholders without an argument are left empty.
+    template<typename T, typename... Args>
+    void format_to(std::string& buffer, const std::string_view fmt, const T& first, const Args&... rest)
+    {
+        const std::size_t next = copy_until_placeholder(buffer, fmt);
+        if (next == std::string_view::npos)
+            return;
+
+        append(buffer, first);
+        format_to(buffer, fmt.substr(next), rest...);
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Queue of diagnostic messages reported by the C interface. Any number of
+// threads can push without taking a lock: each message is linked onto an
+// atomic list head with a CAS. Readers take the whole list at once and keep
+// the messages (in the order they were pushed) until they are cleared.
+class MessageQueue
+{
+public:
+    MessageQueue() = default;
+
+    MessageQueue(const MessageQueue&) = delete;
+    MessageQueue& operator=(const MessageQueue&) = delete;
+
+    ~MessageQueue()
+    {
+        deleteNodes(head.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    // Add a message; lock-free, safe to call from any thread
+    void push(std::string message)
+    {
+        Node* node = new Node{ std::move(message), head.load(std::memory_order_relaxed) };
+        while (!head.compare_exchange_weak(node->next, node,
+            std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Total length of the messages, counting a separator after each one
+    std::size_t size(const std::size_t separatorLength) const
+    {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        collect();
+
+        std::size_t total = 0;
+        for (const auto& m : taken)
+            total += m.length() + separatorLength;
+        return total;
+    }
+
+    // Join the oldest messages with a separator after each one, taking as many
+    // as fit in maxLength; the rest stay queued. The first message is always
+    // taken (truncated by the caller if needed) so the queue keeps moving.
+    std::string take(const std::size_t maxLength, const std::string& separator)
+    {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        collect();
+
+        std::string joined;
+        std::size_t count = 0;
+        for (; count < taken.size(); ++count)
+        {
+            const std::string& m = taken[count];
+            if (count > 0 && joined.length() + m.length() + separator.length() > maxLength)
+                break;
+            joined.append(m).append(separator);
+        }
+        taken.erase(taken.begin(), taken.begin() + static_cast<std::ptrdiff_t>(count));
+        return joined;
+    }
+
+    // Discard all messages
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        deleteNodes(head.exchange(nullptr, std::memory_order_acquire));
+        taken.clear();
+    }
+
+private:
+    struct Node
+    {
+        std::string message;
+        Node* next;
+    };
+
+    // Move the pushed messages to the reader's list; readerMutex must be held
+    void collect() const
+    {
+        Node* node = head.exchange(nullptr, std::memory_order_acquire);
+
+        // The list is newest first
+        std::vector<std::string> pushed;
+        while (node)
+        {
+            pushed.push_back(std::move(node->message));
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+        for (auto it = pushed.rbegin(); it != pushed.rend(); ++it)
+            taken.push_back(std::move(*it));
+    }
+
+    static void deleteNodes(Node* node)
+    {
+        while (node)
+        {
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    mutable std::atomic<Node*> head{ nullptr };
+
+    // Messages already taken off the list, guarded by readerMutex
+    mutable std::vector<std::string> taken;
+    mutable std::mutex readerMutex;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// How many messages of a channel get through to its sinks. The checks run
+// once a sink has accepted the record's severity and before the message is
+// formatted, so messages no sink wants do not use up the limits, and a
+// suppressed message is never formatted.
+struct RateLimitOptions
+{
+    // Token bucket: sustained messages per second (0 = no limit) and the
+    // number of messages that can be let through at once (0 = one second's worth)
+    double messagesPerSecond = 0.;
+    std::size_t burst = 0;
+
+    // Sampling: let the first N messages through, then every Kth one
+    // (0 = no sampling; with K = 0 only the first N get through)
+    std::uint64_t sampleFirst = 0;
+    std::uint64_t sampleEvery = 0;
+
+    // Drop a message identical to one logged within this window (0 = off)
+    std::chrono::milliseconds dedupWindow{ 0 };
+
+    bool enabled() const
+    {
+        return messagesPerSecond > 0. || sampleFirst > 0 || sampleEvery > 0 || dedupWindow.count() > 0;
+    }
+};
+
+// Applies the RateLimitOptions of a channel; shared by all threads logging to it
+class RateLimiter
+{
+public:
+    explicit RateLimiter(const RateLimitOptions& options) :
+        options(options),
+        tokens(static_cast<double>(burstSize())),
+        lastRefill(std::chrono::steady_clock::now())
+    {
+    }
+
+    // Whether allow() needs a key identifying the message
+    bool deduplicates() const
+    {
+        return options.dedupWindow.count() > 0;
+    }
+
+    // Whether the next message may be logged; messageKey identifies the
+    // message for deduplication (0 = do not deduplicate this one)
+    bool allow(const std::size_t messageKey)
+    {
+        std::lock_guard<std::mutex> lock(limiterMutex);
+        if (!check(messageKey))
+        {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Number of messages suppressed so far
+    std::uintmax_t suppressedCount() const
+    {
+        return suppressed.load(std::memory_order_relaxed);
+    }
+
+private:
+    typedef std::chrono::steady_clock clock_t;
+
+    std::size_t burstSize() const
+    {
+        if (options.burst > 0)
+            return options.burst;
+        return options.messagesPerSecond >= 1. ? static_cast<std::size_t>(options.messagesPerSecond) : 1;
+    }
+
+    // limiterMutex must be held
+    bool check(const std::size_t messageKey)
+    {
+        const bool timed = options.messagesPerSecond > 0. || (messageKey != 0 && deduplicates());
+        const clock_t::time_point now = timed ? clock_t::now() : clock_t::time_point();
+
+        const bool dedup = messageKey != 0 && deduplicates();
+        if (dedup)
+        {
+            // Forget the messages whose window has passed, oldest first
+            while (!seenOrder.empty() && now - seenOrder.front().second >= options.dedupWindow)
+            {
+                lastSeen.erase(seenOrder.front().first);
+                seenOrder.pop_front();
+            }
+
+            if (lastSeen.find(messageKey) != lastSeen.end())
+                return false;
+        }
+
+        if (options.sampleFirst > 0 || options.sampleEvery > 0)
+        {
+            const std::uint64_t n = sampled++;
+            if (n >= options.sampleFirst &&
+                (options.sampleEvery == 0 || (n - options.sampleFirst) % options.sampleEvery != 0))
+                return false;
+        }
+
+        if (options.messagesPerSecond > 0.)
+        {
+            const double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+            lastRefill = now;
+            tokens = std::min(static_cast<double>(burstSize()), tokens + elapsed * options.messagesPerSecond);
+            if (tokens < 1.)
+                return false;
+            tokens -= 1.;
+        }
+
+        // Only a message that is logged starts a window; beyond the limit the
+        // oldest message is forgotten early
+        if (dedup)
+        {
+            if (lastSeen.size() >= maxTrackedMessages)
+            {
+                lastSeen.erase(seenOrder.front().first);
+                seenOrder.pop_front();
+            }
+            seenOrder.emplace_back(messageKey, now);
+            lastSeen.emplace(messageKey, std::prev(seenOrder.end()));
+        }
+
+        return true;
+    }
+
+    static constexpr std::size_t maxTrackedMessages = 4096;
+
+    const RateLimitOptions options;
+
+    std::mutex limiterMutex;
+    double tokens;
+    clock_t::time_point lastRefill;
+    std::uint64_t sampled = 0;
+
+    // Messages logged within the dedup window, oldest first, and by key
+    std::list<std::pair<std::size_t, clock_t::time_point>> seenOrder;
+    std::unordered_map<std::size_t, std::list<std::pair<std::size_t, clock_t::time_point>>::iterator> lastSeen;
+
+    std::atomic<std::uintmax_t> suppressed{ 0 };
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Layout of the ring buffer files written by RingBufferBackend and dumped by
+// app-logger-ring-dump. The file has a fixed size: a header followed by the
+// data area, which holds the most recent formatted records as text lines
+// ('\n' after each one), overwriting the oldest once it is full.
+//
+//    file    := header data[capacity]
+//    header  := magic[8] version:u32 headerSize:u32 capacity:u64 written:u64 reserved[32]
+//
+// "written" is the total number of bytes ever written to the data area; the
+// next byte goes to data[written % capacity]. It is updated after the record
+// itself, so the newest record in the range it covers is always complete.
+// The oldest one is not: once the buffer has wrapped, the writer overwrites
+// the oldest bytes before it updates "written", so a reader (or the file left
+// behind by a crashed process) may find the first record of the range partly
+// overwritten. app-logger-ring-dump therefore skips to the first '\n' of a
+// wrapped buffer.
+// Integers are stored in the byte order of the machine that wrote the file.
+namespace logring
+{
+    constexpr char fileMagic[8] = { 'A', 'L', 'O', 'G', 'R', 'I', 'N', 'G' };
+    constexpr std::uint32_t fileVersion = 1;
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t headerSize;
+        std::uint64_t capacity;
+        std::uint64_t written;
+        std::uint8_t reserved[32];
+    };
+    static_assert(sizeof(FileHeader) == 64, "the ring buffer header must be 64 bytes");
+
+    // Size of the data area unless the sink options say otherwise
+    constexpr std::uint64_t defaultCapacity = 8 * 1024 * 1024;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "applogger_ring_buffer.hxx"
+
+#include <boost/log/sinks/basic_sink_backend.hpp>
+#include <boost/log/sinks/frontend_requirements.hpp>
+#include <boost/log/core/record_view.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace logging = boost::log;
+namespace sinks = boost::log::sinks;
+
+// Sink backend writing formatted records into a fixed-size memory-mapped file
+// used as a circular buffer (see applogger_ring_buffer.hxx). Writing a record
+// is a memory copy; the operating system writes the pages back to the file,
+// so the most recent records survive a crash of the process. Use 
+// app-logger-ring-dump to print the records in order.
+class RingBufferBackend :
+    public sinks::basic_formatted_sink_backend<
+        char,
+        sinks::combine_requirements<sinks::synchronized_feeding, sinks::flushing>::type
+    >
+{
+public:
+    // Creates (truncates) the file with room for capacity bytes of records and maps it
+    RingBufferBackend(const std::string& filename, const std::uint64_t capacity) noexcept(false);
+
+    // Write a formatted record followed by a newline
+    void consume(const logging::record_view& rec, const string_type& formattedMessage);
+
+    // Ask the operating system to write the mapped pages back to the file
+    void flush();
+
+private:
+    // Copy bytes to the data area at the current write position and advance it
+    void write(const char* bytes, std::size_t length);
+
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+
+    logring::FileHeader* header = nullptr;
+    char* data = nullptr;
+    std::uint64_t capacity = 0;
+
+    // Bytes written so far; published to header->written after each record
+    std::uint64_t written = 0;
+};
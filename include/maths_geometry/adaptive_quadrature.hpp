@@ -0,0 +1,646 @@
+#pragma once
+
+#include "maths_geometry/maths_operations.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Adaptive quadrature to a target absolute tolerance, for integrands too expensive
+// to over-sample with the fixed-step rules of maths_operations.hpp:
+// - adaptive_simpson: Simpson's rule on bisected intervals, reusing every value
+// - gauss_kronrod_15 and gauss_kronrod_21: the Kronrod extensions of the 7 and 10
+//   point Gauss rules on bisected intervals, with the QUADPACK error estimate
+// - tanh_sinh: the double exponential rule, for integrands singular at the ends
+//
+// An interval is accepted once its error estimate is within its share of the
+// tolerance, tolerance * (length of the interval) / (length of [first, last]), so
+// the estimates add up to at most the tolerance. Intervals are also accepted,
+// short of the tolerance, when their estimate is down to rounding in T, or at the
+// depth limit; the result then reports that it did not converge. The bisecting rules can spread
+// the intervals over threads: [first, last] is split into one piece per thread,
+// and each thread bisects its own pieces, taking intervals from the others when
+// it runs out (work stealing). The integrand is then called from several threads
+// at once. The sums depend on which thread accepts which interval, so results with
+// threads may differ from each other in the last bits.
+//
+// The integrand is anything callable as T(T), or a batch integrand
+// void(const T* xs, T* ys, size_t n) as with the fixed-step rules; the bisecting
+// rules call it on all the new nodes of an interval at once.
+
+namespace maths_ops
+{
+   /**
+    * @brief The outcome of an adaptive integration.
+    *
+    * @tparam T Supports float, double and long double.
+    */
+   template <typename T>
+   struct quadrature_result
+   {
+      T value;                // The integral
+      T error;                // Estimate of the absolute error of value
+      size_t evaluations;     // Calls of the integrand, counted per node
+      size_t intervals;       // Intervals accepted (bisecting rules) or levels of halving (tanh_sinh)
+      bool converged;         // False when the limits or rounding stopped the refinement short of the tolerance
+   };
+
+   namespace quadrature_detail
+   {
+      // Nodes (x) and weights of the Gauss-Kronrod rules on [-1, 1], from QUADPACK (qk15, qk21).
+      // The nodes at odd positions, and the centre for the 15 point rule, are the Gauss nodes.
+      constexpr long double gk15_nodes[8] = {
+         0.991455371120812639206854697526329L, 0.949107912342758524526189684047851L,
+         0.864864423359769072789712788640926L, 0.741531185599394439863864773280788L,
+         0.586087235467691130294144845693013L, 0.405845151377397166906606412076961L,
+         0.207784955007898467600689403773245L, 0.000000000000000000000000000000000L };
+      constexpr long double gk15_kronrod_weights[8] = {
+         0.022935322010529224963732008058970L, 0.063092092629978553290700663189204L,
+         0.104790010322250183839876322541518L, 0.140653259715525918745189590510238L,
+         0.169004726639267902826583426598550L, 0.190350578064785409913256402421014L,
+         0.204432940075298892414161999234649L, 0.209482141084727828012999174891714L };
+      constexpr long double gk15_gauss_weights[4] = {
+         0.129484966168869693270611432679082L, 0.279705391489276667901467771423780L,
+         0.381830050505118944950369775488975L, 0.417959183673469387755102040816327L };
+
+      constexpr long double gk21_nodes[11] = {
+         0.995657163025808080735527280689003L, 0.973906528517171720077964012084452L,
+         0.930157491355708226001207180059508L, 0.865063366688984510732096688423493L,
+         0.780817726586416897063717578345042L, 0.679409568299024406234327365114874L,
+         0.562757134668604683339000099272694L, 0.433395394129247190799265943165784L,
+         0.294392862701460198131126603103866L, 0.148874338981631210884826001129720L,
+         0.000000000000000000000000000000000L };
+      constexpr long double gk21_kronrod_weights[11] = {
+         0.011694638867371874278064396062192L, 0.032558162307964727478818972459390L,
+         0.054755896574351996031381300244580L, 0.075039674810919952767043140916190L,
+         0.093125454583697605535065465083366L, 0.109387158802297641899210590325805L,
+         0.123491976262065851077208980614881L, 0.134709217311473325928054001771707L,
+         0.142775938577060080797094273138717L, 0.147739104901338491374841515972068L,
+         0.149445554002916905664936468389821L };
+      constexpr long double gk21_gauss_weights[5] = {
+         0.066671344308688137593568809893332L, 0.149451349150580593145776339657697L,
+         0.219086362515982043995534934228163L, 0.269266719309996355091226921569469L,
+         0.295524224714752870173892994651338L };
+
+      // ys[i] = f(xs[i]), through a single call for batch integrands
+      template <typename T, typename F>
+      inline void evaluate(F& f, const T* xs, T* ys, const size_t n, std::true_type)
+      {
+         f(xs, ys, n);
+      }
+
+      template <typename T, typename F>
+      inline void evaluate(F& f, const T* xs, T* ys, const size_t n, std::false_type)
+      {
+         for (size_t i = 0; i < n; ++i)
+            ys[i] = f(xs[i]);
+      }
+
+      template <typename T, typename F>
+      inline void evaluate(F& f, const T* xs, T* ys, const size_t n)
+      {
+         evaluate(f, xs, ys, n, integration_detail::is_batch_integrand<F, T>{});
+      }
+
+      // What one thread has accepted so far; padded to a cache line of its own
+      template <typename T>
+      struct alignas(64) partial_result
+      {
+         T value{ 0 };
+         T error{ 0 };
+         size_t evaluations{ 0 };
+         size_t intervals{ 0 };
+         bool stopped_short{ false };
+      };
+
+      // One double ended queue of intervals per thread. Each thread pushes and pops
+      // at the back of its own queue, so it works depth first on recent (small,
+      // cached) intervals, and steals from the front of the others, where the
+      // oldest and largest intervals are.
+      template <typename Item>
+      class work_stealing_queues
+      {
+      public:
+         explicit work_stealing_queues(const unsigned nqueues)
+            : m_queues(nqueues), m_pending(0)
+         {
+         }
+
+         void push(const unsigned queue, const Item& item)
+         {
+            m_pending.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(m_queues[queue].mutex);
+            m_queues[queue].items.push_back(item);
+         }
+
+         bool pop(const unsigned queue, Item& item)
+         {
+            {
+               std::lock_guard<std::mutex> lock(m_queues[queue].mutex);
+               if (!m_queues[queue].items.empty())
+               {
+                  item = m_queues[queue].items.back();
+                  m_queues[queue].items.pop_back();
+                  return true;
+               }
+            }
+            const unsigned nqueues = static_cast<unsigned>(m_queues.size());
+            for (unsigned k = 1; k < nqueues; ++k)
+            {
+               local_queue& victim = m_queues[(queue + k) % nqueues];
+               std::lock_guard<std::mutex> lock(victim.mutex);
+               if (!victim.items.empty())
+               {
+                  item = victim.items.front();
+                  victim.items.pop_front();
+                  return true;
+               }
+            }
+            return false;
+         }
+
+         // Called once an item taken by pop has been dealt with, after pushing
+         // anything it was split into, so that the count cannot drop to zero early
+         void finish()
+         {
+            m_pending.fetch_sub(1, std::memory_order_acq_rel);
+         }
+
+         bool all_finished() const
+         {
+            return m_pending.load(std::memory_order_acquire) == 0;
+         }
+
+      private:
+         struct alignas(64) local_queue
+         {
+            std::mutex mutex;
+            std::deque<Item> items;
+         };
+
+         std::vector<local_queue> m_queues;
+         std::atomic<size_t> m_pending;
+      };
+
+      // Runs process(item, queues, worker, partial) on every item until none are left,
+      // with the seeds spread over the queues of nworkers threads (the calling thread
+      // being one of them). The first exception thrown by process is rethrown once
+      // all the threads have stopped.
+      template <typename T, typename Item, typename Process>
+      quadrature_result<T> run_adaptive(const std::vector<Item>& seeds, const unsigned nworkers,
+         const size_t seed_evaluations, const T tolerance, Process process)
+      {
+         work_stealing_queues<Item> queues(nworkers);
+         for (size_t i = 0; i < seeds.size(); ++i)
+            queues.push(static_cast<unsigned>(i % nworkers), seeds[i]);
+
+         std::vector<partial_result<T>> partials(nworkers);
+         std::atomic<bool> abort(false);
+         std::exception_ptr error;
+         std::mutex error_mutex;
+
+         auto work = [&](const unsigned worker) {
+            Item item;
+            while (!abort.load(std::memory_order_relaxed))
+            {
+               if (queues.pop(worker, item))
+               {
+                  try
+                  {
+                     process(item, queues, worker, partials[worker]);
+                  }
+                  catch (...)
+                  {
+                     std::lock_guard<std::mutex> lock(error_mutex);
+                     if (!error)
+                        error = std::current_exception();
+                     abort.store(true, std::memory_order_relaxed);
+                  }
+                  queues.finish();
+               }
+               else if (queues.all_finished())
+                  break;
+               else
+                  std::this_thread::yield();
+            }
+         };
+
+         std::vector<std::thread> workers;
+         workers.reserve(nworkers - 1);
+         for (unsigned w = 1; w < nworkers; ++w)
+            workers.emplace_back(work, w);
+         work(0);
+         for (std::thread& worker : workers)
+            worker.join();
+
+         if (error)
+            std::rethrow_exception(error);
+
+         quadrature_result<T> result{ static_cast<T>(0.), static_cast<T>(0.), seed_evaluations, 0, true };
+         for (const partial_result<T>& partial : partials)
+         {
+            result.value += partial.value;
+            result.error += partial.error;
+            result.evaluations += partial.evaluations;
+            result.intervals += partial.intervals;
+            result.converged = result.converged && !partial.stopped_short;
+         }
+         result.converged = result.converged && result.error <= tolerance;
+         return result;
+      }
+
+      // Threads to use: 0 stands for one per hardware thread
+      inline unsigned worker_count(const unsigned nthreads)
+      {
+         return nthreads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : nthreads;
+      }
+
+      // True when [a, b] cannot be bisected any further in T
+      template <typename T>
+      inline bool too_narrow(const T a, const T b)
+      {
+         const T mid = a + static_cast<T>(0.5) * (b - a);
+         return !(mid > a && mid < b);
+      }
+
+      // An interval of adaptive Simpson, with the values of the integrand at its
+      // ends and middle, and the Simpson estimate over it
+      template <typename T>
+      struct simpson_interval
+      {
+         T a, b;
+         T fa, fm, fb;
+         T whole;
+         unsigned depth;
+      };
+
+      template <typename T>
+      struct bisected_interval
+      {
+         T a, b;
+         unsigned depth;
+      };
+
+      // Gauss-Kronrod rule with n_half nodes on each side of the centre: the Kronrod
+      // estimate of the integral over [a, b], and its QUADPACK error estimate. 
+      // at_rounding tells when the estimate is down to rounding, so that 
+      // bisecting further would not lower it.
+      template <typename T, size_t n_half, typename F>
+      void gauss_kronrod_rule(F& f, const T a, const T b, const long double (&nodes)[n_half],
+         const long double (&kronrod_weights)[n_half], const long double (&gauss_weights)[n_half / 2],
+         T& value, T& error, bool& at_rounding)
+      {
+         constexpr size_t n = 2 * n_half - 1;
+         const T centre = static_cast<T>(0.5) * (a + b);
+         const T half_length = static_cast<T>(0.5) * (b - a);
+
+         // Pairs of nodes first, then the centre
+         T xs[n];
+         T ys[n];
+         for (size_t j = 0; j + 1 < n_half; ++j)
+         {
+            const T offset = half_length * static_cast<T>(nodes[j]);
+            xs[2 * j] = centre - offset;
+            xs[2 * j + 1] = centre + offset;
+         }
+         xs[n - 1] = centre;
+         evaluate(f, static_cast<const T*>(xs), ys, n);
+
+         const T f_centre = ys[n - 1];
+         T kronrod = static_cast<T>(kronrod_weights[n_half - 1]) * f_centre;
+         T gauss = (n_half - 1) % 2 == 1 ? static_cast<T>(gauss_weights[(n_half - 1) / 2]) * f_centre : static_cast<T>(0.);
+         T abs_sum = std::abs(kronrod);
+         for (size_t j = 0; j + 1 < n_half; ++j)
+         {
+            const T pair = ys[2 * j] + ys[2 * j + 1];
+            kronrod += static_cast<T>(kronrod_weights[j]) * pair;
+            abs_sum += static_cast<T>(kronrod_weights[j]) * (std::abs(ys[2 * j]) + std::abs(ys[2 * j + 1]));
+            if (j % 2 == 1)
+               gauss += static_cast<T>(gauss_weights[j / 2]) * pair;
+         }
+
+         // Spread of the integrand about its mean, to scale the error
+         const T mean = static_cast<T>(0.5) * kronrod;
+         T spread = static_cast<T>(kronrod_weights[n_half - 1]) * std::abs(f_centre - mean);
+         for (size_t j = 0; j + 1 < n_half; ++j)
+            spread += static_cast<T>(kronrod_weights[j]) * (std::abs(ys[2 * j] - mean) + std::abs(ys[2 * j + 1] - mean));
+
+         const T scale = std::abs(half_length);
+         value = kronrod * half_length;
+         error = std::abs((kronrod - gauss) * half_length);
+         spread *= scale;
+         abs_sum *= scale;
+         if (spread != static_cast<T>(0.) && error != static_cast<T>(0.))
+            error = spread * std::min(static_cast<T>(1.), std::pow(static_cast<T>(200.) * error / spread, static_cast<T>(1.5)));
+         const T epsilon = std::numeric_limits<T>::epsilon();
+         at_rounding = false;
+         if (abs_sum > std::numeric_limits<T>::min() / (static_cast<T>(50.) * epsilon))
+         {
+            at_rounding = error <= static_cast<T>(50.) * epsilon * abs_sum;
+            error = std::max(static_cast<T>(50.) * epsilon * abs_sum, error);
+         }
+      }
+
+      // Bisects with a Gauss-Kronrod rule, each interval costing 2 n_half - 1 calls
+      template <typename T, size_t n_half, typename F>
+      quadrature_result<T> adaptive_gauss_kronrod(const T first, const T last, const T tolerance, F& f,
+         const long double (&nodes)[n_half], const long double (&kronrod_weights)[n_half],
+         const long double (&gauss_weights)[n_half / 2], const unsigned nthreads, const unsigned max_depth)
+      {
+         const unsigned nworkers = worker_count(nthreads);
+         const T length = std::abs(last - first);
+         std::vector<bisected_interval<T>> seeds(nworkers);
+         for (unsigned i = 0; i < nworkers; ++i)
+         {
+            seeds[i].a = first + (last - first) * static_cast<T>(i) / static_cast<T>(nworkers);
+            seeds[i].b = i + 1 == nworkers ? last : first + (last - first) * static_cast<T>(i + 1) / static_cast<T>(nworkers);
+            seeds[i].depth = 0;
+         }
+
+         return run_adaptive<T>(seeds, nworkers, 0, tolerance,
+            [&](const bisected_interval<T>& interval, work_stealing_queues<bisected_interval<T>>& queues,
+               const unsigned worker, partial_result<T>& partial) {
+            T value, error;
+            bool at_rounding;
+            gauss_kronrod_rule(f, interval.a, interval.b, nodes, kronrod_weights, gauss_weights, value, error, at_rounding);
+            partial.evaluations += 2 * n_half - 1;
+
+            const T share = length > static_cast<T>(0.) ? tolerance * std::abs(interval.b - interval.a) / length : tolerance;
+            const bool stop = at_rounding || interval.depth >= max_depth || too_narrow(interval.a, interval.b);
+            if (error <= share || stop)
+            {
+               partial.value += value;
+               partial.error += error;
+               partial.intervals += 1;
+               partial.stopped_short = partial.stopped_short || error > share;
+               return;
+            }
+            const T mid = interval.a + static_cast<T>(0.5) * (interval.b - interval.a);
+            queues.push(worker, bisected_interval<T>{ interval.a, mid, interval.depth + 1 });
+            queues.push(worker, bisected_interval<T>{ mid, interval.b, interval.depth + 1 });
+         });
+      }
+   }
+
+   /**
+    * @brief Integrates a function to an absolute tolerance with adaptive Simpson's rule
+    * (https://en.wikipedia.org/wiki/Adaptive_Simpson%27s_method).
+    *
+    * Each interval is compared with its two halves; the difference, divided by 15, estimates
+    * the error, and is added to the halves as the Richardson correction. Every value of the
+    * integrand is reused by the halves, so an interval costs 2 calls.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam F Any callable taking and returning T, or a batch integrand void(const T* xs, T* ys, size_t n).
+    * @param first [in] The starting value of the interval to calculate the integral for.
+    * @param last [in] The last value of the interval to calculate the integral for.
+    * @param tolerance [in] The absolute error to reach.
+    * @param f The function to integrate. Called from several threads at once when nthreads is not 1.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread. Threads only pay off for expensive integrands.
+    * @param max_depth [in] Most bisections of [first, last]; intervals this deep are accepted as they are.
+    * @return The integral, its error estimate and the number of calls of the integrand.
+    */
+   template <typename T, typename F>
+   typename std::enable_if<std::is_floating_point<T>::value, quadrature_result<T>>::type
+   adaptive_simpson(const T first, const T last, const T tolerance, F f, const unsigned nthreads = 1, const unsigned max_depth = 50)
+   {
+      using quadrature_detail::simpson_interval;
+      const unsigned nworkers = quadrature_detail::worker_count(nthreads);
+      const T length = std::abs(last - first);
+
+      // One piece per thread, sharing the values at their common ends
+      std::vector<T> xs(2 * nworkers + 1);
+      std::vector<T> ys(2 * nworkers + 1);
+      for (size_t i = 0; i < xs.size(); ++i)
+         xs[i] = i + 1 == xs.size() ? last : first + (last - first) * static_cast<T>(i) / static_cast<T>(xs.size() - 1);
+      quadrature_detail::evaluate(f, static_cast<const T*>(xs.data()), ys.data(), xs.size());
+
+      std::vector<simpson_interval<T>> seeds(nworkers);
+      for (unsigned i = 0; i < nworkers; ++i)
+      {
+         const T a = xs[2 * i];
+         const T b = xs[2 * i + 2];
+         seeds[i] = simpson_interval<T>{ a, b, ys[2 * i], ys[2 * i + 1], ys[2 * i + 2],
+            (b - a) / static_cast<T>(6.) * (ys[2 * i] + static_cast<T>(4.) * ys[2 * i + 1] + ys[2 * i + 2]), 0 };
+      }
+
+      return quadrature_detail::run_adaptive<T>(seeds, nworkers, xs.size(), tolerance,
+         [&](const simpson_interval<T>& interval, quadrature_detail::work_stealing_queues<simpson_interval<T>>& queues,
+            const unsigned worker, quadrature_detail::partial_result<T>& partial) {
+         const T a = interval.a;
+         const T b = interval.b;
+         const T mid = a + static_cast<T>(0.5) * (b - a);
+         const T quarters[2] = { a + static_cast<T>(0.25) * (b - a), a + static_cast<T>(0.75) * (b - a) };
+         T f_quarters[2];
+         quadrature_detail::evaluate(f, static_cast<const T*>(quarters), f_quarters, 2);
+         partial.evaluations += 2;
+
+         const T left = (mid - a) / static_cast<T>(6.) * (interval.fa + static_cast<T>(4.) * f_quarters[0] + interval.fm);
+         const T right = (b - mid) / static_cast<T>(6.) * (interval.fm + static_cast<T>(4.) * f_quarters[1] + interval.fb);
+         const T difference = left + right - interval.whole;
+         const T error = std::abs(difference) / static_cast<T>(15.);
+
+         const T share = length > static_cast<T>(0.) ? tolerance * std::abs(b - a) / length : tolerance;
+         const bool at_rounding = std::abs(difference) <= static_cast<T>(8.) * std::numeric_limits<T>::epsilon() * (std::abs(left) + std::abs(right));
+         const bool stop = at_rounding || interval.depth >= max_depth || quadrature_detail::too_narrow(a, mid) || quadrature_detail::too_narrow(mid, b);
+         if (error <= share || stop)
+         {
+            partial.value += left + right + difference / static_cast<T>(15.);
+            partial.error += error;
+            partial.intervals += 1;
+            partial.stopped_short = partial.stopped_short || error > share;
+            return;
+         }
+         queues.push(worker, simpson_interval<T>{ a, mid, interval.fa, f_quarters[0], interval.fm, left, interval.depth + 1 });
+         queues.push(worker, simpson_interval<T>{ mid, b, interval.fm, f_quarters[1], interval.fb, right, interval.depth + 1 });
+      });
+   }
+
+   /**
+    * @brief Integrates a function to an absolute tolerance with the adaptive 15 point
+    * Gauss-Kronrod rule (https://en.wikipedia.org/wiki/Gauss%E2%80%93Kronrod_quadrature_formula).
+    *
+    * The 7 point Gauss rule is embedded in the 15 point Kronrod rule; their difference gives
+    * the error estimate, scaled as in QUADPACK. Each interval costs 15 calls, and is bisected
+    * until its estimate is within its share of the tolerance.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam F Any callable taking and returning T, or a batch integrand void(const T* xs, T* ys, size_t n).
+    * @param first [in] The starting value of the interval to calculate the integral for.
+    * @param last [in] The last value of the interval to calculate the integral for.
+    * @param tolerance [in] The absolute error to reach.
+    * @param f The function to integrate. Called from several threads at once when nthreads is not 1.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread. Threads only pay off for expensive integrands.
+    * @param max_depth [in] Most bisections of [first, last]; intervals this deep are accepted as they are.
+    * @return The integral, its error estimate and the number of calls of the integrand.
+    */
+   template <typename T, typename F>
+   typename std::enable_if<std::is_floating_point<T>::value, quadrature_result<T>>::type
+   gauss_kronrod_15(const T first, const T last, const T tolerance, F f, const unsigned nthreads = 1, const unsigned max_depth = 50)
+   {
+      return quadrature_detail::adaptive_gauss_kronrod(first, last, tolerance, f, quadrature_detail::gk15_nodes,
+         quadrature_detail::gk15_kronrod_weights, quadrature_detail::gk15_gauss_weights, nthreads, max_depth);
+   }
+
+   /**
+    * @brief Integrates a function to an absolute tolerance with the adaptive 21 point
+    * Gauss-Kronrod rule (https://en.wikipedia.org/wiki/Gauss%E2%80%93Kronrod_quadrature_formula).
+    *
+    * As gauss_kronrod_15, with the 10 point Gauss rule embedded in the 21 point Kronrod rule.
+    * Each interval costs 21 calls, but smooth integrands need fewer intervals.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam F Any callable taking and returning T, or a batch integrand void(const T* xs, T* ys, size_t n).
+    * @param first [in] The starting value of the interval to calculate the integral for.
+    * @param last [in] The last value of the interval to calculate the integral for.
+    * @param tolerance [in] The absolute error to reach.
+    * @param f The function to integrate. Called from several threads at once when nthreads is not 1.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread. Threads only pay off for expensive integrands.
+    * @param max_depth [in] Most bisections of [first, last]; intervals this deep are accepted as they are.
+    * @return The integral, its error estimate and the number of calls of the integrand.
+    */
+   template <typename T, typename F>
+   typename std::enable_if<std::is_floating_point<T>::value, quadrature_result<T>>::type
+   gauss_kronrod_21(const T first, const T last, const T tolerance, F f, const unsigned nthreads = 1, const unsigned max_depth = 50)
+   {
+      return quadrature_detail::adaptive_gauss_kronrod(first, last, tolerance, f, quadrature_detail::gk21_nodes,
+         quadrature_detail::gk21_kronrod_weights, quadrature_detail::gk21_gauss_weights, nthreads, max_depth);
+   }
+
+   /**
+    * @brief Integrates a function to an absolute tolerance with the tanh-sinh (double
+    * exponential) rule (https://en.wikipedia.org/wiki/Tanh-sinh_quadrature).
+    *
+    * The substitution x = tanh(pi / 2 sinh(t)) crowds the nodes towards both ends at a
+    * double exponential rate, so integrands with integrable singularities at the ends,
+    * such as 1 / sqrt(x) or log(x) on [0, 1], converge about as fast as smooth ones. The
+    * integrand is never called at the ends themselves: the distance of each node to its end
+    * is computed directly, so that nodes next to an end are not rounded onto it. Next to an
+    * end other than 0, nodes cannot get closer than the spacing of T there, which limits
+    * strong singularities such as 1 / sqrt(1 - x) at 1 to about sqrt(epsilon); a change of
+    * variable moving the singularity to 0 avoids that. The step
+    * is halved until the estimate settles within the tolerance; each level reuses the
+    * nodes of the ones before and doubles their number. Levels are too small to be worth
+    * threads, so this rule stays on the calling thread.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam F Any callable taking and returning T, or a batch integrand void(const T* xs, T* ys, size_t n).
+    * @param first [in] The starting value of the interval to calculate the integral for.
+    * @param last [in] The last value of the interval to calculate the integral for.
+    * @param tolerance [in] The absolute error to reach.
+    * @param f The function to integrate.
+    * @param max_levels [in] Most halvings of the step, starting from 1.
+    * @return The integral, its error estimate and the number of calls of the integrand.
+    */
+   template <typename T, typename F>
+   typename std::enable_if<std::is_floating_point<T>::value, quadrature_result<T>>::type
+   tanh_sinh(const T first, const T last, const T tolerance, F f, const unsigned max_levels = 12)
+   {
+      const T half_pi = static_cast<T>(M_PI_2);
+      const T centre = static_cast<T>(0.5) * (first + last);
+      const T half_length = static_cast<T>(0.5) * (last - first);
+
+      // The pair of nodes at t > 0 sits at first + d and last - d, where
+      // d = half_length (1 - tanh(s)) = half_length 2 e / (1 + e), with s = pi / 2 sinh(t) and e = exp(-2 s)
+      auto node = [&](const T t, T& d, T& w) {
+         const T e = std::exp(static_cast<T>(-2.) * half_pi * std::sinh(t));
+         d = half_length * static_cast<T>(2.) * e / (static_cast<T>(1.) + e);
+         w = half_length * half_pi * std::cosh(t) * static_cast<T>(4.) * e / ((static_cast<T>(1.) + e) * (static_cast<T>(1.) + e));
+      };
+
+      // Sum of w f over the nodes at t = t0, t0 + dt, ... (up to t_max), in batches. 
+      // A node is left out once it rounds onto its end, or its weight underflows 
+      // (the weights are negative when first > last). The ends are checked one by 
+      // one, as nodes can get much closer to an end at 0 than to an end at 1.
+      constexpr size_t batch_nodes = 128;
+      T xs[batch_nodes];
+      T ws[batch_nodes];
+      T ys[batch_nodes];
+      quadrature_result<T> result{ static_cast<T>(0.), static_cast<T>(0.), 0, 0, false };
+      auto sum_nodes = [&](const T t0, const T dt, const T t_max, T& t_last) {
+         T sum{ 0 };
+         size_t j = 0;
+         bool more = true;
+         while (more)
+         {
+            size_t len = 0;
+            while (len + 2 <= batch_nodes)
+            {
+               const T t = t0 + dt * static_cast<T>(j);
+               T d, w;
+               node(t, d, w);
+               const bool first_side = d != static_cast<T>(0.) && first + d != first;
+               const bool last_side = d != static_cast<T>(0.) && last - d != last;
+               if (t > t_max || !(std::abs(w) > static_cast<T>(0.)) || !(first_side || last_side))
+               {
+                  more = false;
+                  break;
+               }
+               if (first_side)
+               {
+                  xs[len] = first + d;
+                  ws[len++] = w;
+               }
+               if (last_side)
+               {
+                  xs[len] = last - d;
+                  ws[len++] = w;
+               }
+               t_last = t;
+               ++j;
+            }
+            if (len == 0)
+               break;
+            quadrature_detail::evaluate(f, static_cast<const T*>(xs), ys, len);
+            result.evaluations += len;
+            for (size_t k = 0; k < len; ++k)
+               sum += ws[k] * ys[k];
+         }
+         return sum;
+      };
+
+      // Level 0: step 1, from the centre out to the last node apart from the ends
+      T f_centre;
+      quadrature_detail::evaluate(f, &centre, &f_centre, 1);
+      result.evaluations += 1;
+      T t_max = static_cast<T>(0.);
+      T sum = half_length * half_pi * f_centre + sum_nodes(static_cast<T>(1.), static_cast<T>(1.), std::numeric_limits<T>::max(), t_max);
+
+      T step = static_cast<T>(1.);
+      T estimate = sum;
+      T previous_change = std::numeric_limits<T>::max();
+      result.error = std::numeric_limits<T>::max();
+      for (unsigned level = 1; level <= max_levels; ++level)
+      {
+         // The new nodes fall halfway between the old ones
+         step *= static_cast<T>(0.5);
+         T t_unused;
+         sum += sum_nodes(step, static_cast<T>(2.) * step, t_max, t_unused);
+         const T next = step * sum;
+         const T change = std::abs(next - estimate);
+         estimate = next;
+         result.intervals = level;
+
+         // The number of correct digits about doubles with each level, so once the
+         // changes shrink, the error of the new estimate is about change^2 / previous_change
+         result.error = change < previous_change && previous_change > static_cast<T>(0.) && level > 1 ?
+            std::max(change * change / previous_change, static_cast<T>(4.) * std::numeric_limits<T>::epsilon() * std::abs(next)) : change;
+         previous_change = change;
+         if (result.error <= tolerance)
+         {
+            result.converged = true;
+            break;
+         }
+      }
+      result.value = estimate;
+      return result;
+   }
+}
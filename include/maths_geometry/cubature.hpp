@@ -0,0 +1,619 @@
+#pragma once
+
+#include "maths_geometry/gauss_rules.hpp"
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/parallel_chunks.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Integration in 2D and 3D over rectangular boxes and over the cells of a raster
+// grid described by a geotransform (see set_affine_geotransform). A rule is a set
+// of points in the unit square or cube with weights adding up to 1, mapped onto
+// each box or cell:
+// - tensor_product_rule: the product of 1D Gauss rules (gauss_rules.hpp)
+// - degree5_square_rule and degree5_cube_rule: fully symmetric rules exact for
+//   polynomials of degree 5, with 7 points (Radon) and 14 points (Hammer-Stroud),
+//   against 9 and 27 for the tensor product of 3 point Gauss-Legendre rules
+// - sobol_rule: the first points of the Sobol sequence with equal weights, for
+//   quasi-Monte Carlo integration of rough integrands
+//
+// Integrands are called either per point, as f(x, y) or f(x, y, z), or per batch of
+// points, as f(const T* xs, const T* ys, T* values, size_t n) or
+// f(const T* xs, const T* ys, const T* zs, T* values, size_t n).
+
+namespace maths_ops
+{
+   /**
+    * @brief Points in the unit square (D = 2) or cube (D = 3) with weights
+    * adding up to 1: the integral over a box is its volume times the weighted
+    * sum of the integrand at the mapped points.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam D 2 or 3.
+    */
+   template <typename T, size_t D>
+   class cubature_rule
+   {
+      static_assert(std::is_floating_point<T>::value, "cubature_rule supports float, double and long double");
+      static_assert(D == 2 || D == 3, "cubature_rule supports 2 and 3 dimensions");
+
+   public:
+      cubature_rule() = default;
+
+      /**
+       * @brief Builds a rule from its points and weights.
+       *
+       * @param coords [in] D arrays of n coordinates in [0, 1], one per dimension.
+       * @param weights [in] The n weights, adding up to 1.
+       * @param n [in] The number of points.
+       */
+      cubature_rule(const std::array<const T*, D>& coords, const T* weights, const size_t n)
+         : m_weights(weights, weights + n)
+      {
+         for (size_t d = 0; d < D; ++d)
+            m_coords[d].assign(coords[d], coords[d] + n);
+      }
+
+      size_t size() const { return m_weights.size(); }
+
+      // The coordinates of the points along dimension d (0 for x, 1 for y, 2 for z)
+      const T* coords(const size_t d) const { return m_coords[d].data(); }
+
+      const T* weights() const { return m_weights.data(); }
+
+   private:
+      std::array<std::vector<T>, D> m_coords;
+      std::vector<T> m_weights;
+   };
+
+   namespace cubature_detail
+   {
+      // Points handed to a batch integrand per call, unless one cell has more
+      constexpr size_t batch_points = 256;
+
+      // Fewest elements worth a thread, counted per integrand evaluation
+      constexpr size_t elements_per_point = 16;
+
+      template <typename F, typename T, size_t D, typename = void>
+      struct is_batch_field : std::false_type {};
+
+      template <typename F, typename T>
+      struct is_batch_field<F, T, 2, decltype(void(std::declval<F&>()(
+         std::declval<const T*>(), std::declval<const T*>(), std::declval<T*>(), std::declval<size_t>())))> : std::true_type {};
+
+      template <typename F, typename T>
+      struct is_batch_field<F, T, 3, decltype(void(std::declval<F&>()(
+         std::declval<const T*>(), std::declval<const T*>(), std::declval<const T*>(), std::declval<T*>(), std::declval<size_t>())))> : std::true_type {};
+
+      template <typename T, typename F>
+      T evaluate(F& f, const T x, const T y, const T*, std::integral_constant<size_t, 2>)
+      {
+         return f(x, y);
+      }
+
+      template <typename T, typename F>
+      T evaluate(F& f, const T x, const T y, const T* z, std::integral_constant<size_t, 3>)
+      {
+         return f(x, y, *z);
+      }
+
+      template <typename T, typename F>
+      void evaluate_batch(F& f, const T* xs, const T* ys, const T*, T* values, const size_t n, std::integral_constant<size_t, 2>)
+      {
+         f(xs, ys, values, n);
+      }
+
+      template <typename T, typename F>
+      void evaluate_batch(F& f, const T* xs, const T* ys, const T* zs, T* values, const size_t n, std::integral_constant<size_t, 3>)
+      {
+         f(xs, ys, zs, values, n);
+      }
+
+      // The cells of a raster window, or of a box split into equal parts. The
+      // corner of cell (row, col) is origin + col * col_step + row * row_step, and
+      // the rule's unit square maps onto the parallelogram spanned by the steps.
+      // In 3D, the cells span [z_first, z_first + z_step] in z.
+      template <typename T, size_t D>
+      struct cell_layout
+      {
+         T x0, y0;
+         T col_dx, col_dy, row_dx, row_dy;
+         T z_first = 0, z_step = 1;
+      };
+
+      // The points of a rule mapped onto the cell with its corner at the origin, 
+      // and the volume of a cell
+      template <typename T, size_t D>
+      struct mapped_rule
+      {
+         std::vector<T> ox, oy, oz;
+         T volume;
+
+         mapped_rule(const cubature_rule<T, D>& rule, const cell_layout<T, D>& cells)
+            : ox(rule.size()), oy(rule.size()), oz(D == 3 ? rule.size() : 0)
+         {
+            const T* u = rule.coords(0);
+            const T* v = rule.coords(1);
+            for (size_t k = 0; k < rule.size(); ++k)
+            {
+               ox[k] = u[k] * cells.col_dx + v[k] * cells.row_dx;
+               oy[k] = u[k] * cells.col_dy + v[k] * cells.row_dy;
+            }
+            for (size_t k = 0; k < oz.size(); ++k)
+               oz[k] = cells.z_first + rule.coords(D - 1)[k] * cells.z_step;
+            volume = std::abs(cells.col_dx * cells.row_dy - cells.col_dy * cells.row_dx) * (D == 3 ? std::abs(cells.z_step) : static_cast<T>(1));
+         }
+      };
+
+      template <typename T, size_t D>
+      void cell_corner(const cell_layout<T, D>& cells, const size_t row, const size_t col, T& x, T& y)
+      {
+         const T c = integration_detail::node_index<T>(col);
+         const T r = integration_detail::node_index<T>(row);
+         x = cells.x0 + c * cells.col_dx + r * cells.row_dx;
+         y = cells.y0 + c * cells.col_dy + r * cells.row_dy;
+      }
+
+      // Writes the integral over each cell (row, col) for the rows in [row_begin, row_end)
+      // and the columns in [0, ncols) through sink(row, col, value). The points of the
+      // rule are mapped once; each cell only adds its corner to them.
+      template <typename T, size_t D, typename F, typename S>
+      void cell_integrals(const cubature_rule<T, D>& rule, const cell_layout<T, D>& cells,
+         const size_t row_begin, const size_t row_end, const size_t ncols, F& f, S sink, std::false_type)
+      {
+         const mapped_rule<T, D> mapped(rule, cells);
+         const size_t n = rule.size();
+         const T* w = rule.weights();
+         for (size_t row = row_begin; row < row_end; ++row)
+         {
+            for (size_t col = 0; col < ncols; ++col)
+            {
+               T x, y;
+               cell_corner(cells, row, col, x, y);
+               const T sum = integration_detail::lane_sum<T>(n, [&](const size_t k, T) {
+                  return w[k] * evaluate<T>(f, x + mapped.ox[k], y + mapped.oy[k], mapped.oz.data() + (D == 3 ? k : 0), std::integral_constant<size_t, D>());
+               });
+               sink(row, col, mapped.volume * sum);
+            }
+         }
+      }
+
+      // The same for batch integrands: whole cells of a row go to the integrand together
+      template <typename T, size_t D, typename F, typename S>
+      void cell_integrals(const cubature_rule<T, D>& rule, const cell_layout<T, D>& cells,
+         const size_t row_begin, const size_t row_end, const size_t ncols, F& f, S sink, std::true_type)
+      {
+         const mapped_rule<T, D> mapped(rule, cells);
+         const size_t n = rule.size();
+         const T* w = rule.weights();
+         const size_t per_batch = std::max<size_t>(1, batch_points / std::max<size_t>(1, n));
+         std::vector<T> xs(per_batch * n), ys(per_batch * n), zs(D == 3 ? per_batch * n : 0), values(per_batch * n);
+         for (size_t j = 0; D == 3 && j < per_batch; ++j)
+            std::copy(mapped.oz.begin(), mapped.oz.end(), zs.begin() + j * n);
+         for (size_t row = row_begin; row < row_end; ++row)
+         {
+            for (size_t col0 = 0; col0 < ncols; col0 += per_batch)
+            {
+               const size_t col1 = std::min(ncols, col0 + per_batch);
+               for (size_t col = col0, i = 0; col < col1; ++col)
+               {
+                  T x, y;
+                  cell_corner(cells, row, col, x, y);
+                  for (size_t k = 0; k < n; ++k, ++i)
+                  {
+                     xs[i] = x + mapped.ox[k];
+                     ys[i] = y + mapped.oy[k];
+                  }
+               }
+               evaluate_batch<T>(f, static_cast<const T*>(xs.data()), static_cast<const T*>(ys.data()), static_cast<const T*>(zs.data()),
+                  values.data(), (col1 - col0) * n, std::integral_constant<size_t, D>());
+               for (size_t col = col0; col < col1; ++col)
+               {
+                  const T* y = values.data() + (col - col0) * n;
+                  sink(row, col, mapped.volume * integration_detail::lane_sum<T>(n, [&](const size_t k, T) { return w[k] * y[k]; }));
+               }
+            }
+         }
+      }
+
+      template <typename T, size_t D, typename F, typename S>
+      void cell_integrals(const cubature_rule<T, D>& rule, const cell_layout<T, D>& cells,
+         const size_t row_begin, const size_t row_end, const size_t ncols, F& f, S sink)
+      {
+         cell_integrals(rule, cells, row_begin, row_end, ncols, f, sink, is_batch_field<F, T, D>());
+      }
+
+      // Sobol direction numbers (Joe and Kuo) for the second and third dimensions:
+      // the degree s, the coefficients a and the initial m_1, ..., m_s of the primitive polynomial
+      struct sobol_polynomial
+      {
+         unsigned s;
+         unsigned a;
+         uint32_t m[2];
+      };
+
+      constexpr sobol_polynomial sobol_polynomials[2] = { { 1, 0, { 1, 0 } }, { 2, 1, { 1, 3 } } };
+   }
+
+   /**
+    * @brief The Sobol low discrepancy sequence in up to 3 dimensions, with 32 bit
+    * direction numbers from Joe and Kuo, generated in Gray code order.
+    *
+    * The first point is the origin. The first 2^m points of each dimension are
+    * spread evenly: each of the 2^m intervals [i / 2^m, (i + 1) / 2^m) gets one.
+    */
+   class sobol_sequence
+   {
+   public:
+      /**
+       * @param dimensions [in] 1, 2 or 3; larger values are taken as 3.
+       */
+      explicit sobol_sequence(const unsigned dimensions)
+         : m_dimensions(std::min(3u, std::max(1u, dimensions)))
+      {
+         for (unsigned i = 1; i <= 32; ++i)
+            m_directions[0][i - 1] = uint32_t(1) << (32 - i);
+         for (unsigned d = 1; d < m_dimensions; ++d)
+         {
+            const cubature_detail::sobol_polynomial& p = cubature_detail::sobol_polynomials[d - 1];
+            uint32_t* v = m_directions[d];
+            for (unsigned i = 1; i <= 32; ++i)
+            {
+               if (i <= p.s)
+               {
+                  v[i - 1] = p.m[i - 1] << (32 - i);
+                  continue;
+               }
+               uint32_t x = v[i - p.s - 1] ^ (v[i - p.s - 1] >> p.s);
+               for (unsigned k = 1; k < p.s; ++k)
+                  x ^= ((p.a >> (p.s - 1 - k)) & 1u) ? v[i - k - 1] : 0u;
+               v[i - 1] = x;
+            }
+         }
+      }
+
+      unsigned dimensions() const { return m_dimensions; }
+
+      /**
+       * @brief Writes the next point and moves on.
+       *
+       * @tparam T Supports float, double and long double.
+       * @param point [out] The coordinates, in [0, 1). Must hold dimensions() values.
+       */
+      template <typename T>
+      typename std::enable_if<std::is_floating_point<T>::value, void>::type
+      next(T* point)
+      {
+         const T scale = static_cast<T>(1) / static_cast<T>(4294967296.0);
+         for (unsigned d = 0; d < m_dimensions; ++d)
+            point[d] = static_cast<T>(m_state[d]) * scale;
+
+         // The next point flips the direction of the lowest zero bit of the index
+         unsigned c = 0;
+         for (uint64_t i = m_index; (i & 1u) != 0 && c < 31; i >>= 1)
+            ++c;
+         for (unsigned d = 0; d < m_dimensions; ++d)
+            m_state[d] ^= m_directions[d][c];
+         ++m_index;
+      }
+
+   private:
+      unsigned m_dimensions;
+      uint64_t m_index = 0;
+      uint32_t m_state[3] = {};
+      uint32_t m_directions[3][32] = {};
+   };
+
+   /**
+    * @brief The tensor product of two 1D Gauss rules, on the unit square.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param rx [in] The rule along x.
+    * @param ry [in] The rule along y.
+    * @return The rule, with rx.order() * ry.order() points.
+    */
+   template <typename T>
+   cubature_rule<T, 2> tensor_product_rule(const gauss_rule<T>& rx, const gauss_rule<T>& ry)
+   {
+      const size_t n = rx.order() * ry.order();
+      std::vector<T> xs(n), ys(n), ws(n);
+      for (size_t i = 0, k = 0; i < ry.order(); ++i)
+      {
+         for (size_t j = 0; j < rx.order(); ++j, ++k)
+         {
+            xs[k] = static_cast<T>(0.5) * (static_cast<T>(1) + rx.nodes()[j]);
+            ys[k] = static_cast<T>(0.5) * (static_cast<T>(1) + ry.nodes()[i]);
+            ws[k] = static_cast<T>(0.25) * rx.weights()[j] * ry.weights()[i];
+         }
+      }
+      return cubature_rule<T, 2>({ { xs.data(), ys.data() } }, ws.data(), n);
+   }
+
+   /**
+    * @brief The tensor product of three 1D Gauss rules, on the unit cube.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param rx [in] The rule along x.
+    * @param ry [in] The rule along y.
+    * @param rz [in] The rule along z.
+    * @return The rule, with rx.order() * ry.order() * rz.order() points.
+    */
+   template <typename T>
+   cubature_rule<T, 3> tensor_product_rule(const gauss_rule<T>& rx, const gauss_rule<T>& ry, const gauss_rule<T>& rz)
+   {
+      const size_t n = rx.order() * ry.order() * rz.order();
+      std::vector<T> xs(n), ys(n), zs(n), ws(n);
+      size_t k = 0;
+      for (size_t l = 0; l < rz.order(); ++l)
+      {
+         for (size_t i = 0; i < ry.order(); ++i)
+         {
+            for (size_t j = 0; j < rx.order(); ++j, ++k)
+            {
+               xs[k] = static_cast<T>(0.5) * (static_cast<T>(1) + rx.nodes()[j]);
+               ys[k] = static_cast<T>(0.5) * (static_cast<T>(1) + ry.nodes()[i]);
+               zs[k] = static_cast<T>(0.5) * (static_cast<T>(1) + rz.nodes()[l]);
+               ws[k] = static_cast<T>(0.125) * rx.weights()[j] * ry.weights()[i] * rz.weights()[l];
+            }
+         }
+      }
+      return cubature_rule<T, 3>({ { xs.data(), ys.data(), zs.data() } }, ws.data(), n);
+   }
+
+   /**
+    * @brief Radon's 7 point rule on the unit square, exact for polynomials of degree 5.
+    *
+    * @tparam T Supports float, double and long double.
+    * @return The rule.
+    */
+   template <typename T>
+   cubature_rule<T, 2> degree5_square_rule()
+   {
+      // On [-1, 1]^2: the centre, two points on the y axis and four at (+-a, +-b)
+      const T r = std::sqrt(static_cast<T>(14) / static_cast<T>(15));
+      const T a = std::sqrt(static_cast<T>(3) / static_cast<T>(5));
+      const T b = std::sqrt(static_cast<T>(1) / static_cast<T>(3));
+      const T xs[7] = { 0, 0, 0, a, a, -a, -a };
+      const T ys[7] = { 0, r, -r, b, -b, b, -b };
+      const T ws[7] = { static_cast<T>(8) / static_cast<T>(7), static_cast<T>(20) / static_cast<T>(63), static_cast<T>(20) / static_cast<T>(63),
+         static_cast<T>(5) / static_cast<T>(9), static_cast<T>(5) / static_cast<T>(9), static_cast<T>(5) / static_cast<T>(9), static_cast<T>(5) / static_cast<T>(9) };
+      T us[7], vs[7], unit_ws[7];
+      for (size_t k = 0; k < 7; ++k)
+      {
+         us[k] = static_cast<T>(0.5) * (static_cast<T>(1) + xs[k]);
+         vs[k] = static_cast<T>(0.5) * (static_cast<T>(1) + ys[k]);
+         unit_ws[k] = static_cast<T>(0.25) * ws[k];
+      }
+      return cubature_rule<T, 2>({ { us, vs } }, unit_ws, 7);
+   }
+
+   /**
+    * @brief The Hammer-Stroud 14 point rule on the unit cube, exact for polynomials of degree 5.
+    *
+    * @tparam T Supports float, double and long double.
+    * @return The rule.
+    */
+   template <typename T>
+   cubature_rule<T, 3> degree5_cube_rule()
+   {
+      // On [-1, 1]^3: six points on the axes at +-r and eight at (+-s, +-s, +-s)
+      const T r = std::sqrt(static_cast<T>(19) / static_cast<T>(30));
+      const T s = std::sqrt(static_cast<T>(19) / static_cast<T>(33));
+      const T axis_w = static_cast<T>(320) / static_cast<T>(361);
+      const T corner_w = static_cast<T>(121) / static_cast<T>(361);
+      T us[3][14], ws[14];
+      size_t k = 0;
+      for (size_t d = 0; d < 3; ++d)
+      {
+         for (const T sign : { static_cast<T>(1), static_cast<T>(-1) })
+         {
+            for (size_t e = 0; e < 3; ++e)
+               us[e][k] = e == d ? sign * r : static_cast<T>(0);
+            ws[k++] = axis_w;
+         }
+      }
+      for (size_t corner = 0; corner < 8; ++corner, ++k)
+      {
+         for (size_t e = 0; e < 3; ++e)
+            us[e][k] = (corner >> e) & 1u ? -s : s;
+         ws[k] = corner_w;
+      }
+      for (k = 0; k < 14; ++k)
+      {
+         for (size_t e = 0; e < 3; ++e)
+            us[e][k] = static_cast<T>(0.5) * (static_cast<T>(1) + us[e][k]);
+         ws[k] *= static_cast<T>(0.125);
+      }
+      return cubature_rule<T, 3>({ { us[0], us[1], us[2] } }, ws, 14);
+   }
+
+   /**
+    * @brief The first n points of the Sobol sequence with equal weights, for
+    * quasi-Monte Carlo integration. Its error falls about as 1 / n for smooth
+    * integrands, against 1 / sqrt(n) for random points; n should be a power of 2.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam D 2 or 3.
+    * @param n [in] The number of points.
+    * @return The rule.
+    */
+   template <typename T, size_t D>
+   cubature_rule<T, D> sobol_rule(const size_t n)
+   {
+      sobol_sequence sequence(D);
+      std::array<std::vector<T>, D> coords;
+      for (size_t d = 0; d < D; ++d)
+         coords[d].resize(n);
+      const std::vector<T> ws(n, n > 0 ? static_cast<T>(1) / static_cast<T>(n) : static_cast<T>(0));
+      T point[D];
+      for (size_t k = 0; k < n; ++k)
+      {
+         sequence.next(point);
+         for (size_t d = 0; d < D; ++d)
+            coords[d][k] = point[d];
+      }
+      std::array<const T*, D> pointers;
+      for (size_t d = 0; d < D; ++d)
+         pointers[d] = coords[d].data();
+      return cubature_rule<T, D>(pointers, ws.data(), n);
+   }
+
+   /**
+    * @brief Integrates f(x, y) over [x_first, x_last] x [y_first, y_last],
+    * split into nx by ny equal boxes with the rule on each.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam F Callable as T f(T x, T y), or void f(const T* xs, const T* ys, T* values, size_t n).
+    * @param rule [in] The rule on the unit square.
+    * @param x_first [in] The start of the box along x.
+    * @param x_last [in] The end of the box along x.
+    * @param y_first [in] The start of the box along y.
+    * @param y_last [in] The end of the box along y.
+    * @param f The function to integrate.
+    * @param nx [in] The number of boxes along x.
+    * @param ny [in] The number of boxes along y.
+    * @return The value of the integral.
+    */
+   template <typename T, typename F>
+   typename std::enable_if<std::is_floating_point<T>::value, T>::type
+   integrate_box(const cubature_rule<T, 2>& rule, const T x_first, const T x_last, const T y_first, const T y_last, F f,
+      const size_t nx = 1, const size_t ny = 1)
+   {
+      if (nx == 0 || ny == 0)
+         return static_cast<T>(0);
+      const T dx = (x_last - x_first) / static_cast<T>(nx);
+      const T dy = (y_last - y_first) / static_cast<T>(ny);
+      const cubature_detail::cell_layout<T, 2> cells{ x_first, y_first, dx, 0, 0, dy };
+      T sum{ 0 };
+      cubature_detail::cell_integrals(rule, cells, 0, ny, nx, f, [&sum](size_t, size_t, const T value) { sum += value; });
+      return sum;
+   }
+
+   /**
+    * @brief Integrates f(x, y, z) over [x_first, x_last] x [y_first, y_last] x [z_first, z_last],
+    * split into nx by ny by nz equal boxes with the rule on each.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam F Callable as T f(T x, T y, T z), or void f(const T* xs, const T* ys, const T* zs, T* values, size_t n).
+    * @param rule [in] The rule on the unit cube.
+    * @param x_first [in] The start of the box along x.
+    * @param x_last [in] The end of the box along x.
+    * @param y_first [in] The start of the box along y.
+    * @param y_last [in] The end of the box along y.
+    * @param z_first [in] The start of the box along z.
+    * @param z_last [in] The end of the box along z.
+    * @param f The function to integrate.
+    * @param nx [in] The number of boxes along x.
+    * @param ny [in] The number of boxes along y.
+    * @param nz [in] The number of boxes along z.
+    * @return The value of the integral.
+    */
+   template <typename T, typename F>
+   typename std::enable_if<std::is_floating_point<T>::value, T>::type
+   integrate_box(const cubature_rule<T, 3>& rule, const T x_first, const T x_last, const T y_first, const T y_last,
+      const T z_first, const T z_last, F f, const size_t nx = 1, const size_t ny = 1, const size_t nz = 1)
+   {
+      if (nx == 0 || ny == 0 || nz == 0)
+         return static_cast<T>(0);
+      const T dx = (x_last - x_first) / static_cast<T>(nx);
+      const T dy = (y_last - y_first) / static_cast<T>(ny);
+      const T dz = (z_last - z_first) / static_cast<T>(nz);
+      T sum{ 0 };
+      for (size_t layer = 0; layer < nz; ++layer)
+      {
+         const cubature_detail::cell_layout<T, 3> cells{ x_first, y_first, dx, 0, 0, dy, z_first + dz * integration_detail::node_index<T>(layer), dz };
+         cubature_detail::cell_integrals(rule, cells, 0, ny, nx, f, [&sum](size_t, size_t, const T value) { sum += value; });
+      }
+      return sum;
+   }
+
+   /**
+    * @brief Integrates f(x, y) over each cell of a window of a raster grid,
+    * writing one integral per cell.
+    *
+    * The cells are the parallelograms of the geotransform, which may be rotated:
+    * cell (row, col) spans from apply_geotransform at (row, col) to (row + 1, col + 1).
+    * Divide by the cell area, |geotransform[1] * geotransform[5] - geotransform[2] * geotransform[4]|,
+    * for cell means. The rows are split between threads; a batch integrand gets the
+    * points of consecutive cells of a row together.
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam GT Supports float, double and long double.
+    * @tparam F Callable as T f(T x, T y), or void f(const T* xs, const T* ys, T* values, size_t n).
+    * Must be safe to call from several threads when nthreads is not 1.
+    * @param out [out] The integrals, row-major (see get_row_major_linear_index). Must hold nrows * ncols elements.
+    * @param first_row [in] The row index of the first row of the window.
+    * @param nrows [in] The number of rows of the window.
+    * @param first_col [in] The column index of the first column of the window.
+    * @param ncols [in] The number of columns of the window.
+    * @param geotransform [in] The geotransform array.
+    * @param rule [in] The rule on the unit square.
+    * @param f The function to integrate.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename T, typename GT, typename F>
+   typename std::enable_if<std::is_floating_point<T>::value && std::is_floating_point<GT>::value, void>::type
+   integrate_raster_cells(T* out, const size_t first_row, const size_t nrows, const size_t first_col, const size_t ncols,
+      const GT* geotransform, const cubature_rule<T, 2>& rule, F f, const unsigned nthreads = 0)
+   {
+      T x0, y0;
+      apply_geotransform(&x0, &y0, first_row, first_col, geotransform);
+      const cubature_detail::cell_layout<T, 2> cells{ x0, y0, static_cast<T>(geotransform[1]), static_cast<T>(geotransform[4]),
+         static_cast<T>(geotransform[2]), static_cast<T>(geotransform[5]) };
+      parallel_chunks(nrows, ncols * std::max<size_t>(1, rule.size()) * cubature_detail::elements_per_point, nthreads, [&](const size_t row_begin, const size_t row_end)
+      {
+         F local = f;
+         cubature_detail::cell_integrals(rule, cells, row_begin, row_end, ncols, local, [&](const size_t row, const size_t col, const T value) {
+            out[get_row_major_linear_index(row, col, ncols)] = value;
+         });
+      });
+   }
+
+   /**
+    * @brief Integrates f(x, y, z) over each cell of a window of a raster grid
+    * extended over [z_first, z_last], e.g. the columns of air above the cells,
+    * writing one integral per cell. As the 2D integrate_raster_cells otherwise.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam GT Supports float, double and long double.
+    * @tparam F Callable as T f(T x, T y, T z), or void f(const T* xs, const T* ys, const T* zs, T* values, size_t n).
+    * Must be safe to call from several threads when nthreads is not 1.
+    * @param out [out] The integrals, row-major (see get_row_major_linear_index). Must hold nrows * ncols elements.
+    * @param first_row [in] The row index of the first row of the window.
+    * @param nrows [in] The number of rows of the window.
+    * @param first_col [in] The column index of the first column of the window.
+    * @param ncols [in] The number of columns of the window.
+    * @param geotransform [in] The geotransform array.
+    * @param z_first [in] The bottom of the cells.
+    * @param z_last [in] The top of the cells.
+    * @param rule [in] The rule on the unit cube.
+    * @param f The function to integrate.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename T, typename GT, typename F>
+   typename std::enable_if<std::is_floating_point<T>::value && std::is_floating_point<GT>::value, void>::type
+   integrate_raster_cells(T* out, const size_t first_row, const size_t nrows, const size_t first_col, const size_t ncols,
+      const GT* geotransform, const T z_first, const T z_last, const cubature_rule<T, 3>& rule, F f, const unsigned nthreads = 0)
+   {
+      T x0, y0;
+      apply_geotransform(&x0, &y0, first_row, first_col, geotransform);
+      const cubature_detail::cell_layout<T, 3> cells{ x0, y0, static_cast<T>(geotransform[1]), static_cast<T>(geotransform[4]),
+         static_cast<T>(geotransform[2]), static_cast<T>(geotransform[5]), z_first, z_last - z_first };
+      parallel_chunks(nrows, ncols * std::max<size_t>(1, rule.size()) * cubature_detail::elements_per_point, nthreads, [&](const size_t row_begin, const size_t row_end)
+      {
+         F local = f;
+         cubature_detail::cell_integrals(rule, cells, row_begin, row_end, ncols, local, [&](const size_t row, const size_t col, const T value) {
+            out[get_row_major_linear_index(row, col, ncols)] = value;
+         });
+      });
+   }
+}
@@ -0,0 +1,588 @@
+#pragma once
+
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/parallel_chunks.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Gauss quadrature rules as objects, for integrating the same order over many
+// intervals (e.g. once per grid cell) without recomputing the nodes and weights:
+// - Gauss-Legendre: n nodes, exact for polynomials of degree 2n - 1
+// - Gauss-Lobatto: n nodes including both ends, exact for degree 2n - 3; the ends
+//   are shared by neighbouring intervals of a composite rule
+// - Gauss-Chebyshev: the rule of maths_ops::gauss_chebyshev with n nodes, which
+//   integrates f itself by weighing f(x) sqrt(1 - x^2) at the Chebyshev nodes
+//
+// Orders 1 to 10 (2 to 10 for Lobatto) come from tables computed at compile time.
+// Other orders are computed in long double on first use and kept in a cache shared
+// by all threads for the life of the program, so a rule is cheap to build and copy:
+// it only points at its nodes and weights.
+
+namespace maths_ops
+{
+   enum class gauss_family
+   {
+      chebyshev,
+      legendre,
+      lobatto
+   };
+
+   namespace gauss_rule_detail
+   {
+      // Highest order with a compile time table, for every family
+      constexpr size_t table_order = 10;
+
+      // Nodes (increasing, on [-1, 1]) and weights of the orders in the tables, 
+      // one order after the other
+      constexpr long double legendre_nodes[] = {
+         0.0L,
+         -5.77350269189625764509e-1L, 5.77350269189625764509e-1L,
+         -7.74596669241483377036e-1L, 0.0L, 7.74596669241483377036e-1L,
+         -8.61136311594052575224e-1L, -3.39981043584856264803e-1L, 3.39981043584856264803e-1L, 8.61136311594052575224e-1L,
+         -9.06179845938663992798e-1L, -5.38469310105683091036e-1L, 0.0L, 5.38469310105683091036e-1L,
+         9.06179845938663992798e-1L,
+         -9.32469514203152027812e-1L, -6.61209386466264513661e-1L, -2.38619186083196908631e-1L, 2.38619186083196908631e-1L,
+         6.61209386466264513661e-1L, 9.32469514203152027812e-1L,
+         -9.49107912342758524526e-1L, -7.41531185599394439864e-1L, -4.05845151377397166907e-1L, 0.0L,
+         4.05845151377397166907e-1L, 7.41531185599394439864e-1L, 9.49107912342758524526e-1L,
+         -9.60289856497536231684e-1L, -7.96666477413626739592e-1L, -5.25532409916328985818e-1L, -1.83434642495649804939e-1L,
+         1.83434642495649804939e-1L, 5.25532409916328985818e-1L, 7.96666477413626739592e-1L, 9.60289856497536231684e-1L,
+         -9.68160239507626089836e-1L, -8.36031107326635794299e-1L, -6.13371432700590397309e-1L, -3.24253423403808929039e-1L,
+         0.0L, 3.24253423403808929039e-1L, 6.13371432700590397309e-1L, 8.36031107326635794299e-1L,
+         9.68160239507626089836e-1L,
+         -9.73906528517171720078e-1L, -8.65063366688984510732e-1L, -6.79409568299024406234e-1L, -4.33395394129247190799e-1L,
+         -1.48874338981631210885e-1L, 1.48874338981631210885e-1L, 4.33395394129247190799e-1L, 6.79409568299024406234e-1L,
+         8.65063366688984510732e-1L, 9.73906528517171720078e-1L
+      };
+      constexpr long double legendre_weights[] = {
+         2.00000000000000000000e+0L,
+         1.00000000000000000000e+0L, 1.00000000000000000000e+0L,
+         5.55555555555555555556e-1L, 8.88888888888888888889e-1L, 5.55555555555555555556e-1L,
+         3.47854845137453857373e-1L, 6.52145154862546142627e-1L, 6.52145154862546142627e-1L, 3.47854845137453857373e-1L,
+         2.36926885056189087514e-1L, 4.78628670499366468041e-1L, 5.68888888888888888889e-1L, 4.78628670499366468041e-1L,
+         2.36926885056189087514e-1L,
+         1.71324492379170345040e-1L, 3.60761573048138607570e-1L, 4.67913934572691047390e-1L, 4.67913934572691047390e-1L,
+         3.60761573048138607570e-1L, 1.71324492379170345040e-1L,
+         1.29484966168869693271e-1L, 2.79705391489276667901e-1L, 3.81830050505118944950e-1L, 4.17959183673469387755e-1L,
+         3.81830050505118944950e-1L, 2.79705391489276667901e-1L, 1.29484966168869693271e-1L,
+         1.01228536290376259153e-1L, 2.22381034453374470544e-1L, 3.13706645877887287338e-1L, 3.62683783378361982965e-1L,
+         3.62683783378361982965e-1L, 3.13706645877887287338e-1L, 2.22381034453374470544e-1L, 1.01228536290376259153e-1L,
+         8.12743883615744119719e-2L, 1.80648160694857404058e-1L, 2.60610696402935462319e-1L, 3.12347077040002840069e-1L,
+         3.30239355001259763165e-1L, 3.12347077040002840069e-1L, 2.60610696402935462319e-1L, 1.80648160694857404058e-1L,
+         8.12743883615744119719e-2L,
+         6.66713443086881375936e-2L, 1.49451349150580593146e-1L, 2.19086362515982043996e-1L, 2.69266719309996355091e-1L,
+         2.95524224714752870174e-1L, 2.95524224714752870174e-1L, 2.69266719309996355091e-1L, 2.19086362515982043996e-1L,
+         1.49451349150580593146e-1L, 6.66713443086881375936e-2L
+      };
+      constexpr long double lobatto_nodes[] = {
+         -1.00000000000000000000e+0L, 1.00000000000000000000e+0L,
+         -1.00000000000000000000e+0L, 0.0L, 1.00000000000000000000e+0L,
+         -1.00000000000000000000e+0L, -4.47213595499957939282e-1L, 4.47213595499957939282e-1L, 1.00000000000000000000e+0L,
+         -1.00000000000000000000e+0L, -6.54653670707977143798e-1L, 0.0L, 6.54653670707977143798e-1L,
+         1.00000000000000000000e+0L,
+         -1.00000000000000000000e+0L, -7.65055323929464692851e-1L, -2.85231516480645096314e-1L, 2.85231516480645096314e-1L,
+         7.65055323929464692851e-1L, 1.00000000000000000000e+0L,
+         -1.00000000000000000000e+0L, -8.30223896278566929872e-1L, -4.68848793470714213804e-1L, 0.0L,
+         4.68848793470714213804e-1L, 8.30223896278566929872e-1L, 1.00000000000000000000e+0L,
+         -1.00000000000000000000e+0L, -8.71740148509606615337e-1L, -5.91700181433142302145e-1L, -2.09299217902478868769e-1L,
+         2.09299217902478868769e-1L, 5.91700181433142302145e-1L, 8.71740148509606615337e-1L, 1.00000000000000000000e+0L,
+         -1.00000000000000000000e+0L, -8.99757995411460157312e-1L, -6.77186279510737753446e-1L, -3.63117463826178158711e-1L,
+         0.0L, 3.63117463826178158711e-1L, 6.77186279510737753446e-1L, 8.99757995411460157312e-1L,
+         1.00000000000000000000e+0L,
+         -1.00000000000000000000e+0L, -9.19533908166458813829e-1L, -7.38773865105505075003e-1L, -4.77924949810444495661e-1L,
+         -1.65278957666387024626e-1L, 1.65278957666387024626e-1L, 4.77924949810444495661e-1L, 7.38773865105505075003e-1L,
+         9.19533908166458813829e-1L, 1.00000000000000000000e+0L
+      };
+      constexpr long double lobatto_weights[] = {
+         1.00000000000000000000e+0L, 1.00000000000000000000e+0L,
+         3.33333333333333333333e-1L, 1.33333333333333333333e+0L, 3.33333333333333333333e-1L,
+         1.66666666666666666667e-1L, 8.33333333333333333333e-1L, 8.33333333333333333333e-1L, 1.66666666666666666667e-1L,
+         1.00000000000000000000e-1L, 5.44444444444444444444e-1L, 7.11111111111111111111e-1L, 5.44444444444444444444e-1L,
+         1.00000000000000000000e-1L,
+         6.66666666666666666667e-2L, 3.78474956297846980317e-1L, 5.54858377035486353017e-1L, 5.54858377035486353017e-1L,
+         3.78474956297846980317e-1L, 6.66666666666666666667e-2L,
+         4.76190476190476190476e-2L, 2.76826047361565948011e-1L, 4.31745381209862623418e-1L, 4.87619047619047619048e-1L,
+         4.31745381209862623418e-1L, 2.76826047361565948011e-1L, 4.76190476190476190476e-2L,
+         3.57142857142857142857e-2L, 2.10704227143506039383e-1L, 3.41122692483504364764e-1L, 4.12458794658703881567e-1L,
+         4.12458794658703881567e-1L, 3.41122692483504364764e-1L, 2.10704227143506039383e-1L, 3.57142857142857142857e-2L,
+         2.77777777777777777778e-2L, 1.65495361560805525046e-1L, 2.74538712500161735281e-1L, 3.46428510973046345115e-1L,
+         3.71519274376417233560e-1L, 3.46428510973046345115e-1L, 2.74538712500161735281e-1L, 1.65495361560805525046e-1L,
+         2.77777777777777777778e-2L,
+         2.22222222222222222222e-2L, 1.33305990851070111126e-1L, 2.24889342063126452119e-1L, 2.92042683679683757876e-1L,
+         3.27539761183897456657e-1L, 3.27539761183897456657e-1L, 2.92042683679683757876e-1L, 2.24889342063126452119e-1L,
+         1.33305990851070111126e-1L, 2.22222222222222222222e-2L
+      };
+      constexpr long double chebyshev_nodes[] = {
+         0.0L,
+         -7.07106781186547524401e-1L, 7.07106781186547524401e-1L,
+         -8.66025403784438646764e-1L, 0.0L, 8.66025403784438646764e-1L,
+         -9.23879532511286756128e-1L, -3.82683432365089771728e-1L, 3.82683432365089771728e-1L, 9.23879532511286756128e-1L,
+         -9.51056516295153572116e-1L, -5.87785252292473129169e-1L, 0.0L, 5.87785252292473129169e-1L,
+         9.51056516295153572116e-1L,
+         -9.65925826289068286750e-1L, -7.07106781186547524401e-1L, -2.58819045102520762349e-1L, 2.58819045102520762349e-1L,
+         7.07106781186547524401e-1L, 9.65925826289068286750e-1L,
+         -9.74927912181823607018e-1L, -7.81831482468029808708e-1L, -4.33883739117558120476e-1L, 0.0L,
+         4.33883739117558120476e-1L, 7.81831482468029808708e-1L, 9.74927912181823607018e-1L,
+         -9.80785280403230449126e-1L, -8.31469612302545237079e-1L, -5.55570233019602224743e-1L, -1.95090322016128267848e-1L,
+         1.95090322016128267848e-1L, 5.55570233019602224743e-1L, 8.31469612302545237079e-1L, 9.80785280403230449126e-1L,
+         -9.84807753012208059367e-1L, -8.66025403784438646764e-1L, -6.42787609686539326323e-1L, -3.42020143325668733044e-1L,
+         0.0L, 3.42020143325668733044e-1L, 6.42787609686539326323e-1L, 8.66025403784438646764e-1L,
+         9.84807753012208059367e-1L,
+         -9.87688340595137726190e-1L, -8.91006524188367862360e-1L, -7.07106781186547524401e-1L, -4.53990499739546791560e-1L,
+         -1.56434465040230869010e-1L, 1.56434465040230869010e-1L, 4.53990499739546791560e-1L, 7.07106781186547524401e-1L,
+         8.91006524188367862360e-1L, 9.87688340595137726190e-1L
+      };
+      constexpr long double chebyshev_weights[] = {
+         3.14159265358979323846e+0L,
+         1.11072073453959156175e+0L, 1.11072073453959156175e+0L,
+         5.23598775598298873077e-1L, 1.04719755119659774615e+0L, 5.23598775598298873077e-1L,
+         3.00558864942173135357e-1L, 7.25613288034857753514e-1L, 7.25613288034857753514e-1L, 3.00558864942173135357e-1L,
+         1.94161103872546657735e-1L, 5.08320369231525981581e-1L, 6.28318530717958647693e-1L, 5.08320369231525981581e-1L,
+         1.94161103872546657735e-1L,
+         1.35517335117200763594e-1L, 3.70240244846530520585e-1L, 5.05757579963731284178e-1L, 5.05757579963731284178e-1L,
+         3.70240244846530520585e-1L, 1.35517335117200763594e-1L,
+         9.98671616267281282480e-2L, 2.79821568729650438967e-1L, 4.04353882359336113466e-1L, 4.48798950512827605495e-1L,
+         4.04353882359336113466e-1L, 2.79821568729650438967e-1L, 9.98671616267281282480e-2L,
+         7.66117903040419583241e-2L, 2.18171920325943990145e-1L, 3.26517353211603710666e-1L, 3.85153478957974272901e-1L,
+         3.85153478957974272901e-1L, 3.26517353211603710666e-1L, 2.18171920325943990145e-1L, 7.66117903040419583241e-2L,
+         6.06146488075203984527e-2L, 1.74532925199432957692e-1L, 2.67399954980651737019e-1L, 3.28014603788172135472e-1L,
+         3.49065850398865915385e-1L, 3.28014603788172135472e-1L, 2.67399954980651737019e-1L, 1.74532925199432957692e-1L,
+         6.06146488075203984527e-2L,
+         4.91453366138638637249e-2L, 1.42625321878131914099e-1L, 2.22144146907918312351e-1L, 2.79917955069075288784e-1L,
+         3.10291443484997823311e-1L, 3.10291443484997823311e-1L, 2.79917955069075288784e-1L, 2.22144146907918312351e-1L,
+         1.42625321878131914099e-1L, 4.91453366138638637249e-2L
+      };
+
+      // Where an order starts in the tables of a family whose first order is first_order
+      constexpr size_t table_offset(const size_t order, const size_t first_order)
+      {
+         return (order * (order - 1) - first_order * (first_order - 1)) / 2;
+      }
+
+      template <typename T, size_t N, size_t... I>
+      constexpr std::array<T, N> cast_table(const long double (&table)[N], std::index_sequence<I...>)
+      {
+         return {{ static_cast<T>(table[I])... }};
+      }
+
+      template <typename T, size_t N>
+      constexpr std::array<T, N> cast_table(const long double (&table)[N])
+      {
+         return cast_table<T>(table, std::make_index_sequence<N>());
+      }
+
+      // The tables in T
+      template <typename T>
+      struct tables
+      {
+         static constexpr std::array<T, sizeof(legendre_nodes) / sizeof(long double)> legendre_x = cast_table<T>(legendre_nodes);
+         static constexpr std::array<T, sizeof(legendre_weights) / sizeof(long double)> legendre_w = cast_table<T>(legendre_weights);
+         static constexpr std::array<T, sizeof(lobatto_nodes) / sizeof(long double)> lobatto_x = cast_table<T>(lobatto_nodes);
+         static constexpr std::array<T, sizeof(lobatto_weights) / sizeof(long double)> lobatto_w = cast_table<T>(lobatto_weights);
+         static constexpr std::array<T, sizeof(chebyshev_nodes) / sizeof(long double)> chebyshev_x = cast_table<T>(chebyshev_nodes);
+         static constexpr std::array<T, sizeof(chebyshev_weights) / sizeof(long double)> chebyshev_w = cast_table<T>(chebyshev_weights);
+      };
+
+      // Legendre polynomial P_n(x) and its derivative
+      inline void legendre(const size_t n, const long double x, long double& p, long double& dp)
+      {
+         long double p0 = 1.0L, p1 = x;
+         for (size_t k = 2; k <= n; ++k)
+         {
+            const long double kk = static_cast<long double>(k);
+            const long double p2 = ((2.0L * kk - 1.0L) * x * p1 - (kk - 1.0L) * p0) / kk;
+            p0 = p1;
+            p1 = p2;
+         }
+         p = n == 0 ? 1.0L : p1;
+         dp = n == 0 ? 0.0L : static_cast<long double>(n) * (x * p1 - p0) / (x * x - 1.0L);
+      }
+
+      // Newton's method from a guess, until the step is down to rounding
+      template <typename G>
+      long double newton_root(long double x, G step)
+      {
+         for (int iteration = 0; iteration < 100; ++iteration)
+         {
+            const long double dx = step(x);
+            x -= dx;
+            if (std::abs(dx) <= 4.0L * std::numeric_limits<long double>::epsilon())
+               break;
+         }
+         return x;
+      }
+
+      // Nodes then weights (2 * order values) of a rule, in long double. The
+      // roots are found by Newton's method, from the usual cosine guesses, for 
+      // half of the nodes; the other half mirror them. It costs O(order^2).
+      inline std::vector<long double> compute_rule(const gauss_family family, const size_t n)
+      {
+         std::vector<long double> rule(2 * n);
+         long double* xs = rule.data();
+         long double* ws = rule.data() + n;
+         const long double pi = 3.14159265358979323846264338327950288L;
+         if (family == gauss_family::chebyshev)
+         {
+            for (size_t i = 0; i < n; ++i)
+            {
+               const long double angle = pi * static_cast<long double>(2 * i + 1) / static_cast<long double>(2 * n);
+               xs[i] = -std::cos(angle);
+               ws[i] = pi / static_cast<long double>(n) * std::sin(angle);
+            }
+         }
+         else if (family == gauss_family::legendre)
+         {
+            for (size_t i = 0; i < (n + 1) / 2; ++i)
+            {
+               const long double guess = std::cos(pi * (static_cast<long double>(i) + 0.75L) / (static_cast<long double>(n) + 0.5L));
+               const long double x = newton_root(guess, [n](const long double t) {
+                  long double p, dp;
+                  legendre(n, t, p, dp);
+                  return p / dp;
+               });
+               long double p, dp;
+               legendre(n, x, p, dp);
+               xs[i] = -x;
+               xs[n - 1 - i] = x;
+               ws[i] = ws[n - 1 - i] = 2.0L / ((1.0L - x * x) * dp * dp);
+            }
+            if (n % 2 == 1)
+               xs[n / 2] = 0.0L;
+         }
+         else
+         {
+            // The inner nodes are the roots of P'_(n-1), with P'' from Legendre's equation
+            const size_t m = n - 1;
+            const long double mm = static_cast<long double>(m);
+            const long double end_weight = 2.0L / (static_cast<long double>(n) * mm);
+            xs[0] = -1.0L;
+            xs[n - 1] = 1.0L;
+            ws[0] = ws[n - 1] = end_weight;
+            for (size_t i = 1; i < (n + 1) / 2; ++i)
+            {
+               const long double guess = std::cos(pi * static_cast<long double>(i) / mm);
+               const long double x = newton_root(guess, [m, mm](const long double t) {
+                  long double p, dp;
+                  legendre(m, t, p, dp);
+                  return dp * (1.0L - t * t) / (2.0L * t * dp - mm * (mm + 1.0L) * p);
+               });
+               long double p, dp;
+               legendre(m, x, p, dp);
+               xs[i] = -x;
+               xs[n - 1 - i] = x;
+               ws[i] = ws[n - 1 - i] = end_weight / (p * p);
+            }
+            if (n % 2 == 1)
+               xs[n / 2] = 0.0L;
+         }
+         return rule;
+      }
+
+      // Rules of the orders without a table, computed once per family, order and T. 
+      // The lock is only held to look up and insert; two threads asking for the same 
+      // new order at once may both compute it, and the first one in is kept.
+      template <typename T>
+      const T* cached_rule(const gauss_family family, const size_t order)
+      {
+         static std::mutex mutex;
+         static std::unordered_map<size_t, std::unique_ptr<const T[]>> rules;
+         const size_t key = order * 3 + static_cast<size_t>(family);
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto found = rules.find(key);
+            if (found != rules.end())
+               return found->second.get();
+         }
+
+         const std::vector<long double> computed = compute_rule(family, order);
+         std::unique_ptr<T[]> rule(new T[computed.size()]);
+         std::transform(computed.begin(), computed.end(), rule.get(), [](const long double v) { return static_cast<T>(v); });
+
+         std::lock_guard<std::mutex> lock(mutex);
+         return rules.emplace(key, std::unique_ptr<const T[]>(rule.release())).first->second.get();
+      }
+   }
+
+   /**
+    * @brief A Gauss quadrature rule of a given family and order: its nodes and 
+    * weights on [-1, 1], mapped onto each interval it is applied to.
+    *
+    * Building one does no work for the orders in the compile time tables, and one
+    * lock and lookup for the others after their first use. Rules are small, can be
+    * copied freely and used by any number of threads at once.
+    *
+    * @tparam T Supports float, double and long double.
+    */
+   template <typename T>
+   class gauss_rule
+   {
+      static_assert(std::is_floating_point<T>::value, "gauss_rule supports float, double and long double");
+
+   public:
+      /**
+       * @brief Looks up (or computes, the first time) the rule.
+       *
+       * @param family [in] Chebyshev, Legendre or Lobatto.
+       * @param order [in] The number of nodes. Order 0, and order 1 for Lobatto, give an empty rule which integrates to 0.
+       */
+      gauss_rule(const gauss_family family, const size_t order)
+         : m_family(family)
+      {
+         const size_t first_order = family == gauss_family::lobatto ? 2 : 1;
+         if (order < first_order)
+            return;
+         m_order = order;
+         if (order <= gauss_rule_detail::table_order)
+         {
+            using tables = gauss_rule_detail::tables<T>;
+            const size_t offset = gauss_rule_detail::table_offset(order, first_order);
+            m_nodes = (family == gauss_family::chebyshev ? tables::chebyshev_x.data() :
+               family == gauss_family::legendre ? tables::legendre_x.data() : tables::lobatto_x.data()) + offset;
+            m_weights = (family == gauss_family::chebyshev ? tables::chebyshev_w.data() :
+               family == gauss_family::legendre ? tables::legendre_w.data() : tables::lobatto_w.data()) + offset;
+            return;
+         }
+         m_nodes = gauss_rule_detail::cached_rule<T>(family, order);
+         m_weights = m_nodes + order;
+      }
+
+      gauss_family family() const { return m_family; }
+
+      // The number of nodes
+      size_t order() const { return m_order; }
+
+      // The nodes on [-1, 1], in increasing order
+      const T* nodes() const { return m_nodes; }
+
+      // The weights of the nodes on [-1, 1]
+      const T* weights() const { return m_weights; }
+
+      /**
+       * @brief Maps the nodes and weights onto [first, last], e.g. to evaluate 
+       * the integrand elsewhere.
+       *
+       * @param first [in] The start of the interval.
+       * @param last [in] The end of the interval.
+       * @param xs [out] The order() nodes on [first, last].
+       * @param ws [out] Their weights.
+       */
+      void map(const T first, const T last, T* xs, T* ws) const
+      {
+         const T half = static_cast<T>(0.5) * (last - first);
+         const T mid = static_cast<T>(0.5) * (last + first);
+         for (size_t k = 0; k < m_order; ++k)
+         {
+            xs[k] = mid + half * m_nodes[k];
+            ws[k] = half * m_weights[k];
+         }
+      }
+
+      /**
+       * @brief Integrates f over [first, last], split into nintervals equal 
+       * intervals with the rule on each (a composite rule).
+       *
+       * @tparam F Any callable taking and returning T, or of the form 
+       * void(const T* xs, T* ys, size_t n), filling ys[i] = f(xs[i]). A batch 
+       * integrand is called with the nodes of as many whole intervals as fit in 
+       * 256 nodes (or 256 nodes of an interval, for higher orders).
+       * @param first [in] The start of the interval.
+       * @param last [in] The end of the interval.
+       * @param f The function to integrate.
+       * @param nintervals [in] The number of intervals.
+       * @return The value of the integral.
+       */
+      template <typename F>
+      T integrate(const T first, const T last, F f, const size_t nintervals = 1) const
+      {
+         if (m_order == 0 || nintervals == 0)
+            return static_cast<T>(0);
+         const T h = (last - first) / static_cast<T>(nintervals);
+         return static_cast<T>(0.5) * h * composite_sum(first, h, nintervals, f, integration_detail::is_batch_integrand<F, T>());
+      }
+
+      /**
+       * @brief Integrates f over each of count intervals, e.g. one per grid 
+       * cell along a row, writing one integral per interval.
+       *
+       * @tparam F As for integrate. A batch integrand gets the nodes of 
+       * consecutive intervals together.
+       * @param firsts [in] The starts of the intervals.
+       * @param lasts [in] The ends of the intervals.
+       * @param count [in] The number of intervals.
+       * @param out [out] The integrals. Must hold count values.
+       * @param f The function to integrate. Must be safe to call from several threads when nthreads is not 1.
+       * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+       */
+      template <typename F>
+      void integrate_each(const T* firsts, const T* lasts, const size_t count, T* out, F f, const unsigned nthreads = 1) const
+      {
+         parallel_chunks(count, std::max<size_t>(1, m_order), nthreads, [&](const size_t begin, const size_t end) {
+            F local = f;
+            each_sum(firsts, lasts, begin, end, out, local, integration_detail::is_batch_integrand<F, T>());
+         });
+      }
+
+   private:
+      // Sum over the intervals of the weighted values on [-1, 1]. Lobatto rules 
+      // evaluate the ends between intervals once, with the weights of both sides.
+      template <typename F, typename B>
+      T composite_sum(const T first, const T h, const size_t nintervals, F& f, B batch) const
+      {
+         const size_t skip = m_family == gauss_family::lobatto ? 1 : 0;
+         const size_t n = m_order - 2 * skip;
+
+         // Inner node k of interval j sits at first + h * j + offsets[k]
+         std::vector<T> offsets(n);
+         for (size_t k = 0; k < n; ++k)
+            offsets[k] = static_cast<T>(0.5) * h * (static_cast<T>(1) + m_nodes[k + skip]);
+         T sum = inner_sum(nintervals, n, m_weights + skip, f, batch, 
+            [&](const size_t j) { return first + h * integration_detail::node_index<T>(j); },
+            [&](size_t, const size_t k) { return offsets[k]; });
+         if (skip == 0)
+            return sum;
+
+         // The ends, at first + h * j for j = 0, ..., nintervals
+         const T one{ 1 };
+         const T end_weight = m_weights[0];
+         auto weight = [&](const size_t j) { return j == 0 || j == nintervals ? end_weight : static_cast<T>(2) * end_weight; };
+         return sum + inner_sum(nintervals + 1, 1, &one, f, batch,
+            [&](const size_t j) { return first + h * integration_detail::node_index<T>(j); },
+            [](size_t, size_t) { return static_cast<T>(0); }, weight);
+      }
+
+      // Sum over intervals 0 to nintervals - 1 of scale(j) * w_k f(x), for the n nodes of 
+      // each, where node k of interval j is at start(j) + offset(j, k). For point integrands:
+      template <typename F, typename S, typename O, typename W = std::nullptr_t>
+      T inner_sum(const size_t nintervals, const size_t n, const T* weights, F& f, std::false_type, S start, O offset, W scale = nullptr) const
+      {
+         T sum{ 0 };
+         if (n == 0)
+            return sum;
+         for (size_t j = 0; j < nintervals; ++j)
+         {
+            const T a = start(j);
+            const T part = integration_detail::lane_sum<T>(n, [&](const size_t k, T) { return weights[k] * f(a + offset(j, k)); });
+            sum += scaled(part, scale, j);
+         }
+         return sum;
+      }
+
+      // For batch integrands, whole intervals go to the integrand together, with the 
+      // weights repeated in a pattern, when they fit in a batch
+      template <typename F, typename S, typename O, typename W = std::nullptr_t>
+      T inner_sum(const size_t nintervals, const size_t n, const T* weights, F& f, std::true_type, S start, O offset, W scale = nullptr) const
+      {
+         T sum{ 0 };
+         if (n == 0)
+            return sum;
+         if (n > integration_detail::batch_nodes)
+         {
+            for (size_t j = 0; j < nintervals; ++j)
+            {
+               const T a = start(j);
+               const T part = integration_detail::batch_weighted_sum<T>(f, n, integration_detail::batch_nodes, [&](const size_t s, const size_t len, T* xs, T*) {
+                  for (size_t k = 0; k < len; ++k)
+                     xs[k] = a + offset(j, s + k);
+                  return weights + s;
+               });
+               sum += scaled(part, scale, j);
+            }
+            return sum;
+         }
+
+         const size_t per_batch = integration_detail::batch_nodes / n;
+         T pattern[integration_detail::batch_nodes];
+         return integration_detail::batch_weighted_sum<T>(f, nintervals * n, per_batch * n, [&](const size_t s, const size_t len, T* xs, T*) {
+            for (size_t j = s / n, k = 0; k < len; ++j)
+            {
+               const T a = start(j);
+               for (size_t i = 0; i < n; ++i, ++k)
+               {
+                  xs[k] = a + offset(j, i);
+                  pattern[k] = scaled(weights[i], scale, j);
+               }
+            }
+            return static_cast<const T*>(pattern);
+         });
+      }
+
+      static T scaled(const T value, std::nullptr_t, size_t) { return value; }
+
+      template <typename W>
+      static T scaled(const T value, W& scale, const size_t j) { return scale(j) * value; }
+
+      // One integral per interval, for point integrands
+      template <typename F>
+      void each_sum(const T* firsts, const T* lasts, const size_t begin, const size_t end, T* out, F& f, std::false_type) const
+      {
+         for (size_t j = begin; j < end; ++j)
+         {
+            const T half = static_cast<T>(0.5) * (lasts[j] - firsts[j]);
+            const T mid = static_cast<T>(0.5) * (lasts[j] + firsts[j]);
+            out[j] = half * integration_detail::lane_sum<T>(m_order, [&](const size_t k, T) { return m_weights[k] * f(mid + half * m_nodes[k]); });
+         }
+      }
+
+      // The same for batch integrands: the weighted values are summed per interval, 
+      // so each batch is split back into its intervals
+      template <typename F>
+      void each_sum(const T* firsts, const T* lasts, const size_t begin, const size_t end, T* out, F& f, std::true_type) const
+      {
+         const size_t n = m_order;
+         if (n == 0)
+         {
+            std::fill(out + begin, out + end, static_cast<T>(0));
+            return;
+         }
+         if (n > integration_detail::batch_nodes)
+         {
+            for (size_t j = begin; j < end; ++j)
+            {
+               const T half = static_cast<T>(0.5) * (lasts[j] - firsts[j]);
+               const T mid = static_cast<T>(0.5) * (lasts[j] + firsts[j]);
+               out[j] = half * inner_sum(1, n, m_weights, f, std::true_type(), [mid](size_t) { return mid; }, [&](size_t, const size_t k) { return half * m_nodes[k]; });
+            }
+            return;
+         }
+
+         const size_t per_batch = integration_detail::batch_nodes / n;
+         T xs[integration_detail::batch_nodes];
+         T ys[integration_detail::batch_nodes];
+         for (size_t j0 = begin; j0 < end; j0 += per_batch)
+         {
+            const size_t j1 = std::min(end, j0 + per_batch);
+            for (size_t j = j0, k = 0; j < j1; ++j)
+            {
+               const T half = static_cast<T>(0.5) * (lasts[j] - firsts[j]);
+               const T mid = static_cast<T>(0.5) * (lasts[j] + firsts[j]);
+               for (size_t i = 0; i < n; ++i, ++k)
+                  xs[k] = mid + half * m_nodes[i];
+            }
+            f(static_cast<const T*>(xs), ys, (j1 - j0) * n);
+            for (size_t j = j0; j < j1; ++j)
+            {
+               const T* y = ys + (j - j0) * n;
+               T sum{ 0 };
+               for (size_t i = 0; i < n; ++i)
+                  sum += m_weights[i] * y[i];
+               out[j] = static_cast<T>(0.5) * (lasts[j] - firsts[j]) * sum;
+            }
+         }
+      }
+
+      const T* m_nodes = nullptr;
+      const T* m_weights = nullptr;
+      size_t m_order = 0;
+      gauss_family m_family;
+   };
+}
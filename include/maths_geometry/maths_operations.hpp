@@ -6,7 +6,10 @@
 
 #include <cmath>
 #include <algorithm>
+#include <cstddef>
+#include <limits>
 #include <type_traits>
+#include <utility>
 
 #ifdef __NVCC__
 #include <device_launch_parameters.h>
@@ -17,6 +20,14 @@
 
 #define ONE_EIGHTY_DEG           180.0
 
+// Marks pointers that do not alias any other pointer argument, 
+// so that the loops over arrays can be vectorised
+#if defined(_MSC_VER)
+#define MATHS_RESTRICT           __restrict
+#else
+#define MATHS_RESTRICT           __restrict__
+#endif
+
 namespace maths_ops 
 {
    /**
@@ -166,9 +177,39 @@ namespace maths_ops
       return ONE_EIGHTY_DEG * r / M_PI;
    }
 
+   /**
+    * @brief Wraps an angle into [0, period) in constant time, without loops
+    * or branches (so loops over arrays of angles can be vectorised).
+    * 
+    * @tparam T supports float, double and long double
+    * @param a [in] The angle.
+    * @param period [in] The full turn in the units of the angle (360 or 2*PI). Must be positive.
+    * @return Angle adjusted in range [0, period)
+    */
+   template <typename T>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value, T>::type
+   wrap_angle(const T a, const T period)
+   {
+      // Whole turns truncated through an integer conversion (no libm call), below
+      // 2^62 where it cannot overflow; above that q has no fraction anyway. Being
+      // one turn off (truncation of negative angles, rounding of q) is corrected below
+      const T q = a * (static_cast<T>(1) / period);
+      const T turns = std::fabs(q) < static_cast<T>(4611686018427387904.0) ? static_cast<T>(static_cast<long long>(q)) : q;
+
+      // Arithmetic rather than ternaries, which GCC turns into branches
+      T r = a - turns * period;
+      r += period * static_cast<T>(r < 0);
+      r -= period * static_cast<T>(r >= period);
+      return r;
+   }
+
    /**
     * @brief Limits an angle in degrees between the values of 0 and 360.
     * 
+    * Positive multiples of 360 give 360 (e.g. north in the meteorological convention),
+    * 0 and negative multiples give 0. Constant time, see wrap_angle.
+    * 
     * @tparam T supports float, double and long double
     * @param d [in] Angle in degrees.
     * @return Angle adjusted in range [0, 360]
@@ -176,36 +217,27 @@ namespace maths_ops
    template <typename T>
    HOSTDEVDECOR 
    typename std::enable_if<std::is_floating_point<T>::value, T>::type
-   get_0_360_deg(T d)
+   get_0_360_deg(const T d)
    {
-      while (d < 0) {
-         d += 360;
-      }
-      while (d > 360) {
-         d -= 360;
-      }
-      return d;
+      const T r = wrap_angle(d, static_cast<T>(360));
+      return (r == 0 && d > 0) ? static_cast<T>(360) : r;
    }
 
    /**
     * @brief Limits an angle in radians between the values of 0 and 2*PI.
     * 
+    * Constant time, see wrap_angle.
+    * 
     * @tparam T supports float, double and long double
     * @param r [in] Angle in radians.
-    * @return Angle adjusted in range [0, 2*PI]
+    * @return Angle adjusted in range [0, 2*PI)
     */
    template <typename T>
    HOSTDEVDECOR 
    typename std::enable_if<std::is_floating_point<T>::value, T>::type
-   get_0_2pi_rad(T r)
+   get_0_2pi_rad(const T r)
    {
-      while (r < 0) {
-         r += 2 * M_PI;
-      }
-      while (r >= 2 * M_PI) {
-         r -= 2 * M_PI;
-      }
-      return r;
+      return wrap_angle(r, static_cast<T>(2 * M_PI));
    }
 
    /**
@@ -238,7 +270,7 @@ namespace maths_ops
    typename std::enable_if<std::is_floating_point<T>::value, T>::type
    to_compass_angle_rad(T r)
    {
-      r = (M_PI / 2) - r;
+      r = static_cast<T>(M_PI / 2) - r;
       return get_0_2pi_rad(r);
    }
 
@@ -274,7 +306,7 @@ namespace maths_ops
    typename std::enable_if<std::is_floating_point<T>::value, T>::type
    convert_to_meteorological_dir_rad(T r)
    {
-      r += M_PI;
+      r += static_cast<T>(M_PI);
       return get_0_2pi_rad(r);
    }
 
@@ -438,9 +470,241 @@ namespace maths_ops
       std::is_floating_point<Tref>::value, void>::type
    rotate_point_about(T* x, T* y, const RM* rot_mat, const Tref xref, const Tref yref)
    {
-      translate_point(x, y, -xref, -yref);
+      translate_point(x, y, static_cast<T>(-xref), static_cast<T>(-yref));
       rotate_point(x, y, rot_mat);
-      translate_point(x, y, xref, yref);
+      translate_point(x, y, static_cast<T>(xref), static_cast<T>(yref));
+   }
+
+   /**
+    * @brief Translates n 2D points in place, stored as separate arrays
+    * of x and y coordinates (structure of arrays).
+    * 
+    * It does not perform any sanity checks on the input values.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @param xs [inout] The x-coordinates of the points. Must not overlap with ys.
+    * @param ys [inout] The y-coordinates of the points. Must not overlap with xs.
+    * @param n [in] The number of points.
+    * @param dx [in] The displacement in x-direction.
+    * @param dy [in] The displacement in y-direction.
+    */
+   template <typename T>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   translate_point(T* MATHS_RESTRICT xs, T* MATHS_RESTRICT ys, const size_t n, const T dx, const T dy)
+   {
+      for (size_t i = 0; i < n; ++i)
+      {
+         xs[i] += dx;
+         ys[i] += dy;
+      }
+   }
+
+   /**
+    * @brief Translates n 2D points, stored as separate arrays of 
+    * x and y coordinates (structure of arrays), into other arrays.
+    * 
+    * It does not perform any sanity checks on the input values.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @param xs_out [out] The translated x-coordinates. Must hold n elements and not overlap with any other array.
+    * @param ys_out [out] The translated y-coordinates. Must hold n elements and not overlap with any other array.
+    * @param xs [in] The x-coordinates of the points.
+    * @param ys [in] The y-coordinates of the points.
+    * @param n [in] The number of points.
+    * @param dx [in] The displacement in x-direction.
+    * @param dy [in] The displacement in y-direction.
+    */
+   template <typename T>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   translate_point(T* MATHS_RESTRICT xs_out, T* MATHS_RESTRICT ys_out, 
+      const T* MATHS_RESTRICT xs, const T* MATHS_RESTRICT ys, const size_t n, const T dx, const T dy)
+   {
+      for (size_t i = 0; i < n; ++i)
+      {
+         xs_out[i] = xs[i] + dx;
+         ys_out[i] = ys[i] + dy;
+      }
+   }
+
+   /**
+    * @brief Rotates n 2D points in place given the rotation matrix, with the
+    * points stored as separate arrays of x and y coordinates (structure of arrays).
+    * The points are rotated about the axes origin. 
+    * 
+    * The matrix is read once, so the loop over the points vectorises.
+    * It does not perform any sanity checks on the input values.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @tparam RM Supports float, double and long double.
+    * @param xs [inout] The x-coordinates of the points. Must not overlap with ys.
+    * @param ys [inout] The y-coordinates of the points. Must not overlap with xs.
+    * @param n [in] The number of points.
+    * @param rotation_matrix [in] The rotation matrix to be applied.
+    */
+   template <typename T, typename RM>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value && std::is_floating_point<RM>::value, void>::type
+   rotate_point(T* MATHS_RESTRICT xs, T* MATHS_RESTRICT ys, const size_t n, const RM* rotation_matrix)
+   {
+      const RM r0 = rotation_matrix[0];
+      const RM r1 = rotation_matrix[1];
+      const RM r2 = rotation_matrix[2];
+      const RM r3 = rotation_matrix[3];
+      for (size_t i = 0; i < n; ++i)
+      {
+         const T xtemp = xs[i];
+         const T ytemp = ys[i];
+         xs[i] = static_cast<T>(r0 * xtemp + r1 * ytemp);
+         ys[i] = static_cast<T>(r2 * xtemp + r3 * ytemp);
+      }
+   }
+
+   /**
+    * @brief Rotates n 2D points given the rotation matrix into other arrays, 
+    * with the points stored as separate arrays of x and y coordinates (structure of arrays).
+    * The points are rotated about the axes origin.
+    * 
+    * It does not perform any sanity checks on the input values.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @tparam RM Supports float, double and long double.
+    * @param xs_out [out] The rotated x-coordinates. Must hold n elements and not overlap with any other array.
+    * @param ys_out [out] The rotated y-coordinates. Must hold n elements and not overlap with any other array.
+    * @param xs [in] The x-coordinates of the points.
+    * @param ys [in] The y-coordinates of the points.
+    * @param n [in] The number of points.
+    * @param rotation_matrix [in] The rotation matrix to be applied.
+    */
+   template <typename T, typename RM>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value && std::is_floating_point<RM>::value, void>::type
+   rotate_point(T* MATHS_RESTRICT xs_out, T* MATHS_RESTRICT ys_out, 
+      const T* MATHS_RESTRICT xs, const T* MATHS_RESTRICT ys, const size_t n, const RM* rotation_matrix)
+   {
+      const RM r0 = rotation_matrix[0];
+      const RM r1 = rotation_matrix[1];
+      const RM r2 = rotation_matrix[2];
+      const RM r3 = rotation_matrix[3];
+      for (size_t i = 0; i < n; ++i)
+      {
+         xs_out[i] = static_cast<T>(r0 * xs[i] + r1 * ys[i]);
+         ys_out[i] = static_cast<T>(r2 * xs[i] + r3 * ys[i]);
+      }
+   }
+
+   /**
+    * @brief Rotates n 2D points in place about another point in 2D space, with the
+    * points stored as separate arrays of x and y coordinates (structure of arrays).
+    * 
+    * The translations are folded into a single offset, computed once:
+    * x' = R (x - ref) + ref = R x + (ref - R ref).
+    * It does not perform any sanity checks on the input values.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @tparam RM Supports float, double and long double.
+    * @tparam Tref Supports float, double and long double.
+    * @param xs [inout] The x-coordinates of the points. Must not overlap with ys.
+    * @param ys [inout] The y-coordinates of the points. Must not overlap with xs.
+    * @param n [in] The number of points.
+    * @param rot_mat [in] The rotation matrix to be applied.
+    * @param xref [in] The x-coordinate of the point to rotate about.
+    * @param yref [in] The y-coordinate of the point to rotate about.
+    */
+   template <typename T, typename RM, typename Tref>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value && 
+      std::is_floating_point<RM>::value &&
+      std::is_floating_point<Tref>::value, void>::type
+   rotate_point_about(T* MATHS_RESTRICT xs, T* MATHS_RESTRICT ys, const size_t n, const RM* rot_mat, const Tref xref, const Tref yref)
+   {
+      const RM r0 = rot_mat[0];
+      const RM r1 = rot_mat[1];
+      const RM r2 = rot_mat[2];
+      const RM r3 = rot_mat[3];
+      const RM x_offset = static_cast<RM>(xref) - (r0 * static_cast<RM>(xref) + r1 * static_cast<RM>(yref));
+      const RM y_offset = static_cast<RM>(yref) - (r2 * static_cast<RM>(xref) + r3 * static_cast<RM>(yref));
+      for (size_t i = 0; i < n; ++i)
+      {
+         const T xtemp = xs[i];
+         const T ytemp = ys[i];
+         xs[i] = static_cast<T>(r0 * xtemp + r1 * ytemp + x_offset);
+         ys[i] = static_cast<T>(r2 * xtemp + r3 * ytemp + y_offset);
+      }
+   }
+
+   /**
+    * @brief Rotates n 2D points about another point in 2D space into other arrays, with
+    * the points stored as separate arrays of x and y coordinates (structure of arrays).
+    * 
+    * It does not perform any sanity checks on the input values.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @tparam RM Supports float, double and long double.
+    * @tparam Tref Supports float, double and long double.
+    * @param xs_out [out] The rotated x-coordinates. Must hold n elements and not overlap with any other array.
+    * @param ys_out [out] The rotated y-coordinates. Must hold n elements and not overlap with any other array.
+    * @param xs [in] The x-coordinates of the points.
+    * @param ys [in] The y-coordinates of the points.
+    * @param n [in] The number of points.
+    * @param rot_mat [in] The rotation matrix to be applied.
+    * @param xref [in] The x-coordinate of the point to rotate about.
+    * @param yref [in] The y-coordinate of the point to rotate about.
+    */
+   template <typename T, typename RM, typename Tref>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value && 
+      std::is_floating_point<RM>::value &&
+      std::is_floating_point<Tref>::value, void>::type
+   rotate_point_about(T* MATHS_RESTRICT xs_out, T* MATHS_RESTRICT ys_out, 
+      const T* MATHS_RESTRICT xs, const T* MATHS_RESTRICT ys, const size_t n, 
+      const RM* rot_mat, const Tref xref, const Tref yref)
+   {
+      const RM r0 = rot_mat[0];
+      const RM r1 = rot_mat[1];
+      const RM r2 = rot_mat[2];
+      const RM r3 = rot_mat[3];
+      const RM x_offset = static_cast<RM>(xref) - (r0 * static_cast<RM>(xref) + r1 * static_cast<RM>(yref));
+      const RM y_offset = static_cast<RM>(yref) - (r2 * static_cast<RM>(xref) + r3 * static_cast<RM>(yref));
+      for (size_t i = 0; i < n; ++i)
+      {
+         xs_out[i] = static_cast<T>(r0 * xs[i] + r1 * ys[i] + x_offset);
+         ys_out[i] = static_cast<T>(r2 * xs[i] + r3 * ys[i] + y_offset);
+      }
+   }
+
+   /**
+    * @brief Finds the bounding box of a set of points (e.g. the vertices of a polygon).
+    * With no points the box is empty: the minimums are above the maximums.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param xmin [out] The smallest x-coordinate.
+    * @param ymin [out] The smallest y-coordinate.
+    * @param xmax [out] The largest x-coordinate.
+    * @param ymax [out] The largest y-coordinate.
+    * @param xs [in] The x-coordinates of the points.
+    * @param ys [in] The y-coordinates of the points.
+    * @param n [in] The number of points.
+    */
+   template <typename T>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   bounding_box(T* xmin, T* ymin, T* xmax, T* ymax, const T* xs, const T* ys, const size_t n)
+   {
+      T x_lo = std::numeric_limits<T>::max(), y_lo = std::numeric_limits<T>::max();
+      T x_hi = std::numeric_limits<T>::lowest(), y_hi = std::numeric_limits<T>::lowest();
+      for (size_t i = 0; i < n; ++i)
+      {
+         x_lo = std::min(x_lo, xs[i]);
+         x_hi = std::max(x_hi, xs[i]);
+         y_lo = std::min(y_lo, ys[i]);
+         y_hi = std::max(y_hi, ys[i]);
+      }
+      *xmin = x_lo;
+      *ymin = y_lo;
+      *xmax = x_hi;
+      *ymax = y_hi;
    }
 
    /**
@@ -759,10 +1023,36 @@ namespace maths_ops
    distance_point_to_line(T x1, T y1, T x2, T y2, T xp, T yp)
    {
       T a, b, c;
-      get_line_coeff(x1, y1, x2, y2, &a, &b, &c);
+      get_generalised_line_eqn_coeff(x1, y1, x2, y2, &a, &b, &c);
       return std::abs(a * xp + b * yp + c) / std::sqrt(a * a + b * b);
    }
 
+   /**
+    * @brief Calculates the squared value of the distance of a point
+    * to a line segment in 2D space (to its closest point, which may be an end).
+    *
+    * @tparam T Supports float, double, long double.
+    * @param x1 [in] x-coordinate of the starting point of the line segment.
+    * @param y1 [in] y-coordinate of the starting point of the line segment.
+    * @param x2 [in] x-coordinate of the ending point of the line segment.
+    * @param y2 [in] y-coordinate of the ending point of the line segment.
+    * @param xp [in] x-coordinate of the point.
+    * @param yp [in] y-coordinate of the point.
+    * @return The squared distance from the point to the line segment.
+    */
+   template <typename T>
+   HOSTDEVDECOR 
+   typename std::enable_if<std::is_floating_point<T>::value, T>::type
+   point_segment_squared_distance(T x1, T y1, T x2, T y2, T xp, T yp)
+   {
+      const T dx = x2 - x1;
+      const T dy = y2 - y1;
+      const T length2 = dot_product(dx, dy, dx, dy);
+      T t = length2 > static_cast<T>(0) ? dot_product(xp - x1, yp - y1, dx, dy) / length2 : static_cast<T>(0);
+      t = t < static_cast<T>(0) ? static_cast<T>(0) : (t > static_cast<T>(1) ? static_cast<T>(1) : t);
+      return points_squared_distance(x1 + t * dx, y1 + t * dy, xp, yp);
+   }
+
    /**
     * @brief Checks whether a point is on the left 
     * of a directed (signed) line segment using the 
@@ -871,122 +1161,435 @@ namespace maths_ops
       return std::log10(x) / std::log10(base);
    }
 
+   namespace integration_detail
+   {
+      // Nodes handed to a batch integrand per call. They are kept on the stack, 
+      // so that the batch overloads do not allocate
+      constexpr size_t batch_nodes = 256;
+
+      // Partial sums kept apart in the loops over the nodes, so that each 
+      // addition only waits on the one before it in the same lane
+      constexpr size_t lanes = 8;
+
+      // Gauss-Chebyshev nodes between exact evaluations of sin and cos. 
+      // Must divide batch_nodes.
+      constexpr size_t chebyshev_block = 32;
+
+      // Detects integrands of the form void(const T* xs, T* ys, size_t n), 
+      // which evaluate the function over n nodes at once
+      template <typename F, typename T, typename = void>
+      struct is_batch_integrand : std::false_type {};
+
+      template <typename F, typename T>
+      struct is_batch_integrand<F, T, decltype(void(std::declval<F&>()(
+         std::declval<const T*>(), std::declval<T*>(), std::declval<size_t>())))> : std::true_type {};
+
+      template <typename T, typename num_t, typename F, bool batch>
+      using enable_integrator = std::enable_if<std::is_floating_point<T>::value && 
+         (std::is_same<num_t, int>::value || std::is_same<num_t, long>::value || 
+         std::is_same<num_t, long long>::value || std::is_same<num_t, size_t>::value) && 
+         is_batch_integrand<F, T>::value == batch, T>;
+
+      // The number of intervals, with zero for negative counts
+      template <typename num_t>
+      HOSTDEVDECOR
+      size_t interval_count(const num_t npoints)
+      {
+         return npoints > num_t(0) ? static_cast<size_t>(npoints) : 0;
+      }
+
+      // Node index as T. Converting 64-bit integers costs more than the cheap 
+      // integrands themselves, so loops convert once per group of nodes and add 
+      // small offsets, which go through int.
+      template <typename T>
+      HOSTDEVDECOR
+      T node_index(const size_t j)
+      {
+         return static_cast<T>(static_cast<long long>(j));
+      }
+
+      template <typename T>
+      HOSTDEVDECOR
+      T node_offset(const size_t k)
+      {
+         return static_cast<T>(static_cast<int>(k));
+      }
+
+      // Sum of g(i, t) over i = 0, ..., count - 1, in lanes partial sums, 
+      // where t is i as T
+      template <typename T, typename G>
+      HOSTDEVDECOR
+      T lane_sum(const size_t count, G g)
+      {
+         T acc[lanes] = {};
+         size_t i = 0;
+         for (; i + lanes <= count; i += lanes) 
+         {
+            const T base = node_index<T>(i);
+            for (size_t k = 0; k < lanes; ++k)
+               acc[k] += g(i + k, base + node_offset<T>(k));
+         }
+         for (; i < count; ++i)
+            acc[i % lanes] += g(i, node_index<T>(i));
+
+         for (size_t width = lanes / 2; width > 0; width /= 2)
+            for (size_t k = 0; k < width; ++k)
+               acc[k] += acc[k + width];
+         return acc[0];
+      }
+
+      // Sum of w_j * f(x_j) over the nodes j = 0, ..., count - 1. nodes(start, len, xs, ws) 
+      // fills the nodes from start on, and returns their weights: either ws, filled 
+      // in, or a table of its own. The integrand is called once per batch_len 
+      // (at most batch_nodes) nodes.
+      template <typename T, typename F, typename N>
+      HOSTDEVDECOR
+      T batch_weighted_sum(F& f, const size_t count, const size_t batch_len, N nodes)
+      {
+         T xs[batch_nodes];
+         T ws[batch_nodes];
+         T ys[batch_nodes];
+         T sum{ 0 };
+         for (size_t start = 0; start < count; start += batch_len) 
+         {
+            const size_t len = std::min(batch_len, count - start);
+            const T* weights = nodes(start, len, xs, ws);
+            f(static_cast<const T*>(xs), ys, len);
+            sum += lane_sum<T>(len, [&](const size_t k, T) { return weights[k] * ys[k]; });
+         }
+         return sum;
+      }
+
+      // Sum of w_j * f(first + j * h) over j = 0, ..., m for the closed 
+      // Newton-Cotes rules, where both ends weigh 1 and the inner weights 
+      // repeat with j % period
+      template <typename T, size_t period, typename F>
+      HOSTDEVDECOR
+      T newton_cotes_batch_sum(F& f, const T first, const T h, const size_t m, const T (&weights)[period])
+      {
+         const T ends_x[2] = { first, first + h * node_index<T>(m) };
+         T ends_y[2];
+         f(ends_x, ends_y, 2);
+
+         // The inner nodes go in batches of a multiple of the period, 
+         // so that all batches share the same weights
+         constexpr size_t batch_len = batch_nodes / period * period;
+         T pattern[batch_len];
+         for (size_t k = 0; k < batch_len; ++k)
+            pattern[k] = weights[(k + 1) % period];
+
+         return ends_y[0] + ends_y[1] + batch_weighted_sum<T>(f, m - 1, batch_len, [&](const size_t start, const size_t len, T* xs, T*) {
+            const T base = node_index<T>(start + 1);
+            for (size_t k = 0; k < len; ++k)
+               xs[k] = first + h * (base + node_offset<T>(k));
+            return static_cast<const T*>(pattern);
+         });
+      }
+
+      // The Gauss-Chebyshev node i sits at the angle (2 i + 1) * step. Rather than 
+      // calling cos and sin for every node, they are called for the first node of 
+      // each block, and the others are rotated from it by the angles 2 k * step.
+      template <typename T>
+      struct chebyshev_rotations
+      {
+         T cos_offset[chebyshev_block];
+         T sin_offset[chebyshev_block];
+
+         HOSTDEVDECOR
+         explicit chebyshev_rotations(const T step)
+         {
+            for (size_t k = 0; k < chebyshev_block; ++k) 
+            {
+               cos_offset[k] = std::cos(step * static_cast<T>(2 * k));
+               sin_offset[k] = std::sin(step * static_cast<T>(2 * k));
+            }
+         }
+      };
+   }
+
    /**
     * @brief Calculates the integral of a function using 
     * the Simpson's rule (https://en.wikipedia.org/wiki/Simpson%27s_rule).
     * 
+    * The integrand is taken as a template parameter, so lambdas (also stateful ones) 
+    * and function objects can be inlined into the loop. Each node is evaluated once. 
+    * With an odd number of intervals, the last one is left out.
+    * 
     * @tparam T Supports float, double and long double.
     * @tparam num_t Supports int, long, long long, and size_t.
+    * @tparam F Any callable taking and returning T, including function pointers.
     * @param first [in] The starting value of the interval to calculate the integral for.
     * @param last [in] The last value of the interval to calculate the integral for.
-    * @param npoints [in] The number of points to use for the integral.
+    * @param npoints [in] The number of intervals to split [first, last] into.
     * @param f The function to integrate.
     * @return The value of the integral.
     */
-   template <typename T, typename num_t>
+   template <typename T, typename num_t, typename F>
    HOSTDEVDECOR
-   typename std::enable_if<std::is_floating_point<T>::value && 
-      (std::is_same<num_t, int>::value || std::is_same<num_t, long>::value || 
-      std::is_same<num_t, long long>::value || std::is_same<num_t, size_t>::value), T>::type
-   simpson(const T first, const T last, const num_t npoints, T (*func)(T)) {
-      T h = (last - first) / npoints;
-      T integral = static_cast<T>(0.);
+   typename integration_detail::enable_integrator<T, num_t, F, false>::type
+   simpson(const T first, const T last, const num_t npoints, F f) 
+   {
+      const size_t m = integration_detail::interval_count(npoints) / 2 * 2;
+      if (m == 0)
+         return static_cast<T>(0.);
+      const T h = (last - first) / static_cast<T>(npoints);
 
-      for (auto i = 0; i < npoints - 1; i += 2)
-         integral += func(first + h * i) + 4.f * f(first + h * (i + 1)) + f(first + h * (i + 2));
+      const T odd = integration_detail::lane_sum<T>(m / 2, [&](size_t, const T i) { 
+         return f(first + h * (static_cast<T>(2.) * i + static_cast<T>(1.))); 
+      });
+      const T even = integration_detail::lane_sum<T>(m / 2 - 1, [&](size_t, const T i) { 
+         return f(first + h * (static_cast<T>(2.) * i + static_cast<T>(2.))); 
+      });
+
+      const T ends = f(first) + f(first + h * integration_detail::node_index<T>(m));
+      return h * (ends + static_cast<T>(4.) * odd + static_cast<T>(2.) * even) / static_cast<T>(3.);
+   }
+
+   /**
+    * @brief Calculates the integral of a function using 
+    * the Simpson's rule (https://en.wikipedia.org/wiki/Simpson%27s_rule), 
+    * with an integrand that evaluates many nodes per call.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @tparam num_t Supports int, long, long long, and size_t.
+    * @tparam F Any callable of the form void(const T* xs, T* ys, size_t n), filling ys[i] = f(xs[i]).
+    * @param first [in] The starting value of the interval to calculate the integral for.
+    * @param last [in] The last value of the interval to calculate the integral for.
+    * @param npoints [in] The number of intervals to split [first, last] into.
+    * @param f The function to integrate. It is called with up to 256 nodes at a time.
+    * @return The value of the integral.
+    */
+   template <typename T, typename num_t, typename F>
+   HOSTDEVDECOR
+   typename integration_detail::enable_integrator<T, num_t, F, true>::type
+   simpson(const T first, const T last, const num_t npoints, F f) 
+   {
+      const size_t m = integration_detail::interval_count(npoints) / 2 * 2;
+      if (m == 0)
+         return static_cast<T>(0.);
+      const T h = (last - first) / static_cast<T>(npoints);
 
-      return h * integral / static_cast<T>(3.);
+      const T weights[2] = { static_cast<T>(2.), static_cast<T>(4.) };
+      const T sum = integration_detail::newton_cotes_batch_sum(f, first, h, m, weights);
+      return h * sum / static_cast<T>(3.);
    }
 
    /**
     * @brief Calculates the integral of a function using 
     * the Newton-Cotes formula for Trapezoidal (https://en.wikipedia.org/wiki/Newton%E2%80%93Cotes_formulas).
     * 
+    * The integrand is taken as a template parameter, so lambdas (also stateful ones) 
+    * and function objects can be inlined into the loop. Each node is evaluated once.
+    * 
     * @tparam T Supports float, double and long double.
     * @tparam num_t Supports int, long, long long, and size_t.
+    * @tparam F Any callable taking and returning T, including function pointers.
     * @param first [in] The starting value of the interval to calculate the integral for.
     * @param last [in] The last value of the interval to calculate the integral for.
-    * @param npoints [in] The number of points to use for the integral.
+    * @param npoints [in] The number of intervals to split [first, last] into.
     * @param f The function to integrate.
     * @return The value of the integral.
     */
-   template <typename T, typename num_t>
+   template <typename T, typename num_t, typename F>
    HOSTDEVDECOR
-   typename std::enable_if<std::is_floating_point<T>::value && 
-      (std::is_same<num_t, int>::value || std::is_same<num_t, long>::value || 
-      std::is_same<num_t, long long>::value || std::is_same<num_t, size_t>::value), T>::type
-   newton_cotes(T first, T last, num_t npoints, T (*f)(T)) 
+   typename integration_detail::enable_integrator<T, num_t, F, false>::type
+   newton_cotes(const T first, const T last, const num_t npoints, F f) 
    {
-      T h = (last - first) / npoints;
-      T integral = static_cast<T>(0.);
+      const size_t m = integration_detail::interval_count(npoints);
+      if (m == 0)
+         return static_cast<T>(0.);
+      const T h = (last - first) / static_cast<T>(npoints);
+
+      const T inner = integration_detail::lane_sum<T>(m - 1, [&](size_t, const T i) { 
+         return f(first + h * (i + static_cast<T>(1.))); 
+      });
 
-      for (auto i = 0; i < npoints; ++i)
-         integral += f(first + i * h) + f(first + (i + 1) * h);
+      const T ends = f(first) + f(first + h * integration_detail::node_index<T>(m));
+      return h * (ends + static_cast<T>(2.) * inner) / static_cast<T>(2.);
+   }
+
+   /**
+    * @brief Calculates the integral of a function using 
+    * the Newton-Cotes formula for Trapezoidal (https://en.wikipedia.org/wiki/Newton%E2%80%93Cotes_formulas), 
+    * with an integrand that evaluates many nodes per call.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @tparam num_t Supports int, long, long long, and size_t.
+    * @tparam F Any callable of the form void(const T* xs, T* ys, size_t n), filling ys[i] = f(xs[i]).
+    * @param first [in] The starting value of the interval to calculate the integral for.
+    * @param last [in] The last value of the interval to calculate the integral for.
+    * @param npoints [in] The number of intervals to split [first, last] into.
+    * @param f The function to integrate. It is called with up to 256 nodes at a time.
+    * @return The value of the integral.
+    */
+   template <typename T, typename num_t, typename F>
+   HOSTDEVDECOR
+   typename integration_detail::enable_integrator<T, num_t, F, true>::type
+   newton_cotes(const T first, const T last, const num_t npoints, F f) 
+   {
+      const size_t m = integration_detail::interval_count(npoints);
+      if (m == 0)
+         return static_cast<T>(0.);
+      const T h = (last - first) / static_cast<T>(npoints);
 
-      return h * integral / static_cast<T>(2.);
+      const T weights[1] = { static_cast<T>(2.) };
+      const T sum = integration_detail::newton_cotes_batch_sum(f, first, h, m, weights);
+      return h * sum / static_cast<T>(2.);
    }
 
    /**
     * @brief Calculates the integral of a function using 
     * the Newton-Cotes formula for Simpson's 3/8 (https://en.wikipedia.org/wiki/Newton%E2%80%93Cotes_formulas).
     * 
+    * The integrand is taken as a template parameter, so lambdas (also stateful ones) 
+    * and function objects can be inlined into the loop. Each node is evaluated once. 
+    * When the number of intervals is not a multiple of 3, the last one or two are left out.
+    * 
     * @tparam T Supports float, double and long double.
     * @tparam num_t Supports int, long, long long, and size_t.
+    * @tparam F Any callable taking and returning T, including function pointers.
     * @param first [in] The starting value of the interval to calculate the integral for.
     * @param last [in] The last value of the interval to calculate the integral for.
-    * @param npoints [in] The number of points to use for the integral.
+    * @param npoints [in] The number of intervals to split [first, last] into.
     * @param f The function to integrate.
     * @return The value of the integral.
     */
-   template <typename T, typename num_t>
+   template <typename T, typename num_t, typename F>
    HOSTDEVDECOR
-   typename std::enable_if<std::is_floating_point<T>::value && 
-      (std::is_same<num_t, int>::value || std::is_same<num_t, long>::value || 
-      std::is_same<num_t, long long>::value || std::is_same<num_t, size_t>::value), T>::type
-   newton_cotes38f(T first, T last, num_t npoints, T (*f)(T)) 
+   typename integration_detail::enable_integrator<T, num_t, F, false>::type
+   newton_cotes38f(const T first, const T last, const num_t npoints, F f) 
    {
-      T h = (last - first) / npoints;
-      T integral = static_cast<T>(0.);
+      const size_t m = integration_detail::interval_count(npoints) / 3 * 3;
+      if (m == 0)
+         return static_cast<T>(0.);
+      const T h = (last - first) / static_cast<T>(npoints);
 
-      for (auto i = 0; i < npoints - 2; i += 3)
-         integral += f(first + i * h) + 3.f * f(first + (i + 1) * h) + 3.f * f(first + (i + 2) * h) + f(first + (i + 3) * h);
+      const T inner = integration_detail::lane_sum<T>(m / 3, [&](size_t, const T i) { 
+         return f(first + h * (static_cast<T>(3.) * i + static_cast<T>(1.))) + f(first + h * (static_cast<T>(3.) * i + static_cast<T>(2.))); 
+      });
+      const T joints = integration_detail::lane_sum<T>(m / 3 - 1, [&](size_t, const T i) { 
+         return f(first + h * (static_cast<T>(3.) * i + static_cast<T>(3.))); 
+      });
 
-      return static_cast<T>(3.) * h * integral / static_cast<T>(8.);
+      const T ends = f(first) + f(first + h * integration_detail::node_index<T>(m));
+      return static_cast<T>(3.) * h * (ends + static_cast<T>(3.) * inner + static_cast<T>(2.) * joints) / static_cast<T>(8.);
+   }
+
+   /**
+    * @brief Calculates the integral of a function using 
+    * the Newton-Cotes formula for Simpson's 3/8 (https://en.wikipedia.org/wiki/Newton%E2%80%93Cotes_formulas), 
+    * with an integrand that evaluates many nodes per call.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @tparam num_t Supports int, long, long long, and size_t.
+    * @tparam F Any callable of the form void(const T* xs, T* ys, size_t n), filling ys[i] = f(xs[i]).
+    * @param first [in] The starting value of the interval to calculate the integral for.
+    * @param last [in] The last value of the interval to calculate the integral for.
+    * @param npoints [in] The number of intervals to split [first, last] into.
+    * @param f The function to integrate. It is called with up to 256 nodes at a time.
+    * @return The value of the integral.
+    */
+   template <typename T, typename num_t, typename F>
+   HOSTDEVDECOR
+   typename integration_detail::enable_integrator<T, num_t, F, true>::type
+   newton_cotes38f(const T first, const T last, const num_t npoints, F f) 
+   {
+      const size_t m = integration_detail::interval_count(npoints) / 3 * 3;
+      if (m == 0)
+         return static_cast<T>(0.);
+      const T h = (last - first) / static_cast<T>(npoints);
+
+      const T weights[3] = { static_cast<T>(2.), static_cast<T>(3.), static_cast<T>(3.) };
+      const T sum = integration_detail::newton_cotes_batch_sum(f, first, h, m, weights);
+      return static_cast<T>(3.) * h * sum / static_cast<T>(8.);
    }
 
    /**
     * @brief Calculates the integral of a function using 
     * the Gauss-Chebysev method (https://en.wikipedia.org/wiki/Chebyshev%E2%80%93Gauss_quadrature) 
     * 
+    * The integrand is taken as a template parameter, so lambdas (also stateful ones) 
+    * and function objects can be inlined into the loop. sin and cos are only called 
+    * once per 32 nodes; the other nodes are rotated from those. To integrate with 
+    * the same number of nodes many times (e.g. once per grid cell), a gauss_rule 
+    * (gauss_rules.hpp) computes the nodes once.
+    * 
     * @tparam T Supports float, double and long double.
     * @tparam num_t Supports int, long, long long, and size_t.
+    * @tparam F Any callable taking and returning T, including function pointers.
     * @param first [in] The starting value of the interval to calculate the integral for.
     * @param last [in] The last value of the interval to calculate the integral for.
-    * @param npoints [in] The number of points to use for the integral.
+    * @param npoints [in] The number of points to use for the integral. The rule has npoints + 1 nodes.
     * @param f The function to integrate.
     * @return The value of the integral.
     */
-   template <typename T, typename num_t>
+   template <typename T, typename num_t, typename F>
    HOSTDEVDECOR
-   typename std::enable_if<std::is_floating_point<T>::value && 
-      (std::is_same<num_t, int>::value || std::is_same<num_t, long>::value || 
-      std::is_same<num_t, long long>::value || std::is_same<num_t, size_t>::value), T>::type 
-   gauss_chebyshev(T first, T last, num_t npoints, T (*f)(T)) 
+   typename integration_detail::enable_integrator<T, num_t, F, false>::type
+   gauss_chebyshev(const T first, const T last, const num_t npoints, F f) 
    {
+      const size_t count = integration_detail::interval_count(npoints) + 1;
+      const T half_diff{ static_cast<T>(0.5) * (last - first) };
+      const T mid{ static_cast<T>(0.5) * (last + first) };
+      const T step{ static_cast<T>(M_PI) / static_cast<T>(2 * count) };
+      const integration_detail::chebyshev_rotations<T> rotations(step);
+
       T out{ 0 };
-      T x_i{ 0 };
-      T arg{ 0 };
-      T diff{ last - first };
-      T sum{ last + first };
-
-      for (auto i = 0; i <= npoints; ++i) {
-         arg = static_cast<T>(M_PI) * (2 * i + 1) / (2 * (npoints + 1));
-         x_i = -std::cos(arg);
-         out += std::sin(arg) * f(static_cast<T>(0.5) * diff * x_i + static_cast<T>(0.5) * sum);
+      for (size_t start = 0; start < count; start += integration_detail::chebyshev_block) 
+      {
+         const T cos_start = std::cos(step * static_cast<T>(2 * start + 1));
+         const T sin_start = std::sin(step * static_cast<T>(2 * start + 1));
+         const size_t len = std::min(integration_detail::chebyshev_block, count - start);
+         out += integration_detail::lane_sum<T>(len, [&](const size_t k, T) {
+            const T cos_arg = cos_start * rotations.cos_offset[k] - sin_start * rotations.sin_offset[k];
+            const T sin_arg = sin_start * rotations.cos_offset[k] + cos_start * rotations.sin_offset[k];
+            return sin_arg * f(mid - half_diff * cos_arg);
+         });
       }
-      return static_cast<T>(0.5) * diff * (static_cast<T>(M_PI) / (npoints + 1)) * out;
+      return half_diff * (static_cast<T>(M_PI) / static_cast<T>(count)) * out;
    }
 
+   /**
+    * @brief Calculates the integral of a function using 
+    * the Gauss-Chebysev method (https://en.wikipedia.org/wiki/Chebyshev%E2%80%93Gauss_quadrature), 
+    * with an integrand that evaluates many nodes per call.
+    * 
+    * @tparam T Supports float, double and long double.
+    * @tparam num_t Supports int, long, long long, and size_t.
+    * @tparam F Any callable of the form void(const T* xs, T* ys, size_t n), filling ys[i] = f(xs[i]).
+    * @param first [in] The starting value of the interval to calculate the integral for.
+    * @param last [in] The last value of the interval to calculate the integral for.
+    * @param npoints [in] The number of points to use for the integral. The rule has npoints + 1 nodes.
+    * @param f The function to integrate. It is called with up to 256 nodes at a time.
+    * @return The value of the integral.
+    */
+   template <typename T, typename num_t, typename F>
+   HOSTDEVDECOR
+   typename integration_detail::enable_integrator<T, num_t, F, true>::type
+   gauss_chebyshev(const T first, const T last, const num_t npoints, F f) 
+   {
+      const size_t count = integration_detail::interval_count(npoints) + 1;
+      const T half_diff{ static_cast<T>(0.5) * (last - first) };
+      const T mid{ static_cast<T>(0.5) * (last + first) };
+      const T step{ static_cast<T>(M_PI) / static_cast<T>(2 * count) };
+      const integration_detail::chebyshev_rotations<T> rotations(step);
+
+      const T out = integration_detail::batch_weighted_sum<T>(f, count, integration_detail::batch_nodes, [&](const size_t start, const size_t len, T* xs, T* ws) {
+         for (size_t block = 0; block < len; block += integration_detail::chebyshev_block) 
+         {
+            const T cos_start = std::cos(step * static_cast<T>(2 * (start + block) + 1));
+            const T sin_start = std::sin(step * static_cast<T>(2 * (start + block) + 1));
+            const size_t block_len = std::min(integration_detail::chebyshev_block, len - block);
+            for (size_t k = 0; k < block_len; ++k) 
+            {
+               xs[block + k] = mid - half_diff * (cos_start * rotations.cos_offset[k] - sin_start * rotations.sin_offset[k]);
+               ws[block + k] = sin_start * rotations.cos_offset[k] + cos_start * rotations.sin_offset[k];
+            }
+         }
+         return static_cast<const T*>(ws);
+      });
+      return half_diff * (static_cast<T>(M_PI) / static_cast<T>(count)) * out;
+   }
 
-}
 
+}
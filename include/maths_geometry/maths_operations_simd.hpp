@@ -0,0 +1,840 @@
+#pragma once
+
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/parallel_chunks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// Explicit SIMD (AVX2 and AVX-512) versions of the distance, magnitude, angle and
+// geotransform functions over arrays, chosen at run time by what the CPU supports. Without an
+// x86-64 target, under NVCC or with MATHS_NO_SIMD defined, only the scalar code is built.
+#if !defined(MATHS_NO_SIMD) && !defined(__NVCC__) && !defined(__CUDACC__) && \
+   (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define MATHS_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+namespace maths_ops
+{
+   /**
+    * @brief Instruction sets used by the array functions of this header.
+    */
+   enum class simd_level
+   {
+      scalar = 0,
+      avx2 = 1,      // AVX2 and FMA
+      avx512 = 2     // AVX-512F
+   };
+
+   /**
+    * @brief Returns the best instruction set the CPU (and the OS) supports.
+    */
+   inline simd_level detect_simd_level()
+   {
+#if defined(MATHS_SIMD_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+      int info[4];
+      __cpuid(info, 1);
+      const bool osxsave = (info[2] & (1 << 27)) != 0;
+      const bool fma = (info[2] & (1 << 12)) != 0;
+      if (!osxsave)
+         return simd_level::scalar;
+
+      const unsigned long long xcr0 = _xgetbv(0);
+      __cpuidex(info, 7, 0);
+      const bool avx2 = (info[1] & (1 << 5)) != 0;
+      const bool avx512f = (info[1] & (1 << 16)) != 0;
+      if (avx512f && avx2 && fma && (xcr0 & 0xE6) == 0xE6)
+         return simd_level::avx512;
+      if (avx2 && fma && (xcr0 & 0x6) == 0x6)
+         return simd_level::avx2;
+#else
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f"))
+         return simd_level::avx512;
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+         return simd_level::avx2;
+#endif
+#endif
+      return simd_level::scalar;
+   }
+
+   namespace simd_detail
+   {
+      inline std::atomic<int>& level_setting()
+      {
+         static std::atomic<int> level{ static_cast<int>(detect_simd_level()) };
+         return level;
+      }
+   }
+
+   /**
+    * @brief Returns the instruction set the array functions use.
+    */
+   inline simd_level get_simd_level()
+   {
+      return static_cast<simd_level>(simd_detail::level_setting().load(std::memory_order_relaxed));
+   }
+
+   /**
+    * @brief Chooses the instruction set of the array functions (e.g. to compare them).
+    * Sets beyond what the CPU supports are lowered to the best supported one.
+    *
+    * @param level [in] The instruction set to use.
+    * @return The instruction set actually used.
+    */
+   inline simd_level set_simd_level(const simd_level level)
+   {
+      const simd_level used = static_cast<int>(level) <= static_cast<int>(detect_simd_level()) ? level : detect_simd_level();
+      simd_detail::level_setting().store(static_cast<int>(used), std::memory_order_relaxed);
+      return used;
+   }
+
+   // Odd minimax polynomial for atan(t), t in [0, 1]: t * (c1 + c3 t^2 + ... + c11 t^10)
+   constexpr double fast_atan_coeff[6] = { 0.99997726, -0.33262347, 0.19354346, -0.11643287, 0.05265332, -0.01172120 };
+
+   /**
+    * @brief Approximates atan2(y, x) with a polynomial, several times faster than std::atan2.
+    *
+    * The maximum absolute error is 2e-6 rad (about 1e-4 deg) for float and double.
+    * The result is in [-PI, PI] like std::atan2, with atan2(0, 0) = 0, but signed
+    * zeros are not told apart and infinite or NaN inputs are not supported.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param y [in] The y-component of the vector.
+    * @param x [in] The x-component of the vector.
+    * @return Vector direction in radians.
+    */
+   template <typename T>
+   HOSTDEVDECOR
+   typename std::enable_if<std::is_floating_point<T>::value, T>::type
+   fast_atan2(const T y, const T x)
+   {
+      const T ax = std::fabs(x);
+      const T ay = std::fabs(y);
+      const T mx = ax > ay ? ax : ay;
+      const T t = mx > static_cast<T>(0) ? (ax < ay ? ax : ay) / mx : static_cast<T>(0);
+      const T t2 = t * t;
+      T a = t * (static_cast<T>(fast_atan_coeff[0]) + t2 * (static_cast<T>(fast_atan_coeff[1]) + t2 * (static_cast<T>(fast_atan_coeff[2]) +
+         t2 * (static_cast<T>(fast_atan_coeff[3]) + t2 * (static_cast<T>(fast_atan_coeff[4]) + t2 * static_cast<T>(fast_atan_coeff[5]))))));
+      if (ax < ay)
+         a = static_cast<T>(M_PI / 2) - a;
+      if (x < static_cast<T>(0))
+         a = static_cast<T>(M_PI) - a;
+      if (y < static_cast<T>(0))
+         a = -a;
+      return a;
+   }
+
+#if defined(MATHS_SIMD_X86)
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+   namespace simd_avx2
+   {
+      template <typename T> struct simd_ops;
+
+      template <> struct simd_ops<float>
+      {
+         typedef __m256 reg;
+         typedef __m256 mask;
+         typedef __m256i ireg;
+         typedef std::int32_t index_t;
+         static constexpr size_t width = 8;
+
+         static reg load(const float* p) { return _mm256_loadu_ps(p); }
+         static void store(float* p, const reg a) { _mm256_storeu_ps(p, a); }
+         static void stream(float* p, const reg a) { _mm256_stream_ps(p, a); }
+         static reg set1(const float a) { return _mm256_set1_ps(a); }
+         static reg add(const reg a, const reg b) { return _mm256_add_ps(a, b); }
+         static reg sub(const reg a, const reg b) { return _mm256_sub_ps(a, b); }
+         static reg mul(const reg a, const reg b) { return _mm256_mul_ps(a, b); }
+         static reg div(const reg a, const reg b) { return _mm256_div_ps(a, b); }
+         static reg fmadd(const reg a, const reg b, const reg c) { return _mm256_fmadd_ps(a, b, c); }
+         static reg sqrt(const reg a) { return _mm256_sqrt_ps(a); }
+         static reg min(const reg a, const reg b) { return _mm256_min_ps(a, b); }
+         static reg max(const reg a, const reg b) { return _mm256_max_ps(a, b); }
+         static reg abs(const reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+         static reg trunc(const reg a) { return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+         static reg sign(const reg a) { return _mm256_or_ps(_mm256_set1_ps(1.0f), _mm256_and_ps(_mm256_set1_ps(-0.0f), a)); }
+         static mask less(const reg a, const reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+         static reg select(const mask m, const reg a, const reg b) { return _mm256_blendv_ps(b, a, m); }
+
+         static ireg iota() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+         static ireg iset1(const index_t a) { return _mm256_set1_epi32(a); }
+         static ireg iadd(const ireg a, const ireg b) { return _mm256_add_epi32(a, b); }
+         static ireg iselect(const mask m, const ireg a, const ireg b) { return _mm256_blendv_epi8(b, a, _mm256_castps_si256(m)); }
+         static void istore(index_t* p, const ireg a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a); }
+      };
+
+      template <> struct simd_ops<double>
+      {
+         typedef __m256d reg;
+         typedef __m256d mask;
+         typedef __m256i ireg;
+         typedef std::int64_t index_t;
+         static constexpr size_t width = 4;
+
+         static reg load(const double* p) { return _mm256_loadu_pd(p); }
+         static void store(double* p, const reg a) { _mm256_storeu_pd(p, a); }
+         static void stream(double* p, const reg a) { _mm256_stream_pd(p, a); }
+         static reg set1(const double a) { return _mm256_set1_pd(a); }
+         static reg add(const reg a, const reg b) { return _mm256_add_pd(a, b); }
+         static reg sub(const reg a, const reg b) { return _mm256_sub_pd(a, b); }
+         static reg mul(const reg a, const reg b) { return _mm256_mul_pd(a, b); }
+         static reg div(const reg a, const reg b) { return _mm256_div_pd(a, b); }
+         static reg fmadd(const reg a, const reg b, const reg c) { return _mm256_fmadd_pd(a, b, c); }
+         static reg sqrt(const reg a) { return _mm256_sqrt_pd(a); }
+         static reg min(const reg a, const reg b) { return _mm256_min_pd(a, b); }
+         static reg max(const reg a, const reg b) { return _mm256_max_pd(a, b); }
+         static reg abs(const reg a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+         static reg trunc(const reg a) { return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+         static reg sign(const reg a) { return _mm256_or_pd(_mm256_set1_pd(1.0), _mm256_and_pd(_mm256_set1_pd(-0.0), a)); }
+         static mask less(const reg a, const reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+         static reg select(const mask m, const reg a, const reg b) { return _mm256_blendv_pd(b, a, m); }
+
+         static ireg iota() { return _mm256_setr_epi64x(0, 1, 2, 3); }
+         static ireg iset1(const index_t a) { return _mm256_set1_epi64x(a); }
+         static ireg iadd(const ireg a, const ireg b) { return _mm256_add_epi64(a, b); }
+         static ireg iselect(const mask m, const ireg a, const ireg b) { return _mm256_blendv_epi8(b, a, _mm256_castpd_si256(m)); }
+         static void istore(index_t* p, const ireg a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a); }
+      };
+
+#include "maths_geometry/maths_operations_simd_kernels.hpp"
+   }
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma")
+#endif
+
+   namespace simd_avx512
+   {
+      template <typename T> struct simd_ops;
+
+      template <> struct simd_ops<float>
+      {
+         typedef __m512 reg;
+         typedef __mmask16 mask;
+         typedef __m512i ireg;
+         typedef std::int32_t index_t;
+         static constexpr size_t width = 16;
+
+         static reg load(const float* p) { return _mm512_loadu_ps(p); }
+         static void store(float* p, const reg a) { _mm512_storeu_ps(p, a); }
+         static void stream(float* p, const reg a) { _mm512_stream_ps(p, a); }
+         static reg set1(const float a) { return _mm512_set1_ps(a); }
+         static reg add(const reg a, const reg b) { return _mm512_add_ps(a, b); }
+         static reg sub(const reg a, const reg b) { return _mm512_sub_ps(a, b); }
+         static reg mul(const reg a, const reg b) { return _mm512_mul_ps(a, b); }
+         static reg div(const reg a, const reg b) { return _mm512_div_ps(a, b); }
+         static reg fmadd(const reg a, const reg b, const reg c) { return _mm512_fmadd_ps(a, b, c); }
+         // Masked forms with all lanes set: the unmasked ones trip -Wuninitialized in the GCC 12 headers
+         static reg sqrt(const reg a) { return _mm512_mask_sqrt_ps(a, 0xFFFF, a); }
+         static reg min(const reg a, const reg b) { return _mm512_mask_min_ps(a, 0xFFFF, a, b); }
+         static reg max(const reg a, const reg b) { return _mm512_mask_max_ps(a, 0xFFFF, a, b); }
+         static reg abs(const reg a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7FFFFFFF))); }
+         static reg trunc(const reg a) { return _mm512_mask_roundscale_ps(a, 0xFFFF, a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+         static reg sign(const reg a) { return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(_mm512_set1_ps(1.0f)),
+            _mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(static_cast<int>(0x80000000u))))); }
+         static mask less(const reg a, const reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+         static reg select(const mask m, const reg a, const reg b) { return _mm512_mask_blend_ps(m, b, a); }
+
+         static ireg iota() { return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); }
+         static ireg iset1(const index_t a) { return _mm512_set1_epi32(a); }
+         static ireg iadd(const ireg a, const ireg b) { return _mm512_add_epi32(a, b); }
+         static ireg iselect(const mask m, const ireg a, const ireg b) { return _mm512_mask_blend_epi32(m, b, a); }
+         static void istore(index_t* p, const ireg a) { _mm512_storeu_si512(p, a); }
+      };
+
+      template <> struct simd_ops<double>
+      {
+         typedef __m512d reg;
+         typedef __mmask8 mask;
+         typedef __m512i ireg;
+         typedef std::int64_t index_t;
+         static constexpr size_t width = 8;
+
+         static reg load(const double* p) { return _mm512_loadu_pd(p); }
+         static void store(double* p, const reg a) { _mm512_storeu_pd(p, a); }
+         static void stream(double* p, const reg a) { _mm512_stream_pd(p, a); }
+         static reg set1(const double a) { return _mm512_set1_pd(a); }
+         static reg add(const reg a, const reg b) { return _mm512_add_pd(a, b); }
+         static reg sub(const reg a, const reg b) { return _mm512_sub_pd(a, b); }
+         static reg mul(const reg a, const reg b) { return _mm512_mul_pd(a, b); }
+         static reg div(const reg a, const reg b) { return _mm512_div_pd(a, b); }
+         static reg fmadd(const reg a, const reg b, const reg c) { return _mm512_fmadd_pd(a, b, c); }
+         static reg sqrt(const reg a) { return _mm512_mask_sqrt_pd(a, 0xFF, a); }
+         static reg min(const reg a, const reg b) { return _mm512_mask_min_pd(a, 0xFF, a, b); }
+         static reg max(const reg a, const reg b) { return _mm512_mask_max_pd(a, 0xFF, a, b); }
+         static reg abs(const reg a) { return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFLL))); }
+         static reg trunc(const reg a) { return _mm512_mask_roundscale_pd(a, 0xFF, a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+         static reg sign(const reg a) { return _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(_mm512_set1_pd(1.0)),
+            _mm512_and_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ull))))); }
+         static mask less(const reg a, const reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+         static reg select(const mask m, const reg a, const reg b) { return _mm512_mask_blend_pd(m, b, a); }
+
+         static ireg iota() { return _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7); }
+         static ireg iset1(const index_t a) { return _mm512_set1_epi64(a); }
+         static ireg iadd(const ireg a, const ireg b) { return _mm512_add_epi64(a, b); }
+         static ireg iselect(const mask m, const ireg a, const ireg b) { return _mm512_mask_blend_epi64(m, b, a); }
+         static void istore(index_t* p, const ireg a) { _mm512_storeu_si512(p, a); }
+      };
+
+#include "maths_geometry/maths_operations_simd_kernels.hpp"
+   }
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif // MATHS_SIMD_X86
+
+   namespace simd_detail
+   {
+      // Whether the SIMD kernels can take arrays of T
+      template <typename T>
+      struct has_kernels : std::integral_constant<bool, std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+      // Largest number of points given to nearest_kernel at once, so that the
+      // lane indexes (32 bits for float) cannot overflow
+      constexpr size_t max_nearest_block = size_t(1) << 30;
+
+      // Grids with more output than this are written around the caches (see geotransform_row_kernel)
+      constexpr size_t stream_grid_bytes = size_t(16) << 20;
+   }
+
+   /**
+    * @brief Calculates the squared distances of n points in euclidean space
+    * from another point, using the best instruction set available (see get_simd_level).
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] The squared distances. Must hold n elements.
+    * @param xs [in] The x-coordinates of the points.
+    * @param ys [in] The y-coordinates of the points.
+    * @param n [in] The number of points.
+    * @param x [in] The x-coordinate of the other point.
+    * @param y [in] The y-coordinate of the other point.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   points_squared_distance(T* out, const T* xs, const T* ys, const size_t n, const T x, const T y)
+   {
+      size_t done = 0;
+#if defined(MATHS_SIMD_X86)
+      if constexpr (simd_detail::has_kernels<T>::value)
+      {
+         switch (get_simd_level())
+         {
+            case simd_level::avx512: done = simd_avx512::squared_distance_kernel(out, xs, ys, n, x, y); break;
+            case simd_level::avx2: done = simd_avx2::squared_distance_kernel(out, xs, ys, n, x, y); break;
+            default: break;
+         }
+      }
+#endif
+      for (size_t i = done; i < n; ++i)
+         out[i] = points_squared_distance(xs[i], ys[i], x, y);
+   }
+
+   /**
+    * @brief Calculates the distances of n points in euclidean space from
+    * another point, using the best instruction set available (see get_simd_level).
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] The distances. Must hold n elements.
+    * @param xs [in] The x-coordinates of the points.
+    * @param ys [in] The y-coordinates of the points.
+    * @param n [in] The number of points.
+    * @param x [in] The x-coordinate of the other point.
+    * @param y [in] The y-coordinate of the other point.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   points_distance(T* out, const T* xs, const T* ys, const size_t n, const T x, const T y)
+   {
+      size_t done = 0;
+#if defined(MATHS_SIMD_X86)
+      if constexpr (simd_detail::has_kernels<T>::value)
+      {
+         switch (get_simd_level())
+         {
+            case simd_level::avx512: done = simd_avx512::distance_kernel(out, xs, ys, n, x, y); break;
+            case simd_level::avx2: done = simd_avx2::distance_kernel(out, xs, ys, n, x, y); break;
+            default: break;
+         }
+      }
+#endif
+      for (size_t i = done; i < n; ++i)
+         out[i] = points_distance(xs[i], ys[i], x, y);
+   }
+
+   /**
+    * @brief Calculates the magnitudes of n (euclidean) vectors,
+    * using the best instruction set available (see get_simd_level).
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] The magnitudes. Must hold n elements.
+    * @param xs [in] The x-components of the vectors.
+    * @param ys [in] The y-components of the vectors.
+    * @param n [in] The number of vectors.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   vector_magnitude(T* out, const T* xs, const T* ys, const size_t n)
+   {
+      size_t done = 0;
+#if defined(MATHS_SIMD_X86)
+      if constexpr (simd_detail::has_kernels<T>::value)
+      {
+         switch (get_simd_level())
+         {
+            case simd_level::avx512: done = simd_avx512::magnitude_kernel(out, xs, ys, n); break;
+            case simd_level::avx2: done = simd_avx2::magnitude_kernel(out, xs, ys, n); break;
+            default: break;
+         }
+      }
+#endif
+      for (size_t i = done; i < n; ++i)
+         out[i] = vector_magnitude(xs[i], ys[i]);
+   }
+
+   /**
+    * @brief Calculates the directions of n (euclidean) vectors with fast_atan2
+    * (see there for the accuracy), using the best instruction set available (see get_simd_level).
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] The directions in radians. Must hold n elements.
+    * @param xs [in] The x-components of the vectors.
+    * @param ys [in] The y-components of the vectors.
+    * @param n [in] The number of vectors.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   vector_direction_fast(T* out, const T* xs, const T* ys, const size_t n)
+   {
+      size_t done = 0;
+#if defined(MATHS_SIMD_X86)
+      if constexpr (simd_detail::has_kernels<T>::value)
+      {
+         switch (get_simd_level())
+         {
+            case simd_level::avx512: done = simd_avx512::direction_kernel(out, xs, ys, n); break;
+            case simd_level::avx2: done = simd_avx2::direction_kernel(out, xs, ys, n); break;
+            default: break;
+         }
+      }
+#endif
+      for (size_t i = done; i < n; ++i)
+         out[i] = fast_atan2(ys[i], xs[i]);
+   }
+
+   /**
+    * @brief Finds the point of a set closest to another point, using the
+    * best instruction set available (see get_simd_level).
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param squared_distance [out] The squared distance of the closest point. Can be NULL.
+    * @param xs [in] The x-coordinates of the points of the set.
+    * @param ys [in] The y-coordinates of the points of the set.
+    * @param n [in] The number of points of the set.
+    * @param x [in] The x-coordinate of the other point.
+    * @param y [in] The y-coordinate of the other point.
+    * @return The index of the closest point (the first one if several are equally close), n if the set is empty.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, size_t>::type
+   nearest_point(T* squared_distance, const T* xs, const T* ys, const size_t n, const T x, const T y)
+   {
+      size_t nearest = n;
+      T nearest_d2 = std::numeric_limits<T>::infinity();
+      size_t done = 0;
+
+#if defined(MATHS_SIMD_X86)
+      if constexpr (simd_detail::has_kernels<T>::value)
+      {
+         const simd_level level = get_simd_level();
+         while (level != simd_level::scalar && done < n)
+         {
+            const size_t block = std::min(n - done, simd_detail::max_nearest_block);
+            size_t block_nearest = 0;
+            T block_d2 = std::numeric_limits<T>::infinity();
+            const size_t block_done = level == simd_level::avx512 ?
+               simd_avx512::nearest_kernel(xs + done, ys + done, block, x, y, &block_nearest, &block_d2) :
+               simd_avx2::nearest_kernel(xs + done, ys + done, block, x, y, &block_nearest, &block_d2);
+
+            if (block_done > 0 && (nearest == n || block_d2 < nearest_d2))
+            {
+               nearest = done + block_nearest;
+               nearest_d2 = block_d2;
+            }
+            done += block_done;
+            if (block_done < block)
+               break;
+         }
+      }
+#endif
+
+      for (size_t i = done; i < n; ++i)
+      {
+         const T d2 = points_squared_distance(xs[i], ys[i], x, y);
+         if (nearest == n || d2 < nearest_d2)
+         {
+            nearest = i;
+            nearest_d2 = d2;
+         }
+      }
+
+      if (squared_distance)
+         *squared_distance = nearest_d2;
+      return nearest;
+   }
+
+   /**
+    * @brief Finds for each of m query points the closest point of a set
+    * (see nearest_point), e.g. to match two particle clouds.
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param nearest [out] The index of the closest point of the set for each query point. Must hold m elements.
+    * @param squared_distances [out] The squared distance of the closest point for each query point. Must hold m elements, or be NULL.
+    * @param qxs [in] The x-coordinates of the query points.
+    * @param qys [in] The y-coordinates of the query points.
+    * @param m [in] The number of query points.
+    * @param xs [in] The x-coordinates of the points of the set.
+    * @param ys [in] The y-coordinates of the points of the set.
+    * @param n [in] The number of points of the set.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   nearest_points(size_t* nearest, T* squared_distances, const T* qxs, const T* qys, const size_t m,
+      const T* xs, const T* ys, const size_t n)
+   {
+      for (size_t q = 0; q < m; ++q)
+         nearest[q] = nearest_point(squared_distances ? squared_distances + q : static_cast<T*>(nullptr), xs, ys, n, qxs[q], qys[q]);
+   }
+
+   namespace simd_detail
+   {
+      // The angles offset + sign * in[i] wrapped into [0, period), see wrap_angle_kernel
+      template <typename T>
+      void wrap_angles(T* out, const T* in, const size_t n, const T sign, const T offset,
+         const T period, const bool full_turn_for_positive)
+      {
+         size_t done = 0;
+#if defined(MATHS_SIMD_X86)
+         if constexpr (has_kernels<T>::value)
+         {
+            switch (get_simd_level())
+            {
+               case simd_level::avx512: done = simd_avx512::wrap_angle_kernel(out, in, n, sign, offset, period, full_turn_for_positive); break;
+               case simd_level::avx2: done = simd_avx2::wrap_angle_kernel(out, in, n, sign, offset, period, full_turn_for_positive); break;
+               default: break;
+            }
+         }
+#endif
+         for (size_t i = done; i < n; ++i)
+         {
+            const T a = offset + sign * in[i];
+            const T r = wrap_angle(a, period);
+            out[i] = (full_turn_for_positive && r == 0 && a > 0) ? period : r;
+         }
+      }
+   }
+
+   /**
+    * @brief Limits n angles in degrees between the values of 0 and 360 (see the
+    * single angle get_0_360_deg), using the best instruction set available (see get_simd_level).
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] Angles adjusted in range [0, 360]. Must hold n elements; can be d.
+    * @param d [in] Angles in degrees.
+    * @param n [in] The number of angles.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   get_0_360_deg(T* out, const T* d, const size_t n)
+   {
+      simd_detail::wrap_angles(out, d, n, static_cast<T>(1), static_cast<T>(0), static_cast<T>(360), true);
+   }
+
+   /**
+    * @brief Limits n angles in radians between the values of 0 and 2*PI (see the
+    * single angle get_0_2pi_rad), using the best instruction set available (see get_simd_level).
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] Angles adjusted in range [0, 2*PI). Must hold n elements; can be r.
+    * @param r [in] Angles in radians.
+    * @param n [in] The number of angles.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   get_0_2pi_rad(T* out, const T* r, const size_t n)
+   {
+      simd_detail::wrap_angles(out, r, n, static_cast<T>(1), static_cast<T>(0), static_cast<T>(2 * M_PI), false);
+   }
+
+   /**
+    * @brief Converts n angles in degrees to follow the compass convention (see the
+    * single angle to_compass_angle_deg), using the best instruction set available (see get_simd_level).
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] Angles converted to the 0-up system. Must hold n elements; can be d.
+    * @param d [in] Angles in degrees.
+    * @param n [in] The number of angles.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   to_compass_angle_deg(T* out, const T* d, const size_t n)
+   {
+      simd_detail::wrap_angles(out, d, n, static_cast<T>(-1), static_cast<T>(90), static_cast<T>(360), true);
+   }
+
+   /**
+    * @brief Converts n angles in radians to follow the compass convention (see the
+    * single angle to_compass_angle_rad), using the best instruction set available (see get_simd_level).
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] Angles converted to the 0-up system. Must hold n elements; can be r.
+    * @param r [in] Angles in radians.
+    * @param n [in] The number of angles.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   to_compass_angle_rad(T* out, const T* r, const size_t n)
+   {
+      simd_detail::wrap_angles(out, r, n, static_cast<T>(-1), static_cast<T>(M_PI / 2), static_cast<T>(2 * M_PI), false);
+   }
+
+   /**
+    * @brief Converts n angles of vectors in degrees to follow the meteorological convention
+    * (see the single angle convert_to_meteorological_dir_deg), using the best instruction
+    * set available (see get_simd_level).
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] Angles converted to the meteorological convention. Must hold n elements; can be d.
+    * @param d [in] Angles in degrees.
+    * @param n [in] The number of angles.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   convert_to_meteorological_dir_deg(T* out, const T* d, const size_t n)
+   {
+      simd_detail::wrap_angles(out, d, n, static_cast<T>(1), static_cast<T>(180), static_cast<T>(360), true);
+   }
+
+   /**
+    * @brief Converts n angles of vectors in radians to follow the meteorological convention
+    * (see the single angle convert_to_meteorological_dir_rad), using the best instruction
+    * set available (see get_simd_level).
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @param out [out] Angles converted to the meteorological convention. Must hold n elements; can be r.
+    * @param r [in] Angles in radians.
+    * @param n [in] The number of angles.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   convert_to_meteorological_dir_rad(T* out, const T* r, const size_t n)
+   {
+      simd_detail::wrap_angles(out, r, n, static_cast<T>(1), static_cast<T>(M_PI), static_cast<T>(2 * M_PI), false);
+   }
+
+   /**
+    * @brief Applies the geotransform to every pixel of a window of a raster grid,
+    * giving the same coordinates as apply_geotransform for each (row, column).
+    *
+    * Along a row the coordinates are stepped from the start of the row instead of
+    * applying the full transform to each pixel, using the best instruction set available
+    * (see get_simd_level), and the rows are split between threads. Large grids are
+    * written around the caches, as they would only evict everything else. The coordinates are
+    * computed in T, from row starts computed in GT. For pixel centres, shift the origin
+    * of the geotransform by half a pixel.
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @tparam GT Supports float, double and long double.
+    * @param xs [out] x-coordinates of the pixels, row-major. Must hold nrows * ncols elements.
+    * @param ys [out] y-coordinates of the pixels, row-major. Must hold nrows * ncols elements.
+    * @param first_row [in] The row index of the first row of the window.
+    * @param nrows [in] The number of rows of the window.
+    * @param first_col [in] The column index of the first column of the window.
+    * @param ncols [in] The number of columns of the window.
+    * @param geotransform [in] The geotransform array.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename T, typename GT>
+   typename std::enable_if<std::is_floating_point<T>::value && std::is_floating_point<GT>::value, void>::type
+   apply_geotransform_grid(T* xs, T* ys, const size_t first_row, const size_t nrows,
+      const size_t first_col, const size_t ncols, const GT* geotransform, const unsigned nthreads = 0)
+   {
+      const T x_step = static_cast<T>(geotransform[1]);
+      const T y_step = static_cast<T>(geotransform[4]);
+      const simd_level level = get_simd_level();
+      const bool stream = nrows * ncols * 2 * sizeof(T) > simd_detail::stream_grid_bytes;
+      (void)level;
+      (void)stream;
+
+      parallel_chunks(nrows, ncols, nthreads, [=](const size_t row_begin, const size_t row_end)
+      {
+         for (size_t r = row_begin; r < row_end; ++r)
+         {
+            const GT row = static_cast<GT>(first_row + r);
+            const GT col = static_cast<GT>(first_col);
+            const T x0 = static_cast<T>(geotransform[0] + col * geotransform[1] + row * geotransform[2]);
+            const T y0 = static_cast<T>(geotransform[3] + col * geotransform[4] + row * geotransform[5]);
+            T* row_xs = xs + r * ncols;
+            T* row_ys = ys + r * ncols;
+
+            size_t done = 0;
+#if defined(MATHS_SIMD_X86)
+            if constexpr (simd_detail::has_kernels<T>::value)
+            {
+               switch (level)
+               {
+                  case simd_level::avx512: done = simd_avx512::geotransform_row_kernel(row_xs, row_ys, ncols, x0, y0, x_step, y_step, stream); break;
+                  case simd_level::avx2: done = simd_avx2::geotransform_row_kernel(row_xs, row_ys, ncols, x0, y0, x_step, y_step, stream); break;
+                  default: break;
+               }
+            }
+#endif
+            for (size_t c = done; c < ncols; ++c)
+            {
+               row_xs[c] = x0 + static_cast<T>(c) * x_step;
+               row_ys[c] = y0 + static_cast<T>(c) * y_step;
+            }
+         }
+      });
+   }
+
+   /**
+    * @brief Applies the geotransform to every pixel of a raster grid
+    * (see the windowed apply_geotransform_grid).
+    *
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @tparam GT Supports float, double and long double.
+    * @param xs [out] x-coordinates of the pixels, row-major. Must hold nrows * ncols elements.
+    * @param ys [out] y-coordinates of the pixels, row-major. Must hold nrows * ncols elements.
+    * @param nrows [in] The number of rows of the grid.
+    * @param ncols [in] The number of columns of the grid.
+    * @param geotransform [in] The geotransform array.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename T, typename GT>
+   typename std::enable_if<std::is_floating_point<T>::value && std::is_floating_point<GT>::value, void>::type
+   apply_geotransform_grid(T* xs, T* ys, const size_t nrows, const size_t ncols,
+      const GT* geotransform, const unsigned nthreads = 0)
+   {
+      apply_geotransform_grid(xs, ys, size_t(0), nrows, size_t(0), ncols, geotransform, nthreads);
+   }
+
+   /**
+    * @brief Applies the inverse geotransform to n points to retrieve the row
+    * and column indexes of the pixels they fall in (see the single point apply_inverse_geotransform).
+    *
+    * The inverse of the geotransform is computed once, the points go through the best
+    * instruction set available (see get_simd_level) and are split between threads.
+    * The result is rounded to the nearest integer value. No bound or overflow checks.
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam index_t Supports int, long, long long and size_t.
+    * @tparam T Supports float, double and long double (long double is not vectorised).
+    * @tparam GT Supports float, double and long double.
+    * @param irows [out] Row indexes. Must hold n elements.
+    * @param icols [out] Column indexes. Must hold n elements.
+    * @param xs [in] x-coordinates of the points.
+    * @param ys [in] y-coordinates of the points.
+    * @param n [in] The number of points.
+    * @param geotransform [in] The geotransform array.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename index_t, typename T, typename GT>
+   typename std::enable_if<
+      (std::is_same<index_t, int>::value || std::is_same<index_t, long>::value || std::is_same<index_t, long long>::value || std::is_same<index_t, size_t>::value) &&
+      std::is_floating_point<T>::value && 
+      std::is_floating_point<GT>::value, void>::type
+   apply_inverse_geotransform(index_t* irows, index_t* icols, const T* xs, const T* ys, const size_t n,
+      const GT* geotransform, const unsigned nthreads = 0)
+   {
+      const GT det = geotransform[1] * geotransform[5] - geotransform[2] * geotransform[4];
+      const T x0 = static_cast<T>(geotransform[0]);
+      const T y0 = static_cast<T>(geotransform[3]);
+      const T col_x = static_cast<T>(geotransform[5] / det);
+      const T col_y = static_cast<T>(-geotransform[2] / det);
+      const T row_x = static_cast<T>(-geotransform[4] / det);
+      const T row_y = static_cast<T>(geotransform[1] / det);
+      const simd_level level = get_simd_level();
+      (void)level;
+
+      parallel_chunks(n, 1, nthreads, [=](const size_t begin, const size_t end)
+      {
+         // The kernels round in T; the indexes are converted a block at a time
+         constexpr size_t block = 256;
+         T rows[block];
+         T cols[block];
+         for (size_t i = begin; i < end; i += block)
+         {
+            const size_t len = std::min(block, end - i);
+            size_t done = 0;
+#if defined(MATHS_SIMD_X86)
+            if constexpr (simd_detail::has_kernels<T>::value)
+            {
+               switch (level)
+               {
+                  case simd_level::avx512: done = simd_avx512::inverse_geotransform_kernel(rows, cols, xs + i, ys + i, len, x0, y0, col_x, col_y, row_x, row_y); break;
+                  case simd_level::avx2: done = simd_avx2::inverse_geotransform_kernel(rows, cols, xs + i, ys + i, len, x0, y0, col_x, col_y, row_x, row_y); break;
+                  default: break;
+               }
+            }
+#endif
+            for (size_t j = done; j < len; ++j)
+            {
+               const T dx = xs[i + j] - x0;
+               const T dy = ys[i + j] - y0;
+               cols[j] = std::round(dx * col_x + dy * col_y);
+               rows[j] = std::round(dx * row_x + dy * row_y);
+            }
+            for (size_t j = 0; j < len; ++j)
+            {
+               irows[i + j] = static_cast<index_t>(rows[j]);
+               icols[i + j] = static_cast<index_t>(cols[j]);
+            }
+         }
+      });
+   }
+}
+
@@ -0,0 +1,260 @@
+// Kernels of maths_operations_simd.hpp, written against the simd_ops<T>
+// wrappers of the enclosing namespace. That header includes this file once
+// per instruction set, inside the namespace and target region of that set,
+// so there is no include guard on purpose. Do not include it directly.
+//
+// Each kernel handles the points that fill whole registers and returns how
+// many it handled; the caller finishes the remaining ones with scalar code.
+
+template <typename T>
+size_t squared_distance_kernel(T* out, const T* xs, const T* ys, const size_t n, const T x, const T y)
+{
+   typedef simd_ops<T> ops;
+   const size_t nfull = n - n % ops::width;
+   const typename ops::reg vx = ops::set1(x);
+   const typename ops::reg vy = ops::set1(y);
+   for (size_t i = 0; i < nfull; i += ops::width)
+   {
+      const typename ops::reg dx = ops::sub(ops::load(xs + i), vx);
+      const typename ops::reg dy = ops::sub(ops::load(ys + i), vy);
+      ops::store(out + i, ops::fmadd(dx, dx, ops::mul(dy, dy)));
+   }
+   return nfull;
+}
+
+template <typename T>
+size_t distance_kernel(T* out, const T* xs, const T* ys, const size_t n, const T x, const T y)
+{
+   typedef simd_ops<T> ops;
+   const size_t nfull = n - n % ops::width;
+   const typename ops::reg vx = ops::set1(x);
+   const typename ops::reg vy = ops::set1(y);
+   for (size_t i = 0; i < nfull; i += ops::width)
+   {
+      const typename ops::reg dx = ops::sub(ops::load(xs + i), vx);
+      const typename ops::reg dy = ops::sub(ops::load(ys + i), vy);
+      ops::store(out + i, ops::sqrt(ops::fmadd(dx, dx, ops::mul(dy, dy))));
+   }
+   return nfull;
+}
+
+template <typename T>
+size_t magnitude_kernel(T* out, const T* xs, const T* ys, const size_t n)
+{
+   typedef simd_ops<T> ops;
+   const size_t nfull = n - n % ops::width;
+   for (size_t i = 0; i < nfull; i += ops::width)
+   {
+      const typename ops::reg vx = ops::load(xs + i);
+      const typename ops::reg vy = ops::load(ys + i);
+      ops::store(out + i, ops::sqrt(ops::fmadd(vx, vx, ops::mul(vy, vy))));
+   }
+   return nfull;
+}
+
+// Same steps as fast_atan2
+template <typename T>
+size_t direction_kernel(T* out, const T* xs, const T* ys, const size_t n)
+{
+   typedef simd_ops<T> ops;
+   typedef typename ops::reg reg;
+   const size_t nfull = n - n % ops::width;
+   const reg zero = ops::set1(static_cast<T>(0));
+   const reg half_pi = ops::set1(static_cast<T>(M_PI / 2));
+   const reg pi = ops::set1(static_cast<T>(M_PI));
+   const reg c1 = ops::set1(static_cast<T>(fast_atan_coeff[0]));
+   const reg c3 = ops::set1(static_cast<T>(fast_atan_coeff[1]));
+   const reg c5 = ops::set1(static_cast<T>(fast_atan_coeff[2]));
+   const reg c7 = ops::set1(static_cast<T>(fast_atan_coeff[3]));
+   const reg c9 = ops::set1(static_cast<T>(fast_atan_coeff[4]));
+   const reg c11 = ops::set1(static_cast<T>(fast_atan_coeff[5]));
+
+   for (size_t i = 0; i < nfull; i += ops::width)
+   {
+      const reg x = ops::load(xs + i);
+      const reg y = ops::load(ys + i);
+      const reg ax = ops::abs(x);
+      const reg ay = ops::abs(y);
+      const reg mx = ops::max(ax, ay);
+
+      // t in [0, 1]; 0 for the zero vector instead of 0/0
+      const reg t = ops::select(ops::less(zero, mx), ops::div(ops::min(ax, ay), mx), zero);
+      const reg t2 = ops::mul(t, t);
+      reg p = ops::fmadd(t2, c11, c9);
+      p = ops::fmadd(t2, p, c7);
+      p = ops::fmadd(t2, p, c5);
+      p = ops::fmadd(t2, p, c3);
+      p = ops::fmadd(t2, p, c1);
+      reg a = ops::mul(t, p);
+
+      a = ops::select(ops::less(ax, ay), ops::sub(half_pi, a), a);
+      a = ops::select(ops::less(x, zero), ops::sub(pi, a), a);
+      a = ops::select(ops::less(y, zero), ops::sub(zero, a), a);
+      ops::store(out + i, a);
+   }
+   return nfull;
+}
+
+// Each lane keeps the closest point it has seen (the first one on ties),
+// then the lanes are reduced
+template <typename T>
+size_t nearest_kernel(const T* xs, const T* ys, const size_t n, const T x, const T y,
+   size_t* nearest, T* nearest_squared_distance)
+{
+   typedef simd_ops<T> ops;
+   typedef typename ops::reg reg;
+   typedef typename ops::ireg ireg;
+   const size_t nfull = n - n % ops::width;
+   if (nfull == 0)
+      return 0;
+
+   const reg vx = ops::set1(x);
+   const reg vy = ops::set1(y);
+   reg best = ops::set1(std::numeric_limits<T>::infinity());
+   ireg best_index = ops::iota();
+   ireg index = ops::iota();
+   const ireg step = ops::iset1(static_cast<typename ops::index_t>(ops::width));
+
+   for (size_t i = 0; i < nfull; i += ops::width)
+   {
+      const reg dx = ops::sub(ops::load(xs + i), vx);
+      const reg dy = ops::sub(ops::load(ys + i), vy);
+      const reg d2 = ops::fmadd(dx, dx, ops::mul(dy, dy));
+      const typename ops::mask closer = ops::less(d2, best);
+      best = ops::select(closer, d2, best);
+      best_index = ops::iselect(closer, index, best_index);
+      index = ops::iadd(index, step);
+   }
+
+   T lane_best[ops::width];
+   typename ops::index_t lane_index[ops::width];
+   ops::store(lane_best, best);
+   ops::istore(lane_index, best_index);
+
+   size_t lane = 0;
+   for (size_t l = 1; l < ops::width; ++l)
+   {
+      if (lane_best[l] < lane_best[lane] || (lane_best[l] == lane_best[lane] && lane_index[l] < lane_index[lane]))
+         lane = l;
+   }
+   *nearest = static_cast<size_t>(lane_index[lane]);
+   *nearest_squared_distance = lane_best[lane];
+   return nfull;
+}
+
+// One row of a raster grid: x = x0 + c * x_step for the columns c = 0, 1, ...
+// (likewise for y). The column numbers are stepped in a register, so no error
+// builds up along the row as it would by adding x_step to x. With stream set the
+// stores bypass the caches (for grids much larger than them), which needs xs and
+// ys equally aligned; the columns up to the register alignment are done here too
+template <typename T>
+size_t geotransform_row_kernel(T* xs, T* ys, const size_t ncols, const T x0, const T y0,
+   const T x_step, const T y_step, const bool stream)
+{
+   typedef simd_ops<T> ops;
+   typedef typename ops::reg reg;
+   const size_t align = ops::width * sizeof(T);
+   const size_t misalign = reinterpret_cast<std::uintptr_t>(xs) % align;
+   const bool streaming = stream && misalign % sizeof(T) == 0 && misalign == reinterpret_cast<std::uintptr_t>(ys) % align;
+   const size_t head = streaming ? std::min(ncols, (align - misalign) % align / sizeof(T)) : 0;
+   const size_t nfull = ncols - (ncols - head) % ops::width;
+   for (size_t c = 0; c < head; ++c)
+   {
+      xs[c] = x0 + static_cast<T>(c) * x_step;
+      ys[c] = y0 + static_cast<T>(c) * y_step;
+   }
+
+   T lanes[ops::width];
+   for (size_t l = 0; l < ops::width; ++l)
+      lanes[l] = static_cast<T>(head + l);
+   reg c = ops::load(lanes);
+   const reg c_step = ops::set1(static_cast<T>(ops::width));
+   const reg vx0 = ops::set1(x0);
+   const reg vy0 = ops::set1(y0);
+   const reg vx_step = ops::set1(x_step);
+   const reg vy_step = ops::set1(y_step);
+
+   if (streaming)
+   {
+      for (size_t i = head; i < nfull; i += ops::width)
+      {
+         ops::stream(xs + i, ops::fmadd(c, vx_step, vx0));
+         ops::stream(ys + i, ops::fmadd(c, vy_step, vy0));
+         c = ops::add(c, c_step);
+      }
+      _mm_sfence();
+   }
+   else
+   {
+      for (size_t i = head; i < nfull; i += ops::width)
+      {
+         ops::store(xs + i, ops::fmadd(c, vx_step, vx0));
+         ops::store(ys + i, ops::fmadd(c, vy_step, vy0));
+         c = ops::add(c, c_step);
+      }
+   }
+   return nfull;
+}
+
+// Pixel (row, column) of points with the inverse of the geotransform, i.e.
+// col = col_x (x - x0) + col_y (y - y0) and row = row_x (x - x0) + row_y (y - y0),
+// rounded half away from zero like std::round
+template <typename T>
+size_t inverse_geotransform_kernel(T* rows, T* cols, const T* xs, const T* ys, const size_t n,
+   const T x0, const T y0, const T col_x, const T col_y, const T row_x, const T row_y)
+{
+   typedef simd_ops<T> ops;
+   typedef typename ops::reg reg;
+   const size_t nfull = n - n % ops::width;
+   const reg vx0 = ops::set1(x0);
+   const reg vy0 = ops::set1(y0);
+   const reg vcol_x = ops::set1(col_x);
+   const reg vcol_y = ops::set1(col_y);
+   const reg vrow_x = ops::set1(row_x);
+   const reg vrow_y = ops::set1(row_y);
+   const reg half = ops::set1(static_cast<T>(0.5));
+
+   for (size_t i = 0; i < nfull; i += ops::width)
+   {
+      const reg dx = ops::sub(ops::load(xs + i), vx0);
+      const reg dy = ops::sub(ops::load(ys + i), vy0);
+      const reg col = ops::fmadd(dx, vcol_x, ops::mul(dy, vcol_y));
+      const reg row = ops::fmadd(dx, vrow_x, ops::mul(dy, vrow_y));
+
+      const reg col_trunc = ops::trunc(col);
+      const reg row_trunc = ops::trunc(row);
+      ops::store(cols + i, ops::select(ops::less(ops::abs(ops::sub(col, col_trunc)), half), col_trunc, ops::add(col_trunc, ops::sign(col))));
+      ops::store(rows + i, ops::select(ops::less(ops::abs(ops::sub(row, row_trunc)), half), row_trunc, ops::add(row_trunc, ops::sign(row))));
+   }
+   return nfull;
+}
+
+// Angles a = offset + sign * in wrapped into [0, period) with the same steps as wrap_angle;
+// with full_turn_for_positive, positive multiples of the period give the
+// period instead of 0 (as get_0_360_deg)
+template <typename T>
+size_t wrap_angle_kernel(T* out, const T* in, const size_t n, const T sign, const T offset,
+   const T period, const bool full_turn_for_positive)
+{
+   typedef simd_ops<T> ops;
+   typedef typename ops::reg reg;
+   const size_t nfull = n - n % ops::width;
+   const reg zero = ops::set1(static_cast<T>(0));
+   const reg vsign = ops::set1(sign);
+   const reg voffset = ops::set1(offset);
+   const reg vperiod = ops::set1(period);
+   const reg vinv_period = ops::set1(static_cast<T>(1) / period);
+   const reg full_turn = ops::set1(full_turn_for_positive ? period : static_cast<T>(0));
+
+   for (size_t i = 0; i < nfull; i += ops::width)
+   {
+      const reg a = ops::fmadd(ops::load(in + i), vsign, voffset);
+      reg r = ops::sub(a, ops::mul(ops::trunc(ops::mul(a, vinv_period)), vperiod));
+      r = ops::select(ops::less(r, zero), ops::add(r, vperiod), r);
+      r = ops::select(ops::less(r, vperiod), r, ops::sub(r, vperiod));
+      // r is 0 or more, so not above 0 means 0
+      r = ops::select(ops::less(zero, r), r, ops::select(ops::less(zero, a), full_turn, zero));
+      ops::store(out + i, r);
+   }
+   return nfull;
+}
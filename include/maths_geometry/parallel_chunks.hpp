@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace maths_ops
+{
+   // Fewest elements (grid cells, points, ...) worth a thread of their own
+   constexpr size_t min_elements_per_thread = size_t(1) << 16;
+
+   /**
+    * @brief Calls f(begin, end) on contiguous chunks of [0, n), one chunk per thread.
+    *
+    * Chunks are kept to at least min_elements_per_thread elements, so small inputs
+    * stay on the calling thread, which always takes the last chunk. The first
+    * exception thrown by f is rethrown once all the threads have finished.
+    *
+    * @tparam F Callable as f(size_t begin, size_t end).
+    * @param n [in] The number of items.
+    * @param elements_per_item [in] How many elements each item stands for (e.g. the columns of a row).
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread.
+    * @param f [in] The work on a chunk of items.
+    */
+   template <typename F>
+   void parallel_chunks(const size_t n, const size_t elements_per_item, unsigned nthreads, F f)
+   {
+      if (nthreads == 0)
+         nthreads = std::max(1u, std::thread::hardware_concurrency());
+      const size_t min_items = std::max<size_t>(1, min_elements_per_thread / std::max<size_t>(1, elements_per_item));
+      const size_t nchunks = std::max<size_t>(1, std::min<size_t>(nthreads, n / min_items));
+      if (nchunks == 1)
+      {
+         f(size_t(0), n);
+         return;
+      }
+
+      std::exception_ptr error;
+      std::mutex error_mutex;
+      auto run = [&](const size_t begin, const size_t end) {
+         try
+         {
+            f(begin, end);
+         }
+         catch (...)
+         {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+               error = std::current_exception();
+         }
+      };
+
+      std::vector<std::thread> workers;
+      workers.reserve(nchunks - 1);
+      const size_t chunk = n / nchunks;
+      const size_t extra = n % nchunks;
+      size_t begin = 0;
+      for (size_t k = 0; k < nchunks; ++k)
+      {
+         const size_t end = begin + chunk + (k < extra ? 1 : 0);
+         if (k + 1 < nchunks)
+            workers.emplace_back(run, begin, end);
+         else
+            run(begin, end);
+         begin = end;
+      }
+      for (std::thread& worker : workers)
+         worker.join();
+
+      if (error)
+         std::rethrow_exception(error);
+   }
+}
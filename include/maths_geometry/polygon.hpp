@@ -0,0 +1,420 @@
+#pragma once
+
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/parallel_chunks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+// Polygons given as contiguous arrays of vertex coordinates (structure of arrays),
+// one ring without the first vertex repeated at the end. The ring may go either way round.
+
+namespace maths_ops
+{
+   /**
+    * @brief Calculates the signed area of a polygon with the Shoelace formula
+    * (see shoelace_term). Positive for counter-clockwise rings.
+    *
+    * The vertices are taken relative to the first one, so that coordinates far
+    * from the origin (e.g. projected) do not cancel out the digits of small polygons.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param xs [in] The x-coordinates of the vertices.
+    * @param ys [in] The y-coordinates of the vertices.
+    * @param n [in] The number of vertices.
+    * @return The signed area; 0 for fewer than 3 vertices.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, T>::type
+   polygon_signed_area(const T* xs, const T* ys, const size_t n)
+   {
+      if (n < 3)
+         return static_cast<T>(0);
+
+      const T x0 = xs[0];
+      const T y0 = ys[0];
+      T twice_area = static_cast<T>(0);
+      for (size_t i = 1; i + 1 < n; ++i)
+         twice_area += shoelace_term(xs[i] - x0, ys[i] - y0, xs[i + 1] - x0, ys[i + 1] - y0);
+      return twice_area / static_cast<T>(2);
+   }
+
+   /**
+    * @brief Calculates the area of a polygon (see polygon_signed_area).
+    *
+    * @tparam T Supports float, double and long double.
+    * @param xs [in] The x-coordinates of the vertices.
+    * @param ys [in] The y-coordinates of the vertices.
+    * @param n [in] The number of vertices.
+    * @return The area.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, T>::type
+   polygon_area(const T* xs, const T* ys, const size_t n)
+   {
+      return std::abs(polygon_signed_area(xs, ys, n));
+   }
+
+   /**
+    * @brief Calculates the centroid (centre of mass) of a polygon
+    * (https://en.wikipedia.org/wiki/Centroid#Of_a_polygon).
+    *
+    * For polygons of no area (fewer than 3 vertices or all on a line)
+    * it gives the mean of the vertices instead.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param cx [out] x-coordinate of the centroid.
+    * @param cy [out] y-coordinate of the centroid.
+    * @param xs [in] The x-coordinates of the vertices.
+    * @param ys [in] The y-coordinates of the vertices.
+    * @param n [in] The number of vertices.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   polygon_centroid(T* cx, T* cy, const T* xs, const T* ys, const size_t n)
+   {
+      *cx = static_cast<T>(0);
+      *cy = static_cast<T>(0);
+      if (n == 0)
+         return;
+
+      // Relative to the first vertex, as in polygon_signed_area; the edges to and
+      // from the first vertex have no term there
+      const T x0 = xs[0];
+      const T y0 = ys[0];
+      T twice_area = static_cast<T>(0);
+      T sx = static_cast<T>(0);
+      T sy = static_cast<T>(0);
+      for (size_t i = 1; i + 1 < n; ++i)
+      {
+         const T xa = xs[i] - x0, ya = ys[i] - y0;
+         const T xb = xs[i + 1] - x0, yb = ys[i + 1] - y0;
+         const T term = shoelace_term(xa, ya, xb, yb);
+         twice_area += term;
+         sx += (xa + xb) * term;
+         sy += (ya + yb) * term;
+      }
+
+      if (std::abs(twice_area) > std::numeric_limits<T>::min())
+      {
+         *cx = x0 + sx / (static_cast<T>(3) * twice_area);
+         *cy = y0 + sy / (static_cast<T>(3) * twice_area);
+         return;
+      }
+
+      for (size_t i = 0; i < n; ++i)
+      {
+         *cx += xs[i] - x0;
+         *cy += ys[i] - y0;
+      }
+      *cx = x0 + *cx / static_cast<T>(n);
+      *cy = y0 + *cy / static_cast<T>(n);
+   }
+
+   /**
+    * @brief The edges of a polygon, prepared for testing many points against it.
+    *
+    * The bounding box of the polygon is kept to reject far points at once.
+    * Inside it, the polygon is cut into horizontal bands and each band holds
+    * a copy of the edges that cross it, stored next to each other, so that a point
+    * is only tested against the few edges at its height (an edge table, as
+    * used for scanline filling).
+    *
+    * Points are classified with the even-odd rule on a ray towards +x: an edge
+    * counts if its lower end is at or below the point and its upper end above it,
+    * so a ray through a vertex is counted once. Points exactly on an edge
+    * may go either way.
+    *
+    * @tparam T Supports float, double and long double.
+    */
+   template <typename T>
+   class polygon_edge_table
+   {
+      static_assert(std::is_floating_point<T>::value, "polygon_edge_table supports float, double and long double");
+
+   public:
+      /**
+       * @brief Builds the table of a polygon.
+       *
+       * @param xs [in] The x-coordinates of the vertices.
+       * @param ys [in] The y-coordinates of the vertices.
+       * @param n [in] The number of vertices. With fewer than 3 the polygon contains no points.
+       * @param nbands [in] The number of horizontal bands; 0 for about one per edge. Fewer
+       * are used if the edges are so tall that the bands would hold more than 4 copies per edge.
+       */
+      polygon_edge_table(const T* xs, const T* ys, const size_t n, size_t nbands = 0)
+      {
+         bounding_box(&m_xmin, &m_ymin, &m_xmax, &m_ymax, xs, ys, n);
+         if (n < 3)
+            return;
+
+         m_ax.assign(xs, xs + n);
+         m_ay.assign(ys, ys + n);
+         m_bx.resize(n);
+         m_by.resize(n);
+         for (size_t i = 0; i < n; ++i)
+         {
+            m_bx[i] = xs[i + 1 < n ? i + 1 : 0];
+            m_by[i] = ys[i + 1 < n ? i + 1 : 0];
+         }
+
+         // An edge is copied into about (its height / band height + 1) bands: bound the
+         // bands so that the copies of all the edges stay within 4 per edge
+         T total_height = 0;
+         for (size_t i = 0; i < n; ++i)
+            total_height += std::abs(m_by[i] - m_ay[i]);
+         if (nbands == 0)
+            nbands = n;
+         if (total_height > 0)
+         {
+            const T most = static_cast<T>(3 * n) * (m_ymax - m_ymin) / total_height;
+            nbands = std::max(static_cast<size_t>(1), std::min(nbands, static_cast<size_t>(std::min(most, static_cast<T>(nbands)))));
+         }
+         m_nbands = m_ymax > m_ymin ? nbands : 1;
+         m_band_scale = m_ymax > m_ymin ? static_cast<T>(m_nbands) / (m_ymax - m_ymin) : static_cast<T>(0);
+
+         // Count the edges of each band, then place them (horizontal edges are never counted)
+         m_band_start.assign(m_nbands + 1, 0);
+         for (size_t i = 0; i < n; ++i)
+         {
+            if (m_ay[i] == m_by[i])
+               continue;
+            const size_t lo = band_of(std::min(m_ay[i], m_by[i]));
+            const size_t hi = band_of(std::max(m_ay[i], m_by[i]));
+            for (size_t b = lo; b <= hi; ++b)
+               ++m_band_start[b + 1];
+         }
+         for (size_t b = 0; b < m_nbands; ++b)
+            m_band_start[b + 1] += m_band_start[b];
+
+         const size_t total = m_band_start[m_nbands];
+         m_xlo.resize(total);
+         m_ylo.resize(total);
+         m_yhi.resize(total);
+         m_dxdy.resize(total);
+         std::vector<size_t> next(m_band_start.begin(), m_band_start.end() - 1);
+         for (size_t i = 0; i < n; ++i)
+         {
+            if (m_ay[i] == m_by[i])
+               continue;
+            const bool up = m_ay[i] < m_by[i];
+            const T xlo = up ? m_ax[i] : m_bx[i];
+            const T ylo = up ? m_ay[i] : m_by[i];
+            const T yhi = up ? m_by[i] : m_ay[i];
+            const T dxdy = (m_bx[i] - m_ax[i]) / (m_by[i] - m_ay[i]);
+            for (size_t b = band_of(ylo); b <= band_of(yhi); ++b)
+            {
+               const size_t k = next[b]++;
+               m_xlo[k] = xlo;
+               m_ylo[k] = ylo;
+               m_yhi[k] = yhi;
+               m_dxdy[k] = dxdy;
+            }
+         }
+      }
+
+      /**
+       * @brief Checks whether a point is inside the bounding box of the polygon.
+       */
+      bool in_bounding_box(const T x, const T y) const
+      {
+         return x >= m_xmin && x <= m_xmax && y >= m_ymin && y <= m_ymax;
+      }
+
+      /**
+       * @brief Checks whether a point is inside the polygon (even-odd rule).
+       */
+      bool contains(const T x, const T y) const
+      {
+         if (!in_bounding_box(x, y) || m_ax.empty())
+            return false;
+
+         const size_t b = band_of(y);
+         unsigned crossings = 0;
+         for (size_t k = m_band_start[b]; k < m_band_start[b + 1]; ++k)
+         {
+            const bool spans = (m_ylo[k] <= y) & (y < m_yhi[k]);
+            crossings ^= static_cast<unsigned>(spans & (x < m_xlo[k] + (y - m_ylo[k]) * m_dxdy[k]));
+         }
+         return crossings != 0;
+      }
+
+      /**
+       * @brief The number of edges (vertices) of the polygon.
+       */
+      size_t size() const { return m_ax.size(); }
+
+      /**
+       * @brief The number of horizontal bands of the table.
+       */
+      size_t bands() const { return m_nbands; }
+
+      T xmin() const { return m_xmin; }
+      T ymin() const { return m_ymin; }
+      T xmax() const { return m_xmax; }
+      T ymax() const { return m_ymax; }
+
+      // The edges in vertex order, from (ax, ay) to (bx, by)
+      const T* edge_ax() const { return m_ax.data(); }
+      const T* edge_ay() const { return m_ay.data(); }
+      const T* edge_bx() const { return m_bx.data(); }
+      const T* edge_by() const { return m_by.data(); }
+
+   private:
+      // Monotonic in y, so an edge is in every band between those of its ends
+      size_t band_of(const T y) const
+      {
+         const T b = (y - m_ymin) * m_band_scale;
+         if (!(b > static_cast<T>(0)))
+            return 0;
+         return std::min(static_cast<size_t>(b), m_nbands - 1);
+      }
+
+      T m_xmin, m_ymin, m_xmax, m_ymax;
+      std::vector<T> m_ax, m_ay, m_bx, m_by;
+
+      size_t m_nbands = 1;
+      T m_band_scale = static_cast<T>(0);
+      std::vector<size_t> m_band_start{ 0, 0 };    // The edges of band b are [m_band_start[b], m_band_start[b + 1])
+      std::vector<T> m_xlo, m_ylo, m_yhi, m_dxdy;  // x and y of the lower end, y of the upper end, slope dx/dy
+   };
+
+   /**
+    * @brief Checks whether each of n points is inside a polygon
+    * (see polygon_edge_table::contains), splitting the points between threads.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param inside [out] 1 for the points inside, 0 otherwise. Must hold n elements.
+    * @param xs [in] The x-coordinates of the points.
+    * @param ys [in] The y-coordinates of the points.
+    * @param n [in] The number of points.
+    * @param polygon [in] The edge table of the polygon.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   points_in_polygon(uint8_t* inside, const T* xs, const T* ys, const size_t n,
+      const polygon_edge_table<T>& polygon, const unsigned nthreads = 0)
+   {
+      parallel_chunks(n, 1, nthreads, [&](const size_t begin, const size_t end)
+      {
+         for (size_t i = begin; i < end; ++i)
+            inside[i] = polygon.contains(xs[i], ys[i]) ? 1 : 0;
+      });
+   }
+
+   /**
+    * @brief Marks the cells of a window of a raster grid whose centres are
+    * inside a polygon, e.g. to make a mask of a catchment.
+    *
+    * The cell centres of a row lie on a line. Instead of testing each centre,
+    * the crossings of that line with the edges of the polygon are found once and
+    * sorted, and the cells between pairs of crossings are filled. The rows are split
+    * between threads and rows clear of the bounding box of the polygon are cleared at once.
+    * The geotransform may be rotated. The centres agree with points_in_polygon applied
+    * to those from apply_geotransform at (row + 0.5, column + 0.5), except for centres
+    * on an edge, which may go either way.
+    *
+    * It does not perform any sanity checks on the input values.
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam GT Supports float, double and long double.
+    * @param mask [out] 1 for the cells inside, 0 otherwise, row-major. Must hold nrows * ncols elements.
+    * @param first_row [in] The row index of the first row of the window.
+    * @param nrows [in] The number of rows of the window.
+    * @param first_col [in] The column index of the first column of the window.
+    * @param ncols [in] The number of columns of the window.
+    * @param geotransform [in] The geotransform array.
+    * @param polygon [in] The edge table of the polygon.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename T, typename GT>
+   typename std::enable_if<std::is_floating_point<T>::value && std::is_floating_point<GT>::value, void>::type
+   polygon_mask(uint8_t* mask, const size_t first_row, const size_t nrows,
+      const size_t first_col, const size_t ncols, const GT* geotransform,
+      const polygon_edge_table<T>& polygon, const unsigned nthreads = 0)
+   {
+      // Along a row, the centre of column c is (x0 + c * sx, y0 + c * sy)
+      const T sx = static_cast<T>(geotransform[1]);
+      const T sy = static_cast<T>(geotransform[4]);
+      const T s2 = sx * sx + sy * sy;
+      const size_t nedges = polygon.size();
+
+      parallel_chunks(nrows, ncols, nthreads, [&](const size_t row_begin, const size_t row_end)
+      {
+         std::vector<T> crossings;
+         crossings.reserve(16);
+         for (size_t r = row_begin; r < row_end; ++r)
+         {
+            uint8_t* row_mask = mask + r * ncols;
+            std::fill(row_mask, row_mask + ncols, uint8_t(0));
+            if (nedges == 0 || ncols == 0)
+               continue;
+
+            const GT row = static_cast<GT>(first_row + r) + static_cast<GT>(0.5);
+            const GT col = static_cast<GT>(first_col) + static_cast<GT>(0.5);
+            const T x0 = static_cast<T>(geotransform[0] + col * geotransform[1] + row * geotransform[2]);
+            const T y0 = static_cast<T>(geotransform[3] + col * geotransform[4] + row * geotransform[5]);
+            const T last = static_cast<T>(ncols - 1);
+            if (std::max(x0, x0 + last * sx) < polygon.xmin() || std::min(x0, x0 + last * sx) > polygon.xmax() ||
+               std::max(y0, y0 + last * sy) < polygon.ymin() || std::min(y0, y0 + last * sy) > polygon.ymax())
+               continue;
+
+            // Columns (in cell units) where the edges cross the line of the row; an edge
+            // counts when its ends are on opposite sides, one end taken as on the left
+            crossings.clear();
+            const T* ax = polygon.edge_ax();
+            const T* ay = polygon.edge_ay();
+            const T* bx = polygon.edge_bx();
+            const T* by = polygon.edge_by();
+            for (size_t e = 0; e < nedges; ++e)
+            {
+               const T da = cross_product(sx, sy, ax[e] - x0, ay[e] - y0);
+               const T db = cross_product(sx, sy, bx[e] - x0, by[e] - y0);
+               if ((da > 0) == (db > 0))
+                  continue;
+               const T f = da / (da - db);
+               const T px = ax[e] + f * (bx[e] - ax[e]) - x0;
+               const T py = ay[e] + f * (by[e] - ay[e]) - y0;
+               crossings.push_back(dot_product(px, py, sx, sy) / s2);
+            }
+            std::sort(crossings.begin(), crossings.end());
+
+            // A ray back along the row from column c crosses the edges before c
+            for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+            {
+               const T from = std::min(last + 1, std::max(static_cast<T>(0), std::floor(crossings[k]) + 1));
+               const T to = std::min(last + 1, std::floor(crossings[k + 1]) + 1);
+               for (size_t c = static_cast<size_t>(from); static_cast<T>(c) < to; ++c)
+                  row_mask[c] = 1;
+            }
+         }
+      });
+   }
+
+   /**
+    * @brief Marks the cells of a raster grid whose centres are inside a polygon
+    * (see the windowed polygon_mask).
+    *
+    * @tparam T Supports float, double and long double.
+    * @tparam GT Supports float, double and long double.
+    * @param mask [out] 1 for the cells inside, 0 otherwise, row-major. Must hold nrows * ncols elements.
+    * @param nrows [in] The number of rows of the grid.
+    * @param ncols [in] The number of columns of the grid.
+    * @param geotransform [in] The geotransform array.
+    * @param polygon [in] The edge table of the polygon.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename T, typename GT>
+   typename std::enable_if<std::is_floating_point<T>::value && std::is_floating_point<GT>::value, void>::type
+   polygon_mask(uint8_t* mask, const size_t nrows, const size_t ncols, const GT* geotransform,
+      const polygon_edge_table<T>& polygon, const unsigned nthreads = 0)
+   {
+      polygon_mask(mask, size_t(0), nrows, size_t(0), ncols, geotransform, polygon, nthreads);
+   }
+}
@@ -0,0 +1,823 @@
+#pragma once
+
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/parallel_chunks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Intersections of line segments in 2D: an exact orientation predicate, pairwise and
+// one-against-many tests, and a Bentley-Ottmann sweep reporting every intersecting
+// pair of a set of segments in O((N + K) log N) for N segments and K pairs.
+//
+// The predicates are exact for any finite input (barring overflow or underflow of the
+// products): they are first evaluated in T with a running error bound, and only when the
+// sign is in doubt again with expansion arithmetic (floating point numbers kept as
+// unevaluated sums, https://people.eecs.berkeley.edu/~jrs/papers/robustr.pdf).
+// So touching and collinear segments are classified correctly, and the sweep does not
+// lose its ordering near intersections.
+
+namespace maths_ops
+{
+   namespace robust_detail
+   {
+      // x + y = a + b exactly
+      template <typename T>
+      inline void two_sum(const T a, const T b, T& x, T& y)
+      {
+         x = a + b;
+         const T b_virtual = x - a;
+         const T a_virtual = x - b_virtual;
+         y = (a - a_virtual) + (b - b_virtual);
+      }
+
+      // x + y = a * b exactly
+      template <typename T>
+      inline void two_product(const T a, const T b, T& x, T& y)
+      {
+         x = a * b;
+         y = std::fma(a, b, -x);
+      }
+
+      /**
+       * @brief The components of an expansion: on the stack up to a fixed number,
+       * which the predicates of segments of similar scale stay well within, and on
+       * the heap beyond (the bound for any input would be the bits of the exponent range).
+       */
+      template <typename T>
+      class components
+      {
+      public:
+         static constexpr size_t inline_capacity = 32;
+
+         components() = default;
+
+         components(const components& other) { *this = other; }
+
+         components& operator=(const components& other)
+         {
+            if (this != &other)
+            {
+               m_heap = other.m_heap;
+               m_size = other.m_size;
+               if (m_heap.empty())
+                  std::copy(other.m_inline, other.m_inline + other.m_size, m_inline);
+            }
+            return *this;
+         }
+
+         size_t size() const { return m_size; }
+         bool empty() const { return m_size == 0; }
+         T& operator[](const size_t i) { return data()[i]; }
+         const T& operator[](const size_t i) const { return data()[i]; }
+         const T& back() const { return data()[m_size - 1]; }
+         const T* begin() const { return data(); }
+         const T* end() const { return data() + m_size; }
+         void clear() { resize(0); }
+
+         void push_back(const T v)
+         {
+            if (m_heap.empty() && m_size < inline_capacity)
+            {
+               m_inline[m_size++] = v;
+               return;
+            }
+            if (m_heap.empty())
+               m_heap.assign(m_inline, m_inline + m_size);
+            m_heap.push_back(v);
+            ++m_size;
+         }
+
+         // New components are left unset
+         void resize(const size_t n)
+         {
+            if (!m_heap.empty() || n > inline_capacity)
+            {
+               if (m_heap.empty())
+                  m_heap.assign(m_inline, m_inline + m_size);
+               m_heap.resize(n);
+            }
+            m_size = n;
+         }
+
+      private:
+         T* data() { return m_heap.empty() ? m_inline : m_heap.data(); }
+         const T* data() const { return m_heap.empty() ? m_inline : m_heap.data(); }
+
+         T m_inline[inline_capacity];
+         std::vector<T> m_heap;
+         size_t m_size = 0;
+      };
+
+      /**
+       * @brief A number as an unevaluated sum of non-overlapping components of
+       * increasing magnitude, so that sums, differences and products are exact.
+       * Its sign is the sign of the largest component.
+       */
+      template <typename T>
+      struct expansion
+      {
+         components<T> c;
+
+         expansion() = default;
+         explicit expansion(const T v) { if (v != 0) c.push_back(v); }
+
+         // Adds a single number (Grow-Expansion, dropping zero components)
+         void grow(T b)
+         {
+            size_t k = 0;
+            for (size_t i = 0; i < c.size(); ++i)
+            {
+               T h;
+               two_sum(b, c[i], b, h);
+               if (h != 0)
+                  c[k++] = h;
+            }
+            c.resize(k);
+            if (b != 0)
+               c.push_back(b);
+         }
+
+         // Merges the components into as few as possible (Compress)
+         void compress()
+         {
+            if (c.size() < 2)
+               return;
+            components<T> g;
+            g.resize(c.size());
+            size_t bottom = c.size() - 1;
+            T q = c[bottom];
+            for (size_t i = c.size() - 1; i-- > 0;)
+            {
+               T big, small;
+               two_sum(q, c[i], big, small);
+               if (small != 0)
+               {
+                  g[bottom--] = big;
+                  q = small;
+               }
+               else
+                  q = big;
+            }
+            g[bottom] = q;
+            c.clear();
+            for (size_t i = bottom + 1; i < g.size(); ++i)
+            {
+               T big, small;
+               two_sum(g[i], q, big, small);
+               if (small != 0)
+                  c.push_back(small);
+               q = big;
+            }
+            if (q != 0)
+               c.push_back(q);
+         }
+
+         int sign() const { return c.empty() ? 0 : (c.back() > 0 ? 1 : -1); }
+
+         friend expansion operator+(expansion a, const expansion& b)
+         {
+            for (const T v : b.c)
+               a.grow(v);
+            return a;
+         }
+
+         friend expansion operator-(expansion a, const expansion& b)
+         {
+            for (const T v : b.c)
+               a.grow(-v);
+            return a;
+         }
+
+         friend expansion operator*(const expansion& a, const expansion& b)
+         {
+            expansion out;
+            for (const T bv : b.c)
+            {
+               for (const T av : a.c)
+               {
+                  T p, e;
+                  two_product(av, bv, p, e);
+                  out.grow(e);
+                  out.grow(p);
+               }
+            }
+            out.compress();
+            return out;
+         }
+      };
+
+      /**
+       * @brief A number computed in T, with a bound on its distance from the exact
+       * value. The sign is known when the value is further from zero than the bound.
+       */
+      template <typename T>
+      struct filtered
+      {
+         static constexpr T u = std::numeric_limits<T>::epsilon() / 2;
+         static constexpr T widen = 1 + 8 * u;
+
+         T v = 0;
+         T e = 0;
+
+         filtered() = default;
+         explicit filtered(const T value) : v(value) {}
+         filtered(const T value, const T error) : v(value), e(error) {}
+
+         // 1, -1 or 0; 2 when the sign is in doubt
+         int sign() const
+         {
+            if (v > e)
+               return 1;
+            if (v < -e)
+               return -1;
+            return v == 0 && e == 0 ? 0 : 2;
+         }
+
+         friend filtered operator+(const filtered& a, const filtered& b)
+         {
+            const T v = a.v + b.v;
+            return filtered(v, (a.e + b.e + std::abs(v) * u) * widen);
+         }
+
+         friend filtered operator-(const filtered& a, const filtered& b)
+         {
+            const T v = a.v - b.v;
+            return filtered(v, (a.e + b.e + std::abs(v) * u) * widen);
+         }
+
+         friend filtered operator*(const filtered& a, const filtered& b)
+         {
+            const T v = a.v * b.v;
+            return filtered(v, (std::abs(a.v) * b.e + std::abs(b.v) * a.e + a.e * b.e + std::abs(v) * u) * widen);
+         }
+      };
+
+      // The exact sign of value(N) for N = filtered<T> first, then expansion<T>
+      template <typename T, typename F>
+      inline int robust_sign(F&& value)
+      {
+         const int s = value(filtered<T>()).sign();
+         return s != 2 ? s : value(expansion<T>()).sign();
+      }
+
+      // The z-component of (b - a) x (c - a), in the number type N
+      template <typename N, typename T>
+      inline N orientation_value(const T ax, const T ay, const T bx, const T by, const T cx, const T cy)
+      {
+         return (N(bx) - N(ax)) * (N(cy) - N(ay)) - (N(by) - N(ay)) * (N(cx) - N(ax));
+      }
+
+      // The z-component of (b - a) x (d - c), in the number type N
+      template <typename N, typename T>
+      inline N direction_cross_value(const T ax, const T ay, const T bx, const T by,
+         const T cx, const T cy, const T dx, const T dy)
+      {
+         return (N(bx) - N(ax)) * (N(dy) - N(cy)) - (N(by) - N(ay)) * (N(dx) - N(cx));
+      }
+
+      // The crossing of the lines through a-b and c-d in homogeneous coordinates
+      // (X / D, Y / D), in the number type N
+      template <typename N, typename T>
+      inline void crossing_value(N& X, N& Y, N& D, const T ax, const T ay, const T bx, const T by,
+         const T cx, const T cy, const T dx, const T dy)
+      {
+         const N rx = N(bx) - N(ax);
+         const N ry = N(by) - N(ay);
+         const N wx = N(dx) - N(cx);
+         const N wy = N(dy) - N(cy);
+         D = rx * wy - ry * wx;
+         const N num = (N(cx) - N(ax)) * wy - (N(cy) - N(ay)) * wx;
+         X = N(ax) * D + rx * num;
+         Y = N(ay) * D + ry * num;
+      }
+   }
+
+   /**
+    * @brief Finds on which side of the directed line from a to b the point c lies, exactly.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param ax [in] x-coordinate of the first point of the line.
+    * @param ay [in] y-coordinate of the first point of the line.
+    * @param bx [in] x-coordinate of the second point of the line.
+    * @param by [in] y-coordinate of the second point of the line.
+    * @param cx [in] x-coordinate of the point to test.
+    * @param cy [in] y-coordinate of the point to test.
+    * @return 1 if the point is on the left, -1 if on the right, 0 if on the line.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, int>::type
+   orientation(const T ax, const T ay, const T bx, const T by, const T cx, const T cy)
+   {
+      // Ends of the line, common in meshes and polylines, would not pass the filter
+      if ((cx == ax && cy == ay) || (cx == bx && cy == by))
+         return 0;
+      return robust_detail::robust_sign<T>([&](auto tag) {
+         return robust_detail::orientation_value<decltype(tag)>(ax, ay, bx, by, cx, cy);
+      });
+   }
+
+   /**
+    * @brief Checks whether the line segments a-b and c-d have any point in common,
+    * exactly (see orientation). Touching at an end and overlapping collinear
+    * segments count. A segment may be a single point.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param ax [in] x-coordinate of the starting point of the first line segment.
+    * @param ay [in] y-coordinate of the starting point of the first line segment.
+    * @param bx [in] x-coordinate of the ending point of the first line segment.
+    * @param by [in] y-coordinate of the ending point of the first line segment.
+    * @param cx [in] x-coordinate of the starting point of the second line segment.
+    * @param cy [in] y-coordinate of the starting point of the second line segment.
+    * @param dx [in] x-coordinate of the ending point of the second line segment.
+    * @param dy [in] y-coordinate of the ending point of the second line segment.
+    * @return true if the segments intersect.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+   segments_intersect(const T ax, const T ay, const T bx, const T by,
+      const T cx, const T cy, const T dx, const T dy)
+   {
+      // Boxes apart, which also settles most pairs without any predicate
+      if (std::max(ax, bx) < std::min(cx, dx) || std::max(cx, dx) < std::min(ax, bx) ||
+         std::max(ay, by) < std::min(cy, dy) || std::max(cy, dy) < std::min(ay, by))
+         return false;
+
+      const int o1 = orientation(ax, ay, bx, by, cx, cy);
+      const int o2 = orientation(ax, ay, bx, by, dx, dy);
+      if (o1 * o2 > 0)
+         return false;
+      const int o3 = orientation(cx, cy, dx, dy, ax, ay);
+      const int o4 = orientation(cx, cy, dx, dy, bx, by);
+      if (o3 * o4 > 0)
+         return false;
+
+      // Collinear segments with overlapping boxes overlap
+      return true;
+   }
+
+   /**
+    * @brief Calculates where the line segments a-b and c-d intersect.
+    *
+    * Whether they intersect is decided exactly (see segments_intersect); the point is
+    * found from the standard line equations (see get_line_equation_standard) of the
+    * segments taken relative to a, which keeps the digits of coordinates far from the origin.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param x [out] x-coordinate of the intersection; for collinear segments, the start of their overlap.
+    * @param y [out] y-coordinate of the intersection; for collinear segments, the start of their overlap.
+    * @param ax [in] x-coordinate of the starting point of the first line segment.
+    * @param ay [in] y-coordinate of the starting point of the first line segment.
+    * @param bx [in] x-coordinate of the ending point of the first line segment.
+    * @param by [in] y-coordinate of the ending point of the first line segment.
+    * @param cx [in] x-coordinate of the starting point of the second line segment.
+    * @param cy [in] y-coordinate of the starting point of the second line segment.
+    * @param dx [in] x-coordinate of the ending point of the second line segment.
+    * @param dy [in] y-coordinate of the ending point of the second line segment.
+    * @return 0 if they do not intersect (x and y are not set), 1 if they meet at a point, 2 if they overlap (collinear).
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, int>::type
+   segment_intersection(T* x, T* y, const T ax, const T ay, const T bx, const T by,
+      const T cx, const T cy, const T dx, const T dy)
+   {
+      if (!segments_intersect(ax, ay, bx, by, cx, cy, dx, dy))
+         return 0;
+
+      const int parallel = robust_detail::robust_sign<T>([&](auto tag) {
+         return robust_detail::direction_cross_value<decltype(tag)>(ax, ay, bx, by, cx, cy, dx, dy);
+      });
+      if (parallel == 0)
+      {
+         // The overlap starts at the later of the (x, y)-smallest ends of the two
+         const bool ab = ax < bx || (ax == bx && ay <= by);
+         const bool cd = cx < dx || (cx == dx && cy <= dy);
+         const T sx1 = ab ? ax : bx, sy1 = ab ? ay : by;
+         const T sx2 = cd ? cx : dx, sy2 = cd ? cy : dy;
+         const bool first = sx1 > sx2 || (sx1 == sx2 && sy1 >= sy2);
+         *x = first ? sx1 : sx2;
+         *y = first ? sy1 : sy2;
+         const bool point = (ax == bx && ay == by) || (cx == dx && cy == dy);
+         return point ? 1 : 2;
+      }
+
+      T a1, b1, c1, a2, b2, c2;
+      get_line_equation_standard(&a1, &b1, &c1, static_cast<T>(0), static_cast<T>(0), bx - ax, by - ay);
+      get_line_equation_standard(&a2, &b2, &c2, cx - ax, cy - ay, dx - ax, dy - ay);
+      const T det = a1 * b2 - a2 * b1;
+      *x = ax + (b1 * c2 - b2 * c1) / det;
+      *y = ay + (a2 * c1 - a1 * c2) / det;
+      return 1;
+   }
+
+   /**
+    * @brief Checks whether each of n line segments intersects the segment a-b
+    * (see the pairwise segments_intersect), splitting the segments between threads.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param intersects [out] 1 for the segments that intersect a-b, 0 otherwise. Must hold n elements.
+    * @param x1s [in] The x-coordinates of the starting points of the segments.
+    * @param y1s [in] The y-coordinates of the starting points of the segments.
+    * @param x2s [in] The x-coordinates of the ending points of the segments.
+    * @param y2s [in] The y-coordinates of the ending points of the segments.
+    * @param n [in] The number of segments.
+    * @param ax [in] x-coordinate of the starting point of the line segment to test against.
+    * @param ay [in] y-coordinate of the starting point of the line segment to test against.
+    * @param bx [in] x-coordinate of the ending point of the line segment to test against.
+    * @param by [in] y-coordinate of the ending point of the line segment to test against.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   segments_intersect(uint8_t* intersects, const T* x1s, const T* y1s, const T* x2s, const T* y2s, const size_t n,
+      const T ax, const T ay, const T bx, const T by, const unsigned nthreads = 0)
+   {
+      parallel_chunks(n, 1, nthreads, [&](const size_t begin, const size_t end)
+      {
+         for (size_t i = begin; i < end; ++i)
+            intersects[i] = segments_intersect(ax, ay, bx, by, x1s[i], y1s[i], x2s[i], y2s[i]) ? 1 : 0;
+      });
+   }
+
+   namespace segment_detail
+   {
+      using robust_detail::filtered;
+      using robust_detail::expansion;
+      using robust_detail::robust_sign;
+
+      // The segments with their ends ordered by (x, y): a is the left (or lower) end
+      template <typename T>
+      struct segment_set
+      {
+         std::vector<T> ax, ay, bx, by;
+      };
+
+      // An event of the sweep: an end of a segment, or the crossing of two segments
+      // kept exactly as such, with its homogeneous coordinates in filtered numbers
+      template <typename T>
+      struct sweep_point
+      {
+         bool vertex = true;
+         T x = 0, y = 0;                     // For ends
+         size_t s = 0, t = 0;                // For crossings
+         int d_sign = 1;                     // Sign of the homogeneous coordinate D
+         filtered<T> X, Y, D;
+      };
+
+      template <typename T>
+      sweep_point<T> make_vertex(const T x, const T y)
+      {
+         sweep_point<T> p;
+         p.x = x;
+         p.y = y;
+         p.X = filtered<T>(x);
+         p.Y = filtered<T>(y);
+         p.D = filtered<T>(static_cast<T>(1));
+         return p;
+      }
+
+      // The crossing of two segments that are not parallel
+      template <typename T>
+      sweep_point<T> make_crossing(const segment_set<T>& segs, const size_t s, const size_t t, const int d_sign)
+      {
+         sweep_point<T> p;
+         p.vertex = false;
+         p.s = s;
+         p.t = t;
+         p.d_sign = d_sign;
+         robust_detail::crossing_value(p.X, p.Y, p.D, segs.ax[s], segs.ay[s], segs.bx[s], segs.by[s],
+            segs.ax[t], segs.ay[t], segs.bx[t], segs.by[t]);
+         return p;
+      }
+
+      template <typename N, typename T>
+      void homogeneous(N& X, N& Y, N& D, const segment_set<T>& segs, const sweep_point<T>& p)
+      {
+         if constexpr (std::is_same<N, filtered<T>>::value)
+         {
+            X = p.X;
+            Y = p.Y;
+            D = p.D;
+         }
+         else if (p.vertex)
+         {
+            X = N(p.x);
+            Y = N(p.y);
+            D = N(static_cast<T>(1));
+         }
+         else
+         {
+            robust_detail::crossing_value(X, Y, D, segs.ax[p.s], segs.ay[p.s], segs.bx[p.s], segs.by[p.s],
+               segs.ax[p.t], segs.ay[p.t], segs.bx[p.t], segs.by[p.t]);
+         }
+      }
+
+      // -1, 0 or 1 as p is before, at or after q in (x, y) order
+      template <typename T>
+      int compare_points(const segment_set<T>& segs, const sweep_point<T>& p, const sweep_point<T>& q)
+      {
+         if (p.vertex && q.vertex)
+            return p.x < q.x ? -1 : (p.x > q.x ? 1 : (p.y < q.y ? -1 : (p.y > q.y ? 1 : 0)));
+         // The crossing of the same two segments, which the filter cannot tell
+         if (!p.vertex && !q.vertex && ((p.s == q.s && p.t == q.t) || (p.s == q.t && p.t == q.s)))
+            return 0;
+
+         const int d_sign = p.d_sign * q.d_sign;
+         const int cx = d_sign * robust_sign<T>([&](auto tag) {
+            using N = decltype(tag);
+            N Xp, Yp, Dp, Xq, Yq, Dq;
+            homogeneous(Xp, Yp, Dp, segs, p);
+            homogeneous(Xq, Yq, Dq, segs, q);
+            return Xp * Dq - Xq * Dp;
+         });
+         if (cx != 0)
+            return cx;
+         return d_sign * robust_sign<T>([&](auto tag) {
+            using N = decltype(tag);
+            N Xp, Yp, Dp, Xq, Yq, Dq;
+            homogeneous(Xp, Yp, Dp, segs, p);
+            homogeneous(Xq, Yq, Dq, segs, q);
+            return Yp * Dq - Yq * Dp;
+         });
+      }
+
+      // 1 if p is above (left of) segment s, -1 if below, 0 if on its line
+      template <typename T>
+      int side(const segment_set<T>& segs, const size_t s, const sweep_point<T>& p)
+      {
+         if (p.vertex)
+            return orientation(segs.ax[s], segs.ay[s], segs.bx[s], segs.by[s], p.x, p.y);
+         // A crossing is on both its segments, which the filter cannot tell
+         if (s == p.s || s == p.t)
+            return 0;
+         return p.d_sign * robust_sign<T>([&](auto tag) {
+            using N = decltype(tag);
+            N X, Y, D;
+            homogeneous(X, Y, D, segs, p);
+            return (N(segs.bx[s]) - N(segs.ax[s])) * (Y - N(segs.ay[s]) * D) - (N(segs.by[s]) - N(segs.ay[s])) * (X - N(segs.ax[s]) * D);
+         });
+      }
+
+      // 1 if segment t turns left of segment s (is steeper), -1 if right, 0 if parallel
+      template <typename T>
+      int turn(const segment_set<T>& segs, const size_t s, const size_t t)
+      {
+         return robust_sign<T>([&](auto tag) {
+            return robust_detail::direction_cross_value<decltype(tag)>(segs.ax[s], segs.ay[s], segs.bx[s], segs.by[s],
+               segs.ax[t], segs.ay[t], segs.bx[t], segs.by[t]);
+         });
+      }
+
+      template <typename T>
+      class sweep
+      {
+      public:
+         sweep(const T* x1s, const T* y1s, const T* x2s, const T* y2s, const size_t n)
+            : m_crossings(point_less{ this }), m_status(status_less{ this })
+         {
+            m_segs.ax.resize(n);
+            m_segs.ay.resize(n);
+            m_segs.bx.resize(n);
+            m_segs.by.resize(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+               const bool forward = x1s[i] < x2s[i] || (x1s[i] == x2s[i] && y1s[i] <= y2s[i]);
+               m_segs.ax[i] = forward ? x1s[i] : x2s[i];
+               m_segs.ay[i] = forward ? y1s[i] : y2s[i];
+               m_segs.bx[i] = forward ? x2s[i] : x1s[i];
+               m_segs.by[i] = forward ? y2s[i] : y1s[i];
+            }
+         }
+
+         void run(std::vector<std::pair<size_t, size_t>>& pairs, const bool skip_shared_ends)
+         {
+            // The ends are sorted once; only the crossings found on the way go through the queue
+            const size_t n = m_segs.ax.size();
+            std::vector<end_point> ends;
+            ends.reserve(2 * n);
+            for (size_t i = 0; i < n; ++i)
+            {
+               ends.push_back(end_point{ m_segs.ax[i], m_segs.ay[i], i, true });
+               ends.push_back(end_point{ m_segs.bx[i], m_segs.by[i], i, false });
+            }
+            std::sort(ends.begin(), ends.end(), [](const end_point& a, const end_point& b) {
+               return a.x < b.x || (a.x == b.x && a.y < b.y);
+            });
+
+            std::vector<size_t> through, starting, involved;
+            size_t next = 0;
+            while (next < ends.size() || !m_crossings.empty())
+            {
+               bool take_end = next < ends.size();
+               bool take_crossing = !m_crossings.empty();
+               if (take_end && take_crossing)
+               {
+                  const int c = compare_points(m_segs, make_vertex(ends[next].x, ends[next].y), *m_crossings.begin());
+                  take_end = c <= 0;
+                  take_crossing = c >= 0;
+               }
+               if (take_crossing)
+               {
+                  m_current = *m_crossings.begin();
+                  m_crossings.erase(m_crossings.begin());
+               }
+               starting.clear();
+               if (take_end)
+               {
+                  const T x = ends[next].x;
+                  const T y = ends[next].y;
+                  m_current = make_vertex(x, y);
+                  for (; next < ends.size() && ends[next].x == x && ends[next].y == y; ++next)
+                  {
+                     if (ends[next].left)
+                        starting.push_back(ends[next].s);
+                  }
+               }
+
+               // The segments through the point are next to each other in the status
+               const auto range = m_status.equal_range(probe);
+               through.assign(range.first, range.second);
+
+               involved.assign(through.begin(), through.end());
+               involved.insert(involved.end(), starting.begin(), starting.end());
+               for (size_t i = 0; i < involved.size(); ++i)
+               {
+                  for (size_t j = i + 1; j < involved.size(); ++j)
+                  {
+                     if (skip_shared_ends && only_meet_at_ends(involved[i], involved[j]))
+                        continue;
+                     pairs.emplace_back(std::min(involved[i], involved[j]), std::max(involved[i], involved[j]));
+                  }
+               }
+
+               // Reinsert the segments that go on past the point, now ordered as they leave it;
+               // points (zero-length segments) are never in the status
+               m_status.erase(range.first, range.second);
+               bool inserted = false;
+               for (const size_t s : through)
+               {
+                  if (!is_right_end(s))
+                  {
+                     m_status.insert(s);
+                     inserted = true;
+                  }
+               }
+               for (const size_t s : starting)
+               {
+                  if (!is_right_end(s))
+                  {
+                     m_status.insert(s);
+                     inserted = true;
+                  }
+               }
+               const auto now = m_status.equal_range(probe);
+               if (!inserted)
+               {
+                  if (now.first != m_status.begin() && now.second != m_status.end())
+                     find_crossing(*std::prev(now.first), *now.second);
+                  continue;
+               }
+               if (now.first != m_status.begin())
+                  find_crossing(*std::prev(now.first), *now.first);
+               if (now.second != m_status.end())
+                  find_crossing(*std::prev(now.second), *now.second);
+            }
+
+            std::sort(pairs.begin(), pairs.end());
+            pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+         }
+
+      private:
+         static constexpr size_t probe = std::numeric_limits<size_t>::max();
+
+         struct end_point
+         {
+            T x, y;
+            size_t s;
+            bool left;
+         };
+
+         struct point_less
+         {
+            const sweep* owner;
+            bool operator()(const sweep_point<T>& p, const sweep_point<T>& q) const
+            {
+               return compare_points(owner->m_segs, p, q) < 0;
+            }
+         };
+
+         // Orders the segments from bottom to top around the current event point:
+         // those through it by how they leave it. The probe stands for the point itself.
+         struct status_less
+         {
+            const sweep* owner;
+            bool operator()(const size_t a, const size_t b) const
+            {
+               if (a == b)
+                  return false;
+               const segment_set<T>& segs = owner->m_segs;
+               const sweep_point<T>& p = owner->m_current;
+               if (a == probe)
+                  return side(segs, b, p) < 0;
+               if (b == probe)
+                  return side(segs, a, p) > 0;
+               const int sa = side(segs, a, p);
+               const int sb = side(segs, b, p);
+               if (sa == 0 && sb == 0)
+               {
+                  const int t = turn(segs, a, b);
+                  return t != 0 ? t > 0 : a < b;
+               }
+               if (sa == 0)
+                  return sb < 0;
+               if (sb == 0)
+                  return sa > 0;
+               return a < b;
+            }
+         };
+
+         bool is_right_end(const size_t s) const
+         {
+            return compare_points(m_segs, make_vertex(m_segs.bx[s], m_segs.by[s]), m_current) == 0;
+         }
+
+         // 1 if the current point is the left end of s, 2 if the right end, 3 if both (a point), 0 if neither
+         int end_at_current(const size_t s) const
+         {
+            const int left = compare_points(m_segs, make_vertex(m_segs.ax[s], m_segs.ay[s]), m_current) == 0 ? 1 : 0;
+            return left | (is_right_end(s) ? 2 : 0);
+         }
+
+         // Whether two segments through the current point meet only there, at an end of both;
+         // collinear segments both starting or both ending there overlap
+         bool only_meet_at_ends(const size_t s, const size_t t) const
+         {
+            const int es = end_at_current(s);
+            const int et = end_at_current(t);
+            if (es == 0 || et == 0)
+               return false;
+            if (es == 3 || et == 3)
+               return true;
+            return es != et || turn(m_segs, s, t) != 0;
+         }
+
+         // Queues the crossing of two neighbouring segments if it is still ahead
+         void find_crossing(const size_t s, const size_t t)
+         {
+            if (!segments_intersect(m_segs.ax[s], m_segs.ay[s], m_segs.bx[s], m_segs.by[s],
+               m_segs.ax[t], m_segs.ay[t], m_segs.bx[t], m_segs.by[t]))
+               return;
+
+            // Collinear overlaps are found at the ends of the segments
+            const int d_sign = turn(m_segs, s, t);
+            if (d_sign == 0)
+               return;
+            const sweep_point<T> q = make_crossing(m_segs, s, t, d_sign);
+            if (compare_points(m_segs, m_current, q) < 0)
+               m_crossings.insert(q);
+         }
+
+         segment_set<T> m_segs;
+         sweep_point<T> m_current;
+         std::set<sweep_point<T>, point_less> m_crossings;   // Crossings ahead, each once
+         std::set<size_t, status_less> m_status;
+      };
+   }
+
+   /**
+    * @brief Finds every pair of intersecting line segments of a set with a
+    * Bentley-Ottmann sweep (https://en.wikipedia.org/wiki/Bentley%E2%80%93Ottmann_algorithm),
+    * in O((n + k) log n) for k pairs instead of testing all n^2 / 2 pairs.
+    *
+    * Touching, overlapping (collinear) and repeated segments and segments of zero length
+    * are all reported, decided exactly (see segments_intersect). For polylines and meshes,
+    * where neighbouring segments share ends, skip_shared_ends leaves out the pairs that only
+    * meet at an end of both.
+    *
+    * @tparam T Supports float, double and long double.
+    * @param pairs [out] The pairs of indexes (i, j) of intersecting segments, with i < j, sorted. Cleared first.
+    * @param x1s [in] The x-coordinates of the starting points of the segments.
+    * @param y1s [in] The y-coordinates of the starting points of the segments.
+    * @param x2s [in] The x-coordinates of the ending points of the segments.
+    * @param y2s [in] The y-coordinates of the ending points of the segments.
+    * @param n [in] The number of segments.
+    * @param skip_shared_ends [in] Leave out the pairs that only meet at an end of both segments.
+    */
+   template <typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   find_segment_intersections(std::vector<std::pair<size_t, size_t>>& pairs,
+      const T* x1s, const T* y1s, const T* x2s, const T* y2s, const size_t n, const bool skip_shared_ends = false)
+   {
+      pairs.clear();
+      segment_detail::sweep<T> engine(x1s, y1s, x2s, y2s, n);
+      engine.run(pairs, skip_shared_ends);
+   }
+}
@@ -0,0 +1,656 @@
+#pragma once
+
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/parallel_chunks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Spatial indexes over points given as separate arrays of x and y coordinates
+// (structure of arrays), for nearest, k-nearest, radius and segment proximity queries
+// without testing every point. Both keep their own copy of the points, sorted so that
+// points close in space are close in memory, and answer with the indexes of the points
+// in the arrays they were built from. They are not changed by queries, so any number
+// of threads may query them at once.
+
+namespace maths_ops
+{
+   namespace spatial_detail
+   {
+      // Fewest elements worth a thread, counted per query (a query visits tens of points)
+      constexpr size_t elements_per_query = 64;
+
+      // Keeps the k closest points found so far, sorted by distance, in ids and d2s;
+      // count is how many are kept
+      template <typename T>
+      inline void keep_nearest(size_t* ids, T* d2s, size_t& count, const size_t k, const size_t id, const T d2)
+      {
+         if (count == k && d2 >= d2s[k - 1])
+            return;
+         size_t pos = count < k ? count++ : k - 1;
+         while (pos > 0 && d2s[pos - 1] > d2)
+         {
+            ids[pos] = ids[pos - 1];
+            d2s[pos] = d2s[pos - 1];
+            --pos;
+         }
+         ids[pos] = id;
+         d2s[pos] = d2;
+      }
+
+      // Squared distance from a point to a box; 0 inside it
+      template <typename T>
+      inline T box_squared_distance(const T xmin, const T ymin, const T xmax, const T ymax, const T x, const T y)
+      {
+         const T dx = std::max(std::max(xmin - x, x - xmax), static_cast<T>(0));
+         const T dy = std::max(std::max(ymin - y, y - ymax), static_cast<T>(0));
+         return dx * dx + dy * dy;
+      }
+
+      // False when no point of the box can be within radius of the segment: the box
+      // grown by radius misses the box of the segment, or all its corners are
+      // further than radius from the line of the segment, on the same side
+      template <typename T>
+      inline bool segment_may_reach_box(const T xmin, const T ymin, const T xmax, const T ymax,
+         const T ax, const T ay, const T bx, const T by, const T radius)
+      {
+         if (std::min(ax, bx) > xmax + radius || std::max(ax, bx) < xmin - radius ||
+            std::min(ay, by) > ymax + radius || std::max(ay, by) < ymin - radius)
+            return false;
+
+         const T dx = bx - ax;
+         const T dy = by - ay;
+         const T reach = radius * std::sqrt(dx * dx + dy * dy);
+         const T c1 = cross_product(dx, dy, xmin - ax, ymin - ay);
+         const T c2 = cross_product(dx, dy, xmax - ax, ymin - ay);
+         const T c3 = cross_product(dx, dy, xmin - ax, ymax - ay);
+         const T c4 = cross_product(dx, dy, xmax - ax, ymax - ay);
+         return !(std::min(std::min(c1, c2), std::min(c3, c4)) > reach || std::max(std::max(c1, c2), std::max(c3, c4)) < -reach);
+      }
+
+      // Fills the rest of a k-nearest answer when fewer than k points were found
+      template <typename T>
+      inline void pad_nearest(size_t* ids, T* d2s, const size_t count, const size_t k, const size_t none)
+      {
+         for (size_t j = count; j < k; ++j)
+         {
+            ids[j] = none;
+            d2s[j] = std::numeric_limits<T>::infinity();
+         }
+      }
+   }
+
+   /**
+    * @brief Bins points into the cells of a uniform grid over their bounding box.
+    *
+    * Best for points spread fairly evenly, e.g. stations or raster cell centres: building
+    * is a counting sort, and queries look at the cells around the query point, ring by ring.
+    * The points of a cell are stored next to each other.
+    *
+    * @tparam T Supports float, double and long double.
+    */
+   template <typename T>
+   class uniform_grid_index
+   {
+      static_assert(std::is_floating_point<T>::value, "uniform_grid_index supports float, double and long double");
+
+   public:
+      /**
+       * @brief Builds the index of n points.
+       *
+       * @param xs [in] The x-coordinates of the points.
+       * @param ys [in] The y-coordinates of the points.
+       * @param n [in] The number of points.
+       * @param cell_size [in] The side of the (square) cells; 0 for about two points per cell.
+       * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+       */
+      uniform_grid_index(const T* xs, const T* ys, const size_t n, T cell_size = 0, const unsigned nthreads = 0)
+      {
+         T xmax = 0, ymax = 0;
+         bounding_box(&m_xmin, &m_ymin, &xmax, &ymax, xs, ys, n);
+         if (n == 0)
+         {
+            m_xmin = m_ymin = static_cast<T>(0);
+            return;
+         }
+
+         // All the points at one place: a single cell
+         if (!(xmax > m_xmin) && !(ymax > m_ymin))
+         {
+            m_cell = cell_size > 0 ? cell_size : static_cast<T>(1);
+            m_inv_cell = static_cast<T>(1) / m_cell;
+            m_ncols = m_nrows = 1;
+         }
+         else
+         {
+            // At most about 4 cells per point, even for points along a line
+            const T width = std::max(xmax - m_xmin, std::numeric_limits<T>::min());
+            const T height = std::max(ymax - m_ymin, std::numeric_limits<T>::min());
+            const T smallest = std::sqrt(width * height / static_cast<T>(4 * n));
+            const T longest_side = std::max(width, height) / static_cast<T>(4 * n);
+            if (!(cell_size > 0))
+               cell_size = std::sqrt(static_cast<T>(2) * width * height / static_cast<T>(n));
+            m_cell = std::max(cell_size, std::max(smallest, longest_side));
+            m_inv_cell = static_cast<T>(1) / m_cell;
+
+            // The cells per side are bounded above, but clamped before the conversion all the same
+            const T most = static_cast<T>(4 * n);
+            m_ncols = static_cast<size_t>(std::min(width * m_inv_cell, most)) + 1;
+            m_nrows = static_cast<size_t>(std::min(height * m_inv_cell, most)) + 1;
+         }
+
+         std::vector<size_t> cells(n);
+         parallel_chunks(n, 1, nthreads, [&](const size_t begin, const size_t end)
+         {
+            for (size_t i = begin; i < end; ++i)
+               cells[i] = cell_row(ys[i]) * m_ncols + cell_col(xs[i]);
+         });
+
+         m_cell_start.assign(m_nrows * m_ncols + 1, 0);
+         for (size_t i = 0; i < n; ++i)
+            ++m_cell_start[cells[i] + 1];
+         std::partial_sum(m_cell_start.begin(), m_cell_start.end(), m_cell_start.begin());
+
+         m_xs.resize(n);
+         m_ys.resize(n);
+         m_ids.resize(n);
+         std::vector<size_t> next(m_cell_start.begin(), m_cell_start.end() - 1);
+         for (size_t i = 0; i < n; ++i)
+         {
+            const size_t k = next[cells[i]]++;
+            m_xs[k] = xs[i];
+            m_ys[k] = ys[i];
+            m_ids[k] = i;
+         }
+      }
+
+      /**
+       * @brief The number of points of the index.
+       */
+      size_t size() const { return m_ids.size(); }
+
+      /**
+       * @brief The side of the cells.
+       */
+      T cell_size() const { return m_cell; }
+
+      /**
+       * @brief Finds the closest point to (x, y).
+       *
+       * @param squared_distance [out] The squared distance of the closest point. Can be NULL.
+       * @param x [in] The x-coordinate of the query point.
+       * @param y [in] The y-coordinate of the query point.
+       * @return The index of the closest point; size() if the index is empty.
+       */
+      size_t nearest(T* squared_distance, const T x, const T y) const
+      {
+         size_t id = size();
+         T d2 = std::numeric_limits<T>::infinity();
+         k_nearest(&id, &d2, 1, x, y);
+         if (squared_distance)
+            *squared_distance = d2;
+         return id;
+      }
+
+      /**
+       * @brief Finds the k closest points to (x, y), closest first.
+       *
+       * @param ids [out] The indexes of the points. Must hold k elements; those beyond size() are set to size().
+       * @param squared_distances [out] Their squared distances. Must hold k elements; those beyond size() are set to infinity.
+       * @param k [in] The number of points to find.
+       * @param x [in] The x-coordinate of the query point.
+       * @param y [in] The y-coordinate of the query point.
+       * @return The number of points found, min(k, size()).
+       */
+      size_t k_nearest(size_t* ids, T* squared_distances, const size_t k, const T x, const T y) const
+      {
+         size_t count = 0;
+         if (k == 0)
+            return 0;
+         if (size() == 0)
+         {
+            spatial_detail::pad_nearest(ids, squared_distances, count, k, size());
+            return 0;
+         }
+
+         // The cells beyond ring r are at least r cells away
+         const long r0 = static_cast<long>(cell_row(y));
+         const long c0 = static_cast<long>(cell_col(x));
+         const long last_ring = static_cast<long>(std::max(m_nrows, m_ncols));
+         for (long ring = 0; ring <= last_ring; ++ring)
+         {
+            for_ring(r0, c0, ring, [&](const size_t cell)
+            {
+               for (size_t p = m_cell_start[cell]; p < m_cell_start[cell + 1]; ++p)
+                  spatial_detail::keep_nearest(ids, squared_distances, count, k, m_ids[p], points_squared_distance(m_xs[p], m_ys[p], x, y));
+            });
+            const T reach = static_cast<T>(ring) * m_cell;
+            if (count == k && squared_distances[k - 1] <= reach * reach)
+               break;
+         }
+         spatial_detail::pad_nearest(ids, squared_distances, count, k, size());
+         return count;
+      }
+
+      /**
+       * @brief Finds the points within a distance of (x, y), in no particular order.
+       *
+       * @param out [out] The indexes of the points are appended to it.
+       * @param x [in] The x-coordinate of the query point.
+       * @param y [in] The y-coordinate of the query point.
+       * @param radius [in] The distance.
+       */
+      void within_radius(std::vector<size_t>& out, const T x, const T y, const T radius) const
+      {
+         const T r2 = radius * radius;
+         for_cells(x - radius, y - radius, x + radius, y + radius, [&](const size_t p)
+         {
+            if (points_squared_distance(m_xs[p], m_ys[p], x, y) <= r2)
+               out.push_back(m_ids[p]);
+         });
+      }
+
+      /**
+       * @brief Finds the points within a distance of the line segment
+       * from (ax, ay) to (bx, by), in no particular order.
+       *
+       * @param out [out] The indexes of the points are appended to it.
+       * @param ax [in] x-coordinate of the starting point of the line segment.
+       * @param ay [in] y-coordinate of the starting point of the line segment.
+       * @param bx [in] x-coordinate of the ending point of the line segment.
+       * @param by [in] y-coordinate of the ending point of the line segment.
+       * @param radius [in] The distance.
+       */
+      void near_segment(std::vector<size_t>& out, const T ax, const T ay, const T bx, const T by, const T radius) const
+      {
+         const T r2 = radius * radius;
+         for_cells(std::min(ax, bx) - radius, std::min(ay, by) - radius, std::max(ax, bx) + radius, std::max(ay, by) + radius,
+            [&](const size_t p)
+         {
+            if (point_segment_squared_distance(ax, ay, bx, by, m_xs[p], m_ys[p]) <= r2)
+               out.push_back(m_ids[p]);
+         });
+      }
+
+   private:
+      size_t cell_col(const T x) const
+      {
+         const T c = (x - m_xmin) * m_inv_cell;
+         return c > 0 ? static_cast<size_t>(std::min(c, static_cast<T>(m_ncols - 1))) : 0;
+      }
+
+      size_t cell_row(const T y) const
+      {
+         const T r = (y - m_ymin) * m_inv_cell;
+         return r > 0 ? static_cast<size_t>(std::min(r, static_cast<T>(m_nrows - 1))) : 0;
+      }
+
+      // Calls f(cell) for the cells of the grid at Chebyshev distance ring from (r0, c0)
+      template <typename F>
+      void for_ring(const long r0, const long c0, const long ring, F&& f) const
+      {
+         const long nrows = static_cast<long>(m_nrows);
+         const long ncols = static_cast<long>(m_ncols);
+         const long c_lo = std::max(c0 - ring, 0L);
+         const long c_hi = std::min(c0 + ring, ncols - 1);
+         for (long r = std::max(r0 - ring, 0L); r <= std::min(r0 + ring, nrows - 1); ++r)
+         {
+            const bool edge_row = r == r0 - ring || r == r0 + ring;
+            const long step = edge_row || ring == 0 ? 1 : 2 * ring;
+            for (long c = edge_row ? c_lo : c0 - ring; c <= c_hi; c += step)
+            {
+               if (c >= 0)
+                  f(static_cast<size_t>(r * ncols + c));
+            }
+         }
+      }
+
+      // Calls f(p) for the stored points in the cells overlapping a box
+      template <typename F>
+      void for_cells(const T xmin, const T ymin, const T xmax, const T ymax, F&& f) const
+      {
+         if (size() == 0)
+            return;
+         const size_t r_hi = cell_row(ymax);
+         const size_t c_lo = cell_col(xmin);
+         const size_t c_hi = cell_col(xmax);
+         for (size_t r = cell_row(ymin); r <= r_hi; ++r)
+         {
+            for (size_t p = m_cell_start[r * m_ncols + c_lo]; p < m_cell_start[r * m_ncols + c_hi + 1]; ++p)
+               f(p);
+         }
+      }
+
+      T m_xmin = 0, m_ymin = 0;
+      T m_cell = 1, m_inv_cell = 1;
+      size_t m_nrows = 0, m_ncols = 0;
+      std::vector<size_t> m_cell_start;   // The points of cell c are [m_cell_start[c], m_cell_start[c + 1])
+      std::vector<T> m_xs, m_ys;
+      std::vector<size_t> m_ids;
+   };
+
+   /**
+    * @brief A static (built once) KD-tree of points.
+    *
+    * Adapts to clustered points, where a uniform grid has many empty or crowded cells.
+    * Each subtree holds a contiguous range of the stored points and its bounding box,
+    * which prunes the queries. The nodes are stored in depth-first order, so
+    * the left child of a node is the next one, and a node (56 bytes for double) holds only
+    * its box, its range of points and its right child, so a visit touches one or two cache lines.
+    * The points of a leaf (up to leaf_size) are stored next to each other.
+    * The subtrees are built in parallel.
+    *
+    * @tparam T Supports float, double and long double.
+    */
+   template <typename T>
+   class kd_tree
+   {
+      static_assert(std::is_floating_point<T>::value, "kd_tree supports float, double and long double");
+
+   public:
+      // Most points in a leaf
+      static constexpr size_t leaf_size = 8;
+
+      /**
+       * @brief Builds the tree of n points.
+       *
+       * @param xs [in] The x-coordinates of the points.
+       * @param ys [in] The y-coordinates of the points.
+       * @param n [in] The number of points.
+       * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+       */
+      kd_tree(const T* xs, const T* ys, const size_t n, unsigned nthreads = 0)
+      {
+         if (n == 0)
+            return;
+         if (nthreads == 0)
+            nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+         // The shape of the tree only depends on n, so the nodes of the subtrees
+         // can be laid out first and filled in by different threads
+         m_nodes.reserve(2 * (n / leaf_size + 1));
+         layout(0, n);
+
+         m_ids.resize(n);
+         std::iota(m_ids.begin(), m_ids.end(), size_t(0));
+         build(0, xs, ys, nthreads);
+
+         m_xs.resize(n);
+         m_ys.resize(n);
+         parallel_chunks(n, 1, nthreads, [&](const size_t begin, const size_t end)
+         {
+            for (size_t i = begin; i < end; ++i)
+            {
+               m_xs[i] = xs[m_ids[i]];
+               m_ys[i] = ys[m_ids[i]];
+            }
+         });
+      }
+
+      /**
+       * @brief The number of points of the tree.
+       */
+      size_t size() const { return m_ids.size(); }
+
+      /**
+       * @brief Finds the closest point to (x, y).
+       *
+       * @param squared_distance [out] The squared distance of the closest point. Can be NULL.
+       * @param x [in] The x-coordinate of the query point.
+       * @param y [in] The y-coordinate of the query point.
+       * @return The index of the closest point; size() if the tree is empty.
+       */
+      size_t nearest(T* squared_distance, const T x, const T y) const
+      {
+         size_t id = size();
+         T d2 = std::numeric_limits<T>::infinity();
+         k_nearest(&id, &d2, 1, x, y);
+         if (squared_distance)
+            *squared_distance = d2;
+         return id;
+      }
+
+      /**
+       * @brief Finds the k closest points to (x, y), closest first.
+       *
+       * @param ids [out] The indexes of the points. Must hold k elements; those beyond size() are set to size().
+       * @param squared_distances [out] Their squared distances. Must hold k elements; those beyond size() are set to infinity.
+       * @param k [in] The number of points to find.
+       * @param x [in] The x-coordinate of the query point.
+       * @param y [in] The y-coordinate of the query point.
+       * @return The number of points found, min(k, size()).
+       */
+      size_t k_nearest(size_t* ids, T* squared_distances, const size_t k, const T x, const T y) const
+      {
+         size_t count = 0;
+         if (k == 0)
+            return 0;
+
+         // Pending subtrees, nearer child visited first; the depth is below 64 for any size_t n
+         size_t stack[64];
+         T stack_d2[64];
+         size_t top = 0;
+         if (!m_nodes.empty())
+         {
+            stack[top] = 0;
+            stack_d2[top++] = static_cast<T>(0);
+         }
+         while (top > 0)
+         {
+            --top;
+            if (count == k && stack_d2[top] >= squared_distances[k - 1])
+               continue;
+            const node& nd = m_nodes[stack[top]];
+            if (nd.right == 0)
+            {
+               for (size_t p = nd.begin; p < nd.end; ++p)
+                  spatial_detail::keep_nearest(ids, squared_distances, count, k, m_ids[p], points_squared_distance(m_xs[p], m_ys[p], x, y));
+               continue;
+            }
+            const size_t left = stack[top] + 1;
+            const T dl = box_squared_distance(m_nodes[left], x, y);
+            const T dr = box_squared_distance(m_nodes[nd.right], x, y);
+            const bool left_first = dl <= dr;
+            stack[top] = left_first ? nd.right : left;
+            stack_d2[top++] = left_first ? dr : dl;
+            stack[top] = left_first ? left : nd.right;
+            stack_d2[top++] = left_first ? dl : dr;
+         }
+         spatial_detail::pad_nearest(ids, squared_distances, count, k, size());
+         return count;
+      }
+
+      /**
+       * @brief Finds the points within a distance of (x, y), in no particular order.
+       *
+       * @param out [out] The indexes of the points are appended to it.
+       * @param x [in] The x-coordinate of the query point.
+       * @param y [in] The y-coordinate of the query point.
+       * @param radius [in] The distance.
+       */
+      void within_radius(std::vector<size_t>& out, const T x, const T y, const T radius) const
+      {
+         const T r2 = radius * radius;
+         visit([&](const node& nd) { return box_squared_distance(nd, x, y) <= r2; },
+            [&](const size_t p)
+         {
+            if (points_squared_distance(m_xs[p], m_ys[p], x, y) <= r2)
+               out.push_back(m_ids[p]);
+         });
+      }
+
+      /**
+       * @brief Finds the points within a distance of the line segment
+       * from (ax, ay) to (bx, by), in no particular order.
+       *
+       * @param out [out] The indexes of the points are appended to it.
+       * @param ax [in] x-coordinate of the starting point of the line segment.
+       * @param ay [in] y-coordinate of the starting point of the line segment.
+       * @param bx [in] x-coordinate of the ending point of the line segment.
+       * @param by [in] y-coordinate of the ending point of the line segment.
+       * @param radius [in] The distance.
+       */
+      void near_segment(std::vector<size_t>& out, const T ax, const T ay, const T bx, const T by, const T radius) const
+      {
+         const T r2 = radius * radius;
+         visit([&](const node& nd) { return spatial_detail::segment_may_reach_box(nd.xmin, nd.ymin, nd.xmax, nd.ymax, ax, ay, bx, by, radius); },
+            [&](const size_t p)
+         {
+            if (point_segment_squared_distance(ax, ay, bx, by, m_xs[p], m_ys[p]) <= r2)
+               out.push_back(m_ids[p]);
+         });
+      }
+
+   private:
+      struct node
+      {
+         T xmin, ymin, xmax, ymax;  // Bounding box of the points of the subtree
+         size_t begin, end;         // The points of the subtree
+         size_t right;              // The right child; 0 for leaves (the left child is the next node)
+      };
+
+      static T box_squared_distance(const node& nd, const T x, const T y)
+      {
+         return spatial_detail::box_squared_distance(nd.xmin, nd.ymin, nd.xmax, nd.ymax, x, y);
+      }
+
+      // Appends the nodes of the subtree of [begin, end), split at the middle
+      void layout(const size_t begin, const size_t end)
+      {
+         const size_t self = m_nodes.size();
+         m_nodes.push_back(node{ 0, 0, 0, 0, begin, end, 0 });
+         if (end - begin <= leaf_size)
+            return;
+         const size_t mid = begin + (end - begin) / 2;
+         layout(begin, mid);
+         m_nodes[self].right = m_nodes.size();
+         layout(mid, end);
+      }
+
+      // Fills the bounding boxes and sorts the points of the subtree of node i,
+      // handing the left subtree to another thread while there are threads to spare
+      void build(const size_t i, const T* xs, const T* ys, const unsigned nthreads)
+      {
+         node& nd = m_nodes[i];
+         nd.xmin = nd.ymin = std::numeric_limits<T>::max();
+         nd.xmax = nd.ymax = std::numeric_limits<T>::lowest();
+         for (size_t p = nd.begin; p < nd.end; ++p)
+         {
+            nd.xmin = std::min(nd.xmin, xs[m_ids[p]]);
+            nd.xmax = std::max(nd.xmax, xs[m_ids[p]]);
+            nd.ymin = std::min(nd.ymin, ys[m_ids[p]]);
+            nd.ymax = std::max(nd.ymax, ys[m_ids[p]]);
+         }
+         if (nd.right == 0)
+            return;
+
+         // Split across the longer side of the box
+         const T* coords = nd.xmax - nd.xmin >= nd.ymax - nd.ymin ? xs : ys;
+         const size_t mid = m_nodes[i + 1].end;
+         std::nth_element(m_ids.begin() + nd.begin, m_ids.begin() + mid, m_ids.begin() + nd.end,
+            [coords](const size_t a, const size_t b) { return coords[a] < coords[b]; });
+
+         const size_t right = nd.right;
+         if (nthreads > 1 && nd.end - nd.begin >= min_elements_per_thread)
+         {
+            const unsigned left_threads = nthreads / 2;
+            std::thread left([this, i, xs, ys, left_threads]() { build(i + 1, xs, ys, left_threads); });
+            build(right, xs, ys, nthreads - left_threads);
+            left.join();
+         }
+         else
+         {
+            build(i + 1, xs, ys, 1);
+            build(right, xs, ys, 1);
+         }
+      }
+
+      // Calls f(p) for the stored points of the leaves whose subtrees pass enter(node)
+      template <typename E, typename F>
+      void visit(E&& enter, F&& f) const
+      {
+         size_t stack[64];
+         size_t top = 0;
+         if (!m_nodes.empty())
+            stack[top++] = 0;
+         while (top > 0)
+         {
+            const size_t i = stack[--top];
+            const node& nd = m_nodes[i];
+            if (!enter(nd))
+               continue;
+            if (nd.right == 0)
+            {
+               for (size_t p = nd.begin; p < nd.end; ++p)
+                  f(p);
+               continue;
+            }
+            stack[top++] = nd.right;
+            stack[top++] = i + 1;
+         }
+      }
+
+      std::vector<node> m_nodes;
+      std::vector<T> m_xs, m_ys;
+      std::vector<size_t> m_ids;
+   };
+
+   /**
+    * @brief Finds for each of m query points the closest point of a spatial index
+    * (uniform_grid_index or kd_tree), splitting the queries between threads.
+    *
+    * @tparam Index uniform_grid_index<T> or kd_tree<T>.
+    * @tparam T Supports float, double and long double.
+    * @param nearest [out] The index of the closest point for each query point (size() of the index if empty). Must hold m elements.
+    * @param squared_distances [out] The squared distance of the closest point for each query point. Must hold m elements, or be NULL.
+    * @param index [in] The spatial index.
+    * @param qxs [in] The x-coordinates of the query points.
+    * @param qys [in] The y-coordinates of the query points.
+    * @param m [in] The number of query points.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename Index, typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   nearest_points(size_t* nearest, T* squared_distances, const Index& index,
+      const T* qxs, const T* qys, const size_t m, const unsigned nthreads = 0)
+   {
+      parallel_chunks(m, spatial_detail::elements_per_query, nthreads, [&](const size_t begin, const size_t end)
+      {
+         for (size_t q = begin; q < end; ++q)
+            nearest[q] = index.nearest(squared_distances ? squared_distances + q : static_cast<T*>(nullptr), qxs[q], qys[q]);
+      });
+   }
+
+   /**
+    * @brief Finds for each of m query points the k closest points of a spatial index
+    * (uniform_grid_index or kd_tree), closest first, splitting the queries between threads.
+    *
+    * @tparam Index uniform_grid_index<T> or kd_tree<T>.
+    * @tparam T Supports float, double and long double.
+    * @param nearest [out] The indexes of the k closest points of each query point, row-major (see k_nearest of the index). Must hold m * k elements.
+    * @param squared_distances [out] Their squared distances, row-major. Must hold m * k elements.
+    * @param k [in] The number of points to find for each query point.
+    * @param index [in] The spatial index.
+    * @param qxs [in] The x-coordinates of the query points.
+    * @param qys [in] The y-coordinates of the query points.
+    * @param m [in] The number of query points.
+    * @param nthreads [in] Most threads to use; 0 for one per hardware thread, 1 to stay on the calling thread.
+    */
+   template <typename Index, typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, void>::type
+   k_nearest_points(size_t* nearest, T* squared_distances, const size_t k, const Index& index,
+      const T* qxs, const T* qys, const size_t m, const unsigned nthreads = 0)
+   {
+      parallel_chunks(m, k * spatial_detail::elements_per_query, nthreads, [&](const size_t begin, const size_t end)
+      {
+         for (size_t q = begin; q < end; ++q)
+            index.k_nearest(nearest + q * k, squared_distances + q * k, k, qxs[q], qys[q]);
+      });
+   }
+}
@@ -0,0 +1,547 @@
+#pragma once
+
+#include "time_utilities/time_utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace timeutils
+{
+    /**
+     * @brief Histogram of durations in nanoseconds, with buckets ~12% wide.
+     *
+     * It has a single writer (the thread that owns it) and any number of
+     * readers: the writer updates the counters with plain atomic stores,
+     * so recording never locks nor waits for a reader.
+     */
+    class DurationHistogram
+    {
+    public:
+        // Exact buckets below 16 ns, then 8 buckets per power of two
+        static constexpr std::size_t nbuckets = 16 + 60 * 8;
+
+        /**
+         * @brief Records a duration. Only the owning thread may call it.
+         */
+        void record(const std::uint64_t ns)
+        {
+            increment(buckets[bucket_index(ns)], 1);
+            increment(count, 1);
+            increment(total, ns);
+            if (ns < min.load(std::memory_order_relaxed))
+                min.store(ns, std::memory_order_relaxed);
+            if (ns > max.load(std::memory_order_relaxed))
+                max.store(ns, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Adds the contents of another histogram to this one.
+         * Used to merge per-thread histograms; not safe while this one is being written.
+         */
+        void merge(const DurationHistogram& other)
+        {
+            for (std::size_t i = 0; i < nbuckets; ++i)
+                increment(buckets[i], other.buckets[i].load(std::memory_order_relaxed));
+            increment(count, other.count.load(std::memory_order_relaxed));
+            increment(total, other.total.load(std::memory_order_relaxed));
+            min.store(std::min(min.load(std::memory_order_relaxed), other.min.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+            max.store(std::max(max.load(std::memory_order_relaxed), other.max.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+        }
+
+        std::uint64_t get_count() const { return count.load(std::memory_order_relaxed); }
+        std::uint64_t get_total() const { return total.load(std::memory_order_relaxed); }
+        std::uint64_t get_min() const { return get_count() > 0 ? min.load(std::memory_order_relaxed) : 0; }
+        std::uint64_t get_max() const { return max.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Returns the approximate duration below which a fraction p of the records fall.
+         */
+        std::uint64_t percentile(const double p) const
+        {
+            std::uint64_t n = 0;
+            for (std::size_t i = 0; i < nbuckets; ++i)
+                n += buckets[i].load(std::memory_order_relaxed);
+            if (n == 0)
+                return 0;
+
+            const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(p * static_cast<double>(n) + 0.5));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < nbuckets; ++i)
+            {
+                seen += buckets[i].load(std::memory_order_relaxed);
+                if (seen >= rank)
+                    return std::clamp(bucket_middle(i), get_min(), get_max());
+            }
+            return get_max();
+        }
+
+        static std::size_t bucket_index(const std::uint64_t ns)
+        {
+            if (ns < 16)
+                return static_cast<std::size_t>(ns);
+
+            const int e = top_bit(ns);
+            const std::size_t sub = static_cast<std::size_t>((ns >> (e - 3)) & 7);
+            return 16 + static_cast<std::size_t>(e - 4) * 8 + sub;
+        }
+
+        // Index of the highest set bit of a non-zero value
+        static int top_bit(const std::uint64_t ns)
+        {
+#if defined(_MSC_VER)
+            unsigned long e;
+            _BitScanReverse64(&e, ns);
+            return static_cast<int>(e);
+#else
+            return 63 - __builtin_clzll(ns);
+#endif
+        }
+
+        static std::uint64_t bucket_middle(const std::size_t index)
+        {
+            if (index < 16)
+                return index;
+
+            const int e = static_cast<int>((index - 16) / 8) + 4;
+            const std::uint64_t sub = (index - 16) % 8;
+            const std::uint64_t low = (std::uint64_t(1) << e) + (sub << (e - 3));
+            return low + (std::uint64_t(1) << (e - 4));
+        }
+
+    private:
+        static void increment(std::atomic<std::uint64_t>& value, const std::uint64_t by)
+        {
+            value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<std::uint64_t>, nbuckets> buckets{};
+        std::atomic<std::uint64_t> count{ 0 };
+        std::atomic<std::uint64_t> total{ 0 };
+        std::atomic<std::uint64_t> min{ std::numeric_limits<std::uint64_t>::max() };
+        std::atomic<std::uint64_t> max{ 0 };
+    };
+
+    /**
+     * @brief Summary of the durations recorded for a timer zone, in nanoseconds.
+     */
+    struct TimerSummary
+    {
+        std::string name;
+        std::uint64_t count;
+        std::uint64_t total;
+        std::uint64_t min;
+        std::uint64_t max;
+        std::uint64_t p50;
+        std::uint64_t p99;
+    };
+
+    /**
+     * @brief A timed region as a trace event: when it started (since the
+     * registry was created) and how long it took, in nanoseconds.
+     */
+    struct TraceEvent
+    {
+        std::size_t zone;
+        std::uint64_t start;
+        std::uint64_t duration;
+    };
+
+    /**
+     * @brief Trace events of one thread, appended in fixed-size chunks.
+     * The thread publishes each event by bumping the chunk's count, so the
+     * events can be written out while the thread keeps recording.
+     */
+    struct TraceBuffer
+    {
+        struct Chunk
+        {
+            static constexpr std::size_t capacity = 4096;
+
+            std::array<TraceEvent, capacity> events;
+            std::atomic<std::size_t> used{ 0 };
+            std::atomic<Chunk*> next{ nullptr };
+        };
+
+        explicit TraceBuffer(const std::size_t tid) :
+            tid(tid)
+        {}
+
+        ~TraceBuffer()
+        {
+            Chunk* chunk = head.load(std::memory_order_relaxed);
+            while (chunk)
+            {
+                Chunk* next = chunk->next.load(std::memory_order_relaxed);
+                delete chunk;
+                chunk = next;
+            }
+        }
+
+        // Only the owning thread appends
+        void append(const TraceEvent& event)
+        {
+            if (!tail || tail->used.load(std::memory_order_relaxed) == Chunk::capacity)
+            {
+                Chunk* chunk = new Chunk();
+                if (tail)
+                    tail->next.store(chunk, std::memory_order_release);
+                else
+                    head.store(chunk, std::memory_order_release);
+                tail = chunk;
+            }
+
+            const std::size_t used = tail->used.load(std::memory_order_relaxed);
+            tail->events[used] = event;
+            tail->used.store(used + 1, std::memory_order_release);
+        }
+
+        const std::size_t tid;
+        std::string name;   // guarded by the registry lock
+        std::atomic<Chunk*> head{ nullptr };
+        Chunk* tail = nullptr;
+    };
+
+    /**
+     * @brief Keeps the timer zones and the histograms of every thread that
+     * recorded into them. Threads find their histograms without locking;
+     * the registry lock is only taken when a thread records for the first
+     * time, when it exits and when the summaries are collected.
+     */
+    class TimerRegistry
+    {
+    public:
+        static constexpr std::size_t max_zones = 256;
+        static constexpr std::size_t invalid_zone = max_zones;
+
+        static TimerRegistry& instance()
+        {
+            static TimerRegistry registry;
+            return registry;
+        }
+
+        /**
+         * @brief Returns the id of a zone, registering it on first use.
+         * Zones with the same name share their histograms.
+         */
+        std::size_t register_zone(const char* name)
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (std::size_t i = 0; i < zone_names.size(); ++i)
+            {
+                if (zone_names[i] == name)
+                    return i;
+            }
+            if (zone_names.size() >= max_zones)
+                return invalid_zone;
+
+            zone_names.emplace_back(name);
+            retired.push_back(std::make_unique<DurationHistogram>());
+            return zone_names.size() - 1;
+        }
+
+        /**
+         * @brief Records a duration for a zone in the calling thread's histogram.
+         */
+        void record(const std::size_t zone, const std::uint64_t ns)
+        {
+            if (zone >= max_zones)
+                return;
+
+            ThreadHistograms& mine = thread_histograms();
+            DurationHistogram* histogram = mine.zones[zone].load(std::memory_order_relaxed);
+            if (!histogram)
+            {
+                histogram = new DurationHistogram();
+                mine.zones[zone].store(histogram, std::memory_order_release);
+            }
+            histogram->record(ns);
+        }
+
+        /**
+         * @brief Records a region of a zone that started at a given time (e.g. Stopwatch::start)
+         * and lasted ns nanoseconds; while tracing, it is also kept as a trace event.
+         */
+        void record(const std::size_t zone, const std::chrono::high_resolution_clock::time_point start, const std::uint64_t ns)
+        {
+            record(zone, ns);
+            if (zone >= max_zones || !tracing.load(std::memory_order_relaxed))
+                return;
+
+            const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count();
+            thread_trace().append(TraceEvent{ zone, static_cast<std::uint64_t>(std::max<std::int64_t>(0, since_epoch)), ns });
+        }
+
+        /**
+         * @brief Starts or stops keeping the timed regions as trace events.
+         * The events are kept in memory until written out, so trace a bounded part of a run.
+         */
+        void set_tracing(const bool enabled)
+        {
+            tracing.store(enabled, std::memory_order_relaxed);
+        }
+
+        bool is_tracing() const
+        {
+            return tracing.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Names the calling thread in the trace (e.g. "worker 3").
+         */
+        void set_thread_name(const std::string& name)
+        {
+            TraceBuffer& mine = thread_trace();
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            mine.name = name;
+        }
+
+        /**
+         * @brief Writes the trace events of all threads in the Chrome trace-event
+         * JSON format, which chrome://tracing and ui.perfetto.dev open.
+         * Each region is a complete ("X") event, i.e. a begin and end pair.
+         */
+        void write_chrome_trace(std::ostream& out)
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+
+            out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+            bool first = true;
+            char number[64];
+            for (const auto& buffer : trace_buffers)
+            {
+                out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"args\":{\"name\":\"" << json_escape(buffer->name.empty() ? "thread " + std::to_string(buffer->tid) : buffer->name) << "\"}}";
+                first = false;
+
+                for (const TraceBuffer::Chunk* chunk = buffer->head.load(std::memory_order_acquire); chunk;
+                    chunk = chunk->next.load(std::memory_order_acquire))
+                {
+                    const std::size_t used = chunk->used.load(std::memory_order_acquire);
+                    for (std::size_t i = 0; i < used; ++i)
+                    {
+                        // Timestamps are in microseconds, with ns precision
+                        const TraceEvent& event = chunk->events[i];
+                        std::snprintf(number, sizeof(number), "\"ts\":%.3f,\"dur\":%.3f",
+                            static_cast<double>(event.start) / 1e3, static_cast<double>(event.duration) / 1e3);
+                        out << ",\n{\"name\":\"" << json_escape(zone_names[event.zone]) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                            << buffer->tid << ',' << number << '}';
+                    }
+                }
+            }
+            out << "\n]}\n";
+        }
+
+        /**
+         * @brief Writes the Chrome trace to a file; returns false if it cannot be written.
+         */
+        bool write_chrome_trace(const std::string& filename)
+        {
+            std::ofstream out(filename);
+            if (!out)
+                return false;
+            write_chrome_trace(out);
+            return static_cast<bool>(out);
+        }
+
+        /**
+         * @brief Starts tracing and writes the trace to a file when the process exits
+         * (returning from main or calling std::exit). Only the last file given is written.
+         */
+        void trace_until_exit(const std::string& filename)
+        {
+            {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                if (exit_trace_file.empty())
+                    std::atexit([]() { TimerRegistry& registry = instance(); registry.write_chrome_trace(registry.exit_trace_file); });
+                exit_trace_file = filename;
+            }
+            set_tracing(true);
+        }
+
+        /**
+         * @brief Returns the summaries of all zones with records, since the start of the process.
+         */
+        std::vector<TimerSummary> summaries()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+
+            std::vector<TimerSummary> result;
+            for (std::size_t zone = 0; zone < zone_names.size(); ++zone)
+            {
+                DurationHistogram merged;
+                merged.merge(*retired[zone]);
+                for (const ThreadHistograms* t : threads)
+                {
+                    const DurationHistogram* histogram = t->zones[zone].load(std::memory_order_acquire);
+                    if (histogram)
+                        merged.merge(*histogram);
+                }
+
+                if (merged.get_count() == 0)
+                    continue;
+                result.push_back(TimerSummary{ zone_names[zone], merged.get_count(), merged.get_total(),
+                    merged.get_min(), merged.get_max(), merged.percentile(0.5), merged.percentile(0.99) });
+            }
+            return result;
+        }
+
+    private:
+        struct ThreadHistograms
+        {
+            std::array<std::atomic<DurationHistogram*>, max_zones> zones{};
+
+            ThreadHistograms()
+            {
+                TimerRegistry& registry = TimerRegistry::instance();
+                std::lock_guard<std::mutex> lock(registry.registry_mutex);
+                registry.threads.push_back(this);
+            }
+
+            // Keep what the thread recorded when it exits
+            ~ThreadHistograms()
+            {
+                TimerRegistry& registry = TimerRegistry::instance();
+                std::lock_guard<std::mutex> lock(registry.registry_mutex);
+                registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+                for (std::size_t zone = 0; zone < max_zones; ++zone)
+                {
+                    DurationHistogram* histogram = zones[zone].load(std::memory_order_relaxed);
+                    if (histogram)
+                    {
+                        registry.retired[zone]->merge(*histogram);
+                        delete histogram;
+                    }
+                }
+            }
+        };
+
+        static ThreadHistograms& thread_histograms()
+        {
+            thread_local ThreadHistograms histograms;
+            return histograms;
+        }
+
+        // The trace buffers stay with the registry after their thread exits
+        static TraceBuffer& thread_trace()
+        {
+            thread_local TraceBuffer* buffer = nullptr;
+            if (!buffer)
+            {
+                TimerRegistry& registry = instance();
+                std::lock_guard<std::mutex> lock(registry.registry_mutex);
+                registry.trace_buffers.push_back(std::make_unique<TraceBuffer>(registry.trace_buffers.size() + 1));
+                buffer = registry.trace_buffers.back().get();
+            }
+            return *buffer;
+        }
+
+        static std::string json_escape(const std::string& text)
+        {
+            std::string escaped;
+            for (const char c : text)
+            {
+                if (c == '"' || c == '\\')
+                    escaped += '\\';
+                if (static_cast<unsigned char>(c) >= 0x20)
+                    escaped += c;
+            }
+            return escaped;
+        }
+
+        TimerRegistry() = default;
+
+        std::mutex registry_mutex;
+        std::vector<std::string> zone_names;
+        std::vector<std::unique_ptr<DurationHistogram>> retired;
+        std::vector<ThreadHistograms*> threads;
+
+        // Trace events, see set_tracing
+        const std::chrono::high_resolution_clock::time_point epoch = std::chrono::high_resolution_clock::now();
+        std::atomic<bool> tracing{ false };
+        std::vector<std::unique_ptr<TraceBuffer>> trace_buffers;
+        std::string exit_trace_file;
+    };
+
+    /**
+     * @brief A named timer zone; declare it static so it is registered once
+     * (TIMEUTILS_SCOPED_TIMER does that).
+     */
+    struct TimerZone
+    {
+        const std::size_t id;
+
+        explicit TimerZone(const char* name) :
+            id(TimerRegistry::instance().register_zone(name))
+        {}
+    };
+
+    /**
+     * @brief Measures the time until the end of the scope with a Stopwatch
+     * and records it in the calling thread's histogram for the zone, and as
+     * a trace event while tracing.
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(const TimerZone& zone) :
+            zone(zone.id)
+        {}
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        ~ScopedTimer()
+        {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::high_resolution_clock::now() - stopwatch.start).count();
+            TimerRegistry::instance().record(zone, stopwatch.start, static_cast<std::uint64_t>(ns));
+        }
+
+    private:
+        const std::size_t zone;
+        Stopwatch<std::chrono::nanoseconds> stopwatch;
+    };
+
+    /**
+     * @brief Formats a duration in nanoseconds with a suitable unit, e.g. "12.3 us".
+     */
+    inline std::string format_duration(const std::uint64_t ns)
+    {
+        char text[32];
+        if (ns < 1000)
+            std::snprintf(text, sizeof(text), "%llu ns", static_cast<unsigned long long>(ns));
+        else if (ns < 1000000)
+            std::snprintf(text, sizeof(text), "%.1f us", static_cast<double>(ns) / 1e3);
+        else if (ns < 1000000000)
+            std::snprintf(text, sizeof(text), "%.1f ms", static_cast<double>(ns) / 1e6);
+        else
+            std::snprintf(text, sizeof(text), "%.2f s", static_cast<double>(ns) / 1e9);
+        return std::string(text);
+    }
+}
+
+#define TIMEUTILS_CONCAT_IMPL(a, b) a##b
+#define TIMEUTILS_CONCAT(a, b) TIMEUTILS_CONCAT_IMPL(a, b)
+
+// Time the rest of the enclosing scope under a name known at compile time,
+// e.g. TIMEUTILS_SCOPED_TIMER("solver/assemble");
+#define TIMEUTILS_SCOPED_TIMER(name) \
+    static const timeutils::TimerZone TIMEUTILS_CONCAT(timeutils_zone_, __LINE__)(name); \
+    timeutils::ScopedTimer TIMEUTILS_CONCAT(timeutils_timer_, __LINE__)(TIMEUTILS_CONCAT(timeutils_zone_, __LINE__))
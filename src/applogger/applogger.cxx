@@ -1,10 +1,14 @@
 #include "applogger/applogger.hxx"
+#include "applogger/applogger_binary_backend.hxx"
+#include "applogger/applogger_ring_buffer_backend.hxx"
+#include "time_utilities/scoped_timer.hpp"
 
 #include <boost/log/core.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/log/expressions.hpp>
 #include <boost/log/sinks/text_file_backend.hpp>
 #include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
 #include <boost/log/sources/severity_channel_logger.hpp>
 #include <boost/log/sources/record_ostream.hpp>
 #include <boost/log/utility/setup/file.hpp>
@@ -19,6 +23,9 @@
 #include <string>
 #include <map>
 #include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
 
 namespace logging = boost::log;
 namespace sinks = boost::log::sinks;
@@ -26,6 +33,83 @@ namespace expr = boost::log::expressions;
 namespace attrs = boost::log::attributes;
 namespace keywords = boost::log::keywords;
 
+namespace
+{
+    const std::pair<const char*, std::uint64_t> byteSuffixes[] = { { "k", 1ull << 10 }, { "m", 1ull << 20 }, { "g", 1ull << 30 } };
+    const std::pair<const char*, std::uint64_t> timeSuffixes[] = { { "s", 1 }, { "m", 60 }, { "h", 3600 }, { "d", 86400 } };
+
+    // Parse a number with an optional unit suffix (not case-sensitive), e.g. "16M" or "6h"
+    template<std::size_t N>
+    std::uint64_t parseWithSuffix(const std::string& value, const std::string& key, 
+        const std::pair<const char*, std::uint64_t> (&suffixes)[N]) noexcept(false)
+    {
+        std::size_t end = 0;
+        const std::uint64_t number = std::stoull(value, &end);
+
+        std::string suffix = value.substr(end);
+        suffix.erase(std::remove(suffix.begin(), suffix.end(), ' '), suffix.end());
+        std::transform(suffix.begin(), suffix.end(), suffix.begin(), 
+            [](unsigned char c){ return std::tolower(c); });
+        if (suffix.empty())
+            return number;
+
+        for (const auto& s : suffixes)
+        {
+            if (suffix.compare(s.first) == 0)
+                return number * s.second;
+        }
+        throw std::runtime_error(std::string("sinkOptionsFromString: invalid value for '") + key + std::string("'!"));
+    }
+
+    bool parseFlag(const std::string& value, const std::string& key) noexcept(false)
+    {
+        if (value == "1" || value == "true" || value == "on")
+            return true;
+        if (value == "0" || value == "false" || value == "off")
+            return false;
+        throw std::runtime_error(std::string("sinkOptionsFromString: invalid value for '") + key + std::string("'!"));
+    }
+
+    // Formatter shared by all sinks with the same format. When several of them
+    // receive the same record (in the same thread), it is formatted only once:
+    // the text of the last record is kept per thread and reused. Keeping a
+    // reference to the record makes sure a new record cannot be mistaken for it.
+    class SharedFormatter
+    {
+    public:
+        explicit SharedFormatter(const logging::formatter& formatter) :
+            formatter(std::make_shared<const logging::formatter>(formatter))
+        {}
+
+        void operator()(const logging::record_view& rec, logging::formatting_ostream& strm) const
+        {
+            // Sinks hold copies of this object; the wrapped formatter identifies them
+            thread_local LastRecord last;
+            if (last.owner != formatter.get() || !(last.rec == rec))
+            {
+                last.owner = formatter.get();
+                last.rec = rec;
+                last.text.clear();
+
+                logging::formatting_ostream textStream(last.text);
+                (*formatter)(rec, textStream);
+                textStream.flush();
+            }
+            strm.write(last.text.data(), static_cast<std::streamsize>(last.text.size()));
+        }
+
+    private:
+        struct LastRecord
+        {
+            const logging::formatter* owner = nullptr;
+            logging::record_view rec;
+            std::string text;
+        };
+
+        std::shared_ptr<const logging::formatter> formatter;
+    };
+}
+
 AppLogger::Severity AppLogger::severityFromString(const std::string& str) noexcept(false)
 {
     std::string local_str{ str };
@@ -50,6 +134,139 @@ AppLogger::Severity AppLogger::severityFromString(const std::string& str) noexce
     throw std::runtime_error(std::string(__FUNCTION__) + std::string(": severity not recognised!"));
 }
 
+AppLogger::OverflowPolicy AppLogger::overflowPolicyFromString(const std::string& str) noexcept(false)
+{
+    std::string local_str{ str };
+    std::transform(local_str.begin(), local_str.end(), local_str.begin(), 
+        [](unsigned char c){ return std::tolower(c); });
+
+    if (local_str.compare("block") == 0)
+        return OverflowPolicy::Block;
+
+    if (local_str.compare("drop_oldest") == 0)
+        return OverflowPolicy::DropOldest;
+
+    if (local_str.compare("drop_newest") == 0)
+        return OverflowPolicy::DropNewest;
+
+    throw std::runtime_error(std::string(__FUNCTION__) + std::string(": overflow policy not recognised!"));
+}
+
+AppLogger::SinkType AppLogger::sinkTypeFromString(const std::string& str) noexcept(false)
+{
+    std::string local_str{ str };
+    std::transform(local_str.begin(), local_str.end(), local_str.begin(), 
+        [](unsigned char c){ return std::tolower(c); });
+
+    if (local_str.compare("text") == 0)
+        return SinkType::TextFile;
+
+    if (local_str.compare("binary") == 0)
+        return SinkType::BinaryFile;
+
+    if (local_str.compare("ring") == 0)
+        return SinkType::RingBuffer;
+
+    throw std::runtime_error(std::string(__FUNCTION__) + std::string(": sink type not recognised!"));
+}
+
+AppLogger::SinkOptions AppLogger::sinkOptionsFromString(const std::string& str) noexcept(false)
+{
+    auto trim = [](const std::string& s) {
+        const auto first = s.find_first_not_of(" \t");
+        if (first == std::string::npos)
+            return std::string();
+        const auto last = s.find_last_not_of(" \t");
+        return s.substr(first, last - first + 1);
+    };
+
+    SinkOptions options;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ';'))
+    {
+        item = trim(item);
+        if (item.empty())
+            continue;
+
+        const auto pos = item.find('=');
+        if (pos == std::string::npos)
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": expected key=value, got '") + item + std::string("'"));
+
+        std::string key = trim(item.substr(0, pos));
+        const std::string value = trim(item.substr(pos + 1));
+        std::transform(key.begin(), key.end(), key.begin(), 
+            [](unsigned char c){ return std::tolower(c); });
+
+        if (key.compare("type") == 0)
+        {
+            options.type = sinkTypeFromString(value);
+        }
+        else if (key.compare("async") == 0)
+        {
+            options.asynchronous = parseFlag(value, key);
+        }
+        else if (key.compare("queue_size") == 0)
+        {
+            options.queueCapacity = static_cast<std::size_t>(std::stoull(value));
+        }
+        else if (key.compare("overflow") == 0)
+        {
+            options.overflowPolicy = overflowPolicyFromString(value);
+        }
+        else if (key.compare("ring_size") == 0)
+        {
+            options.ringBufferSize = parseWithSuffix(value, key, byteSuffixes);
+        }
+        else if (key.compare("rotation_size") == 0)
+        {
+            options.rotationSize = parseWithSuffix(value, key, byteSuffixes);
+        }
+        else if (key.compare("rotation_interval") == 0)
+        {
+            options.rotationInterval = std::chrono::seconds(parseWithSuffix(value, key, timeSuffixes));
+        }
+        else if (key.compare("max_files") == 0)
+        {
+            options.retention.maxFiles = static_cast<std::size_t>(std::stoull(value));
+        }
+        else if (key.compare("max_total_size") == 0)
+        {
+            options.retention.maxTotalSize = parseWithSuffix(value, key, byteSuffixes);
+        }
+        else if (key.compare("compress") == 0)
+        {
+            options.retention.compress = parseFlag(value, key);
+        }
+        else if (key.compare("rate_limit") == 0)
+        {
+            options.rateLimit.messagesPerSecond = std::stod(value);
+        }
+        else if (key.compare("burst") == 0)
+        {
+            options.rateLimit.burst = static_cast<std::size_t>(std::stoull(value));
+        }
+        else if (key.compare("sample_first") == 0)
+        {
+            options.rateLimit.sampleFirst = std::stoull(value);
+        }
+        else if (key.compare("sample_every") == 0)
+        {
+            options.rateLimit.sampleEvery = std::stoull(value);
+        }
+        else if (key.compare("dedup_window_ms") == 0)
+        {
+            options.rateLimit.dedupWindow = std::chrono::milliseconds(std::stoll(value));
+        }
+        else
+        {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": option '") + key + std::string("' not recognised!"));
+        }
+    }
+
+    return options;
+}
+
 // Singleton instance getter
 AppLogger& AppLogger::getInstance() 
 {
@@ -57,6 +274,31 @@ AppLogger& AppLogger::getInstance()
     return instance;
 }
 
+AppLogger::~AppLogger()
+{
+    stopTimerReports();
+
+    // Make sure nothing new reaches the sinks, then write out what is still queued
+    for (auto& entry : asyncChannelSinks)
+    {
+        loggingCore->remove_sink(entry.second.sink);
+        entry.second.stop();
+        entry.second.sink->flush();
+    }
+
+    for (auto& entry : channelSinks)
+    {
+        loggingCore->remove_sink(entry.second);
+        entry.second->flush();
+    }
+
+    if (consoleSink)
+    {
+        loggingCore->remove_sink(consoleSink);
+        consoleSink->flush();
+    }
+}
+
 // Initialize the AppLogger with default settings
 void AppLogger::init() 
 {
@@ -73,33 +315,17 @@ void AppLogger::addChannelSinkWithFormat(
     const AppLogger::Severity minSeverity,
     const std::string& format
 ) {
-    typedef sinks::synchronous_sink<sinks::text_file_backend> sink_t;
-    
-    auto backend = boost::make_shared<sinks::text_file_backend>(
-        keywords::file_name = filename,
-        keywords::rotation_size = 10 * 1024 * 1024,
-        keywords::time_based_rotation = sinks::file::rotation_at_time_point(0, 0, 0)
-    );
-
-    auto sink = boost::make_shared<sink_t>(backend);
-
-    // Set filter for both channel and severity
-    sink->set_filter(
-        expr::attr<std::string>("Channel") == channel &&
-        expr::attr<AppLogger::Severity>("Severity") >= minSeverity
-    );
-
-    // Parse the format string and create a formatter
-    auto formatter = logging::parse_formatter(format);
-    
-    // Set the custom formatter
-    sink->set_formatter(formatter);
+    addChannelSinkWithFormat(channel, filename, minSeverity, format, SinkOptions());
+}
 
-    // Store the sink in our map
-    channelSinks[channel] = sink;
-    
-    // Add the sink to the core
-    logging::core::get()->add_sink(sink);
+void AppLogger::addChannelSinkWithFormat(
+    const std::string& channel,
+    const std::string& filename,
+    const AppLogger::Severity minSeverity,
+    const std::string& format,
+    const SinkOptions& options
+) {
+    attachChannelSink(channel, filename, minSeverity, sharedFormatter(format), options);
 }
 
 // Add a channel-specific sink with custom filter and format
@@ -108,33 +334,217 @@ void AppLogger::addChannelSink(
     const std::string& filename,
     const AppLogger::Severity minSeverity
 ) {
-    typedef sinks::synchronous_sink<sinks::text_file_backend> sink_t;
-    
+    addChannelSink(channel, filename, minSeverity, SinkOptions());
+}
+
+void AppLogger::addChannelSink(
+    const std::string& channel,
+    const std::string& filename,
+    const AppLogger::Severity minSeverity,
+    const SinkOptions& options
+) {
+    attachChannelSink(channel, filename, minSeverity, sharedFormatter(std::string()), options);
+}
+
+logging::formatter AppLogger::sharedFormatter(const std::string& format)
+{
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    auto it = formatterCache.find(format);
+    if (it != formatterCache.end())
+        return it->second;
+
+    // An empty format stands for the default one
+    logging::formatter formatter;
+    if (format.empty())
+    {
+        formatter = 
+            expr::stream
+                << expr::format_date_time<boost::posix_time::ptime>("TimeStamp", "%Y-%m-%d %H:%M:%S.%f")
+                << " [" << expr::attr<std::string>("Channel") << "]"
+                << " [" << expr::attr<AppLogger::Severity>("Severity") << "] "
+                << expr::smessage;
+    }
+    else
+    {
+        formatter = logging::parse_formatter(format);
+    }
+
+    return formatterCache.emplace(format, logging::formatter(SharedFormatter(formatter))).first->second;
+}
+
+std::uintmax_t AppLogger::getDroppedRecordCount(const std::string& channel) const
+{
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    std::uintmax_t dropped = 0;
+    auto range = asyncChannelSinks.equal_range(channel);
+    for (auto it = range.first; it != range.second; ++it)
+        dropped += it->second.queue->droppedCount();
+    return dropped;
+}
+
+std::uintmax_t AppLogger::getSuppressedCount(const std::string& channel) const
+{
+    const ChannelEntry* entry = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(channelRegistryMutex);
+        auto it = channelIds.find(channel);
+        if (it == channelIds.end())
+            return 0;
+        entry = channelStorage[it->second].get();
+    }
+
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    std::uintmax_t suppressed = 0;
+    for (const auto& limiter : entry->limiters)
+        suppressed += limiter->suppressedCount();
+    return suppressed;
+}
+
+void AppLogger::reportTimers(const std::string& channel)
+{
+    for (const auto& summary : timeutils::TimerRegistry::instance().summaries())
+    {
+        logToChannel(channel, Severity::Info, "timer " + summary.name 
+            + ": count=" + std::to_string(summary.count)
+            + " min=" + timeutils::format_duration(summary.min)
+            + " max=" + timeutils::format_duration(summary.max)
+            + " p50=" + timeutils::format_duration(summary.p50)
+            + " p99=" + timeutils::format_duration(summary.p99)
+            + " total=" + timeutils::format_duration(summary.total));
+    }
+}
+
+void AppLogger::startTimerReports(const std::string& channel, const std::chrono::seconds interval)
+{
+    if (interval.count() <= 0)
+        throw std::runtime_error(std::string(__FUNCTION__) + ": the report interval must be positive");
+
+    stopTimerReports();
+
+    timerReportStop = false;
+    timerReportThread = std::thread([this, channel, interval]() {
+        std::unique_lock<std::mutex> lock(timerReportMutex);
+        while (!timerReportWake.wait_for(lock, interval, [this]() { return timerReportStop; }))
+        {
+            lock.unlock();
+            reportTimers(channel);
+            lock.lock();
+        }
+    });
+}
+
+void AppLogger::stopTimerReports()
+{
+    if (!timerReportThread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(timerReportMutex);
+        timerReportStop = true;
+    }
+    timerReportWake.notify_all();
+    timerReportThread.join();
+}
+
+void AppLogger::attachChannelSink(
+    const std::string& channel,
+    const std::string& filename,
+    const AppLogger::Severity minSeverity,
+    const logging::formatter& formatter,
+    const SinkOptions& options
+) {
+    ChannelEntry& entry = *channels[registerChannel(channel).id].load(std::memory_order_acquire);
+
+    // Sinks may be added from several threads (e.g. through the C interface)
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    if (options.rateLimit.enabled())
+    {
+        entry.limiters.push_back(std::make_unique<RateLimiter>(options.rateLimit));
+        entry.limiter.store(entry.limiters.back().get(), std::memory_order_release);
+    }
+
+    if (options.type == SinkType::BinaryFile)
+    {
+        auto backend = boost::make_shared<BinaryFileBackend>(filename);
+        addChannelFrontend(channel, backend, minSeverity, formatter, options);
+        entry.binarySinks.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (options.type == SinkType::RingBuffer)
+    {
+        auto backend = boost::make_shared<RingBufferBackend>(filename, options.ringBufferSize);
+        addChannelFrontend(channel, backend, minSeverity, formatter, options);
+        entry.textSinks.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Rotate at midnight unless an interval is given; the active file keeps its name.
+    // The collector (and its thread) takes care of the rotated files only when
+    // retention or compression is asked for, otherwise they are not kept
     auto backend = boost::make_shared<sinks::text_file_backend>(
         keywords::file_name = filename,
-        keywords::rotation_size = 10 * 1024 * 1024,
-        keywords::time_based_rotation = sinks::file::rotation_at_time_point(0, 0, 0)
+        keywords::rotation_size = options.rotationSize > 0 ? options.rotationSize : std::numeric_limits<std::uintmax_t>::max(),
+        keywords::enable_final_rotation = false
     );
+    if (options.rotationInterval.count() > 0)
+        backend->set_time_based_rotation(sinks::file::rotation_at_time_interval(
+            boost::posix_time::seconds(static_cast<long>(options.rotationInterval.count()))));
+    else
+        backend->set_time_based_rotation(sinks::file::rotation_at_time_point(0, 0, 0));
+    if (options.retention.enabled())
+    {
+        backend->set_file_collector(boost::make_shared<RotatedFileCollector>(filename, options.retention));
+        backend->scan_for_files();
+    }
 
-    auto sink = boost::make_shared<sink_t>(backend);
+    addChannelFrontend(channel, backend, minSeverity, formatter, options);
+    entry.textSinks.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename BackendT>
+void AppLogger::addChannelFrontend(
+    const std::string& channel,
+    const boost::shared_ptr<BackendT>& backend,
+    const AppLogger::Severity minSeverity,
+    const logging::formatter& formatter,
+    const SinkOptions& options
+) {
+    constexpr bool formatted = 
+        sinks::has_requirement<typename BackendT::frontend_requirements, sinks::formatted_records>::value;
 
     // Set filter for both channel and severity
-    sink->set_filter(
+    auto filter = 
         expr::attr<std::string>("Channel") == channel &&
-        expr::attr<AppLogger::Severity>("Severity") >= minSeverity
-    );
+        expr::attr<AppLogger::Severity>("Severity") >= minSeverity;
 
-    // Set the formatter
-    sink->set_formatter(
-        expr::stream
-            << expr::format_date_time<boost::posix_time::ptime>("TimeStamp", "%Y-%m-%d %H:%M:%S.%f")
-            << " [" << expr::attr<std::string>("Channel") << "]"
-            << " [" << expr::attr<AppLogger::Severity>("Severity") << "] "
-            << expr::smessage
-    );
+    if (options.asynchronous)
+    {
+        typedef sinks::asynchronous_sink<BackendT, AsyncRecordQueue> async_sink_t;
+
+        // The writer thread starts right away and waits for records
+        auto sink = boost::make_shared<async_sink_t>(backend);
+        sink->setLimits(options.queueCapacity, options.overflowPolicy);
+        sink->set_filter(filter);
+        if constexpr (formatted)
+            sink->set_formatter(formatter);
+        acceptSeverity(minSeverity);
+
+        asyncChannelSinks.emplace(channel, AsyncSinkEntry{ sink, sink.get(), [sink]() { sink->stopAccepting(); sink->stop(); } });
+        logging::core::get()->add_sink(sink);
+        return;
+    }
+
+    typedef sinks::synchronous_sink<BackendT> sync_sink_t;
+
+    auto sink = boost::make_shared<sync_sink_t>(backend);
+    sink->set_filter(filter);
+    if constexpr (formatted)
+        sink->set_formatter(formatter);
+    acceptSeverity(minSeverity);
 
     // Store the sink in our map
-    channelSinks[channel] = sink;
+    channelSinks.emplace(channel, sink);
     
     // Add the sink to the core
     logging::core::get()->add_sink(sink);
@@ -164,22 +574,58 @@ void AppLogger::initConsoleSink()
     sink->set_filter(
         expr::attr<AppLogger::Severity>("Severity") >= AppLogger::Severity::Info
     );
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    acceptSeverity(AppLogger::Severity::Info);
+    consoleSeverity.store(static_cast<int>(AppLogger::Severity::Info), std::memory_order_relaxed);
 
+    consoleSink = sink;
     logging::core::get()->add_sink(sink);
 }
 
-// Get or create a channel-specific logger
-logging::sources::severity_channel_logger<AppLogger::Severity, std::string>& AppLogger::getChannelLogger(
-    const std::string& channel
-) {
-    auto it = channelLoggers.find(channel);
-    if (it == channelLoggers.end()) {
-        auto logger = boost::make_shared<logging::sources::severity_channel_logger<AppLogger::Severity, std::string>>(
-            keywords::channel = channel
-        );
-        channelLoggers[channel] = logger;
-        return *logger;
-    }
-    return *(it->second);
+void AppLogger::acceptSeverity(const AppLogger::Severity severity)
+{
+    lowestSinkSeverity = std::min(lowestSinkSeverity, static_cast<int>(severity));
+    severityThreshold.store(lowestSinkSeverity, std::memory_order_relaxed);
+}
+
+AppLogger::ChannelHandle AppLogger::registerChannel(const std::string& channel) noexcept(false)
+{
+    const ChannelHandle handle = findOrRegisterChannel(channel);
+    if (!isRegistered(handle))
+        throw std::runtime_error(std::string(__FUNCTION__) + std::string(": too many channels registered!"));
+    return handle;
+}
+
+AppLogger::ChannelHandle AppLogger::findOrRegisterChannel(const std::string& channel)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(channelRegistryMutex);
+        auto it = channelIds.find(channel);
+        if (it != channelIds.end())
+            return ChannelHandle{ it->second };
+        if (channelStorage.size() >= maxChannels)
+            return ChannelHandle{ static_cast<std::uint32_t>(maxChannels) };
+    }
+
+    std::unique_lock<std::shared_mutex> lock(channelRegistryMutex);
+    auto it = channelIds.find(channel);
+    if (it != channelIds.end())
+        return ChannelHandle{ it->second };
+
+    if (channelStorage.size() >= maxChannels)
+        return ChannelHandle{ static_cast<std::uint32_t>(maxChannels) };
+
+    const auto id = static_cast<std::uint32_t>(channelStorage.size());
+    channelStorage.push_back(std::make_unique<ChannelEntry>(channel));
+    channelIds.emplace(channel, id);
+    
+    // Publish the entry last, so that a handle never refers to an empty slot
+    channels[id].store(channelStorage.back().get(), std::memory_order_release);
+    return ChannelHandle{ id };
+}
+
+const std::string& AppLogger::channelName(const ChannelHandle handle) const
+{
+    return channels[handle.id].load(std::memory_order_acquire)->name;
 }
 
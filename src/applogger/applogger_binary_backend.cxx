@@ -0,0 +1,146 @@
+#include "applogger/applogger_binary_backend.hxx"
+#include "applogger/applogger.hxx"
+
+#include <boost/log/attributes/value_extraction.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    std::mutex formatRegistryMutex;
+    std::deque<std::string> formatStrings{ std::string("{}") };
+    std::unordered_map<std::string, std::uint32_t> formatIds{ { std::string("{}"), logbinary::plainMessageFormat } };
+}
+
+std::uint32_t logbinary::register_format(const char* fmt, const char** registered)
+{
+    std::lock_guard<std::mutex> lock(formatRegistryMutex);
+    auto it = formatIds.find(fmt);
+    if (it == formatIds.end())
+    {
+        formatStrings.emplace_back(fmt);
+        it = formatIds.emplace(formatStrings.back(), static_cast<std::uint32_t>(formatStrings.size() - 1)).first;
+    }
+
+    // Elements of a deque do not move when it grows
+    *registered = formatStrings[it->second].c_str();
+    return it->second;
+}
+
+std::string logbinary::format_string(const std::uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(formatRegistryMutex);
+    if (id < formatStrings.size())
+        return formatStrings[id];
+    return std::string();
+}
+
+BinaryFileBackend::BinaryFileBackend(const std::string& filename) noexcept(false) :
+    file(filename, std::ios::binary | std::ios::trunc)
+{
+    if (!file)
+        throw std::runtime_error(std::string(__FUNCTION__) + std::string(": cannot open '") + filename + std::string("'"));
+
+    entry.reserve(256);
+    entry.append(logbinary::fileMagic, sizeof(logbinary::fileMagic));
+    logbinary::put(entry, logbinary::fileVersion);
+    logbinary::put(entry, static_cast<std::uint32_t>(0));
+    file.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+}
+
+void BinaryFileBackend::consume(const logging::record_view& rec)
+{
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+    std::int64_t timestamp = 0;
+    if (auto ts = logging::extract<boost::posix_time::ptime>("TimeStamp", rec))
+        timestamp = (*ts - epoch).total_microseconds();
+
+    std::uint8_t severity = 0;
+    if (auto sev = logging::extract<AppLogger::Severity>("Severity", rec))
+        severity = static_cast<std::uint8_t>(*sev);
+
+    std::uint32_t channel = 0;
+    if (auto ch = logging::extract<std::string>("Channel", rec))
+        channel = channelId(*ch);
+    else
+        channel = channelId(std::string());
+
+    auto payload = logging::extract<logbinary::Payload>("BinaryPayload", rec);
+    const std::uint32_t formatId = payload ? payload->formatId : logbinary::plainMessageFormat;
+    defineFormat(formatId);
+
+    // Record header, with the length of the arguments filled in once they are packed
+    entry.clear();
+    logbinary::put(entry, logbinary::recordTag);
+    logbinary::put(entry, timestamp);
+    logbinary::put(entry, severity);
+    logbinary::put(entry, channel);
+    logbinary::put(entry, formatId);
+    const std::size_t lengthOffset = entry.size();
+    logbinary::put(entry, static_cast<std::uint32_t>(0));
+
+    if (payload)
+    {
+        entry.append(payload->args);
+    }
+    else
+    {
+        auto message = logging::extract<std::string>("Message", rec);
+        if (message)
+            logbinary::pack_arg(entry, *message);
+        else
+            logbinary::pack_arg(entry, std::string_view());
+    }
+
+    const auto argsLength = static_cast<std::uint32_t>(entry.size() - lengthOffset - sizeof(std::uint32_t));
+    std::memcpy(&entry[lengthOffset], &argsLength, sizeof(argsLength));
+
+    file.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+}
+
+void BinaryFileBackend::flush()
+{
+    file.flush();
+}
+
+std::uint32_t BinaryFileBackend::channelId(const std::string& channel)
+{
+    auto it = channelIds.find(channel);
+    if (it != channelIds.end())
+        return it->second;
+
+    const auto id = static_cast<std::uint32_t>(channelIds.size());
+    channelIds.emplace(channel, id);
+
+    std::string definition;
+    logbinary::put(definition, logbinary::channelTag);
+    logbinary::put(definition, id);
+    logbinary::put(definition, static_cast<std::uint32_t>(channel.size()));
+    definition.append(channel);
+    file.write(definition.data(), static_cast<std::streamsize>(definition.size()));
+    return id;
+}
+
+void BinaryFileBackend::defineFormat(const std::uint32_t formatId)
+{
+    if (formatId < formatDefined.size() && formatDefined[formatId])
+        return;
+
+    if (formatId >= formatDefined.size())
+        formatDefined.resize(formatId + 1, false);
+    formatDefined[formatId] = true;
+
+    const std::string format = logbinary::format_string(formatId);
+    std::string definition;
+    logbinary::put(definition, logbinary::formatTag);
+    logbinary::put(definition, formatId);
+    logbinary::put(definition, static_cast<std::uint32_t>(format.size()));
+    definition.append(format);
+    file.write(definition.data(), static_cast<std::streamsize>(definition.size()));
+}
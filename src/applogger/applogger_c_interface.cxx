@@ -1,19 +1,53 @@
 #include "applogger_c_interface.hxx"
 #include "applogger.hxx"
+#include "applogger_message_queue.hxx"
 
 #include "build_utilities/build_version_utils.hpp"
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
 #include <set>
 
+// The logging functions may be called concurrently (e.g. from OpenMP threads);
+// only initialise_applogger and destroy_applogger must not overlap with other calls.
 namespace applogger
 {
+   typedef std::set<std::string> channel_set;
+
    std::unique_ptr<AppLogger> applogger;
-   std::vector<std::string> messages;
-   std::set<std::string> channels;
+   MessageQueue messages;
+
+   // Channels with a sink. Readers take a snapshot; writers replace the whole 
+   // set under channels_mutex, so a snapshot never changes while it is in use.
+   std::shared_ptr<const channel_set> channels = std::make_shared<const channel_set>();
+   std::mutex channels_mutex;
+
+   std::shared_ptr<const channel_set> get_channels()
+   {
+      return std::atomic_load(&channels);
+   }
+
+   void add_channel(const std::string& channel)
+   {
+      std::lock_guard<std::mutex> lock(channels_mutex);
+      auto current = std::atomic_load(&channels);
+      if (current->count(channel))
+         return;
+
+      auto updated = std::make_shared<channel_set>(*current);
+      updated->insert(channel);
+      std::atomic_store(&channels, std::shared_ptr<const channel_set>(std::move(updated)));
+   }
+
+   void clear_channels()
+   {
+      std::lock_guard<std::mutex> lock(channels_mutex);
+      std::atomic_store(&channels, std::make_shared<const channel_set>());
+   }
 }
 
 void log_message_to_channel(const AppLogger::Severity& severityVal, const std::string& channel, const std::string& message)
@@ -41,6 +75,26 @@ void log_message_to_channel(const AppLogger::Severity& severityVal, const std::s
    }
 }
 
+// Map an APPLOGGER_SEVERITY_* code to a severity; returns false (and Info) for invalid codes
+bool severity_from_code(const int code, AppLogger::Severity& severityVal)
+{
+   if (code < APPLOGGER_SEVERITY_DEBUG || code > APPLOGGER_SEVERITY_CRITICAL)
+   {
+      severityVal = AppLogger::Severity::Info;
+      return false;
+   }
+   severityVal = static_cast<AppLogger::Severity>(code);
+   return true;
+}
+
+// View of a message from C; a negative length means null-terminated
+std::string_view message_view(const char* message, const int length)
+{
+   if (!message)
+      return std::string_view();
+   return length < 0 ? std::string_view(message) : std::string_view(message, static_cast<size_t>(length));
+}
+
 #if __cplusplus
 extern "C" {
 #endif
@@ -50,34 +104,17 @@ extern "C" {
    {
       try
       {
-         size_t msize = 0;
-         for (const auto& m : applogger::messages)
-            msize += (m.length() + 1);
-         
          if (buffer)
          {
-            char* local_buffer = new char[msize];
-            if (local_buffer == nullptr)
-            {
-               *err = APPLOGGER_EXIT_ERROR;
-               return;
-            }
-            memset(local_buffer, 0, msize * sizeof(char));
-
-            std::string temp;
-            for (const auto& m : applogger::messages)
-               temp += m + std::string("\n");
-
-            strcpy(local_buffer, temp.c_str());
+            // Messages that do not fit stay queued for the next call
+            const std::string all_messages = applogger::messages.take(static_cast<size_t>(*nchars), "\n");
 
             memset(buffer, 0, *nchars * sizeof(char));
-            strncpy(buffer, local_buffer, *nchars - 1);
-            delete[] local_buffer;
-            applogger::messages.clear();
+            strncpy(buffer, all_messages.c_str(), *nchars - 1);
          }
          else 
          {  
-            *nchars = static_cast<int>(msize);
+            *nchars = static_cast<int>(applogger::messages.size(1));
          }
       }
       catch(const std::exception& e)
@@ -144,7 +181,7 @@ extern "C" {
       }
       catch(const std::exception& e)
       {
-         applogger::messages.push_back(e.what());
+         applogger::messages.push(e.what());
          *err = APPLOGGER_EXIT_ERROR;
          return;
       }
@@ -155,6 +192,13 @@ extern "C" {
    //====================================================================
    DllExport void add_sink_to_applogger(const char* sinkname, 
       const char* channel, const char* format, const char* minseverity, int* err)
+   {
+      add_sink_with_options_to_applogger(sinkname, channel, format, minseverity, nullptr, err);
+   }
+
+   //====================================================================
+   DllExport void add_sink_with_options_to_applogger(const char* sinkname, 
+      const char* channel, const char* format, const char* minseverity, const char* options, int* err)
    {
       try
       {
@@ -172,21 +216,34 @@ extern "C" {
          }
          catch(const std::exception& e)
          {
-            applogger::messages.push_back(e.what());
-            applogger::messages.push_back("Using default value of 'Info'");
+            applogger::messages.push(e.what());
+            applogger::messages.push("Using default value of 'Info'");
+            *err = APPLOGGER_EXIT_WITH_MESSAGES;
+         }
+
+         AppLogger::SinkOptions sinkOptions;
+         try
+         {
+            if (options)
+               sinkOptions = AppLogger::sinkOptionsFromString(std::string(options));
+         }
+         catch(const std::exception& e)
+         {
+            applogger::messages.push(e.what());
+            applogger::messages.push("Using default sink options");
             *err = APPLOGGER_EXIT_WITH_MESSAGES;
          }
          
          if (format)
-            applogger::applogger->addChannelSinkWithFormat(std::string(channel), std::string(sinkname), severity, std::string(format));
+            applogger::applogger->addChannelSinkWithFormat(std::string(channel), std::string(sinkname), severity, std::string(format), sinkOptions);
          else 
-            applogger::applogger->addChannelSink(std::string(channel), std::string(sinkname), severity);
+            applogger::applogger->addChannelSink(std::string(channel), std::string(sinkname), severity, sinkOptions);
 
-         applogger::channels.emplace(channel);
+         applogger::add_channel(std::string(channel));
       }
       catch(const std::exception& e)
       {
-         applogger::messages.push_back(e.what());
+         applogger::messages.push(e.what());
          *err = APPLOGGER_EXIT_ERROR;
          return;
       }
@@ -211,32 +268,210 @@ extern "C" {
          }
          catch(const std::exception& e)
          {
-            applogger::messages.push_back(e.what());
-            applogger::messages.push_back("Using default value of 'Info'");
+            applogger::messages.push(e.what());
+            applogger::messages.push("Using default value of 'Info'");
             *err = APPLOGGER_EXIT_WITH_MESSAGES;
          }
 
+         const auto channels = applogger::get_channels();
+         const std::string message_str(message ? message : "");
          if (channel)
          {
-            if (applogger::channels.find(std::string(channel)) != applogger::channels.end())
-               log_message_to_channel(severityVal, std::string(channel), std::string(message));
+            if (channels->find(std::string(channel)) != channels->end())
+               log_message_to_channel(severityVal, std::string(channel), message_str);
             else 
             {
                *err = APPLOGGER_EXIT_WITH_MESSAGES;
-               applogger::messages.push_back("channel not regognised, logging to all available channels");
-               for (auto& c : applogger::channels)
-                  log_message_to_channel(severityVal, c, std::string(message));
+               applogger::messages.push("channel not regognised, logging to all available channels");
+               for (auto& c : *channels)
+                  log_message_to_channel(severityVal, c, message_str);
             }
          }
          else
          {
-            for (auto& c : applogger::channels)
-               log_message_to_channel(severityVal, c, std::string(message));
+            for (auto& c : *channels)
+               log_message_to_channel(severityVal, c, message_str);
+         }
+      }
+      catch(const std::exception& e)
+      {
+         applogger::messages.push(e.what());
+         *err = APPLOGGER_EXIT_ERROR;
+         return;
+      }
+   }
+
+   //====================================================================
+   DllExport void get_applogger_channel_id(const char* channel, int* id, int* err)
+   {
+      try
+      {
+         *err = APPLOGGER_EXIT_SUCCESS;
+         if (!applogger::applogger)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": logger is not initialised yet!"));
+         }
+         if (!channel)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": no channel name given!"));
+         }
+
+         *id = static_cast<int>(applogger::applogger->registerChannel(std::string(channel)).id);
+      }
+      catch(const std::exception& e)
+      {
+         applogger::messages.push(e.what());
+         *err = APPLOGGER_EXIT_ERROR;
+         return;
+      }
+   }
+
+   //====================================================================
+   DllExport void get_applogger_suppressed_count(const char* channel, long long* count, int* err)
+   {
+      try
+      {
+         *err = APPLOGGER_EXIT_SUCCESS;
+         if (!applogger::applogger)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": logger is not initialised yet!"));
+         }
+         if (!channel)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": no channel name given!"));
          }
+
+         *count = static_cast<long long>(applogger::applogger->getSuppressedCount(std::string(channel)));
+      }
+      catch(const std::exception& e)
+      {
+         applogger::messages.push(e.what());
+         *err = APPLOGGER_EXIT_ERROR;
+         return;
+      }
+   }
+
+   //====================================================================
+   DllExport void send_message_with_id_to_applogger(int channel_id, int severity, const char* message, int length, int* err)
+   {
+      send_messages_to_applogger(1, &channel_id, &severity, &message, &length, err);
+   }
+
+   //====================================================================
+   DllExport void send_messages_to_applogger(int count, const int* channel_ids, const int* severities, 
+      const char* const* messages, const int* lengths, int* err)
+   {
+      try
+      {
+         *err = APPLOGGER_EXIT_SUCCESS;
+         if (!applogger::applogger)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": logger is not initialised yet!"));
+         }
+         if (count <= 0)
+            return;
+         if (!channel_ids || !severities || !messages)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": channel ids, severities and messages are required!"));
+         }
+
+         AppLogger& logger = *applogger::applogger;
+         int unknown_channels = 0;
+         int invalid_severities = 0;
+         for (int i = 0; i < count; ++i)
+         {
+            const AppLogger::ChannelHandle handle{ static_cast<std::uint32_t>(channel_ids[i]) };
+            if (channel_ids[i] < 0 || !logger.isRegistered(handle))
+            {
+               ++unknown_channels;
+               continue;
+            }
+
+            AppLogger::Severity severityVal;
+            if (!severity_from_code(severities[i], severityVal))
+               ++invalid_severities;
+
+            // Rejected messages are skipped before their length is even measured
+            if (!logger.isEnabled(severityVal))
+               continue;
+
+            logger.logToChannel(handle, severityVal, message_view(messages[i], lengths ? lengths[i] : -1));
+         }
+
+         if (unknown_channels > 0)
+         {
+            applogger::messages.push(std::to_string(unknown_channels) + " message(s) with an unknown channel id were not logged");
+            *err = APPLOGGER_EXIT_WITH_MESSAGES;
+         }
+         if (invalid_severities > 0)
+         {
+            applogger::messages.push(std::to_string(invalid_severities) + " message(s) with an invalid severity were logged as 'Info'");
+            *err = APPLOGGER_EXIT_WITH_MESSAGES;
+         }
+      }
+      catch(const std::exception& e)
+      {
+         applogger::messages.push(e.what());
+         *err = APPLOGGER_EXIT_ERROR;
+         return;
+      }
+   }
+
+   //====================================================================
+   DllExport void report_applogger_timers(const char* channel, int* err)
+   {
+      try
+      {
+         *err = APPLOGGER_EXIT_SUCCESS;
+         if (!applogger::applogger)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": logger is not initialised yet!"));
+         }
+         if (!channel)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": no channel name given!"));
+         }
+
+         applogger::applogger->reportTimers(std::string(channel));
+      }
+      catch(const std::exception& e)
+      {
+         applogger::messages.push(e.what());
+         *err = APPLOGGER_EXIT_ERROR;
+         return;
+      }
+   }
+
+   //====================================================================
+   DllExport void start_applogger_timer_reports(const char* channel, int interval_seconds, int* err)
+   {
+      try
+      {
+         *err = APPLOGGER_EXIT_SUCCESS;
+         if (!applogger::applogger)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": logger is not initialised yet!"));
+         }
+         if (interval_seconds < 0)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": the report interval cannot be negative!"));
+         }
+
+         if (interval_seconds == 0)
+         {
+            applogger::applogger->stopTimerReports();
+            return;
+         }
+         if (!channel)
+         {
+            throw std::runtime_error(std::string(__FUNCTION__) + std::string(": no channel name given!"));
+         }
+
+         applogger::applogger->startTimerReports(std::string(channel), std::chrono::seconds(interval_seconds));
       }
       catch(const std::exception& e)
       {
-         applogger::messages.push_back(e.what());
+         applogger::messages.push(e.what());
          *err = APPLOGGER_EXIT_ERROR;
          return;
       }
@@ -247,9 +482,10 @@ extern "C" {
    {
       *err = APPLOGGER_EXIT_SUCCESS;
       applogger::messages.clear();
-      applogger::channels.clear();
-      // applogger::applogger should be destroyed since it's 
-      // a unique_ptr...
+      applogger::clear_channels();
+      // Destroying the logger writes out anything still queued 
+      // in asynchronous sinks and closes the log files
+      applogger::applogger.reset();
    }
 
 #if __cplusplus
@@ -0,0 +1,289 @@
+#include "applogger/applogger_file_collector.hxx"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#ifdef APPLOGGER_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+    // Whether a file stem matches the stem of the file name pattern of the sink; a
+    // placeholder (%Y, %m, %5N...) matches any run of characters other than dots
+    bool matchesStemPattern(const char* pattern, const char* name)
+    {
+        for (; *pattern; ++pattern, ++name)
+        {
+            if (pattern[0] == '%' && pattern[1] != '%' && pattern[1] != '\0')
+            {
+                ++pattern;
+                while (std::isdigit(static_cast<unsigned char>(*pattern)))
+                    ++pattern;
+                const char* rest = *pattern ? pattern + 1 : pattern;
+                for (; *name && *name != '.'; )
+                {
+                    if (matchesStemPattern(rest, ++name))
+                        return true;
+                }
+                return false;
+            }
+            if (pattern[0] == '%' && pattern[1] == '%')
+                ++pattern;
+            if (*pattern != *name)
+                return false;
+        }
+        return *name == '\0';
+    }
+}
+
+bool rotatedFileCompressionAvailable()
+{
+#ifdef APPLOGGER_HAS_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+RotatedFileCollector::RotatedFileCollector(const fs::path& activeFile, const RetentionOptions& options) noexcept(false) :
+    directory(activeFile.has_parent_path() ? activeFile.parent_path() : fs::path(".")),
+    stem(activeFile.stem().string()),
+    extension(activeFile.extension().string()),
+    options(options)
+{
+    if (options.compress && !rotatedFileCompressionAvailable())
+        throw std::runtime_error(std::string(__FUNCTION__) + std::string(": compression of rotated files is not available in this build!"));
+
+    // Files rotated by earlier runs count towards the retention limits
+    foundAtStart = scanDirectory();
+
+    worker = std::thread(&RotatedFileCollector::run, this);
+}
+
+RotatedFileCollector::~RotatedFileCollector()
+{
+    {
+        std::lock_guard<std::mutex> lock(collectorMutex);
+        stopping = true;
+        workAvailable.notify_one();
+    }
+    worker.join();
+}
+
+void RotatedFileCollector::store_file(const fs::path& srcPath)
+{
+    // Move the file out of the way with a timestamp; the sink reopens the active name.
+    // The name comes from the file itself, since the sink may expand a pattern
+    const std::string timestamp = boost::posix_time::to_iso_string(boost::posix_time::second_clock::local_time());
+    const std::string srcStem = srcPath.stem().string();
+    const std::string srcExtension = srcPath.extension().string();
+    fs::path target = directory / (srcStem + "." + timestamp + srcExtension);
+    for (int n = 1; fs::exists(target) || fs::exists(target.string() + ".gz"); ++n)
+        target = directory / (srcStem + "." + timestamp + "-" + std::to_string(n) + srcExtension);
+
+    boost::system::error_code ec;
+    fs::rename(srcPath, target, ec);
+    if (ec)
+    {
+        std::cerr << __FUNCTION__ << ": cannot rename '" << srcPath.string() << "': " << ec.message() << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(collectorMutex);
+    pending.push_back(target);
+    workAvailable.notify_one();
+}
+
+#if BOOST_VERSION >= 107700
+bool RotatedFileCollector::is_in_storage(const fs::path& srcPath) const
+{
+    return isRotatedFile(srcPath);
+}
+
+sinks::file::scan_result RotatedFileCollector::scan_for_files(sinks::file::scan_method, const fs::path&)
+{
+    sinks::file::scan_result result;
+    result.found_count = foundAtStart;
+    return result;
+}
+#else
+uintmax_t RotatedFileCollector::scan_for_files(sinks::file::scan_method, const fs::path&, unsigned int*)
+{
+    return foundAtStart;
+}
+#endif
+
+void RotatedFileCollector::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(collectorMutex);
+    idle.wait(lock, [this]() { return pending.empty() && !busy; });
+}
+
+bool RotatedFileCollector::isRotatedFile(const fs::path& path) const
+{
+    boost::system::error_code ec;
+    if (path.has_parent_path() && !fs::equivalent(path.parent_path(), directory, ec))
+        return false;
+
+    // stem.YYYYMMDDTHHMMSS[-N]extension[.gz], where the stem may be an expanded pattern
+    std::string name = path.filename().string();
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0)
+        name.resize(name.size() - 3);
+    if (name.size() < extension.size() || name.compare(name.size() - extension.size(), extension.size(), extension) != 0)
+        return false;
+    name.resize(name.size() - extension.size());
+
+    // The timestamp follows the last dot, then the stem must match
+    const std::size_t timestampLength = 15;
+    const std::size_t dot = name.rfind('.');
+    if (dot == std::string::npos || name.size() < dot + 1 + timestampLength)
+        return false;
+
+    const std::string middle = name.substr(dot + 1);
+    for (std::size_t i = 0; i < timestampLength; ++i)
+    {
+        if (i == 8 ? middle[i] != 'T' : !std::isdigit(static_cast<unsigned char>(middle[i])))
+            return false;
+    }
+    if (middle.size() > timestampLength)
+    {
+        if (middle[timestampLength] != '-' || middle.size() == timestampLength + 1)
+            return false;
+        for (std::size_t i = timestampLength + 1; i < middle.size(); ++i)
+        {
+            if (!std::isdigit(static_cast<unsigned char>(middle[i])))
+                return false;
+        }
+    }
+    return matchesStemPattern(stem.c_str(), name.substr(0, dot).c_str());
+}
+
+std::size_t RotatedFileCollector::scanDirectory()
+{
+    boost::system::error_code ec;
+    if (!fs::is_directory(directory, ec))
+        return 0;
+
+    std::vector<std::pair<std::time_t, StoredFile>> found;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+    {
+        // A file may be removed while we look at it; skip it rather than throw
+        boost::system::error_code fileError;
+        if (!fs::is_regular_file(it->status(fileError)) || !isRotatedFile(it->path()))
+            continue;
+        const std::time_t lastWrite = fs::last_write_time(it->path(), fileError);
+        if (fileError)
+            continue;
+        const std::uintmax_t size = fs::file_size(it->path(), fileError);
+        if (fileError)
+            continue;
+        found.emplace_back(lastWrite, StoredFile{ it->path(), size });
+    }
+
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first || (a.first == b.first && a.second.path < b.second.path);
+    });
+    for (auto& f : found)
+        stored.push_back(f.second);
+    return found.size();
+}
+
+void RotatedFileCollector::run()
+{
+    std::unique_lock<std::mutex> lock(collectorMutex);
+    while (true)
+    {
+        workAvailable.wait(lock, [this]() { return stopping || !pending.empty(); });
+        if (pending.empty())
+            break;
+
+        StoredFile file{ pending.front(), 0 };
+        pending.pop_front();
+        busy = true;
+
+        // Compression may take a while; writers can keep rotating meanwhile
+        lock.unlock();
+        boost::system::error_code ec;
+        file.size = fs::file_size(file.path, ec);
+        if (options.compress)
+            compress(file);
+        stored.push_back(file);
+        applyRetention();
+        lock.lock();
+
+        busy = false;
+        if (pending.empty())
+            idle.notify_all();
+    }
+}
+
+void RotatedFileCollector::compress(StoredFile& file)
+{
+#ifdef APPLOGGER_HAS_ZLIB
+    const fs::path compressed = file.path.string() + ".gz";
+
+    std::ifstream in(file.path.string(), std::ios::binary);
+    gzFile out = gzopen(compressed.string().c_str(), "wb6");
+    if (!in || !out)
+    {
+        if (out)
+            gzclose(out);
+        std::cerr << __FUNCTION__ << ": cannot compress '" << file.path.string() << "'" << std::endl;
+        return;
+    }
+
+    std::vector<char> buffer(1 << 16);
+    bool ok = true;
+    while (ok && in)
+    {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        const std::streamsize n = in.gcount();
+        if (n > 0)
+            ok = gzwrite(out, buffer.data(), static_cast<unsigned>(n)) == static_cast<int>(n);
+    }
+    ok = gzclose(out) == Z_OK && ok;
+    in.close();
+
+    boost::system::error_code ec;
+    if (!ok)
+    {
+        // Keep the uncompressed file rather than a broken archive
+        fs::remove(compressed, ec);
+        std::cerr << __FUNCTION__ << ": cannot compress '" << file.path.string() << "'" << std::endl;
+        return;
+    }
+
+    fs::remove(file.path, ec);
+    file.path = compressed;
+    file.size = fs::file_size(compressed, ec);
+#else
+    (void)file;
+#endif
+}
+
+void RotatedFileCollector::applyRetention()
+{
+    std::uintmax_t totalSize = 0;
+    for (const auto& f : stored)
+        totalSize += f.size;
+
+    while (!stored.empty() &&
+        ((options.maxFiles > 0 && stored.size() > options.maxFiles) ||
+         (options.maxTotalSize > 0 && totalSize > options.maxTotalSize)))
+    {
+        boost::system::error_code ec;
+        fs::remove(stored.front().path, ec);
+        totalSize -= stored.front().size;
+        stored.pop_front();
+    }
+}
@@ -0,0 +1,81 @@
+#include "applogger/applogger_ring_buffer_backend.hxx"
+
+#include <boost/interprocess/exceptions.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace bip = boost::interprocess;
+
+RingBufferBackend::RingBufferBackend(const std::string& filename, const std::uint64_t capacity) noexcept(false) :
+    capacity(capacity > 0 ? capacity : logring::defaultCapacity)
+{
+    try
+    {
+        // Create the file at its full size, then map all of it
+        {
+            std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+            if (!file)
+                throw std::runtime_error(std::string(__FUNCTION__) + std::string(": cannot open '") + filename + std::string("'"));
+        }
+        std::filesystem::resize_file(filename, sizeof(logring::FileHeader) + this->capacity);
+
+        mapping = bip::file_mapping(filename.c_str(), bip::read_write);
+        region = bip::mapped_region(mapping, bip::read_write);
+    }
+    catch (const bip::interprocess_exception& e)
+    {
+        throw std::runtime_error(std::string(__FUNCTION__) + std::string(": cannot map '") + filename + std::string("': ") + e.what());
+    }
+    catch (const std::filesystem::filesystem_error& e)
+    {
+        throw std::runtime_error(std::string(__FUNCTION__) + std::string(": cannot resize '") + filename + std::string("': ") + e.what());
+    }
+
+    char* base = static_cast<char*>(region.get_address());
+    header = reinterpret_cast<logring::FileHeader*>(base);
+    data = base + sizeof(logring::FileHeader);
+
+    std::memcpy(header->magic, logring::fileMagic, sizeof(logring::fileMagic));
+    header->version = logring::fileVersion;
+    header->headerSize = static_cast<std::uint32_t>(sizeof(logring::FileHeader));
+    header->capacity = this->capacity;
+    header->written = 0;
+}
+
+void RingBufferBackend::consume(const logging::record_view&, const string_type& formattedMessage)
+{
+    write(formattedMessage.data(), formattedMessage.size());
+    write("\n", 1);
+
+    // Publish the new position only once the record is in place
+    std::atomic_thread_fence(std::memory_order_release);
+    header->written = written;
+}
+
+void RingBufferBackend::flush()
+{
+    region.flush(0, 0, true);
+}
+
+void RingBufferBackend::write(const char* bytes, std::size_t length)
+{
+    // Only the tail of a record longer than the whole buffer can be kept
+    if (length > capacity)
+    {
+        written += length - capacity;
+        bytes += length - capacity;
+        length = static_cast<std::size_t>(capacity);
+    }
+
+    const std::uint64_t offset = written % capacity;
+    const std::size_t first = static_cast<std::size_t>(std::min<std::uint64_t>(length, capacity - offset));
+    std::memcpy(data + offset, bytes, first);
+    std::memcpy(data, bytes + first, length - first);
+    written += length;
+}
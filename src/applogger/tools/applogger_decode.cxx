@@ -0,0 +1,233 @@
+#include "applogger/applogger_binary.hxx"
+#include "applogger/applogger_format.hxx"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Turns a binary channel log (see applogger_binary.hxx) back into the
+// text format of the default channel sinks:
+//    2024-01-31 12:00:00.000000 [channel] [Severity] message
+//
+// Usage: app-logger-decode <binary log> [text output]
+
+namespace
+{
+    const char* const severity_names[] = { "Debug", "Info", "Warning", "Error", "Critical" };
+
+    template <typename T>
+    bool read_value(std::istream& in, T& value)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    bool read_string(std::istream& in, std::string& value)
+    {
+        std::uint32_t length = 0;
+        if (!read_value(in, length))
+            return false;
+        value.resize(length);
+        return length == 0 || static_cast<bool>(in.read(&value[0], length));
+    }
+
+    void append_timestamp(std::string& line, const std::int64_t microseconds)
+    {
+        std::int64_t seconds = microseconds / 1000000;
+        std::int64_t fraction = microseconds % 1000000;
+        if (fraction < 0)
+        {
+            fraction += 1000000;
+            --seconds;
+        }
+
+        // The timestamp already is in the writer's local time, so no conversion here
+        std::time_t t = static_cast<std::time_t>(seconds);
+        char text[64];
+        std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", std::gmtime(&t));
+        line.append(text);
+
+        std::snprintf(text, sizeof(text), ".%06lld", static_cast<long long>(fraction));
+        line.append(text);
+    }
+
+    // Append the next packed argument; returns false if the arguments are malformed
+    bool append_argument(std::string& line, const char*& pos, const char* end)
+    {
+        std::uint8_t type = 0;
+        if (!logbinary::get(pos, end, type))
+            return false;
+
+        switch (type)
+        {
+        case logbinary::signedArg:
+        {
+            std::int64_t value = 0;
+            if (!logbinary::get(pos, end, value))
+                return false;
+            logformat::append(line, value);
+            return true;
+        }
+        case logbinary::unsignedArg:
+        {
+            std::uint64_t value = 0;
+            if (!logbinary::get(pos, end, value))
+                return false;
+            logformat::append(line, value);
+            return true;
+        }
+        case logbinary::floatArg:
+        {
+            double value = 0.;
+            if (!logbinary::get(pos, end, value))
+                return false;
+            logformat::append(line, value);
+            return true;
+        }
+        case logbinary::boolArg:
+        {
+            std::uint8_t value = 0;
+            if (!logbinary::get(pos, end, value))
+                return false;
+            logformat::append(line, value != 0);
+            return true;
+        }
+        case logbinary::charArg:
+        {
+            std::uint8_t value = 0;
+            if (!logbinary::get(pos, end, value))
+                return false;
+            logformat::append(line, static_cast<char>(value));
+            return true;
+        }
+        case logbinary::stringArg:
+        {
+            std::uint32_t length = 0;
+            if (!logbinary::get(pos, end, length) || static_cast<std::size_t>(end - pos) < length)
+                return false;
+            line.append(pos, length);
+            pos += length;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    // Substitute the packed arguments into the format string
+    bool append_message(std::string& line, std::string_view format, const std::string& args)
+    {
+        const char* pos = args.data();
+        const char* end = args.data() + args.size();
+        while (true)
+        {
+            const std::size_t next = logformat::copy_until_placeholder(line, format);
+            if (next == std::string_view::npos)
+                return true;
+            format = format.substr(next);
+            if (pos < end && !append_argument(line, pos, end))
+                return false;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <binary log> [text output]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Error: cannot open '" << argv[1] << "'" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream file_out;
+    if (argc > 2)
+    {
+        file_out.open(argv[2]);
+        if (!file_out)
+        {
+            std::cerr << "Error: cannot open '" << argv[2] << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream& out = argc > 2 ? file_out : std::cout;
+
+    char magic[sizeof(logbinary::fileMagic)];
+    std::uint32_t version = 0, reserved = 0;
+    if (!in.read(magic, sizeof(magic)) ||
+        std::string(magic, sizeof(magic)) != std::string(logbinary::fileMagic, sizeof(logbinary::fileMagic)) ||
+        !read_value(in, version) || !read_value(in, reserved))
+    {
+        std::cerr << "Error: '" << argv[1] << "' is not a binary AppLogger log" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (version != logbinary::fileVersion)
+    {
+        std::cerr << "Error: unsupported format version " << version << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::unordered_map<std::uint32_t, std::string> channels;
+    std::unordered_map<std::uint32_t, std::string> formats;
+    std::string args, line;
+    std::size_t nrecords = 0;
+
+    std::uint8_t tag = 0;
+    while (read_value(in, tag))
+    {
+        if (tag == logbinary::channelTag || tag == logbinary::formatTag)
+        {
+            std::uint32_t id = 0;
+            std::string text;
+            if (!read_value(in, id) || !read_string(in, text))
+                break;
+            (tag == logbinary::channelTag ? channels : formats)[id] = text;
+            continue;
+        }
+
+        if (tag != logbinary::recordTag)
+        {
+            std::cerr << "Error: unexpected entry after " << nrecords << " records, stopping" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::int64_t timestamp = 0;
+        std::uint8_t severity = 0;
+        std::uint32_t channel = 0, format = 0;
+        if (!read_value(in, timestamp) || !read_value(in, severity) ||
+            !read_value(in, channel) || !read_value(in, format) || !read_string(in, args))
+            break;
+
+        line.clear();
+        append_timestamp(line, timestamp);
+        line.append(" [").append(channels[channel]).append("] [");
+        if (severity < sizeof(severity_names) / sizeof(*severity_names))
+            line.append(severity_names[severity]);
+        else
+            logformat::append(line, static_cast<int>(severity));
+        line.append("] ");
+
+        if (!append_message(line, formats.count(format) ? formats[format] : std::string("{}"), args))
+            line.append("<malformed arguments>");
+
+        out << line << '\n';
+        ++nrecords;
+    }
+
+    // A truncated last record is expected if the writer crashed
+    if (!in.eof())
+        std::cerr << "Warning: the log ends with an incomplete entry" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include "applogger/applogger_ring_buffer.hxx"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Prints the records kept in a ring buffer log (see applogger_ring_buffer.hxx),
+// oldest first. Works on the file of a running process as well as on the one
+// left behind by a process that crashed.
+//
+// Usage: app-logger-ring-dump <ring buffer log> [text output]
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <ring buffer log> [text output]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Error: cannot open '" << argv[1] << "'" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    logring::FileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, logring::fileMagic, sizeof(logring::fileMagic)) != 0)
+    {
+        std::cerr << "Error: '" << argv[1] << "' is not an AppLogger ring buffer log" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (header.version != logring::fileVersion)
+    {
+        std::cerr << "Error: unsupported format version " << header.version << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Take the position before the data, so the range it covers is complete
+    const std::uint64_t written = header.written;
+    const std::uint64_t capacity = header.capacity;
+
+    std::vector<char> data(static_cast<std::size_t>(capacity));
+    in.seekg(header.headerSize);
+    if (capacity == 0 || !in.read(data.data(), static_cast<std::streamsize>(capacity)))
+    {
+        std::cerr << "Error: '" << argv[1] << "' is truncated" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream file_out;
+    if (argc > 2)
+    {
+        file_out.open(argv[2], std::ios::binary);
+        if (!file_out)
+        {
+            std::cerr << "Error: cannot open '" << argv[2] << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream& out = argc > 2 ? file_out : std::cout;
+
+    if (written <= capacity)
+    {
+        out.write(data.data(), static_cast<std::streamsize>(written));
+        return EXIT_SUCCESS;
+    }
+
+    // The buffer has wrapped around: the oldest byte is at the write position,
+    // and the record it belongs to was partly overwritten, so skip to the next one
+    const std::size_t start = static_cast<std::size_t>(written % capacity);
+    std::string ordered;
+    ordered.reserve(data.size());
+    ordered.append(data.data() + start, data.size() - start);
+    ordered.append(data.data(), start);
+
+    const std::size_t first = ordered.find('\n');
+    if (first != std::string::npos)
+        out.write(ordered.data() + first + 1, static_cast<std::streamsize>(ordered.size() - first - 1));
+
+    return EXIT_SUCCESS;
+}
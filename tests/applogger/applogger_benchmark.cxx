@@ -0,0 +1,251 @@
+#include "applogger/applogger.hxx"
+#include "applogger/applogger_c_interface.hxx"
+
+#include <boost/version.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Throughput and per-call latency of AppLogger for 1 to N threads, for each
+// sink configuration, through the C++ interface and the C interface.
+// The results go to a CSV or JSON file (chosen by the extension) so they can
+// be compared between builds, e.g. before and after a Boost upgrade.
+// The console configuration prints every message: redirect stdout.
+//
+// Usage: app-logger-benchmark [max threads] [messages per thread] [results.csv|results.json]
+
+namespace
+{
+   typedef std::chrono::steady_clock clock_type;
+
+   const std::string message = "benchmark message #1234 with a payload of typical length (64B)";
+
+   struct Result
+   {
+      std::string api;
+      std::string sink;
+      int threads;
+      std::uint64_t messages;
+      double seconds;
+      std::uint64_t p50;
+      std::uint64_t p99;
+      std::uint64_t p999;
+      std::uint64_t max;
+   };
+
+   // How a configuration is set up and which severity its messages have
+   struct SinkConfig
+   {
+      const char* name;
+      const char* filename;
+      const char* format;       // NULL for the default format
+      const char* options;      // NULL for the default options
+      const char* minSeverity;
+      AppLogger::Severity severity;
+   };
+
+   // Messages are logged as Debug so that the console (Info and above) only
+   // prints them in the console configuration
+   const SinkConfig configs[] = {
+      { "console",       nullptr,                  nullptr, nullptr,      nullptr,   AppLogger::Severity::Info },
+      { "file",          "bench-file.log",         nullptr, nullptr,      "debug",   AppLogger::Severity::Debug },
+      { "custom_format", "bench-custom.log",       "[%TimeStamp%][%Channel%][%Severity%] %Message%", nullptr, "debug", AppLogger::Severity::Debug },
+      { "async_file",    "bench-async.log",        nullptr, "async=true", "debug",   AppLogger::Severity::Debug },
+      { "binary",        "bench-binary.bin",       nullptr, "type=binary", "debug",  AppLogger::Severity::Debug },
+      { "ring",          "bench-ring.ring",        nullptr, "type=ring",  "debug",   AppLogger::Severity::Debug },
+      { "filtered",      "bench-filtered.log",     nullptr, nullptr,      "warning", AppLogger::Severity::Debug },
+   };
+
+   const char* severity_name(const AppLogger::Severity severity)
+   {
+      return severity == AppLogger::Severity::Info ? "info" : "debug";
+   }
+
+   // Run log_one(thread, i) from each thread and collect the latency of every call
+   Result run(const std::string& api, const SinkConfig& config, const int nthreads, const int nmessages,
+      const std::function<void(int, int)>& log_one, const std::function<void()>& finish)
+   {
+      std::vector<std::vector<std::uint32_t>> latencies(static_cast<size_t>(nthreads));
+      std::vector<std::thread> workers;
+
+      const auto start = clock_type::now();
+      for (int t = 0; t < nthreads; ++t)
+      {
+         workers.emplace_back([&, t]() {
+            auto& samples = latencies[static_cast<size_t>(t)];
+            samples.reserve(static_cast<size_t>(nmessages));
+            for (int i = 0; i < nmessages; ++i)
+            {
+               const auto before = clock_type::now();
+               log_one(t, i);
+               const auto after = clock_type::now();
+               samples.push_back(static_cast<std::uint32_t>(
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count()));
+            }
+         });
+      }
+      for (auto& w : workers)
+         w.join();
+
+      // Writing out what asynchronous sinks still have queued counts towards the throughput
+      finish();
+      const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+      std::vector<std::uint32_t> all;
+      for (auto& samples : latencies)
+         all.insert(all.end(), samples.begin(), samples.end());
+      std::sort(all.begin(), all.end());
+
+      auto percentile = [&all](const double p) -> std::uint64_t {
+         if (all.empty())
+            return 0;
+         return all[std::min(all.size() - 1, static_cast<size_t>(p * static_cast<double>(all.size())))];
+      };
+
+      return Result{ api, config.name, nthreads, static_cast<std::uint64_t>(all.size()), seconds,
+         percentile(0.5), percentile(0.99), percentile(0.999), all.empty() ? 0 : all.back() };
+   }
+
+   Result run_cpp(const SinkConfig& config, const int nthreads, const int nmessages)
+   {
+      auto logger = std::make_unique<AppLogger>();
+      logger->init();
+      if (config.filename)
+      {
+         const AppLogger::Severity minSeverity = AppLogger::severityFromString(config.minSeverity);
+         const AppLogger::SinkOptions options = config.options ?
+            AppLogger::sinkOptionsFromString(config.options) : AppLogger::SinkOptions();
+         if (config.format)
+            logger->addChannelSinkWithFormat("bench", config.filename, minSeverity, config.format, options);
+         else
+            logger->addChannelSink("bench", config.filename, minSeverity, options);
+      }
+
+      const AppLogger::ChannelHandle handle = logger->registerChannel("bench");
+      return run("cpp", config, nthreads, nmessages,
+         [&](int, int) { logger->logToChannel(handle, config.severity, message); },
+         [&]() { logger.reset(); });
+   }
+
+   Result run_c(const SinkConfig& config, const int nthreads, const int nmessages, const bool by_id)
+   {
+      int err = 0;
+      initialise_applogger(&err);
+      if (config.filename)
+         add_sink_with_options_to_applogger(config.filename, "bench", config.format, config.minSeverity, config.options, &err);
+      else
+      {
+         // The console prints messages of channels with a sink only
+         add_sink_with_options_to_applogger("bench-console.log", "bench", nullptr, "critical", nullptr, &err);
+      }
+
+      int channel_id = 0;
+      get_applogger_channel_id("bench", &channel_id, &err);
+      const char* severity = severity_name(config.severity);
+      const int severity_code = static_cast<int>(config.severity);
+
+      auto finish = []() {
+         int err = 0;
+         destroy_applogger(&err);
+      };
+
+      if (by_id)
+      {
+         return run("c_id", config, nthreads, nmessages,
+            [&](int, int) {
+               int err = 0;
+               send_message_with_id_to_applogger(channel_id, severity_code, message.c_str(), static_cast<int>(message.size()), &err);
+            }, finish);
+      }
+
+      return run("c", config, nthreads, nmessages,
+         [&](int, int) {
+            int err = 0;
+            send_message_to_applogger("bench", severity, message.c_str(), &err);
+         }, finish);
+   }
+
+   void write_csv(std::ostream& out, const std::vector<Result>& results)
+   {
+      out << "boost,api,sink,threads,messages,seconds,messages_per_second,p50_ns,p99_ns,p999_ns,max_ns\n";
+      for (const auto& r : results)
+      {
+         out << BOOST_LIB_VERSION << ',' << r.api << ',' << r.sink << ',' << r.threads << ',' << r.messages << ','
+            << r.seconds << ',' << static_cast<double>(r.messages) / r.seconds << ','
+            << r.p50 << ',' << r.p99 << ',' << r.p999 << ',' << r.max << '\n';
+      }
+   }
+
+   void write_json(std::ostream& out, const std::vector<Result>& results)
+   {
+      out << "{\n  \"boost\": \"" << BOOST_LIB_VERSION << "\",\n  \"results\": [\n";
+      for (size_t i = 0; i < results.size(); ++i)
+      {
+         const auto& r = results[i];
+         out << "    { \"api\": \"" << r.api << "\", \"sink\": \"" << r.sink << "\", \"threads\": " << r.threads
+            << ", \"messages\": " << r.messages << ", \"seconds\": " << r.seconds
+            << ", \"messages_per_second\": " << static_cast<double>(r.messages) / r.seconds
+            << ", \"p50_ns\": " << r.p50 << ", \"p99_ns\": " << r.p99 << ", \"p999_ns\": " << r.p999
+            << ", \"max_ns\": " << r.max << " }" << (i + 1 < results.size() ? "," : "") << '\n';
+      }
+      out << "  ]\n}\n";
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   const int max_threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+   const int nmessages = argc > 2 ? std::atoi(argv[2]) : 20000;
+   const std::string output = argc > 3 ? argv[3] : "applogger-benchmark.csv";
+
+   // 1, 2, 4, ... up to and including max_threads
+   std::vector<int> thread_counts;
+   for (int n = 1; n < max_threads; n *= 2)
+      thread_counts.push_back(n);
+   thread_counts.push_back(max_threads);
+
+   std::vector<Result> results;
+   for (const auto& config : configs)
+   {
+      for (const int nthreads : thread_counts)
+      {
+         results.push_back(run_cpp(config, nthreads, nmessages));
+         results.push_back(run_c(config, nthreads, nmessages, false));
+         results.push_back(run_c(config, nthreads, nmessages, true));
+
+         for (size_t i = results.size() - 3; i < results.size(); ++i)
+         {
+            const auto& r = results[i];
+            std::cerr << std::left << std::setw(6) << r.api << std::setw(15) << r.sink
+               << std::right << std::setw(3) << r.threads << " threads "
+               << std::setw(12) << std::fixed << std::setprecision(0) << static_cast<double>(r.messages) / r.seconds << " msg/s"
+               << "  p50 " << std::setw(7) << r.p50 << " ns  p99 " << std::setw(7) << r.p99
+               << " ns  p999 " << std::setw(8) << r.p999 << " ns" << std::endl;
+         }
+      }
+   }
+
+   std::ofstream out(output);
+   if (!out)
+   {
+      std::cerr << "Error: cannot write '" << output << "'" << std::endl;
+      return EXIT_FAILURE;
+   }
+   if (output.size() > 5 && output.compare(output.size() - 5, 5, ".json") == 0)
+      write_json(out, results);
+   else
+      write_csv(out, results);
+
+   std::cerr << "Results written to " << output << std::endl;
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#include "applogger/applogger.hxx"
+#include "time_utilities/time_utils.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Compares building messages eagerly with std::string concatenation 
+// against AppLogger::logf, for accepted and for filtered records, and
+// the cost of messages suppressed by a channel's rate limits.
+
+constexpr int NMESSAGES = 200000;
+
+template <typename F>
+void run_case(const char* name, F&& log_one)
+{
+   timeutils::Stopwatch<std::chrono::nanoseconds> stopwatch;
+   for (int i = 0; i < NMESSAGES; ++i)
+      log_one(i);
+   double elapsed = stopwatch.elapsed();
+
+   std::cout << std::left << std::setw(34) << name 
+      << std::right << std::setw(10) << std::fixed << std::setprecision(1) << elapsed / NMESSAGES << " ns/call" << std::endl;
+}
+
+int main()
+{
+   AppLogger logger;
+   logger.init();
+   logger.addChannelSink("accepted", "logf-benchmark.log", AppLogger::Severity::Debug);
+   logger.addChannelSink("filtered", "logf-benchmark-filtered.log", AppLogger::Severity::Warning);
+   logger.addChannelSink("limited", "logf-benchmark-limited.log", AppLogger::Severity::Debug,
+      AppLogger::sinkOptionsFromString("sample_first=10; sample_every=0"));
+
+   AppLogger::ChannelHandle accepted = logger.registerChannel("accepted");
+   AppLogger::ChannelHandle filtered = logger.registerChannel("filtered");
+   AppLogger::ChannelHandle limited = logger.registerChannel("limited");
+   const double residual = 1.2345e-6;
+
+   std::cout << "Messages per case: " << NMESSAGES << std::endl;
+
+   run_case("concatenation, accepted", [&](int i) {
+      logger.debug(accepted, "iteration " + std::to_string(i) + " residual " + std::to_string(residual));
+   });
+
+   run_case("logf, accepted", [&](int i) {
+      logger.logf(accepted, AppLogger::Severity::Debug, "iteration {} residual {}", i, residual);
+   });
+
+   run_case("concatenation, filtered by sink", [&](int i) {
+      logger.debug(filtered, "iteration " + std::to_string(i) + " residual " + std::to_string(residual));
+   });
+
+   run_case("logf, filtered by sink", [&](int i) {
+      logger.logf(filtered, AppLogger::Severity::Debug, "iteration {} residual {}", i, residual);
+   });
+
+   run_case("logf, suppressed by rate limit", [&](int i) {
+      logger.logf(limited, AppLogger::Severity::Debug, "iteration {} residual {}", i, residual);
+   });
+
+   return EXIT_SUCCESS;
+}
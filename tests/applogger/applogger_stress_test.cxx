@@ -0,0 +1,116 @@
+#include "applogger/applogger_c_interface.hxx"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Calls the C interface from many threads at once: adding sinks, logging by
+// name and by id, reporting errors and draining the error messages.
+// Build the library and this test with APPLOGGER_TSAN=ON to run it under ThreadSanitizer.
+// Boost.Log should be instrumented too: otherwise the reference counting of records
+// handed to the asynchronous writer threads is reported as a race inside Boost.
+//
+// Usage: app-logger-stress-test [threads] [messages per thread]
+
+namespace
+{
+  std::atomic<int> failed_calls{ 0 };
+
+  void check(const int err)
+  {
+    if (err == APPLOGGER_EXIT_ERROR)
+      ++failed_calls;
+  }
+
+  // Returns the number of lines in the error messages taken off the queue
+  int drain_errors()
+  {
+    int err = 0;
+    int message_size = 0;
+    get_applogger_errors(nullptr, &message_size, &err);
+    if (err != APPLOGGER_EXIT_SUCCESS || message_size == 0)
+      return 0;
+
+    // Messages may arrive between the two calls; they stay queued if they do not fit
+    std::string buffer(static_cast<size_t>(message_size) + 1, '\0');
+    get_applogger_errors(&buffer[0], &message_size, &err);
+    check(err);
+
+    int lines = 0;
+    for (const char c : buffer)
+    {
+      if (c == '\0')
+        break;
+      if (c == '\n')
+        ++lines;
+    }
+    // The last separator is cut off by the buffer size
+    return buffer[0] != '\0' ? lines + 1 : 0;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  const int nthreads = argc > 1 ? std::atoi(argv[1]) : 8;
+  const int nmessages = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+  int err = 0;
+  initialise_applogger(&err);
+  check(err);
+
+  std::atomic<int> errors_read{ 0 };
+  std::vector<std::thread> workers;
+  for (int t = 0; t < nthreads; ++t)
+  {
+    workers.emplace_back([t, nmessages, &errors_read]() {
+      int err = 0;
+      const std::string channel = "stress-" + std::to_string(t % 4);
+      const std::string sinkname = "stress-log-" + std::to_string(t) + ".log";
+      add_sink_with_options_to_applogger(sinkname.c_str(), channel.c_str(), nullptr, "debug",
+        t % 2 == 0 ? "async=true" : nullptr, &err);
+      check(err);
+
+      int channel_id = -1;
+      get_applogger_channel_id(channel.c_str(), &channel_id, &err);
+      check(err);
+
+      for (int i = 0; i < nmessages; ++i)
+      {
+        const std::string message = "thread " + std::to_string(t) + " message #" + std::to_string(i);
+        send_message_to_applogger(channel.c_str(), "debug", message.c_str(), &err);
+        check(err);
+
+        const int severity = APPLOGGER_SEVERITY_DEBUG;
+        const char* text = message.c_str();
+        send_messages_to_applogger(1, &channel_id, &severity, &text, nullptr, &err);
+        check(err);
+
+        // Every 100th message goes to an unknown channel, which reports one error message
+        if (i % 100 == 0)
+        {
+          send_message_to_applogger("no-such-channel", "debug", message.c_str(), &err);
+          check(err);
+        }
+
+        if (i % 500 == 0)
+          errors_read += drain_errors();
+      }
+    });
+  }
+  for (auto& w : workers)
+    w.join();
+
+  errors_read += drain_errors();
+
+  const int expected_errors = nthreads * ((nmessages + 99) / 100);
+  std::cout << "Threads: " << nthreads << ", messages per thread: " << 2 * nmessages << std::endl;
+  std::cout << "Error messages read: " << errors_read << " (expected " << expected_errors << ")" << std::endl;
+  std::cout << "Failed calls: " << failed_calls << " (expected 0)" << std::endl;
+
+  destroy_applogger(&err);
+
+  return errors_read == expected_errors && failed_calls == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,6 +1,12 @@
 #include "applogger/applogger_c_interface.hxx"
+#include "applogger/applogger.hxx"
+#include "time_utilities/scoped_timer.hpp"
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 void manage_applogger_error_messages(int return_code);
 
@@ -77,6 +83,304 @@ int main()
       send_message_to_applogger("bespoke", "critical", "this is a critical message from bespoke!", &err);
       manage_applogger_error_messages(err);
 
+      add_sink_with_options_to_applogger("async-log.log", "async", nullptr, "debug", 
+        "async=true; queue_size=256; overflow=drop_oldest", &err);
+      manage_applogger_error_messages(err);
+
+      add_sink_with_options_to_applogger("async-blocking-log.log", "async-blocking", nullptr, "debug", 
+        "async=true; overflow=sometimes", &err);
+      manage_applogger_error_messages(err);
+
+      for (int i = 0; i < 100; ++i)
+      {
+        std::string message = "this is async message #" + std::to_string(i);
+        send_message_to_applogger("async", "debug", message.c_str(), &err);
+        manage_applogger_error_messages(err);
+      }
+
+      send_message_to_applogger("async-blocking", "warning", "this is a warning message from async-blocking!", &err);
+      manage_applogger_error_messages(err);
+
+      // Batches of messages by channel id, as sent from Fortran (not null-terminated)
+      {
+        int async_id = -1, bespoke_id = -1;
+        get_applogger_channel_id("async", &async_id, &err);
+        manage_applogger_error_messages(err);
+        get_applogger_channel_id("bespoke", &bespoke_id, &err);
+        manage_applogger_error_messages(err);
+
+        const char text[] = "batched message #0batched message #1batched warning   ";
+        const int channel_ids[] = { async_id, async_id, bespoke_id, 999, async_id };
+        const int severities[] = { APPLOGGER_SEVERITY_DEBUG, APPLOGGER_SEVERITY_INFO, APPLOGGER_SEVERITY_WARNING,
+          APPLOGGER_SEVERITY_INFO, 7 };
+        const char* messages[] = { text, text + 18, text + 36, text, "null-terminated message with a bad severity" };
+        const int lengths[] = { 18, 18, 15, 18, -1 };
+        send_messages_to_applogger(5, channel_ids, severities, messages, lengths, &err);
+        manage_applogger_error_messages(err);
+
+        send_message_with_id_to_applogger(bespoke_id, APPLOGGER_SEVERITY_ERROR, "single message by id", -1, &err);
+        manage_applogger_error_messages(err);
+      }
+
+      destroy_applogger(&err);
+      manage_applogger_error_messages(err);
+
+      // A producer blocked on a full queue gives up when the sink stops accepting records
+      {
+        namespace logging = boost::log;
+        typedef logging::sinks::asynchronous_sink<logging::sinks::text_ostream_backend, AsyncRecordQueue> blocking_sink_t;
+
+        // No writer thread, so the queue stays full
+        auto sink = boost::make_shared<blocking_sink_t>(boost::make_shared<logging::sinks::text_ostream_backend>(), false);
+        sink->setLimits(1, AsyncRecordQueue::OverflowPolicy::Block);
+        sink->set_filter(logging::expressions::attr<std::string>("Channel") == "blocked");
+        logging::core::get()->add_sink(sink);
+
+        std::thread producer([]() {
+          logging::sources::severity_channel_logger_mt<int, std::string> slg(logging::keywords::channel = "blocked");
+          for (int i = 0; i < 2; ++i)
+          {
+            logging::record rec = slg.open_record(logging::keywords::severity = 0);
+            if (rec)
+              slg.push_record(boost::move(rec));
+          }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        sink->stopAccepting();
+        producer.join();
+
+        logging::core::get()->remove_sink(sink);
+        std::cout << "Dropped after the blocked sink stopped: " << sink->droppedCount() << " (expected 1)" << std::endl;
+      }
+
+      // More channel names than can be registered: logging never throws, registering does
+      {
+        AppLogger logger;
+        for (std::size_t i = 0; i < AppLogger::maxChannels + 10; ++i)
+        {
+          logger.debug("channel-" + std::to_string(i), "message to one of many channels");
+          logger.logf("channel-" + std::to_string(i), AppLogger::Severity::Info, "message #{} to one of many channels", i);
+        }
+
+        bool threw = false;
+        try
+        {
+          logger.registerChannel("one channel too many");
+        }
+        catch (const std::runtime_error&)
+        {
+          threw = true;
+        }
+        std::cout << "Logged to " << AppLogger::maxChannels + 10 << " channels; registering one more throws: " << threw << " (expected 1)" << std::endl;
+      }
+
+      // Channel handles registered concurrently through the C++ interface
+      {
+        AppLogger logger;
+        logger.addChannelSink("handles", "handles-log.log", AppLogger::Severity::Debug);
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; ++t)
+        {
+          workers.emplace_back([&logger, t]() {
+            AppLogger::ChannelHandle handle = logger.registerChannel("handles");
+            for (int i = 0; i < 10; ++i)
+              logger.debug(handle, "message #" + std::to_string(i) + " from thread " + std::to_string(t));
+            logger.logf(handle, AppLogger::Severity::Info, "thread {} logged {} messages {{done}}, ratio {}", t, 10, 0.5);
+          });
+        }
+        for (auto& w : workers)
+          w.join();
+
+        std::cout << "Logged to channel '" << logger.channelName(logger.registerChannel("handles")) << "' from 4 threads" << std::endl;
+      }
+
+      // Messages below the threshold are not even built when using the macros
+      {
+        AppLogger logger;
+        logger.addChannelSink("filtered", "filtered-log.log", AppLogger::Severity::Warning);
+
+        int evaluated = 0;
+        auto build_message = [&evaluated](int i) { 
+          ++evaluated; 
+          return "expensive message #" + std::to_string(i); 
+        };
+        for (int i = 0; i < 10; ++i)
+        {
+          APPLOGGER_DEBUG(logger, "filtered", build_message(i));
+          APPLOGGER_WARNING(logger, "filtered", build_message(i));
+        }
+        std::cout << "Threshold " << logger.getSeverityThreshold() << ", messages built: " << evaluated << " (expected 10)" << std::endl;
+      }
+
+      // Binary sink; read back with: app-logger-decode binary-log.bin
+      {
+        AppLogger logger;
+        logger.init();
+        AppLogger::SinkOptions options;
+        options.type = AppLogger::SinkType::BinaryFile;
+        logger.addChannelSink("binary", "binary-log.bin", AppLogger::Severity::Debug, options);
+
+        AppLogger::ChannelHandle handle = logger.registerChannel("binary");
+        for (int i = 0; i < 5; ++i)
+          logger.logf(handle, AppLogger::Severity::Debug, "sample {} of {}: value {} ({})", i, 5, i * 0.25, i % 2 == 0);
+        logger.warning(handle, "plain message in the binary log");
+        std::cout << "Logged 6 messages to binary-log.bin" << std::endl;
+      }
+
+      // Ring buffer sink small enough to wrap around; print with: app-logger-ring-dump ring-log.ring
+      {
+        AppLogger logger;
+        logger.init();
+        logger.addChannelSink("ring", "ring-log.ring", AppLogger::Severity::Debug,
+          AppLogger::sinkOptionsFromString("type=ring; ring_size=4K"));
+
+        AppLogger::ChannelHandle handle = logger.registerChannel("ring");
+        for (int i = 0; i < 200; ++i)
+          logger.logf(handle, AppLogger::Severity::Debug, "ring message #{}", i);
+        std::cout << "Logged 200 messages to ring-log.ring, the last ones are kept" << std::endl;
+      }
+
+      // Sinks with the same format share a formatter; both files should be identical
+      {
+        AppLogger logger;
+        logger.init();
+        logger.addChannelSinkWithFormat("shared", "shared-a-log.log", AppLogger::Severity::Debug, "[%TimeStamp%] %Message%");
+        logger.addChannelSinkWithFormat("shared", "shared-b-log.log", AppLogger::Severity::Debug, "[%TimeStamp%] %Message%");
+        logger.addChannelSinkWithFormat("shared", "shared-c-log.log", AppLogger::Severity::Debug, "%Message%");
+
+        for (int i = 0; i < 5; ++i)
+          logger.logf("shared", AppLogger::Severity::Debug, "shared format message #{}", i);
+        std::cout << "Logged 5 messages to shared-a-log.log and shared-b-log.log (same format) and shared-c-log.log" << std::endl;
+      }
+
+      // Small rotation size with compression and a retention limit
+      {
+        {
+          AppLogger logger;
+          logger.addChannelSink("rotated", "rotated-logs/rotated-log.log", AppLogger::Severity::Debug,
+            AppLogger::sinkOptionsFromString("rotation_size=4K; max_files=3; compress=true"));
+          for (int i = 0; i < 1000; ++i)
+            logger.logf("rotated", AppLogger::Severity::Debug, "rotated message #{} with some padding to fill the files", i);
+        }
+
+        int compressed = 0, total = 0;
+        for (const auto& f : std::filesystem::directory_iterator("rotated-logs"))
+        {
+          ++total;
+          if (f.path().extension() == ".gz")
+            ++compressed;
+        }
+        std::cout << "Files in rotated-logs: " << total << " (expected 4), compressed: " << compressed << " (expected 3)" << std::endl;
+      }
+
+      // Rotation of a file name pattern: the rotated names start from the expanded name
+      {
+        // The active name changes every day, so a file of an earlier run would be counted
+        std::filesystem::remove_all("pattern-logs");
+        {
+          AppLogger logger;
+          logger.addChannelSink("pattern", "pattern-logs/network_%Y%m%d.log", AppLogger::Severity::Debug,
+            AppLogger::sinkOptionsFromString("rotation_size=4K; max_files=2"));
+          for (int i = 0; i < 1000; ++i)
+            logger.logf("pattern", AppLogger::Severity::Debug, "pattern message #{} with some padding to fill the files", i);
+        }
+
+        int total = 0, unexpanded = 0;
+        for (const auto& f : std::filesystem::directory_iterator("pattern-logs"))
+        {
+          ++total;
+          if (f.path().filename().string().find('%') != std::string::npos)
+            ++unexpanded;
+        }
+        std::cout << "Files in pattern-logs: " << total << " (expected 3), with a placeholder left: " << unexpanded << " (expected 0)" << std::endl;
+      }
+
+      // Rate limited channels: sampling, deduplication and a token bucket
+      {
+        AppLogger logger;
+        logger.addChannelSink("sampled", "sampled-log.log", AppLogger::Severity::Debug,
+          AppLogger::sinkOptionsFromString("sample_first=5; sample_every=100"));
+        logger.addChannelSink("dedup", "dedup-log.log", AppLogger::Severity::Debug,
+          AppLogger::sinkOptionsFromString("dedup_window_ms=60000"));
+        logger.addChannelSink("bucket", "bucket-log.log", AppLogger::Severity::Debug,
+          AppLogger::sinkOptionsFromString("rate_limit=10; burst=20"));
+
+        for (int i = 0; i < 1000; ++i)
+        {
+          logger.logf("sampled", AppLogger::Severity::Debug, "sampled warning #{}", i);
+          logger.debug("dedup", "the same warning again");
+          logger.logf("dedup", AppLogger::Severity::Debug, "warning for cell {}", i % 3);
+          logger.debug("bucket", "warning from a hot loop");
+        }
+        std::cout << "Suppressed: sampled " << logger.getSuppressedCount("sampled") << " (expected 985)"
+          << ", dedup " << logger.getSuppressedCount("dedup") << " (expected 1996)"
+          << ", bucket " << logger.getSuppressedCount("bucket") << " (expected about 980)" << std::endl;
+      }
+
+      // A message suppressed by sampling is not remembered as a duplicate, and the
+      // messages remembered are bounded, the oldest forgotten first
+      {
+        AppLogger logger;
+        logger.addChannelSink("retry", "retry-log.log", AppLogger::Severity::Debug,
+          AppLogger::sinkOptionsFromString("sample_every=2; dedup_window_ms=60000"));
+        logger.debug("retry", "first message");
+        logger.debug("retry", "retried message");
+        logger.debug("retry", "retried message");
+        std::cout << "Suppressed with a retry after sampling: " << logger.getSuppressedCount("retry") << " (expected 1)" << std::endl;
+
+        logger.addChannelSink("many", "many-log.log", AppLogger::Severity::Debug,
+          AppLogger::sinkOptionsFromString("dedup_window_ms=60000"));
+        logger.debug("many", "the oldest message");
+        for (int i = 0; i < 5000; ++i)
+          logger.logf("many", AppLogger::Severity::Debug, "distinct message #{}", i);
+        logger.debug("many", "the oldest message");
+        std::cout << "Suppressed after 5000 distinct messages: " << logger.getSuppressedCount("many") << " (expected 0)" << std::endl;
+      }
+
+      // Debug spam that no sink accepts must not use up the limits of the Warnings
+      {
+        AppLogger logger;
+        logger.addChannelSink("spam", "spam-log.log", AppLogger::Severity::Warning,
+          AppLogger::sinkOptionsFromString("sample_first=1; sample_every=0; dedup_window_ms=60000"));
+        for (int i = 0; i < 1000; ++i)
+        {
+          logger.debug("spam", "the same warning again");
+          logger.logf("spam", AppLogger::Severity::Debug, "debug iteration {}", i);
+        }
+        logger.warning("spam", "the same warning again");
+        logger.warning("spam", "the same warning again");
+        std::cout << "Suppressed after Debug spam below the sink severity: " << logger.getSuppressedCount("spam")
+          << " (expected 1, only the repeated Warning)" << std::endl;
+      }
+
+      // Timer summaries, periodically and on demand through the C interface
+      {
+        initialise_applogger(&err);
+        add_sink_to_applogger("timers-log.log", "timers", nullptr, "info", &err);
+        start_applogger_timer_reports("timers", 1, &err);
+        manage_applogger_error_messages(err);
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 3; ++t)
+        {
+          workers.emplace_back([]() {
+            for (int i = 0; i < 250; ++i)
+            {
+              TIMEUTILS_SCOPED_TIMER("test/sleep");
+              std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+          });
+        }
+        for (auto& w : workers)
+          w.join();
+
+        report_applogger_timers("timers", &err);
+        manage_applogger_error_messages(err);
+        destroy_applogger(&err);
+        std::cout << "Logged timer summaries to timers-log.log (expected a periodic report, then test/sleep: count=750, ~5 ms)" << std::endl;
+      }
+
 
       //   // Add channel-specific sinks
       //   logger.addChannelSink(
@@ -0,0 +1,93 @@
+#include "maths_geometry/adaptive_quadrature.hpp"
+#include "benchmark_utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// Integrand evaluations and time to reach a target tolerance over [0, 1] for a
+// sharp peak, 1 / ((x - 0.3)^2 + 1e-4) + e^x:
+// - simpson with the fewest points (doubling) that meet the tolerance
+// - adaptive_simpson, gauss_kronrod_15, gauss_kronrod_21 on one thread
+// Then the bisecting rules on 1, 2, 4... threads with the same peak made
+// expensive, so that the work per evaluation outweighs the queues.
+//
+// Usage: test-adaptive-quadrature-benchmark [tolerance] [work per evaluation] [max threads]
+
+double peak(const double x)
+{
+   return 1. / ((x - 0.3) * (x - 0.3) + 1e-4) + std::exp(x);
+}
+
+const double peak_exact = 100. * (std::atan(70.) + std::atan(30.)) + std::exp(1.) - 1.;
+
+// The peak, plus a sum scaled down below rounding, which the compiler cannot drop
+double expensive_peak(const double x, const int work)
+{
+   double extra = 0.;
+   for (int k = 1; k <= work; ++k)
+      extra += std::sin(k * x);
+   return peak(x) + 1e-300 * extra;
+}
+
+void report(const char* name, const unsigned nthreads, const size_t evaluations, const double us, const double reference_us, const double value, const bool converged)
+{
+   std::cout << std::left << std::setw(18) << name << std::right << std::setw(3) << nthreads << " threads"
+      << std::setw(12) << evaluations << " calls" << std::fixed << std::setprecision(1) << std::setw(12) << us << " us"
+      << "  speedup " << std::setw(6) << reference_us / us << "x"
+      << "  error " << std::scientific << std::setprecision(2) << value - peak_exact
+      << (converged ? "" : "  (not converged)") << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+   const double tolerance = argc > 1 ? std::strtod(argv[1], nullptr) : 1e-9;
+   const int work = argc > 2 ? std::atoi(argv[2]) : 200;
+   const unsigned max_threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : std::max(4u, std::thread::hardware_concurrency());
+   std::cout << "Tolerance: " << tolerance << ", work per evaluation: " << work << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+   // Fixed step Simpson: the points, doubled until the error is within the tolerance
+   size_t npoints = 16;
+   double fixed = 0.;
+   double fixed_us = 0.;
+   for (; npoints < (size_t(1) << 30); npoints *= 2)
+   {
+      fixed_us = run_case(1, [&] { fixed = maths_ops::simpson(0., 1., npoints, peak); }) / 1000.;
+      if (std::abs(fixed - peak_exact) <= tolerance)
+         break;
+   }
+   report("simpson (fixed)", 1, npoints + 1, fixed_us, fixed_us, fixed, std::abs(fixed - peak_exact) <= tolerance);
+
+   auto run_adaptive = [&](const char* name, auto&& rule, const unsigned nthreads, const double reference_us) {
+      maths_ops::quadrature_result<double> result{};
+      const double us = run_case(1, [&] { result = rule(nthreads); }) / 1000.;
+      report(name, nthreads, result.evaluations, us, reference_us > 0. ? reference_us : us, result.value, result.converged);
+      return us;
+   };
+
+   auto cheap_simpson = [&](unsigned nthreads) { return maths_ops::adaptive_simpson(0., 1., tolerance, peak, nthreads); };
+   auto cheap_gk15 = [&](unsigned nthreads) { return maths_ops::gauss_kronrod_15(0., 1., tolerance, peak, nthreads); };
+   auto cheap_gk21 = [&](unsigned nthreads) { return maths_ops::gauss_kronrod_21(0., 1., tolerance, peak, nthreads); };
+   run_adaptive("adaptive_simpson", cheap_simpson, 1, fixed_us);
+   run_adaptive("gauss_kronrod_15", cheap_gk15, 1, fixed_us);
+   run_adaptive("gauss_kronrod_21", cheap_gk21, 1, fixed_us);
+
+   std::cout << "Expensive integrand, speedup against 1 thread" << std::endl;
+   auto f = [work](double x) { return expensive_peak(x, work); };
+   auto expensive_simpson = [&](unsigned nthreads) { return maths_ops::adaptive_simpson(0., 1., tolerance, f, nthreads); };
+   auto expensive_gk21 = [&](unsigned nthreads) { return maths_ops::gauss_kronrod_21(0., 1., tolerance, f, nthreads); };
+   double reference_simpson = 0.;
+   double reference_gk21 = 0.;
+   for (unsigned nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+   {
+      const double us_simpson = run_adaptive("adaptive_simpson", expensive_simpson, nthreads, nthreads == 1 ? 0. : reference_simpson);
+      reference_simpson = nthreads == 1 ? us_simpson : reference_simpson;
+      const double us_gk21 = run_adaptive("gauss_kronrod_21", expensive_gk21, nthreads, nthreads == 1 ? 0. : reference_gk21);
+      reference_gk21 = nthreads == 1 ? us_gk21 : reference_gk21;
+   }
+
+   return EXIT_SUCCESS;
+}
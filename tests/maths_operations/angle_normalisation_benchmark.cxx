@@ -0,0 +1,89 @@
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/maths_operations_simd.hpp"
+#include "benchmark_utils.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Time per angle of get_0_360_deg and to_compass_angle_deg: the former loop
+// of one period per step, the single angle functions and the array versions
+// with each instruction set the CPU supports.
+//
+// Usage: test-angle-normalisation-benchmark [number of angles] [largest angle in degrees]
+
+// get_0_360_deg as it was, for reference
+template <typename T>
+T loop_0_360_deg(T d)
+{
+   while (d < 0) {
+      d += 360;
+   }
+   while (d > 360) {
+      d -= 360;
+   }
+   return d;
+}
+
+template <typename T>
+void run_type(const char* type_name, const size_t n, const double largest)
+{
+   const int repeats = 20;
+   const char* level_names[] = { "scalar", "avx2", "avx512" };
+
+   std::vector<T> angles(n), out(n);
+   for (size_t i = 0; i < n; ++i)
+      angles[i] = static_cast<T>(largest * std::sin(0.37 * i));
+   T sink = 0;
+
+   auto report = [&](const char* name, const char* variant, const double ns, const double reference_ns) {
+      std::cout << std::left << std::setw(8) << type_name << std::setw(22) << name << std::setw(16) << variant
+         << std::right << std::fixed << std::setprecision(3) << std::setw(8) << ns / static_cast<double>(n) << " ns/angle"
+         << "  speedup " << std::setprecision(1) << std::setw(6) << reference_ns / ns << "x" << std::endl;
+   };
+
+   // The angles are shifted by the repeat, so that repeats cannot be merged
+   const double ref = run_case(repeats, [&](const int r) {
+      for (size_t i = 0; i < n; ++i)
+         out[i] = loop_0_360_deg(angles[i] + static_cast<T>(r));
+      sink += out[n / 2];
+   });
+   report("get_0_360_deg", "while loops", ref, ref);
+   report("get_0_360_deg", "single angle", run_case(repeats, [&](const int r) {
+      for (size_t i = 0; i < n; ++i)
+         out[i] = maths_ops::get_0_360_deg(angles[i] + static_cast<T>(r));
+      sink += out[n / 2];
+   }), ref);
+
+   const maths_ops::simd_level best = maths_ops::detect_simd_level();
+   for (int level = 0; level <= static_cast<int>(best); ++level)
+   {
+      maths_ops::set_simd_level(static_cast<maths_ops::simd_level>(level));
+      const std::string variant = std::string("array ") + level_names[level];
+      report("get_0_360_deg", variant.c_str(), run_case(repeats, [&](const int) {
+         maths_ops::get_0_360_deg(out.data(), angles.data(), n);
+         sink += out[n / 2];
+      }), ref);
+      report("to_compass_angle_deg", variant.c_str(), run_case(repeats, [&](const int) {
+         maths_ops::to_compass_angle_deg(out.data(), angles.data(), n);
+         sink += out[n / 2];
+      }), ref);
+   }
+   maths_ops::set_simd_level(best);
+   std::cout << "(checksum " << sink << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+   const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+   const double largest = argc > 2 ? std::strtod(argv[2], nullptr) : 3600.;
+   std::cout << "Angles: " << n << ", up to +/- " << largest << " deg" << std::endl;
+
+   run_type<float>("float", n, largest);
+   run_type<double>("double", n, largest);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "time_utilities/time_utils.hpp"
+
+#include <chrono>
+#include <type_traits>
+
+// Average time in nanoseconds of a kernel over a number of repeats. The kernel
+// may take the index of the repeat, e.g. to vary its input between repeats.
+template <typename F>
+double run_case(const int repeats, F&& kernel)
+{
+   timeutils::Stopwatch<std::chrono::nanoseconds> stopwatch;
+   for (int r = 0; r < repeats; ++r)
+   {
+      if constexpr (std::is_invocable_v<F&, int>)
+         kernel(r);
+      else
+         kernel();
+   }
+   return stopwatch.elapsed() / repeats;
+}
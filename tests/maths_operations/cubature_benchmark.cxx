@@ -0,0 +1,106 @@
+#include "maths_geometry/cubature.hpp"
+#include "maths_geometry/gauss_rules.hpp"
+#include "maths_geometry/maths_operations.hpp"
+#include "benchmark_utils.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Time per cell to integrate a smooth field over each cell of a rotated raster,
+// one integral per cell:
+// - a loop calling apply_geotransform for every point of a 3 x 3 Gauss-Legendre rule
+// - integrate_raster_cells with the same rule, with a point and a batch integrand
+// - the 7 point degree 5 rule, and 16 Sobol points
+// - the batch integrand on all hardware threads
+// The errors are against an 8 x 8 Gauss-Legendre rule.
+//
+// Usage: test-cubature-benchmark [rows] [columns]
+
+int main(int argc, char* argv[])
+{
+   const size_t nrows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+   const size_t ncols = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000;
+   const size_t ncells = nrows * ncols;
+   const int repeats = 3;
+   std::cout << "Cells: " << nrows << " x " << ncols << std::endl;
+
+   double gt[6];
+   maths_ops::set_affine_geotransform(gt, 0., 0., 0.01, 0.01, 0.3);
+
+   auto field = [](double x, double y) { return std::exp(-0.1 * (x * x + y * y)) * std::cos(3. * x - 2. * y); };
+   auto field_batch = [](const double* xs, const double* ys, double* values, size_t n) {
+      for (size_t i = 0; i < n; ++i)
+         values[i] = std::exp(-0.1 * (xs[i] * xs[i] + ys[i] * ys[i])) * std::cos(3. * xs[i] - 2. * ys[i]);
+   };
+
+   const maths_ops::gauss_rule<double> legendre3(maths_ops::gauss_family::legendre, 3);
+   const maths_ops::gauss_rule<double> legendre8(maths_ops::gauss_family::legendre, 8);
+   std::vector<double> reference(ncells), out(ncells);
+   maths_ops::integrate_raster_cells(reference.data(), 0, nrows, 0, ncols, gt, maths_ops::tensor_product_rule(legendre8, legendre8), field_batch);
+
+   double sink = 0.;
+   auto report = [&](const char* name, const double ns, const double reference_ns) {
+      double worst = 0.;
+      for (size_t i = 0; i < ncells; ++i)
+      {
+         worst = std::max(worst, std::abs(out[i] - reference[i]));
+         sink += out[i];
+      }
+      std::cout << std::left << std::setw(46) << name << std::right << std::fixed << std::setprecision(2) << std::setw(10) << ns / static_cast<double>(ncells)
+         << " ns/cell  speedup " << std::setprecision(1) << std::setw(6) << reference_ns / ns << "x  largest error "
+         << std::scientific << std::setprecision(2) << worst << std::defaultfloat << std::endl;
+   };
+
+   // Every point through apply_geotransform, at fractional row and column indexes
+   const double area = std::abs(gt[1] * gt[5] - gt[2] * gt[4]);
+   const double naive = run_case(repeats, [&] {
+      for (size_t r = 0; r < nrows; ++r)
+      {
+         for (size_t c = 0; c < ncols; ++c)
+         {
+            double sum = 0.;
+            for (size_t i = 0; i < 3; ++i)
+            {
+               for (size_t j = 0; j < 3; ++j)
+               {
+                  double x, y;
+                  const double row = static_cast<double>(r) + 0.5 * (1. + legendre3.nodes()[i]);
+                  const double col = static_cast<double>(c) + 0.5 * (1. + legendre3.nodes()[j]);
+                  maths_ops::apply_geotransform(&x, &y, row, col, gt);
+                  sum += 0.25 * legendre3.weights()[i] * legendre3.weights()[j] * field(x, y);
+               }
+            }
+            out[maths_ops::get_row_major_linear_index(r, c, ncols)] = area * sum;
+         }
+      }
+   });
+   report("apply_geotransform per point, 3 x 3", naive, naive);
+
+   const maths_ops::cubature_rule<double, 2> tensor = maths_ops::tensor_product_rule(legendre3, legendre3);
+   report("integrate_raster_cells, 3 x 3", run_case(repeats, [&] {
+      maths_ops::integrate_raster_cells(out.data(), 0, nrows, 0, ncols, gt, tensor, field, 1);
+   }), naive);
+   report("integrate_raster_cells, 3 x 3, batch", run_case(repeats, [&] {
+      maths_ops::integrate_raster_cells(out.data(), 0, nrows, 0, ncols, gt, tensor, field_batch, 1);
+   }), naive);
+
+   const maths_ops::cubature_rule<double, 2> degree5 = maths_ops::degree5_square_rule<double>();
+   report("integrate_raster_cells, 7 point, batch", run_case(repeats, [&] {
+      maths_ops::integrate_raster_cells(out.data(), 0, nrows, 0, ncols, gt, degree5, field_batch, 1);
+   }), naive);
+
+   const maths_ops::cubature_rule<double, 2> sobol = maths_ops::sobol_rule<double, 2>(16);
+   report("integrate_raster_cells, 16 Sobol, batch", run_case(repeats, [&] {
+      maths_ops::integrate_raster_cells(out.data(), 0, nrows, 0, ncols, gt, sobol, field_batch, 1);
+   }), naive);
+
+   report("integrate_raster_cells, 7 point, all threads", run_case(repeats, [&] {
+      maths_ops::integrate_raster_cells(out.data(), 0, nrows, 0, ncols, gt, degree5, field_batch, 0);
+   }), naive);
+
+   std::cout << "(checksum " << sink << ")" << std::endl;
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#include "maths_geometry/gauss_rules.hpp"
+#include "maths_geometry/maths_operations.hpp"
+#include "time_utilities/time_utils.hpp"
+#include "benchmark_utils.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Time per cell to integrate e^(-x) cos(3x) over each of many small cells, one
+// integral per cell, with the same order every time:
+// - gauss_chebyshev per cell, which computes its nodes on every call
+// - a Chebyshev gauss_rule with the same nodes, applied with integrate_each
+// - Legendre rules of the same order (from the tables) and of a higher one (from
+//   the cache), with a point and a batch integrand
+// - the same rules on all hardware threads
+//
+// Usage: test-gauss-rules-benchmark [number of cells] [order]
+
+int main(int argc, char* argv[])
+{
+   const size_t ncells = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+   const size_t order = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8;
+   const int repeats = 5;
+   std::cout << "Cells: " << ncells << ", order: " << order << std::endl;
+
+   std::vector<double> firsts(ncells), lasts(ncells), out(ncells);
+   const double width = 10. / static_cast<double>(ncells);
+   for (size_t i = 0; i < ncells; ++i)
+   {
+      firsts[i] = width * static_cast<double>(i);
+      lasts[i] = firsts[i] + width;
+   }
+
+   auto f = [](double x) { return std::exp(-x) * std::cos(3. * x); };
+   auto batch = [](const double* xs, double* ys, size_t n) {
+      for (size_t i = 0; i < n; ++i)
+         ys[i] = std::exp(-xs[i]) * std::cos(3. * xs[i]);
+   };
+   // The antiderivative of e^(-x) cos(3x)
+   auto primitive = [](double x) { return std::exp(-x) * (3. * std::sin(3. * x) - std::cos(3. * x)) / 10.; };
+
+   double sink = 0.;
+   auto report = [&](const char* name, const double ns, const double reference_ns) {
+      double worst = 0.;
+      for (size_t i = 0; i < ncells; ++i)
+      {
+         worst = std::max(worst, std::abs(out[i] - (primitive(lasts[i]) - primitive(firsts[i]))));
+         sink += out[i];
+      }
+      std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(2) << std::setw(10) << ns / static_cast<double>(ncells)
+         << " ns/cell  speedup " << std::setprecision(1) << std::setw(6) << reference_ns / ns << "x  largest error "
+         << std::scientific << std::setprecision(2) << worst << std::defaultfloat << std::endl;
+   };
+
+   const double reference = run_case(repeats, [&] {
+      for (size_t i = 0; i < ncells; ++i)
+         out[i] = maths_ops::gauss_chebyshev(firsts[i], lasts[i], order - 1, f);
+   });
+   report("gauss_chebyshev per cell", reference, reference);
+
+   const maths_ops::gauss_rule<double> chebyshev(maths_ops::gauss_family::chebyshev, order);
+   report("Chebyshev rule", run_case(repeats, [&] { chebyshev.integrate_each(firsts.data(), lasts.data(), ncells, out.data(), f); }), reference);
+   report("Chebyshev rule, batch", run_case(repeats, [&] { chebyshev.integrate_each(firsts.data(), lasts.data(), ncells, out.data(), batch); }), reference);
+
+   const maths_ops::gauss_rule<double> legendre(maths_ops::gauss_family::legendre, order);
+   report("Legendre rule", run_case(repeats, [&] { legendre.integrate_each(firsts.data(), lasts.data(), ncells, out.data(), f); }), reference);
+   report("Legendre rule, batch", run_case(repeats, [&] { legendre.integrate_each(firsts.data(), lasts.data(), ncells, out.data(), batch); }), reference);
+
+   const maths_ops::gauss_rule<double> lobatto(maths_ops::gauss_family::lobatto, order);
+   report("Lobatto rule", run_case(repeats, [&] { lobatto.integrate_each(firsts.data(), lasts.data(), ncells, out.data(), f); }), reference);
+
+   // A higher order, computed on first use; the first build is timed on its own
+   const size_t high_order = 2 * order + 7;
+   timeutils::Stopwatch<std::chrono::nanoseconds> build_watch;
+   const maths_ops::gauss_rule<double> high(maths_ops::gauss_family::legendre, high_order);
+   const double build_ns = build_watch.elapsed();
+   const double rebuild_ns = run_case(1000, [&] { sink += maths_ops::gauss_rule<double>(maths_ops::gauss_family::legendre, high_order).nodes()[0]; });
+   std::cout << "Legendre order " << high_order << ": first build " << build_ns / 1000. << " us, later builds " << rebuild_ns << " ns" << std::endl;
+   report("Legendre rule, cached order", run_case(repeats, [&] { high.integrate_each(firsts.data(), lasts.data(), ncells, out.data(), f); }), reference);
+
+   report("Legendre rule, batch, all threads", run_case(repeats, [&] { legendre.integrate_each(firsts.data(), lasts.data(), ncells, out.data(), batch, 0); }), reference);
+
+   std::cout << "(checksum " << sink << ")" << std::endl;
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/maths_operations_simd.hpp"
+#include "benchmark_utils.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Time per cell of apply_geotransform_grid and per point of the array
+// apply_inverse_geotransform, with each instruction set the CPU supports
+// and on one or all threads, against loops calling the per-pixel functions.
+//
+// Usage: test-geotransform-grid-benchmark [number of rows and columns]
+
+template <typename T>
+void run_type(const char* type_name, const size_t nside)
+{
+   const int repeats = 10;
+   const char* level_names[] = { "scalar", "avx2", "avx512" };
+   const size_t ncells = nside * nside;
+
+   double geotransform[6];
+   maths_ops::set_affine_geotransform(geotransform, 350000., 4200000., 10., 10., 0.2);
+
+   std::vector<T> xs(ncells), ys(ncells);
+   std::vector<int> irows(ncells), icols(ncells);
+   T sink = 0;
+   long long isink = 0;
+
+   auto report = [&](const char* name, const char* variant, const double ns, const double reference_ns) {
+      std::cout << std::left << std::setw(8) << type_name << std::setw(28) << name << std::setw(20) << variant
+         << std::right << std::fixed << std::setprecision(3) << std::setw(8) << ns / static_cast<double>(ncells) << " ns/cell"
+         << "  speedup " << std::setprecision(1) << std::setw(5) << reference_ns / ns << "x" << std::endl;
+   };
+
+   // References: loops over the per-pixel functions. The grid moves down a row
+   // with each repeat, so that repeats cannot be merged
+   const double ref_grid = run_case(repeats, [&](const int r) {
+      for (size_t i = 0; i < nside; ++i)
+      {
+         for (size_t j = 0; j < nside; ++j)
+            maths_ops::apply_geotransform(&xs[i * nside + j], &ys[i * nside + j], i + r, j, geotransform);
+      }
+      sink += xs[ncells / 2];
+   });
+   const double ref_inverse = run_case(repeats, [&](const int) {
+      for (size_t i = 0; i < ncells; ++i)
+         maths_ops::apply_inverse_geotransform(&irows[i], &icols[i], xs[i], ys[i], geotransform);
+      isink += irows[ncells / 3];
+   });
+   report("apply_geotransform", "per pixel", ref_grid, ref_grid);
+   report("apply_inverse_geotransform", "per point", ref_inverse, ref_inverse);
+
+   const maths_ops::simd_level best = maths_ops::detect_simd_level();
+   for (int level = 0; level <= static_cast<int>(best); ++level)
+   {
+      maths_ops::set_simd_level(static_cast<maths_ops::simd_level>(level));
+      for (const unsigned nthreads : { 1u, 0u })
+      {
+         const std::string variant = std::string(level_names[level]) + (nthreads == 1 ? ", 1 thread" : ", all threads");
+         report("apply_geotransform_grid", variant.c_str(), run_case(repeats, [&](const int r) {
+            maths_ops::apply_geotransform_grid(xs.data(), ys.data(), static_cast<size_t>(r), nside, size_t(0), nside, geotransform, nthreads);
+            sink += xs[ncells / 2];
+         }), ref_grid);
+         report("apply_inverse_geotransform", variant.c_str(), run_case(repeats, [&](const int) {
+            maths_ops::apply_inverse_geotransform(irows.data(), icols.data(), xs.data(), ys.data(), ncells, geotransform, nthreads);
+            isink += irows[ncells / 3];
+         }), ref_inverse);
+      }
+   }
+   maths_ops::set_simd_level(best);
+   std::cout << "(checksum " << sink << " " << isink << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+   const size_t nside = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+   std::cout << "Grid: " << nside << " x " << nside << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+   run_type<float>("float", nside);
+   run_type<double>("double", nside);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#include "maths_geometry/maths_operations.hpp"
+#include "benchmark_utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Time per node of simpson, newton_cotes, newton_cotes38f and gauss_chebyshev 
+// over [0, 1], with the integrand given as a function pointer only known at run 
+// time, as a lambda, and as a batch integrand. Two integrands:
+// - 1 / (1 + x^2), cheap enough that the call itself matters
+// - a tabulated profile, linearly interpolated. Per node, it needs a binary 
+//   search; a batch of increasing nodes walks the table instead.
+//
+// Usage: test-integration-benchmark [number of intervals] [table size]
+
+template <typename T>
+T runge(T x)
+{
+   return static_cast<T>(1.) / (static_cast<T>(1.) + x * x);
+}
+
+// The profile for the function pointer, which cannot carry state
+template <typename T>
+struct profile_table
+{
+   static std::vector<T> xs;
+   static std::vector<T> ys;
+
+   static T at(const T x)
+   {
+      const size_t i = std::min(static_cast<size_t>(std::upper_bound(xs.begin(), xs.end(), x) - xs.begin()), xs.size() - 1);
+      return maths_ops::interp_linear(x, xs[i - 1], ys[i - 1], xs[i], ys[i]);
+   }
+};
+
+template <typename T> std::vector<T> profile_table<T>::xs;
+template <typename T> std::vector<T> profile_table<T>::ys;
+
+template <typename T, typename L, typename B>
+void run_integrand(const char* type_name, const char* integrand_name, const size_t n, T (*function)(T), L lambda, B batch, const T exact)
+{
+   const int repeats = 20;
+   T sink = 0;
+
+   // Read back from a volatile, so that the compiler cannot see through the pointer
+   T (* volatile pointer)(T) = function;
+
+   auto report = [&](const char* name, const char* variant, const double ns, const double reference_ns, const T value) {
+      std::cout << std::left << std::setw(8) << type_name << std::setw(10) << integrand_name << std::setw(18) << name << std::setw(18) << variant
+         << std::right << std::fixed << std::setprecision(3) << std::setw(8) << ns / static_cast<double>(n) << " ns/node"
+         << "  speedup " << std::setprecision(1) << std::setw(6) << reference_ns / ns << "x"
+         << "  error " << std::scientific << std::setprecision(2) << static_cast<double>(value - exact) << std::endl;
+   };
+
+   // The interval is shrunk by each repeat, so that repeats cannot be merged. 
+   // The error is that of the first repeat, over [0, 1].
+   auto run_rule = [&](const char* name, auto&& rule) {
+      T value = 0;
+      auto time_variant = [&](auto f) {
+         return run_case(repeats, [&](const int r) {
+            const T integral = rule(static_cast<T>(1. - 1e-9 * r), f);
+            value = r == 0 ? integral : value;
+            sink += integral;
+         });
+      };
+      const double ref = time_variant(static_cast<T (*)(T)>(pointer));
+      report(name, "function pointer", ref, ref, value);
+      const double lambda_ns = time_variant(lambda);
+      report(name, "lambda", lambda_ns, ref, value);
+      const double batch_ns = time_variant(batch);
+      report(name, "batch", batch_ns, ref, value);
+   };
+
+   run_rule("simpson", [&](const T last, auto f) { return maths_ops::simpson(static_cast<T>(0.), last, n, f); });
+   run_rule("newton_cotes", [&](const T last, auto f) { return maths_ops::newton_cotes(static_cast<T>(0.), last, n, f); });
+   run_rule("newton_cotes38f", [&](const T last, auto f) { return maths_ops::newton_cotes38f(static_cast<T>(0.), last, n, f); });
+   run_rule("gauss_chebyshev", [&](const T last, auto f) { return maths_ops::gauss_chebyshev(static_cast<T>(0.), last, n, f); });
+   std::cout << std::defaultfloat << "(checksum " << sink << ")" << std::endl;
+}
+
+template <typename T>
+void run_type(const char* type_name, const size_t n, const size_t table_size)
+{
+   auto runge_lambda = [](T x) { return static_cast<T>(1.) / (static_cast<T>(1.) + x * x); };
+   auto runge_batch = [](const T* xs, T* ys, size_t m) {
+      for (size_t i = 0; i < m; ++i)
+         ys[i] = static_cast<T>(1.) / (static_cast<T>(1.) + xs[i] * xs[i]);
+   };
+   run_integrand<T>(type_name, "runge", n, runge<T>, runge_lambda, runge_batch, static_cast<T>(0.785398163397448309616));
+
+   // A profile of x^2 sampled at uneven positions over [0, 1]
+   std::vector<T>& txs = profile_table<T>::xs;
+   std::vector<T>& tys = profile_table<T>::ys;
+   txs.resize(table_size);
+   tys.resize(table_size);
+   for (size_t i = 0; i < table_size; ++i)
+   {
+      const double u = static_cast<double>(i) / static_cast<double>(table_size - 1);
+      txs[i] = static_cast<T>(u - 0.1 * std::sin(2. * M_PI * u) / (2. * M_PI));
+      tys[i] = txs[i] * txs[i];
+   }
+
+   auto profile_lambda = [&txs, &tys](T x) {
+      const size_t i = std::min(static_cast<size_t>(std::upper_bound(txs.begin(), txs.end(), x) - txs.begin()), txs.size() - 1);
+      return maths_ops::interp_linear(x, txs[i - 1], tys[i - 1], txs[i], tys[i]);
+   };
+   // Nodes come in increasing order within a batch (Gauss-Chebyshev too), 
+   // so after one search the table is walked forward
+   auto profile_batch = [&txs, &tys](const T* xs, T* ys, size_t m) {
+      size_t i = std::min(static_cast<size_t>(std::upper_bound(txs.begin(), txs.end(), xs[0]) - txs.begin()), txs.size() - 1);
+      for (size_t k = 0; k < m; ++k)
+      {
+         while (i + 1 < txs.size() && txs[i] <= xs[k])
+            ++i;
+         ys[k] = maths_ops::interp_linear(xs[k], txs[i - 1], tys[i - 1], txs[i], tys[i]);
+      }
+   };
+   run_integrand<T>(type_name, "profile", n, profile_table<T>::at, profile_lambda, profile_batch, static_cast<T>(1. / 3.));
+}
+
+int main(int argc, char* argv[])
+{
+   const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 3000000;
+   const size_t table_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+   std::cout << "Intervals: " << n << ", profile table: " << table_size << " samples" << std::endl;
+
+   run_type<float>("float", n, table_size);
+   run_type<double>("double", n, table_size);
+
+   return EXIT_SUCCESS;
+}
@@ -1,8 +1,19 @@
 #include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/adaptive_quadrature.hpp"
+#include "maths_geometry/cubature.hpp"
+#include "maths_geometry/gauss_rules.hpp"
+#include "maths_geometry/maths_operations_simd.hpp"
+#include "maths_geometry/polygon.hpp"
+#include "maths_geometry/segment_intersection.hpp"
+#include "maths_geometry/spatial_index.hpp"
 #include "maths_geometry/machine_numerical_precision.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <iomanip>
+#include <thread>
+#include <vector>
 
 #define LONG_DECIMAL_NUMBER   0.12345678901234567890123456789L
 
@@ -355,6 +366,65 @@ int main()
       std::cout << " " << rad << " (geometric angle - rad) => " << maths_ops::convert_to_meteorological_dir_rad(rad) << " (meteo angle - rad)" << std::endl;
    }
 
+   // --- Array versions of the angle functions, for each instruction set the CPU supports ---
+   std::cout << "\nTesting array 'get_0_360_deg', 'get_0_2pi_rad', 'to_compass_angle_*' and 'convert_to_meteorological_dir_*' \n";
+   {
+      const maths_ops::simd_level best = maths_ops::detect_simd_level();
+      const char* level_names[] = { "scalar", "avx2", "avx512" };
+
+      // Small and large angles of both signs, with exact multiples of the full turn
+      const size_t n = 1003;
+      std::vector<double> angles(n);
+      std::vector<float> anglesf(n);
+      for (size_t i = 0; i < n; ++i)
+      {
+         const double scale = (i % 4 == 0) ? 1. : (i % 4 == 1) ? 100. : (i % 4 == 2) ? 1e4 : 1e6;
+         angles[i] = (i % 7 == 0) ? 360. * (static_cast<double>(i) - 500.) : scale * std::sin(0.7 * i);
+         anglesf[i] = static_cast<float>(angles[i]);
+      }
+
+      for (int level = 0; level <= static_cast<int>(best); ++level)
+      {
+         maths_ops::set_simd_level(static_cast<maths_ops::simd_level>(level));
+
+         std::vector<double> deg(n), rad(n), compass_deg(n), compass_rad(n), meteo_deg(n), meteo_rad(n);
+         maths_ops::get_0_360_deg(deg.data(), angles.data(), n);
+         maths_ops::get_0_2pi_rad(rad.data(), angles.data(), n);
+         maths_ops::to_compass_angle_deg(compass_deg.data(), angles.data(), n);
+         maths_ops::to_compass_angle_rad(compass_rad.data(), angles.data(), n);
+         maths_ops::convert_to_meteorological_dir_deg(meteo_deg.data(), angles.data(), n);
+         maths_ops::convert_to_meteorological_dir_rad(meteo_rad.data(), angles.data(), n);
+
+         std::vector<float> degf(anglesf);
+         maths_ops::get_0_360_deg(degf.data(), degf.data(), n);
+
+         double max_diff = 0., max_diff_f = 0.;
+         bool in_range = true;
+         for (size_t i = 0; i < n; ++i)
+         {
+            const double a = angles[i];
+            max_diff = std::max(max_diff, std::fabs(deg[i] - maths_ops::get_0_360_deg(a)));
+            max_diff = std::max(max_diff, std::fabs(rad[i] - maths_ops::get_0_2pi_rad(a)));
+            max_diff = std::max(max_diff, std::fabs(compass_deg[i] - maths_ops::to_compass_angle_deg(a)));
+            max_diff = std::max(max_diff, std::fabs(compass_rad[i] - maths_ops::to_compass_angle_rad(a)));
+            max_diff = std::max(max_diff, std::fabs(meteo_deg[i] - maths_ops::convert_to_meteorological_dir_deg(a)));
+            max_diff = std::max(max_diff, std::fabs(meteo_rad[i] - maths_ops::convert_to_meteorological_dir_rad(a)));
+            max_diff_f = std::max(max_diff_f, static_cast<double>(std::fabs(degf[i] - maths_ops::get_0_360_deg(anglesf[i]))));
+            in_range = in_range && deg[i] >= 0. && deg[i] <= 360. && rad[i] >= 0. && rad[i] < 2 * M_PI && degf[i] >= 0.f && degf[i] <= 360.f;
+         }
+
+         std::cout << " " << level_names[level] << ": max difference from the single angle versions double " << max_diff << " float " << max_diff_f
+            << " (expected < 1e-9 and < 1e-3), all in range: " << std::boolalpha << in_range << std::noboolalpha << " (expected true)" << std::endl;
+      }
+      maths_ops::set_simd_level(best);
+
+      const double turns[] = { 0., 360., -360., 720., 1e10 + 90. };
+      double wrapped[5];
+      maths_ops::get_0_360_deg(wrapped, turns, 5);
+      std::cout << " 0, 360, -360, 720, 1e10 + 90 deg = " << wrapped[0] << ", " << wrapped[1] << ", " << wrapped[2] << ", " << wrapped[3] << ", " << wrapped[4]
+         << " deg (expected 0, 360, 0, 360, 10)" << std::endl;
+   }
+
    // --- vector_magnitude ---
    std::cout << "\nTesting 'vector_magnitude' \n";
    {
@@ -529,6 +599,835 @@ int main()
       std::cout << "(" << x << ", " << y << ")" << std::endl;
    }
 
+   // --- batch (structure of arrays) point transforms ---
+   std::cout << "\nTesting batch 'translate_point', 'rotate_point' and 'rotate_point_about' \n";
+   {
+      const size_t n = 1000;
+      double rotation_mat[4];
+      maths_ops::calculate_rotation_matrix(M_PI / 3, rotation_mat);
+
+      std::vector<float> xs(n), ys(n);
+      for (size_t i = 0; i < n; ++i)
+      {
+         xs[i] = 0.5f * static_cast<float>(i);
+         ys[i] = 100.f - 0.25f * static_cast<float>(i);
+      }
+
+      // In place against the scalar versions
+      std::vector<float> xs_batch = xs, ys_batch = ys;
+      std::vector<float> xs_scalar = xs, ys_scalar = ys;
+      maths_ops::translate_point(xs_batch.data(), ys_batch.data(), n, 1.5f, -2.5f);
+      maths_ops::rotate_point(xs_batch.data(), ys_batch.data(), n, rotation_mat);
+      maths_ops::rotate_point_about(xs_batch.data(), ys_batch.data(), n, rotation_mat, 10.0, 20.0);
+      for (size_t i = 0; i < n; ++i)
+      {
+         maths_ops::translate_point(&xs_scalar[i], &ys_scalar[i], 1.5f, -2.5f);
+         maths_ops::rotate_point(&xs_scalar[i], &ys_scalar[i], rotation_mat);
+         maths_ops::rotate_point_about(&xs_scalar[i], &ys_scalar[i], rotation_mat, 10.0, 20.0);
+      }
+
+      float max_diff = 0.f;
+      for (size_t i = 0; i < n; ++i)
+         max_diff = std::max(max_diff, std::max(std::fabs(xs_batch[i] - xs_scalar[i]), std::fabs(ys_batch[i] - ys_scalar[i])));
+      std::cout << " " << n << " points, in place: max difference from the scalar versions = " << max_diff << " (expected < 1e-4)" << std::endl;
+
+      // Into other arrays; rotating about (x, y) leaves (x, y) where it is
+      std::vector<float> xs_out(n), ys_out(n);
+      maths_ops::rotate_point_about(xs_out.data(), ys_out.data(), xs.data(), ys.data(), n, rotation_mat, xs[7], ys[7]);
+      std::cout << " (" << xs[7] << ", " << ys[7] << ") about itself => (" << xs_out[7] << ", " << ys_out[7] << ")" << std::endl;
+
+      maths_ops::rotate_point(xs_out.data(), ys_out.data(), xs.data(), ys.data(), n, rotation_mat);
+      maths_ops::translate_point(xs.data(), ys.data(), xs_out.data(), ys_out.data(), n, 0.f, 0.f);
+      std::cout << " (" << xs_out[2] << ", " << ys_out[2] << ") copied back => (" << xs[2] << ", " << ys[2] << ")" << std::endl;
+   }
+
+   // --- SIMD array versions, for each instruction set the CPU supports ---
+   std::cout << "\nTesting array 'points_squared_distance', 'points_distance', 'vector_magnitude', 'vector_direction_fast' and 'nearest_point' \n";
+   {
+      const maths_ops::simd_level best = maths_ops::detect_simd_level();
+      const char* level_names[] = { "scalar", "avx2", "avx512" };
+      std::cout << " Best instruction set: " << level_names[static_cast<int>(best)] << std::endl;
+
+      // Not a multiple of any register width, to go through the scalar tail as well
+      const size_t n = 1003;
+      std::vector<double> xs(n), ys(n);
+      std::vector<float> xsf(n), ysf(n);
+      for (size_t i = 0; i < n; ++i)
+      {
+         xs[i] = 50. * std::cos(0.37 * i) + 0.01 * i;
+         ys[i] = 30. * std::sin(0.11 * i) - 0.02 * i;
+         xsf[i] = static_cast<float>(xs[i]);
+         ysf[i] = static_cast<float>(ys[i]);
+      }
+      xs[0] = ys[0] = 0.;
+      xsf[0] = ysf[0] = 0.f;
+
+      for (int level = 0; level <= static_cast<int>(best); ++level)
+      {
+         maths_ops::set_simd_level(static_cast<maths_ops::simd_level>(level));
+
+         std::vector<double> d2(n), d(n), mag(n), dir(n);
+         maths_ops::points_squared_distance(d2.data(), xs.data(), ys.data(), n, 3., -4.);
+         maths_ops::points_distance(d.data(), xs.data(), ys.data(), n, 3., -4.);
+         maths_ops::vector_magnitude(mag.data(), xs.data(), ys.data(), n);
+         maths_ops::vector_direction_fast(dir.data(), xs.data(), ys.data(), n);
+
+         double max_diff = 0., max_dir_error = 0.;
+         for (size_t i = 0; i < n; ++i)
+         {
+            max_diff = std::max(max_diff, std::fabs(d2[i] - maths_ops::points_squared_distance(xs[i], ys[i], 3., -4.)) / (1. + d2[i]));
+            max_diff = std::max(max_diff, std::fabs(d[i] - maths_ops::points_distance(xs[i], ys[i], 3., -4.)) / (1. + d[i]));
+            max_diff = std::max(max_diff, std::fabs(mag[i] - maths_ops::vector_magnitude(xs[i], ys[i])) / (1. + mag[i]));
+            max_dir_error = std::max(max_dir_error, std::fabs(dir[i] - std::atan2(ys[i], xs[i])));
+         }
+
+         std::vector<float> dirf(n);
+         maths_ops::vector_direction_fast(dirf.data(), xsf.data(), ysf.data(), n);
+         double max_dirf_error = 0.;
+         for (size_t i = 0; i < n; ++i)
+            max_dirf_error = std::max(max_dirf_error, std::fabs(static_cast<double>(dirf[i]) - std::atan2(static_cast<double>(ysf[i]), static_cast<double>(xsf[i]))));
+
+         float nearest_d2f = 0.f;
+         double nearest_d2 = 0.;
+         const size_t nearest_f = maths_ops::nearest_point(&nearest_d2f, xsf.data(), ysf.data(), n, 10.f, 10.f);
+         const size_t nearest_d = maths_ops::nearest_point(&nearest_d2, xs.data(), ys.data(), n, 10., 10.);
+         size_t expected = 0;
+         for (size_t i = 1; i < n; ++i)
+         {
+            if (maths_ops::points_squared_distance(xs[i], ys[i], 10., 10.) < maths_ops::points_squared_distance(xs[expected], ys[expected], 10., 10.))
+               expected = i;
+         }
+
+         std::cout << " " << level_names[level] << ": max relative difference " << max_diff << " (expected < 1e-15)"
+            << ", fast direction error double " << max_dir_error << " float " << max_dirf_error << " (expected < 2e-6)"
+            << ", nearest " << nearest_d << " / " << nearest_f << " (expected " << expected << ")" << std::endl;
+      }
+      maths_ops::set_simd_level(best);
+
+      size_t nearest[3];
+      const double qxs[] = { 0., 10., 1000. };
+      const double qys[] = { 0., 10., 1000. };
+      maths_ops::nearest_points(nearest, static_cast<double*>(nullptr), qxs, qys, 3, xs.data(), ys.data(), n);
+      std::cout << " Nearest to (0, 0), (10, 10), (1000, 1000): " << nearest[0] << ", " << nearest[1] << ", " << nearest[2] << " (expected 0, ...)" << std::endl;
+      std::cout << " Nearest in an empty set: " << maths_ops::nearest_point(static_cast<double*>(nullptr), xs.data(), ys.data(), 0, 1., 1.) << " (expected 0)" << std::endl;
+   }
+
+   // --- fast_atan2 ---
+   std::cout << "\nTesting 'fast_atan2' \n";
+   {
+      double max_error = 0.;
+      for (int i = 0; i < 3600; ++i)
+      {
+         for (double r : { 1e-3, 1., 1e4 })
+         {
+            const double x = r * std::cos(i * M_PI / 1800.);
+            const double y = r * std::sin(i * M_PI / 1800.);
+            max_error = std::max(max_error, std::fabs(maths_ops::fast_atan2(y, x) - std::atan2(y, x)));
+         }
+      }
+      std::cout << " max error around the circle = " << max_error << " rad (expected < 2e-6)" << std::endl;
+      std::cout << " fast_atan2(0, 0) = " << maths_ops::fast_atan2(0.f, 0.f) << ", fast_atan2(1, -1) = " << maths_ops::fast_atan2(1.f, -1.f)
+         << " (expected 0, " << std::atan2(1.f, -1.f) << ")" << std::endl;
+   }
+
+   // --- Geotransform grids and arrays of points, for each instruction set the CPU supports ---
+   std::cout << "\nTesting 'apply_geotransform_grid' and array 'apply_inverse_geotransform' \n";
+   {
+      const maths_ops::simd_level best = maths_ops::detect_simd_level();
+      const char* level_names[] = { "scalar", "avx2", "avx512" };
+
+      double geotransform[6];
+      maths_ops::set_affine_geotransform(geotransform, 350000., 4200000., 10., 10., 0.2);
+
+      // A window with rows not a multiple of any register width, large enough
+      // in double to be written around the caches
+      const size_t first_row = 5, nrows = 1100, first_col = 7, ncols = 1003;
+      const size_t ncells = nrows * ncols;
+      for (int level = 0; level <= static_cast<int>(best); ++level)
+      {
+         maths_ops::set_simd_level(static_cast<maths_ops::simd_level>(level));
+
+         std::vector<double> xs(ncells), ys(ncells), xs_threads(ncells), ys_threads(ncells);
+         maths_ops::apply_geotransform_grid(xs.data(), ys.data(), first_row, nrows, first_col, ncols, geotransform, 1);
+         maths_ops::apply_geotransform_grid(xs_threads.data(), ys_threads.data(), first_row, nrows, first_col, ncols, geotransform, 4);
+
+         std::vector<float> xsf(ncells), ysf(ncells);
+         maths_ops::apply_geotransform_grid(xsf.data(), ysf.data(), first_row, nrows, first_col, ncols, geotransform);
+
+         double max_diff = 0., max_diff_f = 0., max_diff_threads = 0.;
+         for (size_t i = 0; i < nrows; ++i)
+         {
+            for (size_t j = 0; j < ncols; ++j)
+            {
+               double x = 0., y = 0.;
+               maths_ops::apply_geotransform(&x, &y, first_row + i, first_col + j, geotransform);
+               const size_t k = i * ncols + j;
+               max_diff = std::max(max_diff, std::max(std::fabs(xs[k] - x), std::fabs(ys[k] - y)));
+               max_diff_f = std::max(max_diff_f, std::max(std::fabs(xsf[k] - x), std::fabs(ysf[k] - y)));
+               max_diff_threads = std::max(max_diff_threads, std::max(std::fabs(xs_threads[k] - xs[k]), std::fabs(ys_threads[k] - ys[k])));
+            }
+         }
+
+         // Inverse of points a third of a pixel away from the pixel corners, to stay clear of the rounding ties
+         std::vector<double> pxs(ncells), pys(ncells);
+         std::vector<float> pxsf(ncells), pysf(ncells);
+         for (size_t k = 0; k < ncells; ++k)
+         {
+            const double row = static_cast<double>(first_row + k / ncols) + (k % 3 == 0 ? 0.3 : -0.3);
+            const double col = static_cast<double>(first_col + k % ncols) + (k % 5 == 0 ? -0.3 : 0.3);
+            maths_ops::apply_geotransform(&pxs[k], &pys[k], row, col, geotransform);
+            pxsf[k] = static_cast<float>(pxs[k]);
+            pysf[k] = static_cast<float>(pys[k]);
+         }
+         std::vector<long> irows(ncells), icols(ncells);
+         std::vector<int> irowsf(ncells), icolsf(ncells);
+         maths_ops::apply_inverse_geotransform(irows.data(), icols.data(), pxs.data(), pys.data(), ncells, geotransform);
+         maths_ops::apply_inverse_geotransform(irowsf.data(), icolsf.data(), pxsf.data(), pysf.data(), ncells, geotransform, 1);
+
+         size_t mismatches = 0, mismatches_f = 0;
+         for (size_t k = 0; k < ncells; ++k)
+         {
+            long irow = 0, icol = 0;
+            maths_ops::apply_inverse_geotransform(&irow, &icol, pxs[k], pys[k], geotransform);
+            mismatches += (irows[k] != irow || icols[k] != icol) ? 1 : 0;
+            mismatches_f += (irowsf[k] != irow || icolsf[k] != icol) ? 1 : 0;
+         }
+
+         std::cout << " " << level_names[level] << ": grid max difference double " << max_diff << " (expected < 1e-8), float " << max_diff_f
+            << " (expected < 1, the float spacing there is 0.5), threads " << max_diff_threads << " (expected 0)"
+            << "; inverse mismatches double " << mismatches << " float " << mismatches_f << " of " << ncells << " (expected 0)" << std::endl;
+      }
+      maths_ops::set_simd_level(best);
+
+      // Rounding half away from zero, as the single point version
+      const double xs_half[] = { 350000. + 5., 350000. - 5., 350000. + 15. };
+      const double ys_half[] = { 4200000., 4200000., 4200000. };
+      double north_up[6];
+      maths_ops::set_affine_geotransform(north_up, 350000., 4200000., 10., 10., 0.);
+      int irows_half[3], icols_half[3];
+      maths_ops::apply_inverse_geotransform(irows_half, icols_half, xs_half, ys_half, 3, north_up);
+      std::cout << " Columns of x = 0.5, -0.5, 1.5 pixels: " << icols_half[0] << ", " << icols_half[1] << ", " << icols_half[2] << " (expected 1, -1, 2)" << std::endl;
+   }
+
+   // --- Polygons: area, centroid, point in polygon and raster masks ---
+   std::cout << "\nTesting 'polygon_area', 'polygon_centroid', 'points_in_polygon' and 'polygon_mask' \n";
+   {
+      // A 4x2 rectangle, clockwise, far from the origin
+      const double rxs[] = { 500000., 500000., 500004., 500004. };
+      const double rys[] = { 4000000., 4000002., 4000002., 4000000. };
+      double cx = 0., cy = 0.;
+      maths_ops::polygon_centroid(&cx, &cy, rxs, rys, 4);
+      std::cout << std::setprecision(10) << " Rectangle: signed area " << maths_ops::polygon_signed_area(rxs, rys, 4)
+         << ", centroid (" << cx << ", " << cy << ") (expected -8, (500002, 4000001))" << std::setprecision(6) << std::endl;
+
+      // A star-like ring, with vertices at the heights of some of the test points
+      const size_t nvertices = 400;
+      std::vector<double> pxs(nvertices), pys(nvertices);
+      for (size_t i = 0; i < nvertices; ++i)
+      {
+         const double angle = 2. * M_PI * static_cast<double>(i) / static_cast<double>(nvertices);
+         const double radius = 100. * (1. + 0.4 * std::sin(7. * angle));
+         pxs[i] = 350000. + radius * std::cos(angle);
+         pys[i] = std::round(4200000. + radius * std::sin(angle));
+      }
+      const maths_ops::polygon_edge_table<double> polygon(pxs.data(), pys.data(), nvertices);
+
+      // Plain even-odd loop over all the edges
+      auto brute_force = [&](const double x, const double y) {
+         bool in = false;
+         for (size_t i = 0, j = nvertices - 1; i < nvertices; j = i++)
+         {
+            if ((pys[i] > y) != (pys[j] > y) && x < pxs[i] + (y - pys[i]) * (pxs[j] - pxs[i]) / (pys[j] - pys[i]))
+               in = !in;
+         }
+         return in;
+      };
+
+      const size_t npoints = 200000;
+      std::vector<double> xs(npoints), ys(npoints);
+      for (size_t k = 0; k < npoints; ++k)
+      {
+         xs[k] = 350000. + 150. * std::sin(0.731 * static_cast<double>(k));
+         ys[k] = 4200000. + (k % 4 == 0 ? std::round(150. * std::cos(1.37 * static_cast<double>(k))) : 150. * std::cos(1.37 * static_cast<double>(k)));
+      }
+      std::vector<uint8_t> inside(npoints), inside_threads(npoints);
+      maths_ops::points_in_polygon(inside.data(), xs.data(), ys.data(), npoints, polygon, 1);
+      maths_ops::points_in_polygon(inside_threads.data(), xs.data(), ys.data(), npoints, polygon, 4);
+      size_t mismatches = 0, mismatches_threads = 0, count = 0;
+      for (size_t k = 0; k < npoints; ++k)
+      {
+         mismatches += (inside[k] != 0) != brute_force(xs[k], ys[k]) ? 1 : 0;
+         mismatches_threads += inside[k] != inside_threads[k] ? 1 : 0;
+         count += inside[k];
+      }
+      std::cout << " Points inside " << count << " of " << npoints << "; mismatches against all the edges " << mismatches
+         << ", threads " << mismatches_threads << " (expected 0, 0)" << std::endl;
+
+      // Masks of a rotated grid against the test of each cell centre
+      double geotransform[6];
+      maths_ops::set_affine_geotransform(geotransform, 349800., 4200200., 0.37, 0.41, 0.3);
+      const size_t first_row = 3, nrows = 1000, first_col = 11, ncols = 1000;
+      std::vector<uint8_t> mask(nrows * ncols), mask_threads(nrows * ncols);
+      maths_ops::polygon_mask(mask.data(), first_row, nrows, first_col, ncols, geotransform, polygon, 1);
+      maths_ops::polygon_mask(mask_threads.data(), first_row, nrows, first_col, ncols, geotransform, polygon, 4);
+      size_t mask_mismatches = 0, mask_mismatches_threads = 0, cells = 0;
+      for (size_t i = 0; i < nrows; ++i)
+      {
+         for (size_t j = 0; j < ncols; ++j)
+         {
+            double x = 0., y = 0.;
+            maths_ops::apply_geotransform(&x, &y, first_row + i + 0.5, first_col + j + 0.5, geotransform);
+            const size_t k = i * ncols + j;
+            mask_mismatches += (mask[k] != 0) != polygon.contains(x, y) ? 1 : 0;
+            mask_mismatches_threads += mask[k] != mask_threads[k] ? 1 : 0;
+            cells += mask[k];
+         }
+      }
+      std::cout << " Mask cells inside " << cells << " of " << nrows * ncols << " (about " << static_cast<size_t>(maths_ops::polygon_area(pxs.data(), pys.data(), nvertices) / (0.37 * 0.41))
+         << "); mismatches against the centres " << mask_mismatches << ", threads " << mask_mismatches_threads << " (expected 0, 0)" << std::endl;
+
+      const double two[] = { 0., 1. };
+      const maths_ops::polygon_edge_table<double> degenerate(two, two, 2);
+      std::cout << " Degenerate polygon contains (0.5, 0.5): " << degenerate.contains(0.5, 0.5) << " (expected 0)" << std::endl;
+
+      // A comb of tall teeth: every edge spans most of the height, so few bands
+      std::vector<double> comb_xs, comb_ys;
+      for (int i = 0; i < 2000; ++i)
+      {
+         comb_xs.insert(comb_xs.end(), { i + 0., i + 0., i + 0.5, i + 0.5 });
+         comb_ys.insert(comb_ys.end(), { 0., 1000., 1000., 0. });
+      }
+      comb_xs.insert(comb_xs.end(), { 2000., 0. });
+      comb_ys.insert(comb_ys.end(), { -1., -1. });
+      const maths_ops::polygon_edge_table<double> comb(comb_xs.data(), comb_ys.data(), comb_xs.size());
+      std::cout << " Comb of " << comb.size() << " vertices: " << comb.bands() << " bands (expected at most 6), contains (0.25, 500), (0.75, 500): "
+         << comb.contains(0.25, 500.) << ", " << comb.contains(0.75, 500.) << " (expected 1, 0)" << std::endl;
+   }
+
+   // --- Spatial indexes: uniform grid and KD-tree against testing every point ---
+   std::cout << "\nTesting 'uniform_grid_index', 'kd_tree', 'nearest_points' and 'k_nearest_points' \n";
+   {
+      // Half the points spread out, half in a tight cluster, with some repeated
+      const size_t n = 20000;
+      std::vector<double> xs(n), ys(n);
+      for (size_t i = 0; i < n; ++i)
+      {
+         const double scale = i % 2 == 0 ? 1000. : 5.;
+         xs[i] = 350000. + scale * std::sin(0.7137 * static_cast<double>(i));
+         ys[i] = 4200000. + scale * std::cos(1.3711 * static_cast<double>(i / 3 * 3));
+      }
+      const size_t m = 3000;
+      std::vector<double> qxs(m), qys(m);
+      for (size_t q = 0; q < m; ++q)
+      {
+         qxs[q] = 350000. + 1200. * std::sin(0.419 * static_cast<double>(q));
+         qys[q] = 4200000. + (q % 2 == 0 ? 1200. : 8.) * std::cos(0.877 * static_cast<double>(q));
+      }
+
+      const maths_ops::uniform_grid_index<double> grid(xs.data(), ys.data(), n);
+      const maths_ops::kd_tree<double> tree(xs.data(), ys.data(), n, 1);
+      const maths_ops::kd_tree<double> tree_threads(xs.data(), ys.data(), n, 4);
+
+      const size_t k = 5;
+      std::vector<size_t> nearest_grid(m), nearest_tree(m), knn_grid(m * k), knn_tree(m * k);
+      std::vector<double> d2_grid(m), d2_tree(m), knn_d2_grid(m * k), knn_d2_tree(m * k);
+      maths_ops::nearest_points(nearest_grid.data(), d2_grid.data(), grid, qxs.data(), qys.data(), m, 1);
+      maths_ops::nearest_points(nearest_tree.data(), d2_tree.data(), tree_threads, qxs.data(), qys.data(), m, 4);
+      maths_ops::k_nearest_points(knn_grid.data(), knn_d2_grid.data(), k, grid, qxs.data(), qys.data(), m);
+      maths_ops::k_nearest_points(knn_tree.data(), knn_d2_tree.data(), k, tree, qxs.data(), qys.data(), m);
+
+      size_t nearest_mismatches = 0, knn_mismatches = 0, radius_mismatches = 0, segment_mismatches = 0;
+      std::vector<double> d2(n);
+      std::vector<size_t> found, expected;
+      for (size_t q = 0; q < m; ++q)
+      {
+         // Ties may resolve to different points, so the distances are compared
+         for (size_t i = 0; i < n; ++i)
+            d2[i] = maths_ops::points_squared_distance(xs[i], ys[i], qxs[q], qys[q]);
+         const double d2_brute = *std::min_element(d2.begin(), d2.end());
+         nearest_mismatches += (d2_grid[q] != d2_brute || d2_tree[q] != d2_brute) ? 1 : 0;
+
+         std::vector<double> sorted(d2);
+         std::partial_sort(sorted.begin(), sorted.begin() + k, sorted.end());
+         for (size_t j = 0; j < k; ++j)
+            knn_mismatches += (knn_d2_grid[q * k + j] != sorted[j] || knn_d2_tree[q * k + j] != sorted[j]) ? 1 : 0;
+
+         // Radius and segment queries on a sample of the query points
+         if (q % 10 != 0)
+            continue;
+         const double radius = q % 20 == 0 ? 30. : 1.;
+         expected.clear();
+         for (size_t i = 0; i < n; ++i)
+         {
+            if (d2[i] <= radius * radius)
+               expected.push_back(i);
+         }
+         for (int which = 0; which < 2; ++which)
+         {
+            found.clear();
+            if (which == 0)
+               grid.within_radius(found, qxs[q], qys[q], radius);
+            else
+               tree.within_radius(found, qxs[q], qys[q], radius);
+            std::sort(found.begin(), found.end());
+            radius_mismatches += found != expected ? 1 : 0;
+         }
+
+         const double bx = qxs[q] + 300. * std::cos(static_cast<double>(q));
+         const double by = qys[q] + 300. * std::sin(static_cast<double>(q));
+         expected.clear();
+         for (size_t i = 0; i < n; ++i)
+         {
+            if (maths_ops::point_segment_squared_distance(qxs[q], qys[q], bx, by, xs[i], ys[i]) <= radius * radius)
+               expected.push_back(i);
+         }
+         for (int which = 0; which < 2; ++which)
+         {
+            found.clear();
+            if (which == 0)
+               grid.near_segment(found, qxs[q], qys[q], bx, by, radius);
+            else
+               tree.near_segment(found, qxs[q], qys[q], bx, by, radius);
+            std::sort(found.begin(), found.end());
+            segment_mismatches += found != expected ? 1 : 0;
+         }
+      }
+      std::cout << " Mismatches against all the points: nearest " << nearest_mismatches << ", k-nearest " << knn_mismatches
+         << ", radius " << radius_mismatches << ", segment " << segment_mismatches << " (expected 0, 0, 0, 0)" << std::endl;
+
+      // Fewer points than asked for, and empty indexes
+      const double two_xs[] = { 0., 1. };
+      const double two_ys[] = { 0., 0. };
+      const maths_ops::kd_tree<double> small(two_xs, two_ys, 2);
+      size_t ids[3];
+      double d2s[3];
+      const size_t count = small.k_nearest(ids, d2s, 3, 0.9, 0.);
+      const maths_ops::uniform_grid_index<double> empty(two_xs, two_ys, 0);
+      std::cout << " 3 nearest of 2 points: " << count << " found, " << ids[0] << ", " << ids[1] << ", " << ids[2]
+         << " (expected 2 found, 1, 0, 2); nearest in an empty grid: " << empty.nearest(static_cast<double*>(nullptr), 1., 1.) << " (expected 0)" << std::endl;
+
+      // Points all at the same place: a single cell
+      const double same_xs[] = { 3., 3., 3., 3., 3. };
+      const double same_ys[] = { -2., -2., -2., -2., -2. };
+      const maths_ops::uniform_grid_index<double> same(same_xs, same_ys, 5);
+      double same_d2 = -1.;
+      const size_t same_id = same.nearest(&same_d2, 100., 100.);
+      std::cout << " Grid of 5 coincident points: cell size " << same.cell_size() << " (expected 1), nearest to (100, 100) "
+         << same_id << " (expected 0 to 4) at squared distance " << same_d2 << " (expected 19813)" << std::endl;
+   }
+
+   // --- Segment intersections: exact tests and the sweep against testing every pair ---
+   std::cout << "\nTesting 'orientation', 'segments_intersect', 'segment_intersection' and 'find_segment_intersections' \n";
+   {
+      // Points near (0.5, 0.5) against the line through (12, 12) and (24, 24), where a plain
+      // cross product often gets the side wrong (Kettner et al., Classroom examples of robustness problems)
+      int wrong = 0, wrong_naive = 0;
+      for (int i = 0; i < 64; ++i)
+      {
+         for (int j = 0; j < 64; ++j)
+         {
+            const double px = 0.5 + i * std::numeric_limits<double>::epsilon();
+            const double py = 0.5 + j * std::numeric_limits<double>::epsilon();
+            const int expected = j > i ? 1 : (j < i ? -1 : 0);
+            const double naive = maths_ops::cross_product(12. - px, 12. - py, 24. - px, 24. - py);
+            wrong += maths_ops::orientation(px, py, 12., 12., 24., 24.) != expected ? 1 : 0;
+            wrong_naive += (naive > 0. ? 1 : (naive < 0. ? -1 : 0)) != expected ? 1 : 0;
+         }
+      }
+      std::cout << " Orientation of points next to a line: " << wrong << " wrong of 4096 (expected 0; plain cross product " << wrong_naive << " wrong)" << std::endl;
+
+      double x = 0., y = 0.;
+      const int crossing = maths_ops::segment_intersection(&x, &y, 350000., 4200000., 350010., 4200010., 350000., 4200010., 350010., 4200000.);
+      std::cout << std::setprecision(10) << " Crossing of the diagonals of a square: " << crossing << " at (" << x << ", " << y << ") (expected 1 at (350005, 4200005))";
+      const int overlap = maths_ops::segment_intersection(&x, &y, 0., 0., 4., 2., 6., 3., 2., 1.);
+      std::cout << "; collinear overlap: " << overlap << " from (" << x << ", " << y << ") (expected 2 from (2, 1))";
+      std::cout << "; touching ends: " << maths_ops::segments_intersect(0., 0., 1., 1., 1., 1., 2., 0.)
+         << ", parallel apart: " << maths_ops::segments_intersect(0., 0., 1., 1., 0., 0x1p-52, 1., 1. + 0x1p-52) << " (expected 1, 0)" << std::setprecision(6) << std::endl;
+
+      // Segments on a small integer grid, full of shared ends, collinear overlaps, vertical,
+      // horizontal, repeated and zero-length segments, and segments crossing at shared points
+      auto brute_force = [](const std::vector<double>& x1, const std::vector<double>& y1, const std::vector<double>& x2,
+         const std::vector<double>& y2, const bool skip_shared_ends) {
+         std::vector<std::pair<size_t, size_t>> pairs;
+         for (size_t i = 0; i < x1.size(); ++i)
+         {
+            for (size_t j = i + 1; j < x1.size(); ++j)
+            {
+               if (!maths_ops::segments_intersect(x1[i], y1[i], x2[i], y2[i], x1[j], y1[j], x2[j], y2[j]))
+                  continue;
+               if (skip_shared_ends)
+               {
+                  // A shared end, and no overlap beyond it
+                  bool skip = false;
+                  const double ex[2][2] = { { x1[i], x2[i] }, { x1[j], x2[j] } };
+                  const double ey[2][2] = { { y1[i], y2[i] }, { y1[j], y2[j] } };
+                  for (int a = 0; a < 2; ++a)
+                  {
+                     for (int b = 0; b < 2; ++b)
+                     {
+                        if (ex[0][a] != ex[1][b] || ey[0][a] != ey[1][b])
+                           continue;
+                        const double ux = ex[0][1 - a] - ex[0][a], uy = ey[0][1 - a] - ey[0][a];
+                        const double vx = ex[1][1 - b] - ex[1][b], vy = ey[1][1 - b] - ey[1][b];
+                        skip = skip || maths_ops::cross_product(ux, uy, vx, vy) != 0. || maths_ops::dot_product(ux, uy, vx, vy) <= 0.;
+                     }
+                  }
+                  if (skip)
+                     continue;
+               }
+               pairs.emplace_back(i, j);
+            }
+         }
+         return pairs;
+      };
+
+      size_t mismatched_sets = 0, total_pairs = 0;
+      for (int set = 0; set < 40; ++set)
+      {
+         const size_t n = 150;
+         std::vector<double> x1(n), y1(n), x2(n), y2(n);
+         for (size_t i = 0; i < n; ++i)
+         {
+            const double t = static_cast<double>(i * 7 + set * 131);
+            if (set % 2 == 0)
+            {
+               // A grid of 9 x 9 points
+               x1[i] = std::floor(4.5 + 4.49 * std::sin(0.913 * t));
+               y1[i] = std::floor(4.5 + 4.49 * std::sin(1.731 * t));
+               x2[i] = std::floor(4.5 + 4.49 * std::sin(2.377 * t));
+               y2[i] = std::floor(4.5 + 4.49 * std::sin(0.571 * t));
+            }
+            else
+            {
+               // A closed random walk, as a coastline, with a few long segments across it
+               x1[i] = i == 0 ? 0. : x2[i - 1];
+               y1[i] = i == 0 ? 0. : y2[i - 1];
+               x2[i] = i + 1 == n ? 0. : x1[i] + 10. * std::sin(1.7 * t) + (i % 37 == 0 ? 40. : 0.);
+               y2[i] = i + 1 == n ? 0. : y1[i] + 10. * std::cos(1.3 * t);
+            }
+         }
+         const bool skip_shared_ends = set % 4 < 2 ? false : true;
+         std::vector<std::pair<size_t, size_t>> pairs;
+         maths_ops::find_segment_intersections(pairs, x1.data(), y1.data(), x2.data(), y2.data(), n, skip_shared_ends);
+         mismatched_sets += pairs != brute_force(x1, y1, x2, y2, skip_shared_ends) ? 1 : 0;
+         total_pairs += pairs.size();
+      }
+      std::cout << " Sweep against all the pairs: " << mismatched_sets << " of 40 sets differ (expected 0), " << total_pairs << " pairs found" << std::endl;
+
+      // One segment against many, with threads
+      const size_t m = 100000;
+      std::vector<double> x1(m), y1(m), x2(m), y2(m);
+      for (size_t i = 0; i < m; ++i)
+      {
+         x1[i] = 10. * std::sin(0.37 * static_cast<double>(i));
+         y1[i] = 10. * std::cos(0.71 * static_cast<double>(i));
+         x2[i] = x1[i] + std::sin(static_cast<double>(i));
+         y2[i] = y1[i] + std::cos(static_cast<double>(i));
+      }
+      std::vector<uint8_t> hits(m), hits_threads(m);
+      maths_ops::segments_intersect(hits.data(), x1.data(), y1.data(), x2.data(), y2.data(), m, -10., -3., 10., 3., 1);
+      maths_ops::segments_intersect(hits_threads.data(), x1.data(), y1.data(), x2.data(), y2.data(), m, -10., -3., 10., 3., 4);
+      size_t mismatches = 0, count = 0;
+      for (size_t i = 0; i < m; ++i)
+      {
+         mismatches += (hits[i] != 0) != maths_ops::segments_intersect(-10., -3., 10., 3., x1[i], y1[i], x2[i], y2[i]) ? 1 : 0;
+         mismatches += hits[i] != hits_threads[i] ? 1 : 0;
+         count += hits[i];
+      }
+      std::cout << " One against many: " << count << " of " << m << " intersect, mismatches " << mismatches << " (expected 0)" << std::endl;
+   }
+
+   // --- Integrators with function pointers, lambdas and batch integrands ---
+   std::cout << "\nTesting 'simpson', 'newton_cotes', 'newton_cotes38f' and 'gauss_chebyshev' \n";
+   {
+      double (*sine)(double) = [](double x) { return std::sin(x); };
+      const double pi = 3.14159265358979323846;
+      std::cout << std::setprecision(12);
+      std::cout << " Integral of sin over [0, pi] with 600 intervals (expected 2): simpson " << maths_ops::simpson(0., pi, 600, sine)
+         << ", trapezoidal " << maths_ops::newton_cotes(0., pi, 600, sine)
+         << ", 3/8 " << maths_ops::newton_cotes38f(0., pi, 600, sine)
+         << ", Gauss-Chebyshev " << maths_ops::gauss_chebyshev(0., pi, 600, sine) << std::endl;
+
+      // Odd counts leave out the last interval, as before
+      std::cout << " Simpson with 5 intervals of x over [0, 5] (expected 8): " << maths_ops::simpson(0., 5., 5, [](double x) { return x; })
+         << "; 3/8 with 7 intervals of x^3 over [0, 7] (expected 324): " << maths_ops::newton_cotes38f(0., 7., 7, [](double x) { return x * x * x; }) << std::endl;
+
+      // A stateful lambda counting its calls, and a batch integrand over the same function
+      size_t calls = 0, batch_calls = 0;
+      const double k = 3.;
+      auto point = [&calls, k](double x) { ++calls; return std::exp(-k * x) * std::cos(x); };
+      auto batch = [&batch_calls, k](const double* xs, double* ys, size_t n) {
+         ++batch_calls;
+         for (size_t i = 0; i < n; ++i)
+            ys[i] = std::exp(-k * xs[i]) * std::cos(xs[i]);
+      };
+      double largest_difference = 0.;
+      const size_t counts[] = { 0, 1, 2, 3, 6, 255, 256, 257, 1000 };
+      for (size_t n : counts)
+      {
+         largest_difference = std::max(largest_difference, std::abs(maths_ops::simpson(0., 2., n, point) - maths_ops::simpson(0., 2., n, batch)));
+         largest_difference = std::max(largest_difference, std::abs(maths_ops::newton_cotes(0., 2., n, point) - maths_ops::newton_cotes(0., 2., n, batch)));
+         largest_difference = std::max(largest_difference, std::abs(maths_ops::newton_cotes38f(0., 2., n, point) - maths_ops::newton_cotes38f(0., 2., n, batch)));
+         largest_difference = std::max(largest_difference, std::abs(maths_ops::gauss_chebyshev(0., 2., n, point) - maths_ops::gauss_chebyshev(0., 2., n, batch)));
+      }
+      const double exact = (k - std::exp(-2. * k) * (k * std::cos(2.) - std::sin(2.))) / (k * k + 1.);
+      calls = 0;
+      batch_calls = 0;
+      const double s = maths_ops::simpson(0., 2., 1000, point);
+      maths_ops::simpson(0., 2., 1000, batch);
+      std::cout << " Simpson of exp(-3x) cos(x) over [0, 2]: " << s << " (expected " << exact << "), " << calls << " calls (expected 1001), "
+         << batch_calls << " batch calls (expected 5); largest difference between point and batch integrands " << largest_difference << std::endl;
+
+      const float f_integral = maths_ops::simpson(0.f, 1.f, 100, [](float x) { return x * x; });
+      std::cout << std::setprecision(6) << " Simpson of x^2 over [0, 1] in float: " << f_integral << " (expected 0.333333)" << std::endl;
+   }
+
+   // --- Adaptive quadrature: Simpson, Gauss-Kronrod and tanh-sinh, with threads ---
+   std::cout << "\nTesting 'adaptive_simpson', 'gauss_kronrod_15', 'gauss_kronrod_21' and 'tanh_sinh' \n";
+   {
+      std::cout << std::setprecision(12);
+
+      // A sharp peak at x = 0.3 on top of a smooth background
+      auto peak = [](double x) { return 1. / ((x - 0.3) * (x - 0.3) + 1e-4) + std::exp(x); };
+      const double peak_exact = 100. * (std::atan(70.) + std::atan(30.)) + std::exp(1.) - 1.;
+      const double tolerance = 1e-9;
+      const maths_ops::quadrature_result<double> simpson = maths_ops::adaptive_simpson(0., 1., tolerance, peak);
+      const maths_ops::quadrature_result<double> gk15 = maths_ops::gauss_kronrod_15(0., 1., tolerance, peak);
+      const maths_ops::quadrature_result<double> gk21 = maths_ops::gauss_kronrod_21(0., 1., tolerance, peak);
+      std::cout << " Peak over [0, 1] to 1e-9 (expected " << peak_exact << "):" << std::endl;
+      std::cout << "  adaptive_simpson " << simpson.value << ", error " << std::abs(simpson.value - peak_exact) << " (estimate " << simpson.error
+         << "), " << simpson.evaluations << " calls, converged " << simpson.converged << std::endl;
+      std::cout << "  gauss_kronrod_15 " << gk15.value << ", error " << std::abs(gk15.value - peak_exact) << " (estimate " << gk15.error
+         << "), " << gk15.evaluations << " calls, converged " << gk15.converged << std::endl;
+      std::cout << "  gauss_kronrod_21 " << gk21.value << ", error " << std::abs(gk21.value - peak_exact) << " (estimate " << gk21.error
+         << "), " << gk21.evaluations << " calls, converged " << gk21.converged << std::endl;
+
+      // The reported calls against a counter, with threads and a batch integrand
+      std::atomic<size_t> calls(0);
+      auto counted_peak = [&calls, &peak](double x) { calls.fetch_add(1, std::memory_order_relaxed); return peak(x); };
+      auto batch_peak = [&calls, &peak](const double* xs, double* ys, size_t n) {
+         calls.fetch_add(n, std::memory_order_relaxed);
+         for (size_t i = 0; i < n; ++i)
+            ys[i] = peak(xs[i]);
+      };
+      bool counts_match = true, within_tolerance = true;
+      for (unsigned nthreads = 1; nthreads <= 4; nthreads *= 2)
+      {
+         maths_ops::quadrature_result<double> results[4];
+         calls = 0;
+         results[0] = maths_ops::adaptive_simpson(0., 1., tolerance, counted_peak, nthreads);
+         counts_match = counts_match && calls == results[0].evaluations;
+         calls = 0;
+         results[1] = maths_ops::gauss_kronrod_15(0., 1., tolerance, counted_peak, nthreads);
+         counts_match = counts_match && calls == results[1].evaluations;
+         calls = 0;
+         results[2] = maths_ops::gauss_kronrod_21(0., 1., tolerance, batch_peak, nthreads);
+         counts_match = counts_match && calls == results[2].evaluations;
+         calls = 0;
+         results[3] = maths_ops::adaptive_simpson(0., 1., tolerance, batch_peak, nthreads);
+         counts_match = counts_match && calls == results[3].evaluations;
+         for (const maths_ops::quadrature_result<double>& result : results)
+            within_tolerance = within_tolerance && result.converged && std::abs(result.value - peak_exact) <= tolerance;
+      }
+      std::cout << " With 1, 2 and 4 threads and batch integrands: calls counted as reported " << counts_match
+         << ", all within the tolerance " << within_tolerance << " (expected 1, 1)" << std::endl;
+
+      // Singular at the ends
+      const maths_ops::quadrature_result<double> inverse_sqrt = maths_ops::tanh_sinh(0., 1., 1e-12, [](double x) { return 1. / std::sqrt(x); });
+      const maths_ops::quadrature_result<double> log = maths_ops::tanh_sinh(0., 1., 1e-12, [](double x) { return std::log(x); });
+      const maths_ops::quadrature_result<double> both_ends = maths_ops::tanh_sinh(-1., 1., 1e-12, [](double x) { return std::log(1. - x * x); });
+      std::cout << " tanh_sinh of 1/sqrt(x) over [0, 1]: " << inverse_sqrt.value << " (expected 2), " << inverse_sqrt.evaluations << " calls; "
+         << "log(x): " << log.value << " (expected -1), " << log.evaluations << " calls; "
+         << "log(1 - x^2) over [-1, 1]: " << both_ends.value << " (expected " << 4. * std::log(2.) - 4. << "), " << both_ends.evaluations << " calls" << std::endl;
+      // Reversed limits change the sign
+      auto square = [](double x) { return x * x; };
+      const maths_ops::quadrature_result<double> reversed_ts = maths_ops::tanh_sinh(2., 0., 1e-10, square);
+      const maths_ops::quadrature_result<double> reversed_gk = maths_ops::gauss_kronrod_15(2., 0., 1e-10, square);
+      const maths_ops::quadrature_result<double> reversed_simpson = maths_ops::adaptive_simpson(2., 0., 1e-10, square);
+      std::cout << " x^2 over [2, 0]: tanh_sinh " << reversed_ts.value << " (converged " << reversed_ts.converged << "), gauss_kronrod_15 "
+         << reversed_gk.value << ", adaptive_simpson " << reversed_simpson.value << " (expected " << -8. / 3. << ", 1)" << std::endl;
+      const maths_ops::quadrature_result<double> gk_singular = maths_ops::gauss_kronrod_21(0., 1., 1e-12, [](double x) { return 1. / std::sqrt(x); });
+      std::cout << " gauss_kronrod_21 of 1/sqrt(x) for comparison: " << gk_singular.value << ", " << gk_singular.evaluations << " calls, converged " << gk_singular.converged << std::endl;
+
+      const maths_ops::quadrature_result<float> f_result = maths_ops::gauss_kronrod_15(0.f, 2.f, 1e-5f, [](float x) { return x * std::sin(x); });
+      std::cout << std::setprecision(6) << " gauss_kronrod_15 of x sin(x) over [0, 2] in float: " << f_result.value << " (expected "
+         << std::sin(2.) - 2. * std::cos(2.) << "), " << f_result.evaluations << " calls" << std::endl;
+   }
+
+   // --- Gauss rules: tables, cache, composite and per interval integrals ---
+   std::cout << "\nTesting 'gauss_rule' (Chebyshev, Legendre, Lobatto) \n";
+   {
+      std::cout << std::setprecision(6);
+
+      // Exact for polynomials up to degree 2n - 1 (Legendre) and 2n - 3 (Lobatto), 
+      // both from the tables and from the cache
+      auto power_error = [](const maths_ops::gauss_rule<double>& rule, const int degree) {
+         const double value = rule.integrate(0., 2., [degree](double x) { return std::pow(x, degree); });
+         const double exact = std::pow(2., degree + 1) / (degree + 1);
+         return std::abs(value - exact) / exact;
+      };
+      std::cout << " Relative errors for x^(2n-1), Legendre n = 5, 25: " << power_error(maths_ops::gauss_rule<double>(maths_ops::gauss_family::legendre, 5), 9)
+         << ", " << power_error(maths_ops::gauss_rule<double>(maths_ops::gauss_family::legendre, 25), 49)
+         << "; x^(2n-3), Lobatto n = 6, 25: " << power_error(maths_ops::gauss_rule<double>(maths_ops::gauss_family::lobatto, 6), 9)
+         << ", " << power_error(maths_ops::gauss_rule<double>(maths_ops::gauss_family::lobatto, 25), 47) << " (expected ~1e-16)" << std::endl;
+
+      // The Newton iterations for the cache against the tables
+      long double worst = 0.0L;
+      for (size_t order = 2; order <= 10; ++order)
+      {
+         for (const maths_ops::gauss_family family : { maths_ops::gauss_family::chebyshev, maths_ops::gauss_family::legendre, maths_ops::gauss_family::lobatto })
+         {
+            const maths_ops::gauss_rule<long double> table(family, order);
+            const std::vector<long double> computed = maths_ops::gauss_rule_detail::compute_rule(family, order);
+            for (size_t k = 0; k < order; ++k)
+               worst = std::max(worst, std::max(std::abs(computed[k] - table.nodes()[k]), std::abs(computed[order + k] - table.weights()[k])));
+         }
+      }
+      std::cout << " Largest difference of the computed rules from the tables, orders 2 to 10 in long double: " << static_cast<double>(worst) << " (expected ~1e-19)" << std::endl;
+
+      // The Chebyshev rule of n + 1 nodes is that of gauss_chebyshev with n points
+      auto smooth = [](double x) { return std::exp(-x) * std::cos(3. * x); };
+      const double cheb_small = maths_ops::gauss_rule<double>(maths_ops::gauss_family::chebyshev, 8).integrate(0., 2., smooth);
+      const double cheb_large = maths_ops::gauss_rule<double>(maths_ops::gauss_family::chebyshev, 41).integrate(0., 2., smooth);
+      std::cout << " Chebyshev rules against gauss_chebyshev, 8 and 41 nodes: " << cheb_small - maths_ops::gauss_chebyshev(0., 2., 7, smooth)
+         << ", " << cheb_large - maths_ops::gauss_chebyshev(0., 2., 40, smooth) << " (expected ~1e-16)" << std::endl;
+
+      // Composite rules; Lobatto evaluates the ends between intervals once
+      size_t calls = 0;
+      auto counted_sin = [&calls](double x) { ++calls; return std::sin(x); };
+      auto batch_sin = [&calls](const double* xs, double* ys, size_t n) {
+         calls += n;
+         for (size_t i = 0; i < n; ++i)
+            ys[i] = std::sin(xs[i]);
+      };
+      const maths_ops::gauss_rule<double> legendre3(maths_ops::gauss_family::legendre, 3);
+      const maths_ops::gauss_rule<double> lobatto4(maths_ops::gauss_family::lobatto, 4);
+      const double legendre_composite = legendre3.integrate(0., M_PI, counted_sin, 100);
+      const size_t legendre_calls = calls;
+      calls = 0;
+      const double lobatto_point = lobatto4.integrate(0., M_PI, counted_sin, 100);
+      const size_t lobatto_calls = calls;
+      calls = 0;
+      const double lobatto_batch = lobatto4.integrate(0., M_PI, batch_sin, 100);
+      std::cout << std::setprecision(15) << " sin over [0, pi] in 100 intervals: Legendre 3 " << legendre_composite << " (" << legendre_calls
+         << " calls), Lobatto 4 " << lobatto_point << " and batch " << lobatto_batch << " (" << lobatto_calls << " and " << calls
+         << " calls; expected 2, 300, 301)" << std::endl;
+
+      // Many intervals, e.g. the cells of a row, with threads and a batch integrand
+      const size_t ncells = 100000;
+      std::vector<double> firsts(ncells), lasts(ncells), out_point(ncells), out_batch(ncells);
+      for (size_t i = 0; i < ncells; ++i)
+      {
+         firsts[i] = 0.001 * static_cast<double>(i);
+         lasts[i] = firsts[i] + 0.001;
+      }
+      const maths_ops::gauss_rule<double> legendre4(maths_ops::gauss_family::legendre, 4);
+      legendre4.integrate_each(firsts.data(), lasts.data(), ncells, out_point.data(), [](double x) { return std::sin(x); }, 2);
+      legendre4.integrate_each(firsts.data(), lasts.data(), ncells, out_batch.data(), [](const double* xs, double* ys, size_t n) {
+         for (size_t i = 0; i < n; ++i)
+            ys[i] = std::sin(xs[i]);
+      }, 2);
+      double worst_cell = 0.;
+      for (size_t i = 0; i < ncells; ++i)
+      {
+         const double exact = std::cos(firsts[i]) - std::cos(lasts[i]);
+         worst_cell = std::max(worst_cell, std::max(std::abs(out_point[i] - exact), std::abs(out_batch[i] - exact)));
+      }
+      std::cout << std::setprecision(6) << " integrate_each over " << ncells << " cells, 2 threads, largest error: " << worst_cell << " (expected ~1e-16)" << std::endl;
+
+      // The cache hands out one copy of each order, also to threads asking at once
+      const double* cached[4] = {};
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t)
+         threads.emplace_back([&cached, t] { cached[t] = maths_ops::gauss_rule<double>(maths_ops::gauss_family::legendre, 37).nodes(); });
+      for (std::thread& thread : threads)
+         thread.join();
+      const bool shared = cached[0] == cached[1] && cached[1] == cached[2] && cached[2] == cached[3] &&
+         cached[0] == maths_ops::gauss_rule<double>(maths_ops::gauss_family::legendre, 37).nodes();
+      std::cout << " Order 37 from 4 threads at once shares one copy: " << shared << " (expected 1)" << std::endl;
+
+      const float f_value = maths_ops::gauss_rule<float>(maths_ops::gauss_family::legendre, 6).integrate(0.f, 2.f, [](float x) { return x * std::sin(x); });
+      std::cout << " Legendre 6 of x sin(x) over [0, 2] in float: " << f_value << " (expected " << std::sin(2.) - 2. * std::cos(2.) << ")" << std::endl;
+   }
+
+   // --- Integration in 2D and 3D: boxes and raster cells ---
+   std::cout << "\nTesting 'integrate_box', 'integrate_raster_cells' and the cubature rules \n";
+   {
+      std::cout << std::setprecision(12);
+
+      // Degree 5 polynomials are integrated exactly
+      const maths_ops::gauss_rule<double> legendre3(maths_ops::gauss_family::legendre, 3);
+      auto poly2 = [](double x, double y) { return x * x * x * y * y; };
+      std::cout << " x^3 y^2 over [0, 2] x [1, 3]: 7 point rule " << maths_ops::integrate_box(maths_ops::degree5_square_rule<double>(), 0., 2., 1., 3., poly2)
+         << ", Legendre 3 x 3 " << maths_ops::integrate_box(maths_ops::tensor_product_rule(legendre3, legendre3), 0., 2., 1., 3., poly2)
+         << " (expected " << 4. * 26. / 3. << ")" << std::endl;
+      auto poly3 = [](double x, double y, double z) { return x * x * y * z * z * z; };
+      std::cout << " x^2 y z^3 over [0, 1] x [0, 2] x [1, 2]: 14 point rule " << maths_ops::integrate_box(maths_ops::degree5_cube_rule<double>(), 0., 1., 0., 2., 1., 2., poly3)
+         << ", Legendre 3 x 3 x 3 " << maths_ops::integrate_box(maths_ops::tensor_product_rule(legendre3, legendre3, legendre3), 0., 1., 0., 2., 1., 2., poly3)
+         << " (expected 2.5)" << std::endl;
+
+      // The Sobol sequence, and quasi-Monte Carlo against a split box
+      maths_ops::sobol_sequence sobol(3);
+      double point[3];
+      std::cout << " First Sobol points:";
+      for (int i = 0; i < 6; ++i)
+      {
+         sobol.next(point);
+         std::cout << " (" << point[0] << ", " << point[1] << ", " << point[2] << ")";
+      }
+      std::cout << "\n  (expected (0, 0, 0) (0.5, 0.5, 0.5) (0.75, 0.25, 0.25) (0.25, 0.75, 0.75) (0.375, 0.375, 0.625) (0.875, 0.875, 0.125))" << std::endl;
+      auto smooth2 = [](double x, double y) { return std::exp(x + y); };
+      auto smooth3 = [](double x, double y, double z) { return std::exp(x + y + z); };
+      const double exact2 = (std::exp(1.) - 1.) * (std::exp(1.) - 1.);
+      const double exact3 = exact2 * (std::exp(1.) - 1.);
+      std::cout << std::setprecision(3) << " Errors for e^(x+y) over the unit square with 1024 and 65536 Sobol points: "
+         << maths_ops::integrate_box(maths_ops::sobol_rule<double, 2>(1024), 0., 1., 0., 1., smooth2) - exact2 << ", "
+         << maths_ops::integrate_box(maths_ops::sobol_rule<double, 2>(65536), 0., 1., 0., 1., smooth2) - exact2
+         << "; e^(x+y+z) over the unit cube: " << maths_ops::integrate_box(maths_ops::sobol_rule<double, 3>(1024), 0., 1., 0., 1., 0., 1., smooth3) - exact3
+         << ", " << maths_ops::integrate_box(maths_ops::sobol_rule<double, 3>(65536), 0., 1., 0., 1., 0., 1., smooth3) - exact3 << std::endl;
+      std::cout << std::setprecision(12) << " e^(x+y+z) with the 14 point rule on 4 x 4 x 4 boxes: "
+         << maths_ops::integrate_box(maths_ops::degree5_cube_rule<double>(), 0., 1., 0., 1., 0., 1., smooth3, 4, 4, 4) << " (expected " << exact3 << ")" << std::endl;
+
+      // Cells of a rotated raster. A linear integrand integrates to the cell area times 
+      // its value at the centre of the cell.
+      const size_t nrows = 300, ncols = 200, first_row = 10, first_col = 20;
+      double gt[6];
+      maths_ops::set_affine_geotransform(gt, 500000., 4200000., 30., 20., 0.5);
+      const double area = std::abs(gt[1] * gt[5] - gt[2] * gt[4]);
+      auto linear = [](double x, double y) { return x - 2. * y; };
+      auto linear_batch = [](const double* xs, const double* ys, double* values, size_t n) {
+         for (size_t i = 0; i < n; ++i)
+            values[i] = xs[i] - 2. * ys[i];
+      };
+      std::vector<double> cells_point(nrows * ncols), cells_batch(nrows * ncols);
+      const maths_ops::cubature_rule<double, 2> square = maths_ops::degree5_square_rule<double>();
+      maths_ops::integrate_raster_cells(cells_point.data(), first_row, nrows, first_col, ncols, gt, square, linear, 1);
+      maths_ops::integrate_raster_cells(cells_batch.data(), first_row, nrows, first_col, ncols, gt, square, linear_batch, 2);
+      double worst_cell = 0., worst_batch = 0.;
+      for (size_t r = 0; r < nrows; ++r)
+      {
+         for (size_t c = 0; c < ncols; ++c)
+         {
+            double xc, yc;
+            maths_ops::apply_geotransform(&xc, &yc, first_row + r + 0.5, first_col + c + 0.5, gt);
+            const size_t idx = maths_ops::get_row_major_linear_index(r, c, ncols);
+            worst_cell = std::max(worst_cell, std::abs(cells_point[idx] / area - linear(xc, yc)) / std::abs(linear(xc, yc)));
+            worst_batch = std::max(worst_batch, std::abs(cells_batch[idx] - cells_point[idx]) / std::abs(cells_point[idx]));
+         }
+      }
+      std::cout << std::setprecision(3) << " " << nrows << " x " << ncols << " rotated cells, largest relative error of the cell means: " << worst_cell
+         << ", batch on 2 threads against point: " << worst_batch << " (expected ~1e-16, ~1e-16)" << std::endl;
+
+      // The columns of air above the cells
+      std::vector<double> columns(nrows * ncols);
+      maths_ops::integrate_raster_cells(columns.data(), first_row, nrows, first_col, ncols, gt, 100., 300.,
+         maths_ops::sobol_rule<double, 3>(64), [](double, double, double z) { return z; }, 2);
+      double worst_column = 0.;
+      for (const double column : columns)
+         worst_column = std::max(worst_column, std::abs(column / (area * 200.) - 200.) / 200.);
+      std::cout << " Mean height of the columns over [100, 300] from 64 Sobol points, largest relative error: " << worst_column << " (expected ~1e-2)" << std::endl;
+   }
+
    // --- dot_product ---
    {
       // TODO
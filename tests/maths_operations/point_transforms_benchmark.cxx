@@ -0,0 +1,88 @@
+#include "maths_geometry/maths_operations.hpp"
+#include "benchmark_utils.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Compares the batch (structure of arrays) point transforms against
+// a loop calling the scalar versions for each point.
+//
+// Usage: test-point-transforms-benchmark [number of points]
+
+template <typename T>
+void run_type(const char* type_name, const size_t n)
+{
+   const int repeats = 200;
+   T rotation_mat[4];
+   maths_ops::calculate_rotation_matrix(static_cast<T>(0.3), rotation_mat);
+
+   std::vector<T> xs(n), ys(n);
+   for (size_t i = 0; i < n; ++i)
+   {
+      xs[i] = static_cast<T>(i % 1000);
+      ys[i] = static_cast<T>(i / 1000);
+   }
+
+   struct Case
+   {
+      std::string name;
+      double scalar_ns;
+      double batch_ns;
+   };
+   std::vector<Case> cases;
+
+   cases.push_back({ "translate_point",
+      run_case(repeats, [&]() {
+         for (size_t i = 0; i < n; ++i)
+            maths_ops::translate_point(&xs[i], &ys[i], static_cast<T>(0.5), static_cast<T>(-0.5));
+      }),
+      run_case(repeats, [&]() {
+         maths_ops::translate_point(xs.data(), ys.data(), n, static_cast<T>(0.5), static_cast<T>(-0.5));
+      }) });
+
+   cases.push_back({ "rotate_point",
+      run_case(repeats, [&]() {
+         for (size_t i = 0; i < n; ++i)
+            maths_ops::rotate_point(&xs[i], &ys[i], rotation_mat);
+      }),
+      run_case(repeats, [&]() {
+         maths_ops::rotate_point(xs.data(), ys.data(), n, rotation_mat);
+      }) });
+
+   cases.push_back({ "rotate_point_about",
+      run_case(repeats, [&]() {
+         for (size_t i = 0; i < n; ++i)
+            maths_ops::rotate_point_about(&xs[i], &ys[i], rotation_mat, static_cast<T>(500), static_cast<T>(500));
+      }),
+      run_case(repeats, [&]() {
+         maths_ops::rotate_point_about(xs.data(), ys.data(), n, rotation_mat, static_cast<T>(500), static_cast<T>(500));
+      }) });
+
+   for (const auto& c : cases)
+   {
+      std::cout << std::left << std::setw(8) << type_name << std::setw(20) << c.name << std::right << std::fixed
+         << " scalar " << std::setw(8) << std::setprecision(3) << c.scalar_ns / static_cast<double>(n) << " ns/point"
+         << "  batch " << std::setw(8) << c.batch_ns / static_cast<double>(n) << " ns/point"
+         << "  speedup " << std::setprecision(1) << c.scalar_ns / c.batch_ns << "x" << std::endl;
+   }
+
+   // Keep the results alive
+   T checksum = 0;
+   for (size_t i = 0; i < n; i += 997)
+      checksum += xs[i] + ys[i];
+   std::cout << "(checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+   const size_t n = argc > 1 ? static_cast<size_t>(std::atoll(argv[1])) : 1000000;
+   std::cout << "Points: " << n << std::endl;
+
+   run_type<float>("float", n);
+   run_type<double>("double", n);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/maths_operations_simd.hpp"
+#include "maths_geometry/polygon.hpp"
+#include "benchmark_utils.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Time per raster cell to mark the cells of a grid whose centres are inside a polygon:
+// an even-odd loop over all the edges for each centre, points_in_polygon over the
+// centres from apply_geotransform_grid, and polygon_mask.
+//
+// Usage: test-polygon-mask-benchmark [grid side in cells] [number of vertices] [threads, 0 for all]
+
+int main(int argc, char* argv[])
+{
+   const size_t side = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+   const size_t nvertices = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000;
+   const unsigned nthreads = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 0;
+   const size_t ncells = side * side;
+   std::cout << "Grid: " << side << " x " << side << ", polygon of " << nvertices << " vertices, threads " << nthreads << std::endl;
+
+   // A wavy ring filling about half the grid
+   std::vector<double> pxs(nvertices), pys(nvertices);
+   for (size_t i = 0; i < nvertices; ++i)
+   {
+      const double angle = 2. * M_PI * static_cast<double>(i) / static_cast<double>(nvertices);
+      const double radius = 0.4 * static_cast<double>(side) * (1. + 0.2 * std::sin(13. * angle));
+      pxs[i] = 350000. + 0.5 * static_cast<double>(side) + radius * std::cos(angle);
+      pys[i] = 4200000. - 0.5 * static_cast<double>(side) + radius * std::sin(angle);
+   }
+   double geotransform[6];
+   maths_ops::set_affine_geotransform(geotransform, 350000. - 0.5, 4200000. + 0.5, 1., 1., 0.);
+
+   std::vector<double> xs(ncells), ys(ncells);
+   maths_ops::apply_geotransform_grid(xs.data(), ys.data(), side, side, geotransform, nthreads);
+   std::vector<uint8_t> mask(ncells);
+   size_t sink = 0;
+
+   auto report = [&](const char* name, const double ns, const double reference_ns) {
+      std::cout << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(3) << std::setw(10)
+         << ns / static_cast<double>(ncells) << " ns/cell  speedup " << std::setprecision(1) << std::setw(8) << reference_ns / ns << "x" << std::endl;
+   };
+
+   // The loop over all the edges is slow, so it is timed on a sample of rows
+   const size_t sample_rows = std::max<size_t>(1, side / 50);
+   const double ref = run_case(1, [&]() {
+      for (size_t r = 0; r < side; r += side / sample_rows)
+      {
+         for (size_t k = r * side; k < (r + 1) * side; ++k)
+         {
+            bool in = false;
+            for (size_t i = 0, j = nvertices - 1; i < nvertices; j = i++)
+            {
+               if ((pys[i] > ys[k]) != (pys[j] > ys[k]) && xs[k] < pxs[i] + (ys[k] - pys[i]) * (pxs[j] - pxs[i]) / (pys[j] - pys[i]))
+                  in = !in;
+            }
+            sink += in ? 1 : 0;
+         }
+      }
+   }) * static_cast<double>(side) / static_cast<double>((side + side / sample_rows - 1) / (side / sample_rows));
+   report("all edges per centre", ref, ref);
+
+   const int repeats = 5;
+   const double build_ns = run_case(repeats, [&]() {
+      const maths_ops::polygon_edge_table<double> polygon(pxs.data(), pys.data(), nvertices);
+      sink += polygon.bands();
+   });
+   std::cout << std::left << std::setw(34) << "edge table build" << std::right << std::fixed << std::setprecision(3) << std::setw(10)
+      << build_ns / 1e3 << " us" << std::endl;
+   const maths_ops::polygon_edge_table<double> polygon(pxs.data(), pys.data(), nvertices);
+   report("points_in_polygon", run_case(repeats, [&]() {
+      maths_ops::points_in_polygon(mask.data(), xs.data(), ys.data(), ncells, polygon, nthreads);
+      sink += mask[ncells / 2];
+   }), ref);
+   report("polygon_mask", run_case(repeats, [&]() {
+      maths_ops::polygon_mask(mask.data(), side, side, geotransform, polygon, nthreads);
+      sink += mask[ncells / 2];
+   }), ref);
+
+   std::cout << "(checksum " << sink << ")" << std::endl;
+   return EXIT_SUCCESS;
+}
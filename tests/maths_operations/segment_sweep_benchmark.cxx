@@ -0,0 +1,57 @@
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/segment_intersection.hpp"
+#include "benchmark_utils.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// Time to find every crossing of a coastline-like polyline: testing all the
+// pairs with segments_intersect, and the sweep of find_segment_intersections.
+//
+// Usage: test-segment-sweep-benchmark [number of segments]
+
+int main(int argc, char* argv[])
+{
+   const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+   std::cout << "Segments: " << n << std::endl;
+
+   // A closed wandering line that crosses itself now and then
+   std::vector<double> x1(n), y1(n), x2(n), y2(n);
+   for (size_t i = 0; i < n; ++i)
+   {
+      const double t = static_cast<double>(i);
+      const double angle = 2. * M_PI * t / static_cast<double>(n);
+      const double radius = 1000. * (1. + 0.3 * std::sin(17. * angle));
+      x1[i] = i == 0 ? 350000. + radius : x2[i - 1];
+      y1[i] = i == 0 ? 4200000. : y2[i - 1];
+      x2[i] = i + 1 == n ? 350000. + 1000. : 350000. + radius * std::cos(angle) + 0.05 * std::sin(1.7 * t);
+      y2[i] = i + 1 == n ? 4200000. : 4200000. + radius * std::sin(angle) + 0.05 * std::cos(1.3 * t);
+   }
+
+   // All the pairs is slow, so it is timed on the first segments against the rest
+   const size_t sample = std::max<size_t>(1, n / 200);
+   size_t sink = 0;
+   const double brute = run_case(1, [&]() {
+      for (size_t i = 0; i < sample; ++i)
+      {
+         for (size_t j = i + 1; j < n; ++j)
+            sink += maths_ops::segments_intersect(x1[i], y1[i], x2[i], y2[i], x1[j], y1[j], x2[j], y2[j]) ? 1 : 0;
+      }
+   }) * (static_cast<double>(n) * static_cast<double>(n - 1) / 2.) / (static_cast<double>(sample) * (static_cast<double>(n) - static_cast<double>(sample + 1) / 2.));
+
+   std::vector<std::pair<size_t, size_t>> pairs;
+   const double sweep = run_case(1, [&]() {
+      maths_ops::find_segment_intersections(pairs, x1.data(), y1.data(), x2.data(), y2.data(), n, true);
+   });
+
+   std::cout << std::fixed << std::setprecision(3);
+   std::cout << "all pairs (estimated)   " << std::setw(12) << brute / 1e6 << " ms" << std::endl;
+   std::cout << "sweep                   " << std::setw(12) << sweep / 1e6 << " ms  speedup " << std::setprecision(1) << brute / sweep
+      << "x, " << pairs.size() << " crossings" << std::endl;
+   std::cout << "(checksum " << sink << ")" << std::endl;
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#include "maths_geometry/maths_operations_simd.hpp"
+#include "benchmark_utils.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Time per point of the array distance functions with each instruction set
+// the CPU supports, against a loop calling the scalar functions (and std::atan2).
+//
+// Usage: test-simd-distance-benchmark [number of points]
+
+template <typename T>
+void run_type(const char* type_name, const size_t n)
+{
+   const int repeats = 50;
+   const char* level_names[] = { "scalar", "avx2", "avx512" };
+
+   std::vector<T> xs(n), ys(n), out(n);
+   for (size_t i = 0; i < n; ++i)
+   {
+      xs[i] = static_cast<T>(100. * std::cos(0.001 * i));
+      ys[i] = static_cast<T>(100. * std::sin(0.0013 * i));
+   }
+   // The other point moves with the repeat, so that repeats cannot be merged
+   const T x0 = static_cast<T>(1.5);
+   const T y = static_cast<T>(-2.5);
+   T sink = 0;
+
+   auto report = [&](const char* name, const char* variant, const double ns, const double reference_ns) {
+      std::cout << std::left << std::setw(8) << type_name << std::setw(25) << name << std::setw(12) << variant
+         << std::right << std::fixed << std::setprecision(3) << std::setw(8) << ns / static_cast<double>(n) << " ns/point"
+         << "  speedup " << std::setprecision(1) << std::setw(5) << reference_ns / ns << "x" << std::endl;
+   };
+
+   // References: loops over the scalar functions
+   const double ref_d2 = run_case(repeats, [&](const double r) {
+      const T x = x0 + static_cast<T>(r);
+      for (size_t i = 0; i < n; ++i)
+         out[i] = maths_ops::points_squared_distance(xs[i], ys[i], x, y);
+   });
+   const double ref_d = run_case(repeats, [&](const double r) {
+      const T x = x0 + static_cast<T>(r);
+      for (size_t i = 0; i < n; ++i)
+         out[i] = maths_ops::points_distance(xs[i], ys[i], x, y);
+   });
+   const double ref_dir = run_case(repeats, [&](const double) {
+      for (size_t i = 0; i < n; ++i)
+         out[i] = maths_ops::vector_direction(xs[i], ys[i]);
+   });
+   const double ref_nearest = run_case(repeats, [&](const double r) {
+      const T x = x0 + static_cast<T>(r);
+      size_t nearest = 0;
+      T best = maths_ops::points_squared_distance(xs[0], ys[0], x, y);
+      for (size_t i = 1; i < n; ++i)
+      {
+         const T d2 = maths_ops::points_squared_distance(xs[i], ys[i], x, y);
+         if (d2 < best)
+         {
+            best = d2;
+            nearest = i;
+         }
+      }
+      sink += static_cast<T>(nearest);
+   });
+   report("points_squared_distance", "scalar loop", ref_d2, ref_d2);
+   report("points_distance", "scalar loop", ref_d, ref_d);
+   report("vector_direction", "std::atan2", ref_dir, ref_dir);
+   report("nearest_point", "scalar loop", ref_nearest, ref_nearest);
+
+   const maths_ops::simd_level best = maths_ops::detect_simd_level();
+   for (int level = 0; level <= static_cast<int>(best); ++level)
+   {
+      maths_ops::set_simd_level(static_cast<maths_ops::simd_level>(level));
+      const char* variant = level_names[level];
+
+      report("points_squared_distance", variant, run_case(repeats, [&](const double r) {
+         const T x = x0 + static_cast<T>(r);
+         maths_ops::points_squared_distance(out.data(), xs.data(), ys.data(), n, x, y);
+      }), ref_d2);
+      report("points_distance", variant, run_case(repeats, [&](const double r) {
+         const T x = x0 + static_cast<T>(r);
+         maths_ops::points_distance(out.data(), xs.data(), ys.data(), n, x, y);
+      }), ref_d);
+      report("vector_direction_fast", variant, run_case(repeats, [&](const double) {
+         maths_ops::vector_direction_fast(out.data(), xs.data(), ys.data(), n);
+      }), ref_dir);
+      report("nearest_point", variant, run_case(repeats, [&](const double r) {
+         const T x = x0 + static_cast<T>(r);
+         sink += static_cast<T>(maths_ops::nearest_point(static_cast<T*>(nullptr), xs.data(), ys.data(), n, x, y));
+      }), ref_nearest);
+   }
+   maths_ops::set_simd_level(best);
+
+   std::cout << "(checksum " << sink + out[n / 2] << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+   const size_t n = argc > 1 ? static_cast<size_t>(std::atoll(argv[1])) : 100000;
+   std::cout << "Points: " << n << std::endl;
+
+   run_type<float>("float", n);
+   run_type<double>("double", n);
+
+   return EXIT_SUCCESS;
+}
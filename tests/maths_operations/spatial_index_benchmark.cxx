@@ -0,0 +1,98 @@
+#include "maths_geometry/maths_operations.hpp"
+#include "maths_geometry/maths_operations_simd.hpp"
+#include "maths_geometry/spatial_index.hpp"
+#include "benchmark_utils.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Time per query point to find the nearest of a set of stations: the SIMD
+// nearest_points over all the stations, and the uniform grid and KD-tree indexes
+// (building them and querying them). The stations are either spread evenly or clustered.
+//
+// Usage: test-spatial-index-benchmark [number of stations] [number of query points] [threads, 0 for all]
+
+void run_layout(const char* layout, const bool clustered, const size_t n, const size_t m, const unsigned nthreads)
+{
+   std::vector<double> xs(n), ys(n);
+   for (size_t i = 0; i < n; ++i)
+   {
+      // Clustered: a tenth of the stations spread out, the rest around 20 towns
+      const double t = static_cast<double>(i);
+      const bool town = clustered && i % 10 != 0;
+      const double cx = town ? 100000. * std::sin(3.1 * static_cast<double>(i % 20)) : 0.;
+      const double cy = town ? 100000. * std::cos(1.7 * static_cast<double>(i % 20)) : 0.;
+      const double spread = town ? 2000. : 100000.;
+      xs[i] = 350000. + cx + spread * std::sin(0.7137 * t);
+      ys[i] = 4200000. + cy + spread * std::cos(1.3711 * t);
+   }
+   std::vector<double> qxs(m), qys(m);
+   for (size_t q = 0; q < m; ++q)
+   {
+      qxs[q] = 350000. + 100000. * std::sin(0.419 * static_cast<double>(q));
+      qys[q] = 4200000. + 100000. * std::cos(0.877 * static_cast<double>(q));
+   }
+   std::vector<size_t> nearest(m);
+   std::vector<double> d2(m);
+   size_t sink = 0;
+
+   auto report = [&](const char* name, const double ns, const size_t count, const double reference_ns) {
+      std::cout << std::left << std::setw(10) << layout << std::setw(26) << name << std::right << std::fixed << std::setprecision(3)
+         << std::setw(12) << ns / static_cast<double>(count) << " ns/query";
+      if (reference_ns > 0.)
+         std::cout << "  speedup " << std::setprecision(1) << std::setw(8) << reference_ns / ns * static_cast<double>(count) / static_cast<double>(m) << "x";
+      std::cout << std::endl;
+   };
+
+   // Testing every station is slow, so it is timed on a sample of the queries
+   const size_t sample = std::max<size_t>(1, m / 1000);
+   const double ref = run_case(1, [&]() {
+      maths_ops::nearest_points(nearest.data(), d2.data(), qxs.data(), qys.data(), sample, xs.data(), ys.data(), n);
+      sink += nearest[0];
+   }) * static_cast<double>(m) / static_cast<double>(sample);
+   report("all stations (SIMD)", ref, m, 0.);
+
+   double build = run_case(1, [&]() {
+      const maths_ops::uniform_grid_index<double> grid(xs.data(), ys.data(), n, 0., nthreads);
+      sink += grid.size();
+   });
+   const maths_ops::uniform_grid_index<double> grid(xs.data(), ys.data(), n, 0., nthreads);
+   const double grid_query = run_case(1, [&]() {
+      maths_ops::nearest_points(nearest.data(), d2.data(), grid, qxs.data(), qys.data(), m, nthreads);
+      sink += nearest[m / 2];
+   });
+   std::cout << std::left << std::setw(10) << layout << std::setw(26) << "grid build" << std::right << std::fixed
+      << std::setprecision(3) << std::setw(12) << build / 1e6 << " ms" << std::endl;
+   report("grid query", grid_query, m, ref);
+
+   build = run_case(1, [&]() {
+      const maths_ops::kd_tree<double> tree(xs.data(), ys.data(), n, nthreads);
+      sink += tree.size();
+   });
+   const maths_ops::kd_tree<double> tree(xs.data(), ys.data(), n, nthreads);
+   const double tree_query = run_case(1, [&]() {
+      maths_ops::nearest_points(nearest.data(), d2.data(), tree, qxs.data(), qys.data(), m, nthreads);
+      sink += nearest[m / 2];
+   });
+   std::cout << std::left << std::setw(10) << layout << std::setw(26) << "kd-tree build" << std::right << std::fixed
+      << std::setprecision(3) << std::setw(12) << build / 1e6 << " ms" << std::endl;
+   report("kd-tree query", tree_query, m, ref);
+
+   std::cout << "(checksum " << sink << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+   const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+   const size_t m = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+   const unsigned nthreads = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 0;
+   std::cout << "Stations: " << n << ", query points: " << m << ", threads " << nthreads << std::endl;
+
+   run_layout("even", false, n, m, nthreads);
+   run_layout("clustered", true, n, m, nthreads);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#include "time_utilities/scoped_timer.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    void sleep_for_ms(const int ms)
+    {
+        TIMEUTILS_SCOPED_TIMER("sleep");
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+
+    double busy_work(const int n)
+    {
+        TIMEUTILS_SCOPED_TIMER("busy");
+        double sum = 0.0;
+        for (int i = 1; i <= n; ++i)
+            sum += 1.0 / i;
+        return sum;
+    }
+
+    void print(const timeutils::TimerSummary& summary)
+    {
+        std::cout << summary.name << ": count=" << summary.count
+            << " min=" << timeutils::format_duration(summary.min)
+            << " max=" << timeutils::format_duration(summary.max)
+            << " p50=" << timeutils::format_duration(summary.p50)
+            << " p99=" << timeutils::format_duration(summary.p99) << std::endl;
+    }
+}
+
+int main()
+{
+    // Bucket boundaries: exact below 16 ns, then within 1/8 of a power of two
+    timeutils::DurationHistogram histogram;
+    for (std::uint64_t ns = 1; ns <= 1000; ++ns)
+        histogram.record(ns * 1000);
+    std::cout << "Histogram count " << histogram.get_count() << " (expected 1000)" << std::endl;
+    std::cout << "Histogram min " << histogram.get_min() << " max " << histogram.get_max() << " (expected 1000 1000000)" << std::endl;
+    std::cout << "Histogram p50 " << histogram.percentile(0.5) << " (expected ~500000, to within a bucket)" << std::endl;
+    std::cout << "Histogram p99 " << histogram.percentile(0.99) << " (expected ~990000, to within a bucket)" << std::endl;
+
+    // Five 20 ms sleeps on this thread, and busy work on four threads
+    for (int i = 0; i < 5; ++i)
+        sleep_for_ms(20);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t)
+    {
+        workers.emplace_back([]() {
+            for (int i = 0; i < 250; ++i)
+                busy_work(10000);
+        });
+    }
+    // Summaries can be taken while the threads record
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::cout << "Zones while recording: " << timeutils::TimerRegistry::instance().summaries().size() << std::endl;
+    for (auto& w : workers)
+        w.join();
+
+    // The records of threads that have exited are kept
+    const auto summaries = timeutils::TimerRegistry::instance().summaries();
+    for (const auto& summary : summaries)
+        print(summary);
+    std::cout << "(expected sleep: count=5, ~20 ms; busy: count=1000)" << std::endl;
+
+    // Trace of two parallel stages, open it in chrome://tracing or ui.perfetto.dev
+    timeutils::TimerRegistry& registry = timeutils::TimerRegistry::instance();
+    registry.set_tracing(true);
+    registry.set_thread_name("main");
+    {
+        TIMEUTILS_SCOPED_TIMER("stages");
+        for (int stage = 0; stage < 2; ++stage)
+        {
+            std::vector<std::thread> stage_workers;
+            for (int t = 0; t < 3; ++t)
+            {
+                stage_workers.emplace_back([t]() {
+                    timeutils::TimerRegistry::instance().set_thread_name("worker " + std::to_string(t));
+                    for (int i = 0; i < 100 * (t + 1); ++i)
+                        busy_work(10000);
+                });
+            }
+            for (auto& w : stage_workers)
+                w.join();
+        }
+
+        // A region timed with a plain Stopwatch
+        static const timeutils::TimerZone stopwatch_zone("stopwatch");
+        timeutils::Stopwatch<std::chrono::nanoseconds> stopwatch;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        registry.record(stopwatch_zone.id, stopwatch.start, static_cast<std::uint64_t>(stopwatch.elapsed()));
+    }
+    registry.set_tracing(false);
+    busy_work(10);
+
+    // Written to the temporary directory, so that the test leaves no file behind in the tree
+    const std::string trace_path = (std::filesystem::temp_directory_path() / "scoped-timer-trace.json").string();
+    if (!registry.write_chrome_trace(trace_path))
+    {
+        std::cerr << "Error: cannot write " << trace_path << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::ifstream in(trace_path);
+    std::stringstream trace;
+    trace << in.rdbuf();
+    const std::string text = trace.str();
+    std::size_t events = 0;
+    for (std::size_t pos = text.find("\"ph\":\"X\""); pos != std::string::npos; pos = text.find("\"ph\":\"X\"", pos + 1))
+        ++events;
+    std::cout << "Trace events in " << trace_path << ": " << events << " (expected 1202)" << std::endl;
+
+    return EXIT_SUCCESS;
+}